@@ -27,16 +27,160 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #define INTEL_COPYRIGHT \
   "Copyright (c) 2017, Intel Corporation. All rights reserved."
 
+//
+// Block-split stream header, see LZ4_BLOCK_HEADER in Lz4DecompressLib.h
+//
+typedef struct {
+  unsigned int  DecompressedSize;
+  unsigned int  BlockSize;
+  unsigned int  BlockCount;
+} BLOCK_HEADER;
+
 void PrintHelp (void)
 {
   printf (   "\n" UTILITY_NAME " - " INTEL_COPYRIGHT "\n"
-             "\nUsage:  Lz4Compress -e|-d  -o <outputFile>  <inputFile>\n"
+             "\nUsage:  Lz4Compress -e|-d  [-b <blockSize>]  -o <outputFile>  <inputFile>\n"
              "  -e: encode file\n"
              "  -d: decode file\n"
+             "  -b BlockSize: use block-split format with independent blocks of BlockSize bytes\n"
              "  -o FileName, --output FileName: specify the output filename\n"
              );
 }
 
+/*++
+
+Routine Description:
+
+  Compress the input into the block-split format. Every block is compressed
+  independently so that blocks can be decompressed in parallel.
+
+Arguments:
+
+  bufi            - input buffer
+  inpsz           - input buffer size
+  blksz           - block size
+  bufo            - pointer to receive the allocated output buffer
+
+Returns:
+
+  > 0           output size
+  <= 0          failure
+
+--*/
+int
+BlockCompress (
+  const char   *bufi,
+  int           inpsz,
+  int           blksz,
+  char        **bufo
+  )
+{
+  BLOCK_HEADER  *hdr;
+  unsigned int  *csz;
+  char          *out;
+  int            cnt;
+  int            idx;
+  int            len;
+  int            res;
+  int            pos;
+  int            bufsz;
+
+  cnt   = (inpsz + blksz - 1) / blksz;
+  pos   = sizeof(BLOCK_HEADER) + cnt * sizeof(unsigned int);
+  bufsz = pos + cnt * LZ4_compressBound(blksz);
+  out   = (char *)malloc(bufsz);
+  *bufo = out;
+  if (out == NULL) {
+    return -1;
+  }
+
+  hdr = (BLOCK_HEADER *)out;
+  csz = (unsigned int *)(hdr + 1);
+  hdr->DecompressedSize = inpsz;
+  hdr->BlockSize        = blksz;
+  hdr->BlockCount       = cnt;
+  for (idx = 0; idx < cnt; idx++) {
+    len = inpsz - idx * blksz;
+    if (len > blksz) {
+      len = blksz;
+    }
+    res = LZ4_compress_HC(bufi + idx * blksz, out + pos, len, bufsz - pos, 0);
+    if (res <= 0) {
+      return -1;
+    }
+    csz[idx] = res;
+    pos     += res;
+  }
+
+  return pos;
+}
+
+/*++
+
+Routine Description:
+
+  Decompress a block-split input buffer.
+
+Arguments:
+
+  bufi            - input buffer
+  inpsz           - input buffer size
+  bufo            - pointer to receive the allocated output buffer
+
+Returns:
+
+  > 0           output size
+  <= 0          failure
+
+--*/
+int
+BlockDecompress (
+  const char   *bufi,
+  int           inpsz,
+  char        **bufo
+  )
+{
+  const BLOCK_HEADER  *hdr;
+  const unsigned int  *csz;
+  char                *out;
+  unsigned int         idx;
+  int                  len;
+  int                  res;
+  int                  pos;
+
+  *bufo = NULL;
+  hdr   = (const BLOCK_HEADER *)bufi;
+  if ((inpsz < (int)sizeof(BLOCK_HEADER)) || (hdr->BlockSize == 0) ||
+      (hdr->BlockCount > (inpsz - sizeof(BLOCK_HEADER)) / sizeof(unsigned int))) {
+    return -1;
+  }
+
+  out = (char *)malloc(hdr->DecompressedSize);
+  *bufo = out;
+  if (out == NULL) {
+    return -1;
+  }
+
+  csz = (const unsigned int *)(hdr + 1);
+  pos = sizeof(BLOCK_HEADER) + hdr->BlockCount * sizeof(unsigned int);
+  for (idx = 0; idx < hdr->BlockCount; idx++) {
+    len = hdr->DecompressedSize - idx * hdr->BlockSize;
+    if (len > (int)hdr->BlockSize) {
+      len = hdr->BlockSize;
+    }
+    if ((len <= 0) || (csz[idx] > (unsigned int)(inpsz - pos))) {
+      return -1;
+    }
+    res = LZ4_decompress_safe(bufi + pos, out + idx * hdr->BlockSize, csz[idx], len);
+    if (res != len) {
+      return -1;
+    }
+    pos += csz[idx];
+  }
+
+  return hdr->DecompressedSize;
+}
+
 
 int
 main (
@@ -69,6 +213,7 @@ Returns:
 	int    res;
 	int    decompress;
 	int    inpsz;
+	int    blksz;
 	char   *bufi;
 	char   *bufo;
 	char   *input;
@@ -81,6 +226,7 @@ Returns:
 	output = NULL;
 	input  = NULL;
 	decompress = -1;
+	blksz  = 0;
 
   if (argc < 5) {
     PrintHelp ();
@@ -93,6 +239,15 @@ Returns:
 				decompress = 1;
       } else if (!strcmp(argv[i], "-e")) {
 				decompress = 0;
+			} else if (!strcmp(argv[i], "-b")) {
+        if (i+1 < argc) {
+          blksz = (int)strtol(argv[i+1], NULL, 0);
+          i++;
+        }
+        if (blksz <= 0) {
+          printf("Invalid block size!\n");
+          return -1;
+        }
 			} else if (!strcmp(argv[i], "-o")) {
         if (i+1 < argc) {
           output =  argv[i+1];
@@ -140,7 +295,15 @@ Returns:
   }
 	fclose(fp);
 
-	if (decompress == 1) {
+	if (bufi == NULL) {
+		res = -1;
+	} else if (blksz > 0) {
+		if (decompress == 1) {
+			res = BlockDecompress (bufi, inpsz, &bufo);
+		} else {
+			res = BlockCompress (bufi, inpsz, blksz, &bufo);
+		}
+	} else if (decompress == 1) {
 		sz = *(int *)bufi;
 		if ((sz < 0) || (inpsz < sizeof(int))) {
 			res = -1;
@@ -163,7 +326,7 @@ Returns:
 		if (!fp) {
 			printf("Cannot create file '%s' !\n", output);
 		} else {
-      if (!decompress) {
+      if (!decompress && (blksz == 0)) {
         fwrite(&inpsz, sizeof(int), 1, fp);
       }
       fwrite(bufo, res, 1, fp);
@@ -1,7 +1,7 @@
 /** @file
   This file defines the hob structure for performance data.
 
-  Copyright (c) 2017, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2017 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -10,6 +10,7 @@
 #define __PERFORMANCE_INFO_GUID_H__
 
 extern EFI_GUID gLoaderPerformanceInfoGuid;
+extern EFI_GUID gLoaderComponentProfileGuid;
 
 #pragma pack(1)
 
@@ -22,6 +23,98 @@ typedef struct {
   UINT64    TimeStamp[0];
 } PERFORMANCE_INFO;
 
+//
+// Boot timeline exported from the measure points.
+// All the fields are little endian and the times are in nanoseconds.
+//
+#define PERF_TIMELINE_SIGNATURE          SIGNATURE_32 ('P', 'T', 'L', 'N')
+#define PERF_TIMELINE_REVISION           1
+#define PERF_TIMELINE_MAX_SPANS          96
+
+//
+// Span types, one nesting depth per type
+//
+#define PERF_SPAN_TYPE_STAGE             0    // Id is the stage number (1 - Stage1A ... 4 - Payload)
+#define PERF_SPAN_TYPE_STEP              1    // Id is the measure point closing the span
+#define PERF_SPAN_TYPE_FSP               2    // Id is the FSP entry measure point
+
+typedef struct {
+  UINT16    Id;
+  UINT8     Type;
+  UINT8     Depth;
+  UINT32    Reserved;
+  UINT64    StartNs;
+  UINT64    EndNs;
+} PERF_TIMELINE_SPAN;
+
+typedef struct {
+  UINT32              Signature;
+  UINT16              Revision;
+  UINT16              Count;
+  UINT32              Length;
+  UINT32              Reserved;
+  PERF_TIMELINE_SPAN  Span[0];
+} PERF_TIMELINE;
+
+//
+// Each span is also published as a platform firmware vendor record in the
+// ACPI FPDT Firmware Basic Boot Performance Table, after the basic boot record.
+//
+#define PERF_TIMELINE_FPDT_RECORD_TYPE       0x1000
+#define PERF_TIMELINE_FPDT_RECORD_REVISION   1
+
+typedef struct {
+  UINT16              Type;
+  UINT8               Length;
+  UINT8               Revision;
+  PERF_TIMELINE_SPAN  Span;
+} PERF_TIMELINE_FPDT_RECORD;
+
+//
+// Per-component load profile recorded by the container library.
+// Stage2 passes the records to the payload in a HOB with room for the
+// payload to append the components it loads itself.
+//
+#define COMPONENT_PROFILE_REVISION       1
+#define COMPONENT_PROFILE_MAX_ENTRIES    32
+
+//
+// Load phases, the time of each phase is in microseconds.
+// Hash only authentication is accounted to the hash phase. RSA signature
+// verification hashes the data internally, so it is all accounted to the
+// verify phase.
+//
+#define COMPONENT_PHASE_LOCATE           0
+#define COMPONENT_PHASE_COPY             1
+#define COMPONENT_PHASE_HASH             2
+#define COMPONENT_PHASE_VERIFY           3
+#define COMPONENT_PHASE_DECOMPRESS       4
+#define COMPONENT_PHASE_MAX              5
+
+#define COMPONENT_PROFILE_FLAG_ASYNC     BIT0   // Loaded on an AP
+#define COMPONENT_PROFILE_FLAG_STREAMING BIT1   // Copied from flash and hashed in one pass, accounted to hash
+#define COMPONENT_PROFILE_FLAG_FAILED    BIT2   // Authentication or decompression failed
+
+typedef struct {
+  UINT32    ContainerSig;        // 0 for a component from the flash map
+  UINT32    ComponentName;
+  UINT32    CompressAlg;         // Compression signature, such as LZDM, LZ4 or LZMA
+  UINT32    CompressedSize;      // Signed data size including the compression header
+  UINT32    DecompressedSize;
+  UINT8     AuthType;
+  UINT8     Flags;
+  UINT16    Reserved;
+  UINT32    PhaseTime[COMPONENT_PHASE_MAX];
+} COMPONENT_PROFILE_ENTRY;
+
+typedef struct {
+  UINT16                   Revision;
+  UINT16                   Count;
+  UINT16                   MaxCount;
+  UINT16                   Reserved;
+  COMPONENT_PROFILE_ENTRY  Entry[0];
+} COMPONENT_PROFILE;
+
 #pragma pack()
 
 #endif
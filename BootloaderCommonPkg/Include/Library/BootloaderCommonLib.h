@@ -1,6 +1,6 @@
 /** @file
 
-  Copyright (c) 2017 - 2019, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2017 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -607,6 +607,30 @@ GetHashStorePtr (
   VOID
   );
 
+/**
+  This function retrieves component load profile pointer.
+
+  @retval    The component load profile pointer.
+
+**/
+VOID *
+EFIAPI
+GetComponentProfilePtr (
+  VOID
+  );
+
+/**
+  This function sets component load profile pointer.
+
+  @param ComponentProfile   The pointer to component load profile.
+
+**/
+VOID
+EFIAPI
+SetComponentProfilePtr (
+  IN VOID                 *ComponentProfile
+  );
+
 /**
   Match a given hash with the ones in hash store.
 
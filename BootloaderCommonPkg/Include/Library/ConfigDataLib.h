@@ -240,6 +240,25 @@ BuildConfigData (
   IN  UINT32      Length
   );
 
+/**
+  Build the configuration data tag index for the current platform ID.
+
+  The index resolves every tag in the configuration data blob against the
+  current platform ID so that the following lookups for the current platform
+  don't need to walk the whole blob.
+
+  @retval EFI_SUCCESS             The index was built successfully.
+  @retval EFI_NOT_FOUND           No configuration data blob is available.
+  @retval EFI_UNSUPPORTED         The blob is too big to be indexed.
+  @retval EFI_OUT_OF_RESOURCES    Not enough memory for the index.
+
+**/
+EFI_STATUS
+EFIAPI
+BuildConfigDataIndex (
+  VOID
+  );
+
 /**
   Get a full CFGDATA set length.
 
@@ -1,7 +1,7 @@
 /** @file
   Header file for container library implementation.
 
-  Copyright (c) 2019, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2019 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -10,6 +10,7 @@
 
 #include <Library/PcdLib.h>
 #include <Library/CryptoLib.h>
+#include <Guid/PerformanceInfoGuid.h>
 
 
 #define CONTAINER_LIST_SIGNATURE SIGNATURE_32('C','T','N', 'L')
@@ -56,6 +57,7 @@ typedef struct {
   UINT32           HeaderCache;
   UINT32           HeaderSize;
   UINT32           Base;
+  UINT32           DirOffset;   // Component directory offset in HeaderCache, 0 if not available
 } CONTAINER_ENTRY;
 
 typedef struct {
@@ -89,6 +91,33 @@ typedef struct {
   UINT8            HashData[0];
 } COMPONENT_ENTRY;
 
+//
+// State of a component load that is split into the prepare, execute and
+// finish phases, so that the execute phase can run on an AP.
+//
+typedef struct {
+  UINT32           ComponentId;
+  UINT32           ComponentName;
+  UINT32           CompressAlg;
+  UINT32           Usage;
+  UINT8            AuthType;
+  BOOLEAN          Async;
+  BOOLEAN          IsInFlash;
+  BOOLEAN          IsStreaming;
+  UINT8           *CompData;
+  UINT8           *HashData;
+  UINT8           *CompBuf;
+  VOID            *ScrBuf;
+  VOID            *AllocBuf;
+  VOID            *CompBase;
+  VOID            *ReqCompBase;
+  UINT32           SignedDataLen;
+  UINT32           DecompressedLen;
+  EFI_STATUS       AuthStatus;
+  EFI_STATUS       Status;
+  UINT64           PhaseTicks[COMPONENT_PHASE_MAX];
+} COMPONENT_LOAD_CONTEXT;
+
 
 /**
   Load a component from a container or flahs map to memory and call callback
@@ -117,6 +146,92 @@ LoadComponentWithCallback (
   IN     LOAD_COMPONENT_CALLBACK  LoadComponentCallback
   );
 
+/**
+  Prepare to load a component from a container or flash map to memory.
+
+  It locates the component and allocates all the buffers required to load it,
+  so that ExecuteComponentLoad () does not need to allocate any memory.
+  FinishComponentLoad () must be called to release the buffers afterwards.
+
+  If Async is TRUE, the load is prepared to be executed on an AP. Component
+  loads that cannot be authenticated without debug output, such as the RSA
+  signed ones, are not supported in this mode.
+
+  @param[in]  ContainerSig    Container signature or component type.
+  @param[in]  ComponentName   Component name.
+  @param[in]  Buffer          Existing buffer to load the component into, or NULL.
+  @param[in]  Length          Size of the existing buffer, 0 if unknown.
+  @param[in]  Async           Whether the load will be executed on an AP.
+  @param[out] Context         Pointer to receive the component load context.
+
+  @retval EFI_UNSUPPORTED          Unsupported AuthType or compression.
+  @retval EFI_NOT_FOUND            Cannot locate component.
+  @retval EFI_BUFFER_TOO_SMALL     Specified buffer size is too small.
+  @retval EFI_OUT_OF_RESOURCES     Failed to allocate the buffers.
+  @retval EFI_SUCCESS              The component load is ready to be executed.
+
+**/
+EFI_STATUS
+EFIAPI
+PrepareComponentLoad (
+  IN  UINT32                    ContainerSig,
+  IN  UINT32                    ComponentName,
+  IN  VOID                     *Buffer,  OPTIONAL
+  IN  UINT32                    Length,
+  IN  BOOLEAN                   Async,
+  OUT COMPONENT_LOAD_CONTEXT   *Context
+  );
+
+/**
+  Copy, authenticate and decompress a component prepared by PrepareComponentLoad ().
+
+  It does not allocate any memory. If the load was prepared with Async set to
+  TRUE and LoadComponentCallback is NULL, it does not print anything either,
+  so it can run on an AP.
+
+  @param[in,out] Context                Component load context.
+  @param[in]     LoadComponentCallback  Callback function pointer, or NULL.
+
+  @retval EFI_SECURITY_VIOLATION   Authentication failed.
+  @retval EFI_SUCCESS              The component has been loaded.
+  @retval Others                   Decompression failed.
+
+**/
+EFI_STATUS
+EFIAPI
+ExecuteComponentLoad (
+  IN OUT COMPONENT_LOAD_CONTEXT   *Context,
+  IN     LOAD_COMPONENT_CALLBACK   LoadComponentCallback
+  );
+
+/**
+  Complete a component load and release its temporary buffers.
+
+  For an async load, the progress callbacks that were skipped on the AP are
+  issued here in order. If the load was executed, its per phase timing is
+  appended to the component load profile. If the load failed or was never
+  executed, the buffer allocated for the component is freed as well.
+
+  @param[in,out] Context                Component load context.
+  @param[in]     LoadComponentCallback  Callback function pointer, or NULL.
+  @param[out]    Buffer                 Pointer to receive component base.
+  @param[out]    Length                 Pointer to receive component size.
+
+  @retval EFI_NOT_READY            The load was never executed.
+  @retval EFI_SECURITY_VIOLATION   Authentication failed.
+  @retval EFI_SUCCESS              The component has been loaded.
+  @retval Others                   Decompression failed.
+
+**/
+EFI_STATUS
+EFIAPI
+FinishComponentLoad (
+  IN OUT COMPONENT_LOAD_CONTEXT   *Context,
+  IN     LOAD_COMPONENT_CALLBACK   LoadComponentCallback,
+  OUT    VOID                    **Buffer,  OPTIONAL
+  OUT    UINT32                   *Length   OPTIONAL
+  );
+
 /**
   Locate a component region information from a container or flash map.
 
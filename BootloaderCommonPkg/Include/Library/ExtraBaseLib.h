@@ -44,4 +44,18 @@ AsmEnableAvx (
   VOID
 );
 
+/**
+  Read the extended control register XCR0 (XFEATURE_ENABLED_MASK).
+
+  It must only be called when CR4.OSXSAVE is set.
+
+  @retval  The value of XCR0.
+
+**/
+UINT64
+EFIAPI
+AsmReadXcr0 (
+  VOID
+  );
+
 #endif
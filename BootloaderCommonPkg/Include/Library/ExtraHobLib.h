@@ -0,0 +1,25 @@
+/** @file
+Header file for extra HOB routines
+
+Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _EXTRA_HOB_LIB_H_
+#define _EXTRA_HOB_LIB_H_
+
+/**
+  Returns the number of HOB list walks saved by the GUID HOB directory.
+
+  @return The number of GUID HOB searches answered from the directory,
+          or 0 if the directory is not available.
+
+**/
+UINT32
+EFIAPI
+GetHobDirectorySavedWalks (
+  VOID
+  );
+
+#endif
@@ -148,4 +148,21 @@ FatFsListDir (
   IN  CHAR16                                     *DirFilePath
   );
 
+/**
+  Get the metadata cache statistics of a file system.
+
+  @param[in]     FsHandle         file system handle.
+  @param[out]    CacheStats       Pointer to receive the cache statistics.
+
+  @retval EFI_SUCCESS             The statistics were returned.
+  @retval EFI_INVALID_PARAMETER   Parameter is not valid.
+
+**/
+EFI_STATUS
+EFIAPI
+FatFsGetCacheStats (
+  IN  EFI_HANDLE                                  FsHandle,
+  OUT FS_CACHE_STATS                             *CacheStats
+  );
+
 #endif // _FAT_LIB_H_
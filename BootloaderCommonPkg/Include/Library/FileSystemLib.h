@@ -13,6 +13,13 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/PartitionLib.h>
 #include <Guid/OsBootOptionGuid.h>
 
+typedef struct {
+  UINT32                CacheBlocks;
+  UINT32                BlockSize;
+  UINT32                Hits;
+  UINT32                Misses;
+} FS_CACHE_STATS;
+
 /**
   Initialize file systems.
 
@@ -145,6 +152,23 @@ EFI_STATUS
   IN  CHAR16                                     *DirFilePath
   );
 
+/**
+  Get the metadata cache statistics of a file system.
+
+  @param[in]     FsHandle         file system handle.
+  @param[out]    CacheStats       Pointer to receive the cache statistics.
+
+  @retval EFI_SUCCESS             The statistics were returned.
+  @retval EFI_INVALID_PARAMETER   Parameter is not valid.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *FS_GET_CACHE_STATS) (
+  IN  EFI_HANDLE                                  FsHandle,
+  OUT FS_CACHE_STATS                             *CacheStats
+  );
+
 /**
   Get SW partition no. of detected file system
 
@@ -307,6 +331,25 @@ ListDir (
   IN  CHAR16                                     *DirFilePath
   );
 
+/**
+  Get the metadata cache statistics of a file system.
+
+  @param[in]     FsHandle         file system handle.
+  @param[out]    CacheStats       Pointer to receive the cache statistics.
+
+  @retval EFI_SUCCESS             The statistics were returned.
+  @retval EFI_INVALID_PARAMETER   Parameter is not valid.
+  @retval EFI_NOT_READY           The file system is not initialized.
+  @retval EFI_UNSUPPORTED         The file system has no metadata cache.
+
+**/
+EFI_STATUS
+EFIAPI
+GetFileSystemCacheStats (
+  IN  EFI_HANDLE                                  FsHandle,
+  OUT FS_CACHE_STATS                             *CacheStats
+  );
+
 typedef struct {
   FS_INIT_FILE_SYSTEM                 InitFileSystem;
   FS_CLOSE_FILE_SYSTEM                CloseFileSystem;
@@ -315,6 +358,7 @@ typedef struct {
   FS_READ_FILE                        ReadFile;
   FS_CLOSE_FILE                       CloseFile;
   FS_LIST_DIR                         ListDir;
+  FS_GET_CACHE_STATS                  GetCacheStats;
 } FILE_SYSTEM_FUNC;
 
 #endif // _FAT_PEIM_H_
@@ -1,7 +1,7 @@
 /** @file
   Basic graphics rendering support
 
-  Copyright (c) 2017 - 2019, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2017 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -70,6 +70,9 @@ typedef struct {
   UINTN                         CursorY;
   EFI_GRAPHICS_OUTPUT_BLT_PIXEL ForegroundColor;
   EFI_GRAPHICS_OUTPUT_BLT_PIXEL BackgroundColor;
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL *ShadowBuf;
+  UINT16                        *DirtyStart;
+  UINT16                        *DirtyEnd;
 } FRAME_BUFFER_CONSOLE;
 
 /**
@@ -170,6 +173,22 @@ InitFrameBufferConsole (
   IN     UINTN                 OffY
   );
 
+/**
+  Release the shadow buffer of the frame buffer console.
+
+  Pending changes are copied to the frame buffer first, and the console draws
+  straight into the frame buffer afterwards. This is used to give the memory
+  back before the OS image is loaded.
+
+  @retval EFI_SUCCESS            The shadow buffer was released or not in use.
+
+**/
+EFI_STATUS
+EFIAPI
+ReleaseFrameBufferConsoleShadow (
+  VOID
+  );
+
 /**
   Scroll the console area of the screen up.
 
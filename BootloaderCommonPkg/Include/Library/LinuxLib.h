@@ -1,6 +1,6 @@
 /** @file
 
-  Copyright (c) 2011 - 2019, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2011 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -223,6 +223,64 @@ LoadBzImage (
   IN      UINT32                   CmdLineLen
   );
 
+/**
+  Get the placement requirement of a relocatable linux kernel image.
+
+  A boot loader that knows the placement in advance can load the image so
+  that its protected-mode kernel already sits at an acceptable run address,
+  and LoadBzImageInPlace() can then boot it without relocating it to
+  LINUX_KERNEL_BASE.
+
+  @param[in]  ImageBase      Memory address of a bzImage or its first 4KB.
+  @param[out] KernelOffset   Offset of the protected-mode kernel in the image.
+  @param[out] KernelAlign    Required alignment of the protected-mode kernel.
+  @param[out] KernelSize     Memory needed by the kernel from its run address.
+
+  @retval EFI_INVALID_PARAMETER   Input parameters are not valid.
+  @retval EFI_UNSUPPORTED         Not a bzImage or kernel is not relocatable.
+  @retval EFI_SUCCESS             Placement information is returned.
+**/
+EFI_STATUS
+EFIAPI
+GetBzImagePlacement (
+  IN  CONST VOID             *ImageBase,
+  OUT UINT32                 *KernelOffset,
+  OUT UINT32                 *KernelAlign,
+  OUT UINT32                 *KernelSize
+  );
+
+/**
+  Load linux kernel image and setup boot parameters, running the kernel in
+  place when the image buffer satisfies its placement requirement.
+
+  The protected-mode kernel is only copied to LINUX_KERNEL_BASE when it is not
+  relocatable, not aligned as required, or KernelBufLen does not cover the
+  memory returned by GetBzImagePlacement().
+
+  @param[in]  KernelBase     Memory address of an kernel image.
+  @param[in]  KernelBufLen   Bytes owned by the caller from KernelBase. 0 if unknown.
+  @param[in]  InitRdBase     Memory address of an InitRd image.
+  @param[in]  InitRdLen      InitRd image size.
+  @param[in]  CmdLineBase    Memory address of command line buffer.
+  @param[in]  CmdLineLen     Command line buffer size.
+  @param[out] CopiedLen      Bytes of kernel copied, 0 if run in place. Optional.
+
+  @retval EFI_INVALID_PARAMETER   Input parameters are not valid.
+  @retval EFI_UNSUPPORTED         Unsupported binary type.
+  @retval EFI_SUCCESS             Kernel is loaded successfully.
+**/
+EFI_STATUS
+EFIAPI
+LoadBzImageInPlace (
+  IN  CONST VOID                  *KernelBase,
+  IN      UINT32                   KernelBufLen,
+  IN  CONST VOID                  *InitRdBase,
+  IN      UINT32                   InitRdLen,
+  IN  CONST VOID                  *CmdLineBase,
+  IN      UINT32                   CmdLineLen,
+  OUT     UINT32                  *CopiedLen    OPTIONAL
+  );
+
 /**
   Update linux kernel boot parameters.
 
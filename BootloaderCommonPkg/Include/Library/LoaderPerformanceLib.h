@@ -1,6 +1,6 @@
 /** @file
 
-  Copyright (c) 2016 - 2017, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2016 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -8,6 +8,8 @@
 #ifndef _LOADER_PERF_LIB_H_
 #define _LOADER_PERF_LIB_H_
 
+#include <Guid/PerformanceInfoGuid.h>
+
 typedef CHAR8 * (EFIAPI *PERF_ID_TO_STR) (UINT32 Id);
 
 /**
@@ -48,5 +50,32 @@ PrintMeasurePoint (
   IN PERF_ID_TO_STR  PerfIdToStrTbl
   );
 
+/**
+  Build a boot timeline from the measure points.
+
+  Every measure point closes a step span that starts at the previous measure
+  point. The steps are grouped into stage spans by the upper nibble of their
+  Id, and the FSP API spans are added when the FSP performance HOBs are
+  available.
+
+  @param[in]      PerfData    Measure points to export.
+  @param[out]     Timeline    Buffer to receive the timeline. Optional.
+  @param[in, out] Size        On input, size of the Timeline buffer.
+                              On output, size of the complete timeline.
+
+  @retval EFI_SUCCESS             The timeline was exported.
+  @retval EFI_INVALID_PARAMETER   PerfData or Size is NULL.
+  @retval EFI_BUFFER_TOO_SMALL    The buffer is too small. Size is updated
+                                  with the required size.
+
+**/
+EFI_STATUS
+EFIAPI
+BuildPerfTimeline (
+  IN     BL_PERF_DATA    *PerfData,
+  OUT    PERF_TIMELINE   *Timeline  OPTIONAL,
+  IN OUT UINT32          *Size
+  );
+
 
 #endif
@@ -14,7 +14,24 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 
-#define  LZ4_SIGNATURE    SIGNATURE_32 ('L', 'Z', '4', ' ')
+#define  LZ4_SIGNATURE        SIGNATURE_32 ('L', 'Z', '4', ' ')
+#define  LZ4_BLOCK_SIGNATURE  SIGNATURE_32 ('L', 'Z', '4', 'B')
+
+///
+/// Block-split LZ4 stream header.
+///
+/// The decompressed data is split into BlockSize pieces (the last one may be
+/// shorter) and each piece is compressed as an independent LZ4 block without
+/// any dictionary. The header is followed by BlockCount UINT32 entries holding
+/// the compressed size of each block, and then by the compressed blocks back
+/// to back in the same order.
+///
+typedef struct {
+  UINT32        DecompressedSize;
+  UINT32        BlockSize;
+  UINT32        BlockCount;
+  UINT32        CompressedSize[0];
+} LZ4_BLOCK_HEADER;
 
 /**
   Given a LZ4 compressed source buffer, this function retrieves the size of
@@ -86,5 +103,98 @@ Lz4Decompress (
   IN OUT VOID    *Scratch
   );
 
+/**
+  Given a block-split LZ4 source buffer, this function retrieves the size of
+  the uncompressed buffer and the size of the scratch buffer required to
+  decompress it.
+
+  The scratch buffer is used to hold the source offset of every block.
+
+  @param  Source          The source buffer containing the compressed data.
+  @param  SourceSize      The size, in bytes, of the source buffer.
+  @param  DestinationSize A pointer to the size, in bytes, of the uncompressed buffer.
+  @param  ScratchSize     A pointer to the size, in bytes, of the scratch buffer.
+
+  @retval  RETURN_SUCCESS            The sizes were returned successfully.
+  @retval  RETURN_INVALID_PARAMETER  The block index table is not valid.
+
+**/
+RETURN_STATUS
+EFIAPI
+Lz4BlockDecompressGetInfo (
+  IN  CONST VOID  *Source,
+  IN  UINT32      SourceSize,
+  OUT UINT32      *DestinationSize,
+  OUT UINT32      *ScratchSize
+  );
+
+/**
+  Validate a block-split LZ4 source buffer and build its block offset table.
+
+  @param  Source          The source buffer containing the compressed data.
+  @param  SourceSize      The size, in bytes, of the source buffer.
+  @param  Scratch         The scratch buffer to receive the block offset table.
+  @param  BlockCount      A pointer to receive the number of blocks.
+
+  @retval  RETURN_SUCCESS            The block offset table was built successfully.
+  @retval  RETURN_INVALID_PARAMETER  The block index table is not valid.
+
+**/
+RETURN_STATUS
+EFIAPI
+Lz4BlockDecompressSetup (
+  IN  CONST VOID  *Source,
+  IN  UINTN        SourceSize,
+  IN OUT VOID     *Scratch,
+  OUT UINT32      *BlockCount
+  );
+
+/**
+  Decompress a single block from a block-split LZ4 source buffer.
+
+  Blocks are independent from each other, so different blocks can be
+  decompressed concurrently on different processors.
+
+  @param  Source          The source buffer containing the compressed data.
+  @param  Destination     The destination buffer of the whole decompressed data.
+  @param  Scratch         The block offset table built by Lz4BlockDecompressSetup.
+  @param  Index           The block index to decompress.
+
+  @retval  RETURN_SUCCESS            The block was decompressed successfully.
+  @retval  RETURN_INVALID_PARAMETER  The block is corrupted.
+
+**/
+RETURN_STATUS
+EFIAPI
+Lz4BlockDecompressOne (
+  IN CONST VOID  *Source,
+  IN OUT VOID    *Destination,
+  IN CONST VOID  *Scratch,
+  IN UINT32       Index
+  );
+
+/**
+  Decompresses a block-split LZ4 source buffer on the current processor.
+
+  @param  Source      The source buffer containing the compressed data.
+  @param  SourceSize  The size of source buffer.
+  @param  Destination The destination buffer to store the decompressed data
+  @param  Scratch     A temporary scratch buffer that is used to perform the decompression.
+
+  @retval  RETURN_SUCCESS Decompression completed successfully, and
+                          the uncompressed buffer is returned in Destination.
+  @retval  RETURN_INVALID_PARAMETER
+                          The source buffer specified by Source is corrupted
+                          (not in a valid compressed format).
+**/
+RETURN_STATUS
+EFIAPI
+Lz4BlockDecompress (
+  IN CONST VOID  *Source,
+  IN UINTN       SourceSize,
+  IN OUT VOID    *Destination,
+  IN OUT VOID    *Scratch
+  );
+
 #endif
 
@@ -89,6 +89,32 @@ DoHashVerify (
   IN OUT   UINT8           *Hash
   );
 
+/**
+  Verify a pre-calculated digest with the built-in one.
+
+  It is used when the digest has been accumulated incrementally by the caller,
+  e.g. while streaming a component from flash into memory.
+
+  @param[in]  Digest         Calculated digest of the data.
+  @param[in]  Usage          Hash usage.
+  @param[in]  HashAlg        Specify hash algorithm.
+  @param[in,out]  Hash       On input,  expected hash value when Usage is not used.
+                             On output, calculated hash value when verification succeeds.
+
+  @retval RETURN_SUCCESS             Hash verification succeeded.
+  @retval RETRUN_INVALID_PARAMETER   Hash parameter is not valid.
+  @retval RETURN_SECURITY_VIOLATION  Hash verification failed.
+
+**/
+RETURN_STATUS
+EFIAPI
+DoHashVerifyDigest (
+  IN CONST UINT8           *Digest,
+  IN       HASH_COMP_USAGE  Usage,
+  IN       UINT8            HashAlg,
+  IN OUT   UINT8           *Hash
+  );
+
 /**
   Verifies the RSA signature with PKCS1-v1_5 encoding scheme defined in RSA PKCS#1.
   Also(optional), return the hash of the message to the caller.
@@ -1,7 +1,7 @@
 /** @file
   Lite variable service library
 
-  Copyright (c) 2017, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2017 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -124,4 +124,37 @@ VariableConstructor (
   IN  UINT32    Size
   );
 
+/**
+  Start a batch of variable updates.
+
+  The following SetVariable calls are kept in memory and visible to GetVariable,
+  and they are written to flash together by CommitVariableBatch. The batch needs
+  to be committed before the current stage exits, otherwise the updates are lost.
+
+  @retval EFI_SUCCESS             The batch was started.
+  @retval EFI_NOT_READY           The variable service is not initialized.
+  @retval EFI_ALREADY_STARTED     A batch has been started already.
+  @retval EFI_OUT_OF_RESOURCES    Not enough memory to hold the pending updates.
+
+**/
+EFI_STATUS
+EFIAPI
+StartVariableBatch (
+  VOID
+  );
+
+/**
+  Write all variable updates of current batch to flash and end the batch.
+
+  @retval EFI_SUCCESS             All pending updates were written.
+  @retval EFI_NOT_STARTED         No batch has been started.
+  @retval Others                  Failed to write the pending updates.
+
+**/
+EFI_STATUS
+EFIAPI
+CommitVariableBatch (
+  VOID
+  );
+
 #endif
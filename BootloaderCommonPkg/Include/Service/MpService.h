@@ -0,0 +1,73 @@
+/** @file
+
+  Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef __MP_SERVICE_H__
+#define __MP_SERVICE_H__
+
+#include <Guid/BootLoaderServiceGuid.h>
+
+#define MP_SERVICE_SIGNATURE  SIGNATURE_32 ('M', 'P', 'S', 'V')
+#define MP_SERVICE_VERSION    1
+
+/**
+  Task function to run on an application processor.
+
+  @param[in] Argument     Argument passed to MP_RUN_TASK.
+
+  @retval                 Task result returned through MP_WAIT_TASK.
+**/
+typedef
+UINT32
+(*MP_TASK_PROC) (
+  IN UINT32   Argument
+  );
+
+/**
+  Run a task function on the first idle application processor.
+
+  The task must not call memory allocation, debug print or any other service
+  that is not multi-processor safe.
+
+  @param[in]  TaskProc    Task function pointer.
+  @param[in]  Argument    Argument for the task function.
+  @param[out] TaskId      Pointer to receive the task ID used to join the task.
+
+  @retval EFI_INVALID_PARAMETER   TaskProc or TaskId is NULL.
+  @retval EFI_NOT_READY           No application processor is available now.
+  @retval EFI_SUCCESS             An application processor accepted the new task.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *MP_RUN_TASK) (
+  IN  MP_TASK_PROC   TaskProc,
+  IN  UINT32         Argument,
+  OUT UINT32        *TaskId
+  );
+
+/**
+  Wait until a task completes.
+
+  @param[in]  TaskId      Task ID returned from MP_RUN_TASK.
+  @param[out] Result      Pointer to receive the task function return value.
+
+  @retval EFI_INVALID_PARAMETER   Invalid TaskId.
+  @retval EFI_SUCCESS             The task has completed.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *MP_WAIT_TASK) (
+  IN  UINT32         TaskId,
+  OUT UINT32        *Result  OPTIONAL
+  );
+
+typedef struct {
+  SERVICE_COMMON_HEADER              Header;
+  MP_RUN_TASK                        RunTask;
+  MP_WAIT_TASK                       WaitTask;
+} MP_SERVICE;
+
+#endif
@@ -260,9 +260,13 @@ GetServiceBySignature (
   UINT32                    Index;
 
   ServiceList = (SERVICES_LIST *)GetServiceListPtr ();
+  if (ServiceList == NULL) {
+    return NULL;
+  }
+
   for (Index = 0; Index < ServiceList->Count; Index++) {
     ServiceHeader = ServiceList->Header[Index];
-    if (ServiceHeader->Signature == Signature) {
+    if ((ServiceHeader != NULL) && (ServiceHeader->Signature == Signature)) {
       return ServiceHeader;
     }
   }
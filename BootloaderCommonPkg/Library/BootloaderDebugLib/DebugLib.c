@@ -1,6 +1,6 @@
 /** @file
 
-  Copyright (c) 2014 - 2018, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2014 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -155,7 +155,7 @@ DebugClearMemory (
   IN UINTN  Length
   )
 {
-  return Buffer;
+  return SetMem (Buffer, Length, PcdGet8 (PcdDebugClearMemoryValue));
 }
 
 
@@ -9,6 +9,97 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/BootloaderCommonLib.h>
 #include <Library/ConfigDataLib.h>
 #include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#define CDATA_INDEX_SIGNATURE   SIGNATURE_32 ('C', 'D', 'I', 'X')
+#define CDATA_INDEX_EMPTY       0xFFFF
+
+typedef struct {
+  UINT16   Tag;
+  //
+  // Resolved header offset in DWORD from the start of data blob.
+  // 0 indicates the tag exists but no data applies to the platform.
+  //
+  UINT16   Offset;
+} CDATA_INDEX_ENTRY;
+
+//
+// Tag to header index for the active platform ID. It is stored as library
+// data so that it is migrated with the loader data and passed to payloads.
+// Offsets are relative to the data blob so it does not depend on the blob
+// location.
+//
+typedef struct {
+  UINT32             Signature;
+  UINT16             PlatformId;
+  UINT16             InternalDataOffset;
+  UINT32             UsedLength;
+  UINT32             EntryNum;
+  CDATA_INDEX_ENTRY  Entry[0];
+} CDATA_INDEX;
+
+/**
+  Get the hash index slot for a tag.
+
+  @param[in] Index      Configuration data tag index.
+  @param[in] Tag        Configuration TAG ID.
+
+  @retval    Pointer to the slot holding the tag, or the empty slot
+             where the tag can be inserted.
+
+**/
+STATIC
+CDATA_INDEX_ENTRY *
+GetConfigIndexSlot (
+  IN  CDATA_INDEX   *Index,
+  IN  UINT32         Tag
+  )
+{
+  UINT32     Slot;
+  UINT32     Mask;
+
+  Mask = Index->EntryNum - 1;
+  Slot = ((Tag * 0x9E3779B1) >> 16) & Mask;
+  while ((Index->Entry[Slot].Tag != CDATA_INDEX_EMPTY) && (Index->Entry[Slot].Tag != Tag)) {
+    Slot = (Slot + 1) & Mask;
+  }
+  return &Index->Entry[Slot];
+}
+
+/**
+  Get the tag index if it is valid for the current data blob and platform.
+
+  @param[in] CdataBlob  Configuration data blob pointer.
+  @param[in] PidMask    Platform ID mask to look up.
+
+  @retval    Configuration data tag index pointer.
+             NULL if no valid index is available.
+
+**/
+STATIC
+CDATA_INDEX *
+GetConfigDataIndex (
+  IN  CDATA_BLOB    *CdataBlob,
+  IN  UINT32         PidMask
+  )
+{
+  CDATA_INDEX   *Index;
+  EFI_STATUS     Status;
+
+  Status = GetLibraryData (PcdGet8 (PcdConfigDataLibId), (VOID **)&Index);
+  if (EFI_ERROR (Status)) {
+    return NULL;
+  }
+
+  if ((Index->Signature != CDATA_INDEX_SIGNATURE) ||
+      (PID_TO_MASK (Index->PlatformId) != PidMask) ||
+      (Index->UsedLength != CdataBlob->UsedLength) ||
+      (Index->InternalDataOffset != CdataBlob->ExtraInfo.InternalDataOffset)) {
+    return NULL;
+  }
+
+  return Index;
+}
 
 /**
   Find configuration data header by its tag and platform ID.
@@ -35,8 +126,22 @@ FindConfigHdrByPidMaskTag (
   UINT8                Idx;
   REFERENCE_CFG_DATA  *Refer;
   UINT32               Offset;
+  CDATA_INDEX         *Index;
+  CDATA_INDEX_ENTRY   *Entry;
 
   CdataBlob = (CDATA_BLOB *) GetConfigDataPtr ();
+
+  if ((IsInternal == 0) && (Level == 0)) {
+    Index = GetConfigDataIndex (CdataBlob, PidMask);
+    if (Index != NULL) {
+      Entry = GetConfigIndexSlot (Index, Tag);
+      if ((Entry->Tag == CDATA_INDEX_EMPTY) || (Entry->Offset == 0)) {
+        return NULL;
+      }
+      return (CDATA_HEADER *) ((UINT8 *)CdataBlob + (Entry->Offset << 2));
+    }
+  }
+
   Offset    = IsInternal > 0 ? (CdataBlob->ExtraInfo.InternalDataOffset * 4) : CdataBlob->HeaderLength;
 
   while (Offset < CdataBlob->UsedLength) {
@@ -66,6 +171,111 @@ FindConfigHdrByPidMaskTag (
   return NULL;
 }
 
+/**
+  Build the configuration data tag index for the current platform ID.
+
+  The index resolves every tag in the configuration data blob against the
+  current platform ID, including the reference tags, so that the following
+  lookups for the current platform don't need to walk the whole blob.
+  It needs to be rebuilt if the platform ID or the blob is changed, otherwise
+  lookups fall back to walk the blob.
+
+  @retval EFI_SUCCESS             The index was built successfully.
+  @retval EFI_NOT_FOUND           No configuration data blob is available.
+  @retval EFI_UNSUPPORTED         The blob is too big to be indexed.
+  @retval EFI_OUT_OF_RESOURCES    Not enough memory for the index.
+
+**/
+EFI_STATUS
+EFIAPI
+BuildConfigDataIndex (
+  VOID
+  )
+{
+  CDATA_BLOB          *CdataBlob;
+  CDATA_HEADER        *CdataHdr;
+  CDATA_HEADER        *MatchHdr;
+  CDATA_INDEX         *Index;
+  CDATA_INDEX_ENTRY   *Entry;
+  UINT32               Offset;
+  UINT32               TagNum;
+  UINT32               EntryNum;
+  UINT32               IndexSize;
+  UINT32               PidMask;
+  UINT16               PlatformId;
+  EFI_STATUS           Status;
+
+  CdataBlob = (CDATA_BLOB *) GetConfigDataPtr ();
+  if ((CdataBlob == NULL) || (CdataBlob->UsedLength <= CdataBlob->HeaderLength)) {
+    return EFI_NOT_FOUND;
+  }
+
+  // Offset is stored in DWORD with 16 bits
+  if (CdataBlob->UsedLength > (MAX_UINT16 << 2)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  // Invalidate the old index since the lookup below needs to walk the blob
+  Status = GetLibraryData (PcdGet8 (PcdConfigDataLibId), (VOID **)&Index);
+  if (!EFI_ERROR (Status)) {
+    Index->Signature = 0;
+  }
+
+  TagNum = 0;
+  Offset = CdataBlob->HeaderLength;
+  while (Offset < CdataBlob->UsedLength) {
+    CdataHdr = (CDATA_HEADER *) ((UINT8 *)CdataBlob + Offset);
+    if (CdataHdr->Length == 0) {
+      break;
+    }
+    TagNum++;
+    Offset += (CdataHdr->Length << 2);
+  }
+
+  // Keep the load factor below 1/2
+  EntryNum = 16;
+  while (EntryNum < TagNum * 2) {
+    EntryNum <<= 1;
+  }
+
+  IndexSize = sizeof (CDATA_INDEX) + EntryNum * sizeof (CDATA_INDEX_ENTRY);
+  Index     = AllocatePool (IndexSize);
+  if (Index == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  SetMem (Index, IndexSize, 0xFF);
+
+  PlatformId = GetPlatformId ();
+  PidMask    = PID_TO_MASK (PlatformId);
+  Index->PlatformId         = PlatformId;
+  Index->InternalDataOffset = CdataBlob->ExtraInfo.InternalDataOffset;
+  Index->UsedLength         = CdataBlob->UsedLength;
+  Index->EntryNum           = EntryNum;
+
+  Offset = CdataBlob->HeaderLength;
+  while (Offset < CdataBlob->UsedLength) {
+    CdataHdr = (CDATA_HEADER *) ((UINT8 *)CdataBlob + Offset);
+    if (CdataHdr->Length == 0) {
+      break;
+    }
+    Entry = GetConfigIndexSlot (Index, CdataHdr->Tag);
+    if (Entry->Tag == CDATA_INDEX_EMPTY) {
+      // The first match in the blob wins, same as the linear lookup
+      MatchHdr      = FindConfigHdrByPidMaskTag (PidMask, CdataHdr->Tag, 0, 0);
+      Entry->Tag    = (UINT16)CdataHdr->Tag;
+      Entry->Offset = (MatchHdr == NULL) ? 0 : (UINT16)(((UINT8 *)MatchHdr - (UINT8 *)CdataBlob) >> 2);
+    }
+    Offset += (CdataHdr->Length << 2);
+  }
+
+  Index->Signature = CDATA_INDEX_SIGNATURE;
+  SetLibraryData (PcdGet8 (PcdConfigDataLibId), Index, IndexSize);
+
+  DEBUG ((DEBUG_INFO, "CFGDATA index: %d tags for platform ID %d\n", TagNum, PlatformId));
+
+  return EFI_SUCCESS;
+}
+
 /**
   Find configuration data header by its tag.
 
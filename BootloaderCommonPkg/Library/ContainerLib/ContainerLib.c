@@ -17,12 +17,156 @@
 #include <Library/CryptoLib.h>
 #include <Library/SecureBootLib.h>
 #include <Library/DecompressLib.h>
+#include <Library/TimeStampLib.h>
 
 #define  TEMP_BUF_ALIGN    0x10
 #define  AUTH_DATA_ALIGN   0x04
+#define  STREAM_CHUNK_SIZE 0x10000
 
 #define  IS_FLASH_ADDRESS(x)   (((UINT32)(UINTN)(x)) >= 0xF0000000)
 
+#define  COMPONENT_DIR_EMPTY   0xFFFF
+
+//
+// Component directory appended to the container header cache.
+// Offset[] holds the offsets of all COMPONENT_ENTRY in the header cache in
+// container order. It is followed by an open addressing hash table of
+// (BucketMask + 1) entries, each holding an index into Offset[].
+// All offsets are relative to the header cache so that the directory stays
+// valid when the header cache is migrated.
+//
+typedef struct {
+  UINT16           BucketMask;
+  UINT16           Count;
+  UINT16           Offset[0];
+} COMPONENT_DIRECTORY;
+
+/**
+  Get the hash bucket for a component name.
+
+  @param[in] ComponentName    Component name.
+  @param[in] BucketMask       Hash table size minus 1.
+
+  @retval    Hash bucket index.
+
+**/
+STATIC
+UINT32
+GetComponentBucket (
+  IN  UINT32    ComponentName,
+  IN  UINT32    BucketMask
+  )
+{
+  return ((ComponentName * 0x9E3779B1) >> 16) & BucketMask;
+}
+
+/**
+  Get the buffer size required for a component directory.
+
+  @param[in]  Count         Component count in the container.
+  @param[out] BucketMask    Pointer to receive hash table size minus 1.
+
+  @retval     Component directory size in bytes.
+
+**/
+STATIC
+UINT32
+GetComponentDirectorySize (
+  IN  UINT32    Count,
+  OUT UINT32   *BucketMask
+  )
+{
+  UINT32    Buckets;
+
+  // Keep the hash table at most half full
+  Buckets = 4;
+  while (Buckets < Count * 2) {
+    Buckets <<= 1;
+  }
+  *BucketMask = Buckets - 1;
+
+  return sizeof (COMPONENT_DIRECTORY) + (Count + Buckets) * sizeof (UINT16);
+}
+
+/**
+  Build the component directory for a cached container header.
+
+  @param[in]  ContainerHdr  Cached container header.
+  @param[in]  Directory     Component directory buffer.
+  @param[in]  BucketMask    Hash table size minus 1.
+
+**/
+STATIC
+VOID
+BuildComponentDirectory (
+  IN  CONTAINER_HDR        *ContainerHdr,
+  IN  COMPONENT_DIRECTORY  *Directory,
+  IN  UINT32                BucketMask
+  )
+{
+  UINT32                Index;
+  UINT32                Bucket;
+  UINT16               *Table;
+  COMPONENT_ENTRY      *CompEntry;
+
+  Directory->BucketMask = (UINT16)BucketMask;
+  Directory->Count      = ContainerHdr->Count;
+  Table = &Directory->Offset[Directory->Count];
+  SetMem16 (Table, (BucketMask + 1) * sizeof (UINT16), COMPONENT_DIR_EMPTY);
+
+  CompEntry = (COMPONENT_ENTRY *)&ContainerHdr[1];
+  for (Index = 0; Index < Directory->Count; Index++) {
+    Directory->Offset[Index] = (UINT16)((UINT8 *)CompEntry - (UINT8 *)ContainerHdr);
+    // Linear probing keeps the first entry of a duplicated name ahead of the others
+    Bucket = GetComponentBucket (CompEntry->Name, BucketMask);
+    while (Table[Bucket] != COMPONENT_DIR_EMPTY) {
+      Bucket = (Bucket + 1) & BucketMask;
+    }
+    Table[Bucket] = (UINT16)Index;
+    CompEntry = (COMPONENT_ENTRY *)((UINT8 *)(CompEntry + 1) + CompEntry->HashSize);
+  }
+}
+
+/**
+  Look up a component in a registered container using its component directory.
+
+  @param[in] ContainerEntry    Container entry pointer.
+  @param[in] ComponentName     Component name in container.
+  @param[in] SkipReserved      Ignore the entries with COMPONENT_ENTRY_ATTR_RESERVED.
+
+  @retval    Component index in the container, or COMPONENT_DIR_EMPTY if not found.
+
+**/
+STATIC
+UINT32
+LookupComponentDirectory (
+  IN  CONTAINER_ENTRY  *ContainerEntry,
+  IN  UINT32            ComponentName,
+  IN  BOOLEAN           SkipReserved
+  )
+{
+  COMPONENT_DIRECTORY  *Directory;
+  COMPONENT_ENTRY      *CompEntry;
+  UINT16               *Table;
+  UINT32                Bucket;
+  UINT32                Index;
+
+  Directory = (COMPONENT_DIRECTORY *)(UINTN)(ContainerEntry->HeaderCache + ContainerEntry->DirOffset);
+  Table     = &Directory->Offset[Directory->Count];
+  Bucket    = GetComponentBucket (ComponentName, Directory->BucketMask);
+  while (Table[Bucket] != COMPONENT_DIR_EMPTY) {
+    Index     = Table[Bucket];
+    CompEntry = (COMPONENT_ENTRY *)(UINTN)(ContainerEntry->HeaderCache + Directory->Offset[Index]);
+    if ((CompEntry->Name == ComponentName) &&
+        (!SkipReserved || ((CompEntry->Attribute & COMPONENT_ENTRY_ATTR_RESERVED) == 0))) {
+      return Index;
+    }
+    Bucket = (Bucket + 1) & Directory->BucketMask;
+  }
+
+  return COMPONENT_DIR_EMPTY;
+}
+
 /**
   Get the container pointer by the container signature
 
@@ -113,6 +257,11 @@ RegisterContainerInternal (
   UINT32                Index;
   VOID                 *Buffer;
   UINT32                MaxHdrSize;
+  UINT32                HdrSize;
+  UINT32                AllocSize;
+  UINT32                DirOffset;
+  UINT32                DirSize;
+  UINT32                BucketMask;
 
   ContainerList = (CONTAINER_LIST *)GetContainerListPtr ();
   if (ContainerList == NULL) {
@@ -130,21 +279,37 @@ RegisterContainerInternal (
     return EFI_BUFFER_TOO_SMALL;
   }
 
-  MaxHdrSize = GetContainerHeaderSize (ContainerHdr) + SIGNATURE_AND_KEY_SIZE_MAX;
+  HdrSize    = GetContainerHeaderSize (ContainerHdr);
+  MaxHdrSize = HdrSize + SIGNATURE_AND_KEY_SIZE_MAX;
   if (MaxHdrSize > ContainerHdr->DataOffset) {
     MaxHdrSize = ContainerHdr->DataOffset;
   }
 
-  Buffer  = AllocatePool (MaxHdrSize);
+  // Append the component directory to the header cache
+  AllocSize  = MaxHdrSize;
+  DirOffset  = 0;
+  DirSize    = 0;
+  BucketMask = 0;
+  if (HdrSize > 0) {
+    DirOffset  = ALIGN_UP (MaxHdrSize, sizeof (UINT32));
+    DirSize    = GetComponentDirectorySize (ContainerHdr->Count, &BucketMask);
+    AllocSize  = DirOffset + DirSize;
+  }
+
+  Buffer  = AllocatePool (AllocSize);
   if (Buffer == NULL) {
     return  EFI_OUT_OF_RESOURCES;
   }
 
   ContainerList->Entry[Index].Signature   = ContainerHdr->Signature;
   ContainerList->Entry[Index].HeaderCache = (UINT32)(UINTN)Buffer;
-  ContainerList->Entry[Index].HeaderSize  = MaxHdrSize ;
+  ContainerList->Entry[Index].HeaderSize  = AllocSize;
   ContainerList->Entry[Index].Base        = ContainerBase;
+  ContainerList->Entry[Index].DirOffset   = DirOffset;
   CopyMem (Buffer, (VOID *)(UINTN)ContainerBase, MaxHdrSize);
+  if (DirSize > 0) {
+    BuildComponentDirectory ((CONTAINER_HDR *)Buffer, (COMPONENT_DIRECTORY *)((UINT8 *)Buffer + DirOffset), BucketMask);
+  }
   ContainerList->Count++;
 
   return EFI_SUCCESS;
@@ -320,6 +485,131 @@ AuthenticateComponent (
   return Status;
 }
 
+/**
+  Verify a component digest against the expected hash.
+
+  It does the same check as DoHashVerifyDigest () but does not print anything,
+  so it can be used by a component load running on an AP.
+
+  @param[in]     Digest       Component digest.
+  @param[in]     HashAlg      Hash algorithm of the digest.
+  @param[in,out] HashData     Expected hash when Usage is 0. Otherwise, it
+                              receives the digest if it is not NULL.
+  @param[in]     Usage        Hash usage.
+
+  @retval EFI_SECURITY_VIOLATION   Digest does not match.
+  @retval EFI_SUCCESS              Digest matches.
+
+**/
+STATIC
+EFI_STATUS
+VerifyComponentDigest (
+  IN     UINT8    *Digest,
+  IN     UINT8     HashAlg,
+  IN OUT UINT8    *HashData,
+  IN     UINT32    Usage
+  )
+{
+  UINT32     DigestSize;
+
+  DigestSize = (HashAlg == HASH_TYPE_SHA256) ? SHA256_DIGEST_SIZE : SHA384_DIGEST_SIZE;
+  if (Usage == 0) {
+    if ((HashData != NULL) && (CompareMem (HashData, Digest, DigestSize) == 0)) {
+      return EFI_SUCCESS;
+    }
+  } else if (!EFI_ERROR (MatchHashInStore (Usage, HashAlg, Digest))) {
+    if (HashData != NULL) {
+      CopyMem (HashData, Digest, DigestSize);
+    }
+    return EFI_SUCCESS;
+  }
+
+  return EFI_SECURITY_VIOLATION;
+}
+
+/**
+  Copy a component from flash into memory and verify its hash in a single pass.
+
+  The data is copied in STREAM_CHUNK_SIZE pieces and every piece is hashed from
+  the memory copy right after it is copied, while it is still in the CPU cache.
+  The digest is only calculated on the memory copy, so the data consumed by the
+  decompressor later on is exactly the data that has been verified here.
+  If Dst is the same as Src, the data is only hashed.
+
+  @param[out] Dst          Destination memory buffer.
+  @param[in]  Src          Component data on flash.
+  @param[in]  Length       Data length to be copied and authenticated.
+  @param[in]  AuthType     Authentication type, AUTH_TYPE_SHA2_256 or AUTH_TYPE_SHA2_384.
+  @param[in]  HashData     Hash data buffer.
+  @param[in]  Usage        Hash usage.
+  @param[in]  Quiet        Verify the digest without any debug output.
+  @param[out] VerifyTick   Timestamp when the digest verification starts.
+
+  @retval EFI_UNSUPPORTED          Unsupported AuthType.
+  @retval EFI_SECURITY_VIOLATION   Authentication failed.
+  @retval EFI_SUCCESS              Authentication succeeded.
+
+**/
+STATIC
+EFI_STATUS
+CopyAndAuthenticateComponent (
+  OUT UINT8    *Dst,
+  IN  UINT8    *Src,
+  IN  UINT32    Length,
+  IN  UINT8     AuthType,
+  IN  UINT8    *HashData,
+  IN  UINT32    Usage,
+  IN  BOOLEAN   Quiet,
+  OUT UINT64   *VerifyTick
+  )
+{
+  EFI_STATUS   Status;
+  HASH_CTX     HashCtx;
+  UINT8        Digest[HASH_DIGEST_MAX];
+  UINT8        HashAlg;
+  UINT32       Offset;
+  UINT32       ChunkLen;
+
+  *VerifyTick = ReadTimeStamp ();
+  HashAlg = GetHashAlg (AuthType);
+  if (AuthType == AUTH_TYPE_SHA2_256) {
+    Status = Sha256Init (&HashCtx, sizeof (HashCtx));
+  } else if (AuthType == AUTH_TYPE_SHA2_384) {
+    Status = Sha384Init (&HashCtx, sizeof (HashCtx));
+  } else {
+    return EFI_UNSUPPORTED;
+  }
+
+  for (Offset = 0; (Offset < Length) && !EFI_ERROR (Status); Offset += ChunkLen) {
+    ChunkLen = MIN (Length - Offset, STREAM_CHUNK_SIZE);
+    CopyMem (Dst + Offset, Src + Offset, ChunkLen);
+    if (HashAlg == HASH_TYPE_SHA256) {
+      Status = Sha256Update (&HashCtx, Dst + Offset, ChunkLen);
+    } else {
+      Status = Sha384Update (&HashCtx, Dst + Offset, ChunkLen);
+    }
+  }
+
+  if (!EFI_ERROR (Status)) {
+    if (HashAlg == HASH_TYPE_SHA256) {
+      Status = Sha256Final (&HashCtx, Digest);
+    } else {
+      Status = Sha384Final (&HashCtx, Digest);
+    }
+  }
+
+  *VerifyTick = ReadTimeStamp ();
+  if (!EFI_ERROR (Status)) {
+    if (Quiet) {
+      Status = VerifyComponentDigest (Digest, HashAlg, HashData, Usage);
+    } else {
+      Status = DoHashVerifyDigest (Digest, Usage, HashAlg, HashData);
+    }
+  }
+
+  return EFI_ERROR (Status) ? EFI_SECURITY_VIOLATION : EFI_SUCCESS;
+}
+
 /**
   Return Containser Key Type based on its signature
 
@@ -516,8 +806,10 @@ LocateComponentEntry (
   CONTAINER_HDR            *ContainerHdr;
   CONTAINER_ENTRY          *ContainerEntry;
   COMPONENT_ENTRY          *CompEntry;
+  COMPONENT_DIRECTORY      *Directory;
   UINT32                    ContainerBase;
   UINT32                    ContainerSize;
+  UINT32                    Index;
 
   CompEntry = NULL;
 
@@ -546,7 +838,15 @@ LocateComponentEntry (
   // Locate the component from the container header
   ContainerHdr = (CONTAINER_HDR *)(UINTN)ContainerEntry->HeaderCache;
   if (ComponentName != 0) {
-    CompEntry = LocateComponentEntryFromContainer (ContainerHdr, ComponentName);
+    if (ContainerEntry->DirOffset != 0) {
+      Index = LookupComponentDirectory (ContainerEntry, ComponentName, FALSE);
+      if (Index != COMPONENT_DIR_EMPTY) {
+        Directory = (COMPONENT_DIRECTORY *)((UINT8 *)ContainerHdr + ContainerEntry->DirOffset);
+        CompEntry = (COMPONENT_ENTRY *)((UINT8 *)ContainerHdr + Directory->Offset[Index]);
+      }
+    } else {
+      CompEntry = LocateComponentEntryFromContainer (ContainerHdr, ComponentName);
+    }
     if (CompEntry == NULL) {
       return EFI_NOT_FOUND;
     }
@@ -581,12 +881,13 @@ GetNextAvailableComponent (
   IN     UINT32    *ComponentName
 )
 {
-  EFI_STATUS         Status;
-  CONTAINER_HDR     *ContainerHdr;
-  CONTAINER_ENTRY   *ContainerEntry;
-  COMPONENT_ENTRY   *CurrEntry;
-  COMPONENT_ENTRY   *NextEntry;
-  UINT32             Index;
+  EFI_STATUS           Status;
+  CONTAINER_HDR       *ContainerHdr;
+  CONTAINER_ENTRY     *ContainerEntry;
+  COMPONENT_ENTRY     *CurrEntry;
+  COMPONENT_ENTRY     *NextEntry;
+  COMPONENT_DIRECTORY *Directory;
+  UINT32               Index;
 
   if (ComponentName == NULL) {
     return EFI_INVALID_PARAMETER;
@@ -608,6 +909,20 @@ GetNextAvailableComponent (
    if ((*ComponentName == 0) && ((CurrEntry->Attribute & COMPONENT_ENTRY_ATTR_RESERVED) == 0)){
     *ComponentName = CurrEntry->Name;
     Status = EFI_SUCCESS;
+  } else if (ContainerEntry->DirOffset != 0) {
+    // Find the current component in the directory and return the next available one
+    Directory = (COMPONENT_DIRECTORY *)((UINT8 *)ContainerHdr + ContainerEntry->DirOffset);
+    Index     = LookupComponentDirectory (ContainerEntry, *ComponentName, TRUE);
+    if (Index != COMPONENT_DIR_EMPTY) {
+      for (Index++; Index < Directory->Count; Index++) {
+        NextEntry = (COMPONENT_ENTRY *)((UINT8 *)ContainerHdr + Directory->Offset[Index]);
+        if ((NextEntry->Attribute & COMPONENT_ENTRY_ATTR_RESERVED) == 0) {
+          *ComponentName = NextEntry->Name;
+          Status = EFI_SUCCESS;
+          break;
+        }
+      }
+    }
   } else {
     NextEntry = (COMPONENT_ENTRY *)((UINT8 *)(CurrEntry + 1) + CurrEntry->HashSize);
     for (Index = 0; Index < (UINT32)(ContainerHdr->Count-1); Index++) {
@@ -686,30 +1001,131 @@ LocateComponent (
 }
 
 /**
-  Load a component from a container or flahs map to memory and call callback
-  function at predefined point.
+  Report the authentication result of a component load through the callback.
 
-  @param[in]     ContainerSig    Container signature or component type.
-  @param[in]     ComponentName   Component name.
-  @param[in,out] Buffer          Pointer to receive component base.
-  @param[in,out] Length          Pointer to receive component size.
-  @param[in,out] LoadComponentCallback  Callback function pointer.
+  @param[in] Context                Component load context.
+  @param[in] LoadComponentCallback  Callback function pointer.
 
-  @retval EFI_UNSUPPORTED          Unsupported AuthType.
+**/
+STATIC
+VOID
+NotifyComponentAuthenticated (
+  IN  COMPONENT_LOAD_CONTEXT   *Context,
+  IN  LOAD_COMPONENT_CALLBACK   LoadComponentCallback
+  )
+{
+  COMPONENT_CALLBACK_INFO   CbInfo;
+
+  if (Context->AuthStatus == EFI_SUCCESS) {
+    // Update component Call back info after authenticaton is done
+    // This info will used by firmware stage to extend to TPM
+    CbInfo.ComponentType    = Context->ComponentId;
+    CbInfo.CompBuf          = Context->CompBuf;
+    CbInfo.CompLen          = Context->SignedDataLen;
+    CbInfo.HashAlg          = GetHashAlg (Context->AuthType);
+    CbInfo.HashData         = Context->HashData;
+    LoadComponentCallback (PROGESS_ID_AUTHENTICATE, &CbInfo);
+  } else {
+    LoadComponentCallback (PROGESS_ID_AUTHENTICATE, NULL);
+  }
+}
+
+/**
+  Append the load profile of a component to the component load profile.
+
+  The component load profile is allocated on the first use. Once it is full,
+  the components loaded afterwards are not recorded.
+
+  @param[in] Context                Component load context.
+
+**/
+STATIC
+VOID
+AddComponentProfile (
+  IN  COMPONENT_LOAD_CONTEXT   *Context
+  )
+{
+  COMPONENT_PROFILE         *Profile;
+  COMPONENT_PROFILE_ENTRY   *Entry;
+  UINT32                     FreqKhz;
+  UINT32                     Index;
+
+  Profile = (COMPONENT_PROFILE *)GetComponentProfilePtr ();
+  if (Profile == NULL) {
+    Profile = AllocateZeroPool (sizeof (COMPONENT_PROFILE) +
+                                sizeof (COMPONENT_PROFILE_ENTRY) * COMPONENT_PROFILE_MAX_ENTRIES);
+    if (Profile == NULL) {
+      return;
+    }
+    Profile->Revision = COMPONENT_PROFILE_REVISION;
+    Profile->MaxCount = COMPONENT_PROFILE_MAX_ENTRIES;
+    SetComponentProfilePtr (Profile);
+  }
+
+  if (Profile->Count >= Profile->MaxCount) {
+    return;
+  }
+
+  Entry = &Profile->Entry[Profile->Count];
+  Entry->ContainerSig     = (Context->ComponentId < COMP_TYPE_INVALID) ? 0 : Context->ComponentId;
+  Entry->ComponentName    = Context->ComponentName;
+  Entry->CompressAlg      = Context->CompressAlg;
+  Entry->CompressedSize   = Context->SignedDataLen;
+  Entry->DecompressedSize = Context->DecompressedLen;
+  Entry->AuthType         = Context->AuthType;
+  Entry->Flags            = 0;
+  Entry->Reserved         = 0;
+  if (Context->Async) {
+    Entry->Flags |= COMPONENT_PROFILE_FLAG_ASYNC;
+  }
+  if (Context->IsStreaming) {
+    Entry->Flags |= COMPONENT_PROFILE_FLAG_STREAMING;
+  }
+  if (EFI_ERROR (Context->Status)) {
+    Entry->Flags |= COMPONENT_PROFILE_FLAG_FAILED;
+  }
+
+  FreqKhz = GetTimeStampFrequency ();
+  for (Index = 0; Index < COMPONENT_PHASE_MAX; Index++) {
+    Entry->PhaseTime[Index] = (UINT32)DivU64x32 (MultU64x32 (Context->PhaseTicks[Index], 1000), FreqKhz);
+  }
+  Profile->Count++;
+}
+
+/**
+  Prepare to load a component from a container or flash map to memory.
+
+  It locates the component and allocates all the buffers required to load it,
+  so that ExecuteComponentLoad () does not need to allocate any memory.
+  FinishComponentLoad () must be called to release the buffers afterwards.
+
+  If Async is TRUE, the load is prepared to be executed on an AP. Component
+  loads that cannot be authenticated without debug output, such as the RSA
+  signed ones, are not supported in this mode.
+
+  @param[in]  ContainerSig    Container signature or component type.
+  @param[in]  ComponentName   Component name.
+  @param[in]  Buffer          Existing buffer to load the component into, or NULL.
+  @param[in]  Length          Size of the existing buffer, 0 if unknown.
+  @param[in]  Async           Whether the load will be executed on an AP.
+  @param[out] Context         Pointer to receive the component load context.
+
+  @retval EFI_UNSUPPORTED          Unsupported AuthType or compression.
   @retval EFI_NOT_FOUND            Cannot locate component.
   @retval EFI_BUFFER_TOO_SMALL     Specified buffer size is too small.
-  @retval EFI_SECURITY_VIOLATION   Authentication failed.
-  @retval EFI_SUCCESS              Authentication succeeded.
+  @retval EFI_OUT_OF_RESOURCES     Failed to allocate the buffers.
+  @retval EFI_SUCCESS              The component load is ready to be executed.
 
 **/
 EFI_STATUS
 EFIAPI
-LoadComponentWithCallback (
-  IN     UINT32                   ContainerSig,
-  IN     UINT32                   ComponentName,
-  IN OUT VOID                   **Buffer,
-  IN OUT UINT32                  *Length,
-  IN     LOAD_COMPONENT_CALLBACK  LoadComponentCallback
+PrepareComponentLoad (
+  IN  UINT32                    ContainerSig,
+  IN  UINT32                    ComponentName,
+  IN  VOID                     *Buffer,  OPTIONAL
+  IN  UINT32                    Length,
+  IN  BOOLEAN                   Async,
+  OUT COMPONENT_LOAD_CONTEXT   *Context
   )
 {
   EFI_STATUS                Status;
@@ -718,15 +1134,11 @@ LoadComponentWithCallback (
   CONTAINER_ENTRY          *ContainerEntry;
   COMPONENT_ENTRY          *CompEntry;
   UINT8                    *CompData;
-  UINT8                    *CompBuf;
   UINT8                    *HashData;
-  VOID                     *CompBase;
-  VOID                     *ScrBuf;
   VOID                     *AllocBuf;
-  VOID                     *ReqCompBase;
+  VOID                     *CompBase;
   UINT32                    Usage;
   UINT8                     AuthType;
-  UINT32                    DecompressedLen;
   UINT32                    CompLen;
   UINT32                    CompLoc;
   UINT32                    AllocLen;
@@ -734,9 +1146,11 @@ LoadComponentWithCallback (
   UINT32                    DstLen;
   UINT32                    ScrLen;
   BOOLEAN                   IsInFlash;
-  COMPONENT_CALLBACK_INFO   CbInfo;
+  BOOLEAN                   IsHashAuth;
   UINT32                    ComponentId;
+  UINT64                    StartTick;
 
+  StartTick   = ReadTimeStamp ();
   ComponentId = ContainerSig;
   CompLoc = 0;
 
@@ -785,8 +1199,11 @@ LoadComponentWithCallback (
     CompLen   = CompEntry->Size;
   }
 
-  if (LoadComponentCallback != NULL) {
-    LoadComponentCallback (PROGESS_ID_LOCATE, NULL);
+  // Only hash authentication can be done without debug output on an AP
+  IsHashAuth = FeaturePcdGet (PcdVerifiedBootEnabled) &&
+               ((AuthType == AUTH_TYPE_SHA2_256) || (AuthType == AUTH_TYPE_SHA2_384));
+  if (Async && FeaturePcdGet (PcdVerifiedBootEnabled) && !IsHashAuth && (AuthType != AUTH_TYPE_NONE)) {
+    return EFI_UNSUPPORTED;
   }
 
   // Component must have LOADER_COMPRESSED_HEADER
@@ -814,13 +1231,8 @@ LoadComponentWithCallback (
   }
 
   // If it is required to use an existing buffer, verify the size
-  ReqCompBase = NULL;
-  DecompressedLen = CompressHdr->Size;
-  if ((Buffer != NULL) && (*Buffer != NULL)) {
-    ReqCompBase = *Buffer;
-    if ((Length != NULL) && (*Length != 0) && (*Length < DecompressedLen)) {
-      return EFI_BUFFER_TOO_SMALL;
-    }
+  if ((Buffer != NULL) && (Length != 0) && (Length < CompressHdr->Size)) {
+    return EFI_BUFFER_TOO_SMALL;
   }
 
   // If it is on flash, the data needs to be copied into memory first
@@ -834,78 +1246,248 @@ LoadComponentWithCallback (
   if (AllocBuf == NULL) {
     return EFI_OUT_OF_RESOURCES;
   }
-  if (IsInFlash) {
-    // Authenticate component and decompress it if required
-    CompBuf = AllocBuf;
-    ScrBuf  = (UINT8 *)AllocBuf + ALIGN_UP (SignedDataLen, TEMP_BUF_ALIGN);
-    CopyMem (CompBuf, CompData, SignedDataLen);
-    if (LoadComponentCallback != NULL) {
-      LoadComponentCallback (PROGESS_ID_COPY, NULL);
+
+  if (Buffer == NULL) {
+    CompBase = AllocatePages (EFI_SIZE_TO_PAGES ((UINTN) CompressHdr->Size));
+    if (CompBase == NULL) {
+      FreeTemporaryMemory (AllocBuf);
+      return (CompressHdr->Size == 0) ? EFI_BAD_BUFFER_SIZE : EFI_OUT_OF_RESOURCES;
     }
   } else {
-    CompBuf = CompData;
-    ScrBuf  = AllocBuf;
+    CompBase = Buffer;
+  }
+
+  ZeroMem (Context, sizeof (COMPONENT_LOAD_CONTEXT));
+  Context->ComponentId     = ComponentId;
+  Context->ComponentName   = ComponentName;
+  Context->CompressAlg     = CompressHdr->Signature;
+  Context->Usage           = Usage;
+  Context->AuthType        = AuthType;
+  Context->Async           = Async;
+  Context->IsInFlash       = IsInFlash;
+  // For hash only authentication, the copy from flash and the hash calculation
+  // can be merged into a single pass over the component data. It is also used
+  // for async loads since it does not print anything.
+  Context->IsStreaming     = IsHashAuth && (IsInFlash || Async);
+  Context->CompData        = CompData;
+  Context->HashData        = HashData;
+  Context->AllocBuf        = AllocBuf;
+  Context->CompBase        = CompBase;
+  Context->ReqCompBase     = Buffer;
+  Context->SignedDataLen   = SignedDataLen;
+  Context->DecompressedLen = CompressHdr->Size;
+  Context->AuthStatus      = EFI_NOT_READY;
+  Context->Status          = EFI_NOT_READY;
+  if (IsInFlash) {
+    Context->CompBuf = AllocBuf;
+    Context->ScrBuf  = (UINT8 *)AllocBuf + ALIGN_UP (SignedDataLen, TEMP_BUF_ALIGN);
+  } else {
+    Context->CompBuf = CompData;
+    Context->ScrBuf  = AllocBuf;
+  }
+  Context->PhaseTicks[COMPONENT_PHASE_LOCATE] = ReadTimeStamp () - StartTick;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Copy, authenticate and decompress a component prepared by PrepareComponentLoad ().
+
+  It does not allocate any memory. If the load was prepared with Async set to
+  TRUE and LoadComponentCallback is NULL, it does not print anything either,
+  so it can run on an AP.
+
+  @param[in,out] Context                Component load context.
+  @param[in]     LoadComponentCallback  Callback function pointer, or NULL.
+
+  @retval EFI_SECURITY_VIOLATION   Authentication failed.
+  @retval EFI_SUCCESS              The component has been loaded.
+  @retval Others                   Decompression failed.
+
+**/
+EFI_STATUS
+EFIAPI
+ExecuteComponentLoad (
+  IN OUT COMPONENT_LOAD_CONTEXT   *Context,
+  IN     LOAD_COMPONENT_CALLBACK   LoadComponentCallback
+  )
+{
+  EFI_STATUS                Status;
+  LOADER_COMPRESSED_HEADER *CompressHdr;
+  UINT64                    StartTick;
+  UINT64                    VerifyTick;
+  UINT32                    Phase;
+
+  Status    = EFI_SUCCESS;
+  StartTick = ReadTimeStamp ();
+  if (Context->IsStreaming) {
+    Status = CopyAndAuthenticateComponent (Context->CompBuf, Context->CompData, Context->SignedDataLen,
+                                           Context->AuthType, Context->HashData, Context->Usage,
+                                           Context->Async, &VerifyTick);
+    Context->PhaseTicks[COMPONENT_PHASE_HASH]   = VerifyTick - StartTick;
+    Context->PhaseTicks[COMPONENT_PHASE_VERIFY] = ReadTimeStamp () - VerifyTick;
+  } else if (Context->IsInFlash) {
+    CopyMem (Context->CompBuf, Context->CompData, Context->SignedDataLen);
+    Context->PhaseTicks[COMPONENT_PHASE_COPY]   = ReadTimeStamp () - StartTick;
+  }
+  if (Context->IsInFlash && (LoadComponentCallback != NULL)) {
+    LoadComponentCallback (PROGESS_ID_COPY, NULL);
   }
 
   // Verify the component
-  Status = AuthenticateComponent (CompBuf, SignedDataLen, AuthType,
-             CompData + ALIGN_UP(SignedDataLen, AUTH_DATA_ALIGN),  HashData, Usage);
-  if (LoadComponentCallback != NULL) {
-    if(Status == EFI_SUCCESS){
-      // Update component Call back info after authenticaton is done
-      // This info will used by firmware stage to extend to TPM
-      CbInfo.ComponentType    = ComponentId;
-      CbInfo.CompBuf          = CompBuf;
-      CbInfo.CompLen          = SignedDataLen;
-      CbInfo.HashAlg          = GetHashAlg(AuthType);
-      CbInfo.HashData         = HashData;
-      LoadComponentCallback (PROGESS_ID_AUTHENTICATE, &CbInfo);
+  if (!Context->IsStreaming) {
+    StartTick = ReadTimeStamp ();
+    Status = AuthenticateComponent (Context->CompBuf, Context->SignedDataLen, Context->AuthType,
+               Context->CompData + ALIGN_UP (Context->SignedDataLen, AUTH_DATA_ALIGN),
+               Context->HashData, Context->Usage);
+    if ((Context->AuthType == AUTH_TYPE_SHA2_256) || (Context->AuthType == AUTH_TYPE_SHA2_384)) {
+      Phase = COMPONENT_PHASE_HASH;
     } else {
-      LoadComponentCallback (PROGESS_ID_AUTHENTICATE, NULL);
+      Phase = COMPONENT_PHASE_VERIFY;
     }
+    Context->PhaseTicks[Phase] = ReadTimeStamp () - StartTick;
+  }
+  Context->AuthStatus = Status;
+  if (LoadComponentCallback != NULL) {
+    NotifyComponentAuthenticated (Context, LoadComponentCallback);
   }
+
   if (!EFI_ERROR (Status)) {
-    CompressHdr = (LOADER_COMPRESSED_HEADER *)CompBuf;
-    if (ReqCompBase == NULL) {
-      CompBase = AllocatePages (EFI_SIZE_TO_PAGES ((UINTN) DecompressedLen));
-    } else {
-      CompBase = ReqCompBase;
+    CompressHdr = (LOADER_COMPRESSED_HEADER *)Context->CompBuf;
+    StartTick   = ReadTimeStamp ();
+    Status = Decompress (CompressHdr->Signature, CompressHdr->Data, CompressHdr->CompressedSize,
+                         Context->CompBase, Context->ScrBuf);
+    Context->PhaseTicks[COMPONENT_PHASE_DECOMPRESS] = ReadTimeStamp () - StartTick;
+    if (LoadComponentCallback != NULL) {
+      LoadComponentCallback (PROGESS_ID_DECOMPRESS, NULL);
     }
+  } else {
+    Status = EFI_SECURITY_VIOLATION;
+  }
 
-    if (CompBase != NULL) {
-      Status = Decompress (CompressHdr->Signature, CompressHdr->Data, CompressHdr->CompressedSize,
-                           CompBase, ScrBuf);
-      if (LoadComponentCallback != NULL) {
-        LoadComponentCallback (PROGESS_ID_DECOMPRESS, NULL);
-      }
-      if (EFI_ERROR (Status)) {
-        if (ReqCompBase == NULL) {
-          FreePages (CompBase, EFI_SIZE_TO_PAGES ((UINTN) DecompressedLen));
-        }
+  Context->Status = Status;
+  return Status;
+}
+
+/**
+  Complete a component load and release its temporary buffers.
+
+  For an async load, the progress callbacks that were skipped on the AP are
+  issued here in order. If the load was executed, its per phase timing is
+  appended to the component load profile. If the load failed or was never
+  executed, the buffer allocated for the component is freed as well.
+
+  @param[in,out] Context                Component load context.
+  @param[in]     LoadComponentCallback  Callback function pointer, or NULL.
+  @param[out]    Buffer                 Pointer to receive component base.
+  @param[out]    Length                 Pointer to receive component size.
+
+  @retval EFI_NOT_READY            The load was never executed.
+  @retval EFI_SECURITY_VIOLATION   Authentication failed.
+  @retval EFI_SUCCESS              The component has been loaded.
+  @retval Others                   Decompression failed.
+
+**/
+EFI_STATUS
+EFIAPI
+FinishComponentLoad (
+  IN OUT COMPONENT_LOAD_CONTEXT   *Context,
+  IN     LOAD_COMPONENT_CALLBACK   LoadComponentCallback,
+  OUT    VOID                    **Buffer,  OPTIONAL
+  OUT    UINT32                   *Length   OPTIONAL
+  )
+{
+  if (Context->Async && (Context->Status != EFI_NOT_READY)) {
+    if (Context->IsStreaming) {
+      DEBUG ((DEBUG_INFO, "HASH verification for usage (0x%08X): %r\n", Context->Usage, Context->AuthStatus));
+    }
+    if (LoadComponentCallback != NULL) {
+      LoadComponentCallback (PROGESS_ID_LOCATE, NULL);
+      if (Context->IsInFlash) {
+        LoadComponentCallback (PROGESS_ID_COPY, NULL);
       }
-    } else {
-      if (CompressHdr->Size == 0) {
-        Status = EFI_BAD_BUFFER_SIZE;
-      } else {
-        Status = EFI_OUT_OF_RESOURCES;
+      NotifyComponentAuthenticated (Context, LoadComponentCallback);
+      if (!EFI_ERROR (Context->AuthStatus)) {
+        LoadComponentCallback (PROGESS_ID_DECOMPRESS, NULL);
       }
     }
+  }
 
-  } else {
-    Status = EFI_SECURITY_VIOLATION;
+  if (Context->Status != EFI_NOT_READY) {
+    AddComponentProfile (Context);
   }
-  FreeTemporaryMemory (AllocBuf);
 
-  if (!EFI_ERROR (Status)) {
+  if (EFI_ERROR (Context->Status) && (Context->ReqCompBase == NULL)) {
+    FreePages (Context->CompBase, EFI_SIZE_TO_PAGES ((UINTN) Context->DecompressedLen));
+  }
+  FreeTemporaryMemory (Context->AllocBuf);
+
+  if (!EFI_ERROR (Context->Status)) {
     if (Buffer != NULL) {
-      *Buffer = CompBase;
+      *Buffer = Context->CompBase;
     }
     if (Length != NULL) {
-      *Length = DecompressedLen;
+      *Length = Context->DecompressedLen;
     }
   }
 
-  return Status;
+  return Context->Status;
+}
+
+/**
+  Load a component from a container or flahs map to memory and call callback
+  function at predefined point.
+
+  @param[in]     ContainerSig    Container signature or component type.
+  @param[in]     ComponentName   Component name.
+  @param[in,out] Buffer          Pointer to receive component base.
+  @param[in,out] Length          Pointer to receive component size.
+  @param[in,out] LoadComponentCallback  Callback function pointer.
+
+  @retval EFI_UNSUPPORTED          Unsupported AuthType.
+  @retval EFI_NOT_FOUND            Cannot locate component.
+  @retval EFI_BUFFER_TOO_SMALL     Specified buffer size is too small.
+  @retval EFI_SECURITY_VIOLATION   Authentication failed.
+  @retval EFI_SUCCESS              Authentication succeeded.
+
+**/
+EFI_STATUS
+EFIAPI
+LoadComponentWithCallback (
+  IN     UINT32                   ContainerSig,
+  IN     UINT32                   ComponentName,
+  IN OUT VOID                   **Buffer,
+  IN OUT UINT32                  *Length,
+  IN     LOAD_COMPONENT_CALLBACK  LoadComponentCallback
+  )
+{
+  EFI_STATUS                Status;
+  COMPONENT_LOAD_CONTEXT    Context;
+  VOID                     *ReqCompBase;
+  UINT32                    ReqLength;
+
+  // If it is required to use an existing buffer, pass it along with its size
+  ReqCompBase = NULL;
+  ReqLength   = 0;
+  if ((Buffer != NULL) && (*Buffer != NULL)) {
+    ReqCompBase = *Buffer;
+    if (Length != NULL) {
+      ReqLength = *Length;
+    }
+  }
+
+  Status = PrepareComponentLoad (ContainerSig, ComponentName, ReqCompBase, ReqLength, FALSE, &Context);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (LoadComponentCallback != NULL) {
+    LoadComponentCallback (PROGESS_ID_LOCATE, NULL);
+  }
+
+  ExecuteComponentLoad (&Context, LoadComponentCallback);
+
+  return FinishComponentLoad (&Context, LoadComponentCallback, Buffer, Length);
 }
 
 
@@ -1,7 +1,7 @@
 /** @file
   Decompress interfaces
 
-  Copyright (c) 2009 - 2017, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2009 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -9,6 +9,129 @@
 #include <Library/LzmaDecompressLib.h>
 #include <Library/Lz4DecompressLib.h>
 #include <Library/DecompressLib.h>
+#include <Library/SynchronizationLib.h>
+#include <Library/BootloaderCommonLib.h>
+#include <Library/LocalApic.h>
+#include <Service/MpService.h>
+
+#define  MAX_DECOMPRESS_TASK    16
+
+typedef struct {
+  CONST VOID        *Source;
+  VOID              *Destination;
+  CONST VOID        *Scratch;
+  UINT32             BlockCount;
+  volatile UINT32    NextBlock;
+  volatile UINT32    ErrorCount;
+} LZ4_BLOCK_TASK_CONTEXT;
+
+/**
+  Decompress LZ4 blocks until there is no block left.
+
+  It runs on both BSP and APs. Each processor claims the next pending block
+  atomically so that no block is decompressed twice.
+
+  @param[in] Argument     Pointer to LZ4_BLOCK_TASK_CONTEXT.
+
+  @retval                 Number of blocks decompressed by this processor.
+**/
+STATIC
+UINT32
+Lz4BlockDecompressTask (
+  IN UINT32   Argument
+  )
+{
+  LZ4_BLOCK_TASK_CONTEXT  *Context;
+  UINT32                   Index;
+  UINT32                   Count;
+
+  Context = (LZ4_BLOCK_TASK_CONTEXT *)(UINTN)Argument;
+  Count   = 0;
+  while (Context->ErrorCount == 0) {
+    Index = InterlockedIncrement (&Context->NextBlock) - 1;
+    if (Index >= Context->BlockCount) {
+      break;
+    }
+    if (RETURN_ERROR (Lz4BlockDecompressOne (Context->Source, Context->Destination, Context->Scratch, Index))) {
+      InterlockedIncrement (&Context->ErrorCount);
+    }
+    Count++;
+  }
+
+  return Count;
+}
+
+/**
+  Decompress a block-split LZ4 buffer.
+
+  If the MP service is available, idle APs are used to decompress blocks
+  in parallel with the BSP. Otherwise, or if it is called on an AP, all
+  blocks are decompressed on the current processor.
+
+  @param  Source      The source buffer containing the compressed data.
+  @param  SourceSize  The size of source buffer.
+  @param  Destination The destination buffer to store the decompressed data
+  @param  Scratch     A temporary scratch buffer that is used to perform the decompression.
+
+  @retval  RETURN_SUCCESS Decompression completed successfully.
+  @retval  RETURN_INVALID_PARAMETER
+                          The source buffer specified by Source is corrupted.
+**/
+STATIC
+RETURN_STATUS
+Lz4BlockDecompressMp (
+  IN CONST VOID  *Source,
+  IN UINTN        SourceSize,
+  IN OUT VOID    *Destination,
+  IN OUT VOID    *Scratch
+  )
+{
+  RETURN_STATUS            Status;
+  MP_SERVICE              *MpService;
+  MSR_IA32_APIC_BASE       ApicBaseMsr;
+  LZ4_BLOCK_TASK_CONTEXT   Context;
+  UINT32                   TaskId[MAX_DECOMPRESS_TASK];
+  UINT32                   TaskCount;
+  UINT32                   Index;
+
+  MpService = (MP_SERVICE *) GetServiceBySignature (MP_SERVICE_SIGNATURE);
+  if (MpService == NULL) {
+    return Lz4BlockDecompress (Source, SourceSize, Destination, Scratch);
+  }
+
+  // Only BSP can dispatch tasks to APs
+  ApicBaseMsr.Uint64 = AsmReadMsr64 (MSR_IA32_APIC_BASE_ADDRESS);
+  if (ApicBaseMsr.Bits.Bsp == 0) {
+    return Lz4BlockDecompress (Source, SourceSize, Destination, Scratch);
+  }
+
+  Status = Lz4BlockDecompressSetup (Source, SourceSize, Scratch, &Context.BlockCount);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  Context.Source      = Source;
+  Context.Destination = Destination;
+  Context.Scratch     = Scratch;
+  Context.NextBlock   = 0;
+  Context.ErrorCount  = 0;
+
+  // Keep one block for BSP and hand the rest out to idle APs
+  for (TaskCount = 0; (TaskCount < MAX_DECOMPRESS_TASK) && (TaskCount + 1 < Context.BlockCount); TaskCount++) {
+    Status = MpService->RunTask (Lz4BlockDecompressTask, (UINT32)(UINTN)&Context, &TaskId[TaskCount]);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
+
+  Lz4BlockDecompressTask ((UINT32)(UINTN)&Context);
+
+  for (Index = 0; Index < TaskCount; Index++) {
+    MpService->WaitTask (TaskId[Index], NULL);
+  }
+
+  return (Context.ErrorCount == 0) ? RETURN_SUCCESS : RETURN_INVALID_PARAMETER;
+}
 
 /**
   Given a compressed source buffer, this function retrieves the size of
@@ -54,6 +177,8 @@ DecompressGetInfo (
 
   if (Signature == LZ4_SIGNATURE) {
     Status = Lz4DecompressGetInfo (Source, SourceSize, DestinationSize, ScratchSize);
+  } else if (Signature == LZ4_BLOCK_SIGNATURE) {
+    Status = Lz4BlockDecompressGetInfo (Source, SourceSize, DestinationSize, ScratchSize);
   } else if (Signature == LZDM_SIGNATURE) {
     if (DestinationSize != NULL) {
       *DestinationSize = SourceSize;
@@ -109,6 +234,8 @@ Decompress (
   Status = RETURN_UNSUPPORTED;
   if (Signature == LZ4_SIGNATURE) {
     Status = Lz4Decompress (Source, SourceSize, Destination, Scratch);
+  } else if (Signature == LZ4_BLOCK_SIGNATURE) {
+    Status = Lz4BlockDecompressMp (Source, SourceSize, Destination, Scratch);
   } else if (Signature == LZDM_SIGNATURE) {
     CopyMem (Destination, Source, SourceSize);
     Status = RETURN_SUCCESS;
@@ -1,6 +1,6 @@
 /** @file
 
-  Copyright (c) 2019, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2019 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
   Copyright (c) 1997 Manuel Bouyer.
@@ -103,6 +103,8 @@
   @param[in]  File            pointer to an Open file.
   @param[in]  FileBlock       Block to find the file.
   @param[out] DiskBlockPtr    Pointer to the disk which contains block.
+  @param[out] RunLengthPtr    Number of blocks starting from FileBlock that are
+                              known to be contiguous on the disk. Optional.
 
   @retval 0 if success
   @retval other if error.
@@ -112,7 +114,8 @@ RETURN_STATUS
 BlockMap (
   IN  OPEN_FILE     *File,
   IN  INDPTR         FileBlock,
-  OUT INDPTR        *DiskBlockPtr
+  OUT INDPTR        *DiskBlockPtr,
+  OUT UINT32        *RunLengthPtr  OPTIONAL
   );
 
 /**
@@ -256,6 +259,8 @@ ReadInode (
   @param[in]  File            pointer to an Open file.
   @param[in]  FileBlock       Block to find the file.
   @param[out] DiskBlockPtr    Pointer to the disk which contains block.
+  @param[out] RunLengthPtr    Number of blocks starting from FileBlock that are
+                              known to be contiguous on the disk. Optional.
 
   @retval 0 if success
   @retval other if error.
@@ -265,7 +270,8 @@ RETURN_STATUS
 BlockMap (
   IN  OPEN_FILE     *File,
   IN  INDPTR         FileBlock,
-  OUT INDPTR        *DiskBlockPtr
+  OUT INDPTR        *DiskBlockPtr,
+  OUT UINT32        *RunLengthPtr  OPTIONAL
   )
 {
   FILE     *Fp;
@@ -286,6 +292,10 @@ BlockMap (
   FileSystem = Fp->SuperBlockPtr;
   Buf = (VOID *)Fp->Buffer;
 
+  if (RunLengthPtr != NULL) {
+    *RunLengthPtr = 1;
+  }
+
   if ((Fp->DiskInode.Ext2DInodeStatusFlags & EXT4_EXTENTS) != 0) {
     Etable = (EXT4_EXTENT_TABLE*) &(Fp->DiskInode.Ext2DInodeBlocks);
     if (Etable->Eheader.EhMagic != EXT4_EXTENT_HEADER_MAGIC) {
@@ -352,6 +362,9 @@ BlockMap (
       //
       ASSERT (Extent->EstartHi == 0);
       *DiskBlockPtr = Extent->EstartLo + (FileBlock - Extent->Eblk); // (LShiftU64((UINT64)Extent->EiLeafHi, 32) | Extent->EstartLo) + (FileBlock - Extent->Eblk);
+      if (RunLengthPtr != NULL) {
+        *RunLengthPtr = Extent->Eblk + Extent->Elen - (UINT32) FileBlock;
+      }
     } else {
       *DiskBlockPtr = 0;
     }
@@ -469,7 +482,7 @@ BufReadFile (
   BlockSize = FileSystem->Ext2FsBlockSize;    // no fragment
 
   if (FileBlock != Fp->BufferBlockNum) {
-    Rc = BlockMap (File, FileBlock, &DiskBlock);
+    Rc = BlockMap (File, FileBlock, &DiskBlock, NULL);
     if (Rc != 0) {
       return Rc;
     }
@@ -510,6 +523,97 @@ BufReadFile (
   return 0;
 }
 
+/**
+  Read a run of whole FILE blocks directly into the caller buffer.
+
+  The blocks starting from the current seek pointer are mapped to the disk,
+  and all the blocks that are contiguous on the disk, either from a single
+  ext4 extent or from consecutive direct/indirect block pointers, are read
+  with one device request.
+
+  @param[in]  File        Pointer to the open file.
+  @param[in]  MaxBlocks   Maximum number of blocks to read.
+  @param[out] Buffer      Buffer to receive the data.
+  @param[out] BlocksRead  Number of blocks read.
+
+  @retval     0 if success
+  @retval     other if error.
+**/
+STATIC
+RETURN_STATUS
+BulkReadFile (
+  IN  OPEN_FILE     *File,
+  IN  UINT32         MaxBlocks,
+  OUT CHAR8         *Buffer,
+  OUT UINT32        *BlocksRead
+  )
+{
+  FILE *Fp;
+  M_EXT2FS *FileSystem;
+  INDPTR FileBlock;
+  INDPTR DiskBlock;
+  INDPTR NextDiskBlock;
+  UINT32 BlockSize;
+  UINT32 RunLength;
+  UINT32 RSize;
+  RETURN_STATUS Rc;
+
+  Fp = (FILE *)File->FileSystemSpecificData;
+  FileSystem = Fp->SuperBlockPtr;
+  BlockSize = FileSystem->Ext2FsBlockSize;
+  FileBlock = LBLKNO (FileSystem, Fp->SeekPtr);
+
+  Rc = BlockMap (File, FileBlock, &DiskBlock, &RunLength);
+
+  //
+  // BlockMap may have used the block buffer for the index or indirect blocks.
+  //
+  Fp->BufferBlockNum = -1;
+  if (Rc != 0) {
+    return Rc;
+  }
+
+  if (RunLength > MaxBlocks) {
+    RunLength = MaxBlocks;
+  }
+
+  if (DiskBlock == 0) {
+    //
+    // A hole in the file reads as zeros.
+    //
+    ZeroMem (Buffer, BlockSize);
+    *BlocksRead = 1;
+    return 0;
+  }
+
+  if ((Fp->DiskInode.Ext2DInodeStatusFlags & EXT4_EXTENTS) == 0) {
+    //
+    // Extend the run over consecutive block pointers. Most of them come
+    // from the indirect block cache.
+    //
+    while (RunLength < MaxBlocks) {
+      Rc = BlockMap (File, FileBlock + RunLength, &NextDiskBlock, NULL);
+      if ((Rc != 0) || (NextDiskBlock != DiskBlock + RunLength)) {
+        break;
+      }
+      RunLength++;
+    }
+  }
+
+  Rc = DEV_STRATEGY (File->DevPtr) (File->FileDevData, F_READ,
+                                    FSBTODB (FileSystem, DiskBlock),
+                                    RunLength * BlockSize, Buffer, &RSize);
+  if (Rc != 0) {
+    return Rc;
+  }
+  if (RSize != RunLength * BlockSize) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  *BlocksRead = RunLength;
+  return 0;
+}
+
 /**
   Search a directory for a Name and return its inode number.
 
@@ -896,7 +1000,7 @@ Ext2fsOpen (
         INDPTR    DiskBlock;
 
         Buf = Fp->Buffer;
-        Status = BlockMap (File, (INDPTR)0, &DiskBlock);
+        Status = BlockMap (File, (INDPTR)0, &DiskBlock, NULL);
         if (RETURN_ERROR (Status)) {
           goto out;
         }
@@ -1014,6 +1118,10 @@ Ext2fsFileSize (
   Copy a portion of a FILE into a memory.
   Cross block boundaries when necessary
 
+  Whole blocks are read directly into the caller buffer, one device
+  request per contiguous run of blocks. Only the partial blocks at the
+  head and tail go through the block buffer.
+
   @param[in/out]    File      File handle to be read
   @param[in]        Start     Start address of read buffer
   @param[in]        Size      Size to be read
@@ -1032,13 +1140,18 @@ Ext2fsRead (
   )
 {
   FILE *Fp;
+  M_EXT2FS *FileSystem;
   UINT32 Csize;
   CHAR8 *Buf;
   UINT32 BufSize;
+  UINT32 BlockSize;
+  UINT32 Blocks;
   CHAR8 *Address;
   RETURN_STATUS Status;
 
   Fp = (FILE *)File->FileSystemSpecificData;
+  FileSystem = Fp->SuperBlockPtr;
+  BlockSize = FileSystem->Ext2FsBlockSize;
   Status = RETURN_SUCCESS;
   Address = Start;
 
@@ -1050,17 +1163,31 @@ Ext2fsRead (
       break;
     }
 
-    Status = BufReadFile (File, &Buf, &BufSize);
-    if (RETURN_ERROR (Status)) {
-      break;
+    Blocks = Size;
+    if (Blocks > Fp->DiskInode.Ext2DInodeSize - Fp->SeekPtr) {
+      Blocks = (UINT32)(Fp->DiskInode.Ext2DInodeSize - Fp->SeekPtr);
     }
+    Blocks /= BlockSize;
 
-    Csize = Size;
-    if (Csize > BufSize) {
-      Csize = BufSize;
-    }
+    if ((BLOCKOFFSET (FileSystem, Fp->SeekPtr) == 0) && (Blocks != 0)) {
+      Status = BulkReadFile (File, Blocks, Address, &Blocks);
+      if (RETURN_ERROR (Status)) {
+        break;
+      }
+      Csize = Blocks * BlockSize;
+    } else {
+      Status = BufReadFile (File, &Buf, &BufSize);
+      if (RETURN_ERROR (Status)) {
+        break;
+      }
+
+      Csize = Size;
+      if (Csize > BufSize) {
+        Csize = BufSize;
+      }
 
-    CopyMem (Address, Buf, Csize);
+      CopyMem (Address, Buf, Csize);
+    }
 
     Fp->SeekPtr += Csize;
     Address += Csize;
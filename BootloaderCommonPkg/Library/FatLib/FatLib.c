@@ -278,8 +278,14 @@ FatInitFileSystem (
     PrivateData->BlockDeviceCount++;
   }
 
-  Status = FatGetVolumeData (PrivateData);
+  Status = FatInitCache (PrivateData);
+  if (!EFI_ERROR (Status)) {
+    Status = FatGetVolumeData (PrivateData);
+  }
   if (EFI_ERROR (Status)) {
+    if (PrivateData->CacheBuffer != NULL) {
+      FreePool (PrivateData->CacheBuffer);
+    }
     FreePool (PrivateData);
   } else {
     DEBUG ((DEBUG_INFO, "Detected FAT on HwDev %d Part %d\n",  PartBlockDev->HarewareDevice, SwPart));
@@ -312,6 +318,11 @@ FatCloseFileSystem (
   }
 
   if (PrivateData != NULL && PrivateData->Signature == FS_FAT_SIGNATURE) {
+    DEBUG ((DEBUG_INFO, "FAT metadata cache: %d hits, %d misses\n",
+      PrivateData->CacheHits, PrivateData->CacheMisses));
+    if (PrivateData->CacheBuffer != NULL) {
+      FreePool (PrivateData->CacheBuffer);
+    }
     FreePool (PrivateData);
   }
 }
@@ -364,6 +375,15 @@ FatFsOpenFile (
     }
     CopyMem (File, Handle, sizeof (PEI_FAT_FILE));
 
+    //
+    // Walk the FAT chain only once for the opened file. Reading still works
+    // through the FAT chain if the run map cannot be built.
+    //
+    Status = FatBuildClusterRunMap (PrivateData, File);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_WARN, "  FatFsOpenFile: no cluster run map for %s - %r\n", File->FileName, Status));
+      Status = EFI_SUCCESS;
+    }
     *FileHandle = (EFI_HANDLE)File;
 
     DEBUG ((DEBUG_VERBOSE, "  FatFsOpenFile: %s opened\n", File->FileName));
@@ -495,9 +515,44 @@ FatFsCloseFile (
   }
 
   DEBUG ((DEBUG_VERBOSE, "  FatFsCloseFile: %s closed\n", File->FileName));
+  if (File->RunMap != NULL) {
+    FreePool (File->RunMap);
+  }
   FreePool (File);
 }
 
+/**
+  Get the metadata cache statistics of a file system.
+
+  @param[in]     FsHandle         file system handle.
+  @param[out]    CacheStats       Pointer to receive the cache statistics.
+
+  @retval EFI_SUCCESS             The statistics were returned.
+  @retval EFI_INVALID_PARAMETER   Parameter is not valid.
+
+**/
+EFI_STATUS
+EFIAPI
+FatFsGetCacheStats (
+  IN  EFI_HANDLE                                  FsHandle,
+  OUT FS_CACHE_STATS                             *CacheStats
+  )
+{
+  PEI_FAT_PRIVATE_DATA   *PrivateData;
+
+  PrivateData = (PEI_FAT_PRIVATE_DATA *)FsHandle;
+  if (PrivateData == NULL || CacheStats == NULL || PrivateData->Signature != FS_FAT_SIGNATURE) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CacheStats->CacheBlocks = PrivateData->CacheCount;
+  CacheStats->BlockSize   = PrivateData->CacheBlockSize;
+  CacheStats->Hits        = PrivateData->CacheHits;
+  CacheStats->Misses      = PrivateData->CacheMisses;
+
+  return EFI_SUCCESS;
+}
+
 /**
   List directories or files
 
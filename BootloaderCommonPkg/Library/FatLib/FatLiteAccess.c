@@ -1,7 +1,7 @@
 /** @file
   FAT file system access routines for FAT recovery PEIM
 
-Copyright (c) 2006 - 2019, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2006 - 2020, Intel Corporation. All rights reserved.<BR>
 
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
@@ -359,6 +359,178 @@ FatSetFilePos (
 }
 
 
+/**
+  Build the cluster run map of a file from its FAT chain.
+
+  Each run describes a group of physically contiguous clusters, so that the
+  file data can be located later without walking the FAT chain again.
+
+  @param  PrivateData            Global memory map for accessing global variables
+  @param  File                   The file.
+
+  @retval EFI_SUCCESS            The run map was built, or is not needed.
+  @retval EFI_VOLUME_CORRUPTED   The cluster chain is shorter than the file.
+  @retval EFI_OUT_OF_RESOURCES   Insufficant memory resource pool.
+  @retval EFI_DEVICE_ERROR       Something error while accessing media.
+
+**/
+EFI_STATUS
+FatBuildClusterRunMap (
+  IN  PEI_FAT_PRIVATE_DATA  *PrivateData,
+  IN  PEI_FAT_FILE          *File
+  )
+{
+  EFI_STATUS            Status;
+  PEI_FAT_CLUSTER_RUN   *RunMap;
+  UINT32                RunCount;
+  UINT32                ClusterCount;
+  UINT32                FileCluster;
+  UINT32                Cluster;
+  UINT32                PrevCluster;
+  UINT32                Pass;
+
+  File->RunMap   = NULL;
+  File->RunCount = 0;
+
+  if (File->IsFixedRootDir || ((File->Attributes & FAT_ATTR_DIRECTORY) != 0) || (File->FileSize == 0)) {
+    return EFI_SUCCESS;
+  }
+
+  //
+  // The file size bounds the chain walk, so a looped chain cannot hang here.
+  //
+  ClusterCount = (UINT32) DivU64x32 ((UINT64) File->FileSize + File->Volume->ClusterSize - 1, File->Volume->ClusterSize);
+
+  //
+  // The first pass counts the runs and the second one fills them in.
+  // The FAT sectors are in the metadata cache by the second pass.
+  //
+  RunMap   = NULL;
+  RunCount = 0;
+  for (Pass = 0; Pass < 2; Pass++) {
+    RunCount    = 0;
+    PrevCluster = 0;
+    Cluster     = File->StartingCluster;
+    for (FileCluster = 0; FileCluster < ClusterCount; FileCluster++) {
+      if (FAT_CLUSTER_FUNCTIONAL (Cluster)) {
+        if (RunMap != NULL) {
+          FreePool (RunMap);
+        }
+        return EFI_VOLUME_CORRUPTED;
+      }
+
+      if ((FileCluster == 0) || (Cluster != PrevCluster + 1)) {
+        if (RunMap != NULL) {
+          RunMap[RunCount].FileCluster = FileCluster;
+          RunMap[RunCount].Cluster     = Cluster;
+          RunMap[RunCount].Count       = 0;
+        }
+        RunCount++;
+      }
+      if (RunMap != NULL) {
+        RunMap[RunCount - 1].Count++;
+      }
+
+      PrevCluster = Cluster;
+      if (FileCluster + 1 < ClusterCount) {
+        Status = FatGetNextCluster (PrivateData, File->Volume, PrevCluster, &Cluster);
+        if (EFI_ERROR (Status)) {
+          if (RunMap != NULL) {
+            FreePool (RunMap);
+          }
+          return EFI_DEVICE_ERROR;
+        }
+      }
+    }
+
+    if (Pass == 0) {
+      RunMap = (PEI_FAT_CLUSTER_RUN *) AllocatePool (RunCount * sizeof (PEI_FAT_CLUSTER_RUN));
+      if (RunMap == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+      }
+    }
+  }
+
+  File->RunMap   = RunMap;
+  File->RunCount = RunCount;
+
+  return EFI_SUCCESS;
+}
+
+
+/**
+  Reads file data through the cluster run map. Updates the file's CurrentPos.
+
+  @param  PrivateData            Global memory map for accessing global variables
+  @param  File                   The file.
+  @param  Size                   The amount of data to read.
+  @param  Buffer                 The buffer storing the data.
+
+  @retval EFI_SUCCESS            The data is read.
+  @retval EFI_DEVICE_ERROR       Something error while accessing media.
+
+**/
+STATIC
+EFI_STATUS
+FatReadFileByRunMap (
+  IN  PEI_FAT_PRIVATE_DATA  *PrivateData,
+  IN  PEI_FAT_FILE          *File,
+  IN  UINTN                 Size,
+  OUT VOID                  *Buffer
+  )
+{
+  EFI_STATUS            Status;
+  PEI_FAT_VOLUME        *Volume;
+  PEI_FAT_CLUSTER_RUN   *Run;
+  CHAR8                 *BufferPtr;
+  UINT32                RunIndex;
+  UINT32                FileCluster;
+  UINT32                Offset;
+  UINT64                PhysicalAddr;
+  UINT64                RunBytes;
+  UINTN                 Amount;
+
+  Volume    = File->Volume;
+  BufferPtr = Buffer;
+  RunIndex  = 0;
+
+  while (Size != 0) {
+    FileCluster = (UINT32) DivU64x32Remainder (File->CurrentPos, Volume->ClusterSize, &Offset);
+    while ((RunIndex < File->RunCount) &&
+           (FileCluster >= File->RunMap[RunIndex].FileCluster + File->RunMap[RunIndex].Count)) {
+      RunIndex++;
+    }
+    if (RunIndex == File->RunCount) {
+      return EFI_DEVICE_ERROR;
+    }
+
+    //
+    // Read up to the end of the current run at once
+    //
+    Run           = &File->RunMap[RunIndex];
+    PhysicalAddr  = Volume->FirstClusterPos + MultU64x32 (Volume->ClusterSize, Run->Cluster + (FileCluster - Run->FileCluster) - 2);
+    RunBytes      = MultU64x32 (Run->FileCluster + Run->Count - FileCluster, Volume->ClusterSize) - Offset;
+    Amount        = Size > RunBytes ? (UINTN) RunBytes : Size;
+    Status = FatReadDisk (
+               PrivateData,
+               Volume->BlockDeviceNo,
+               PhysicalAddr + Offset,
+               Amount,
+               BufferPtr
+               );
+    if (EFI_ERROR (Status)) {
+      return EFI_DEVICE_ERROR;
+    }
+
+    File->CurrentPos += (UINT32) Amount;
+    BufferPtr += Amount;
+    Size -= Amount;
+  }
+
+  return EFI_SUCCESS;
+}
+
+
 /**
   Reads file data. Updates the file's CurrentPos.
 
@@ -411,6 +583,11 @@ FatReadFile (
     if ((File->Attributes & FAT_ATTR_DIRECTORY) == 0) {
       Size = Size < (File->FileSize - File->CurrentPos) ? Size : (File->FileSize - File->CurrentPos);
     }
+
+    if (File->RunMap != NULL) {
+      return FatReadFileByRunMap (PrivateData, File, Size, Buffer);
+    }
+
     //
     // This is a normal cluster based file
     //
@@ -1,7 +1,7 @@
 /** @file
   General purpose supporting routines for FAT recovery PEIM
 
-Copyright (c) 2006 - 2017, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2006 - 2020, Intel Corporation. All rights reserved.<BR>
 
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
@@ -136,9 +136,69 @@ FatReadBlock (
 }
 
 
+/**
+  Allocate the metadata block cache.
+
+  The cache holds PcdFatCacheBlockCount blocks and is indexed by a hash of
+  the block device number and Lba, so that the FAT sectors and directory
+  blocks touched repeatedly while walking cluster chains are read only once.
+
+  @param  PrivateData            Global memory map for accessing global variables.
+
+  @retval EFI_SUCCESS            The cache was allocated.
+  @retval EFI_UNSUPPORTED        The block size is not supported.
+  @retval EFI_OUT_OF_RESOURCES   Insufficant memory resource pool.
+
+**/
+EFI_STATUS
+FatInitCache (
+  IN  PEI_FAT_PRIVATE_DATA   *PrivateData
+  )
+{
+  UINT32                CacheCount;
+  UINT32                BlockSize;
+  UINT32                Index;
+  UINT8                 *BlockData;
+
+  //
+  // All the logical devices share the block size of the physical device
+  //
+  BlockSize = PrivateData->BlockDevice[0].BlockSize;
+  if ((BlockSize == 0) || (BlockSize > PEI_FAT_MAX_BLOCK_SIZE)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  CacheCount = FixedPcdGet32 (PcdFatCacheBlockCount);
+  if (CacheCount == 0) {
+    CacheCount = 1;
+  }
+
+  PrivateData->CacheBuffer = (PEI_FAT_CACHE_BUFFER *) AllocateZeroPool (
+                               CacheCount * (sizeof (PEI_FAT_CACHE_BUFFER) + BlockSize)
+                               );
+  if (PrivateData->CacheBuffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  BlockData = (UINT8 *) &PrivateData->CacheBuffer[CacheCount];
+  for (Index = 0; Index < CacheCount; Index++) {
+    PrivateData->CacheBuffer[Index].Buffer = BlockData + Index * BlockSize;
+  }
+
+  PrivateData->CacheCount     = CacheCount;
+  PrivateData->CacheBlockSize = BlockSize;
+  PrivateData->CacheTick      = 0;
+  PrivateData->CacheHits      = 0;
+  PrivateData->CacheMisses    = 0;
+  ZeroMem (PrivateData->CacheHash, sizeof (PrivateData->CacheHash));
+
+  return EFI_SUCCESS;
+}
+
+
 /**
   Find a cache block designated to specific Block device and Lba.
-  If not found, invalidate an oldest one and use it. (LRU cache)
+  If not found, invalidate the least recently used one and use it. (LRU cache)
 
   @param  PrivateData       the global memory map.
   @param  BlockDeviceNo     the Block device.
@@ -160,49 +220,63 @@ FatGetCacheBlock (
 {
   EFI_STATUS            Status;
   PEI_FAT_CACHE_BUFFER  *CacheBuffer;
-  INTN                  Index;
-  STATIC UINT8          Seed;
+  UINT32                *Link;
+  UINT32                Bucket;
+  UINT32                Index;
+  UINT32                Victim;
 
-  Status      = EFI_SUCCESS;
   CacheBuffer = NULL;
 
   //
-  // go through existing cache buffers
+  // Current device ID should be less than maximum device ID.
   //
-  for (Index = 0; Index < PEI_FAT_CACHE_SIZE; Index++) {
-    CacheBuffer = & (PrivateData->CacheBuffer[Index]);
-    if (CacheBuffer->Valid && CacheBuffer->BlockDeviceNo == BlockDeviceNo && CacheBuffer->Lba == Lba) {
-      break;
-    }
+  if (BlockDeviceNo >= PEI_FAT_MAX_BLOCK_DEVICE) {
+    return EFI_DEVICE_ERROR;
   }
 
-  if (Index < PEI_FAT_CACHE_SIZE) {
-    *CachePtr = (CHAR8 *) CacheBuffer->Buffer;
-    return EFI_SUCCESS;
+  if (PrivateData->BlockDevice[BlockDeviceNo].BlockSize > PrivateData->CacheBlockSize) {
+    return EFI_DEVICE_ERROR;
   }
+
   //
-  // We have to find an invalid cache buffer
+  // Look up the hash bucket
   //
-  for (Index = 0; Index < PEI_FAT_CACHE_SIZE; Index++) {
-    if (!PrivateData->CacheBuffer[Index].Valid) {
-      break;
+  Bucket = ((UINT32) Lba ^ ((UINT32) BlockDeviceNo << 5)) & (PEI_FAT_CACHE_HASH_SIZE - 1);
+  for (Index = PrivateData->CacheHash[Bucket]; Index != 0; Index = CacheBuffer->HashNext) {
+    CacheBuffer = &PrivateData->CacheBuffer[Index - 1];
+    if (CacheBuffer->BlockDeviceNo == BlockDeviceNo && CacheBuffer->Lba == Lba) {
+      CacheBuffer->Lru = ++PrivateData->CacheTick;
+      PrivateData->CacheHits++;
+      *CachePtr = (CHAR8 *) CacheBuffer->Buffer;
+      return EFI_SUCCESS;
     }
   }
-  //
-  // Use the cache buffer
-  //
-  if (Index == PEI_FAT_CACHE_SIZE) {
-    Index = (Seed++) % PEI_FAT_CACHE_SIZE;
-  }
+
+  PrivateData->CacheMisses++;
 
   //
-  // Current device ID should be less than maximum device ID.
+  // Use an invalid cache buffer, or evict the least recently used one
   //
-  if (BlockDeviceNo >= PEI_FAT_MAX_BLOCK_DEVICE) {
-    return EFI_DEVICE_ERROR;
+  Victim = 0;
+  for (Index = 0; Index < PrivateData->CacheCount; Index++) {
+    if (!PrivateData->CacheBuffer[Index].Valid) {
+      Victim = Index;
+      break;
+    }
+    if (PrivateData->CacheBuffer[Index].Lru < PrivateData->CacheBuffer[Victim].Lru) {
+      Victim = Index;
+    }
   }
 
-  CacheBuffer                 = & (PrivateData->CacheBuffer[Index]);
+  CacheBuffer = &PrivateData->CacheBuffer[Victim];
+  if (CacheBuffer->Valid) {
+    Link = &PrivateData->CacheHash[((UINT32) CacheBuffer->Lba ^ ((UINT32) CacheBuffer->BlockDeviceNo << 5)) & (PEI_FAT_CACHE_HASH_SIZE - 1)];
+    while (*Link != Victim + 1) {
+      Link = &PrivateData->CacheBuffer[*Link - 1].HashNext;
+    }
+    *Link = CacheBuffer->HashNext;
+    CacheBuffer->Valid = FALSE;
+  }
 
   CacheBuffer->BlockDeviceNo  = BlockDeviceNo;
   CacheBuffer->Lba            = Lba;
@@ -222,8 +296,11 @@ FatGetCacheBlock (
     return EFI_DEVICE_ERROR;
   }
 
-  CacheBuffer->Valid  = TRUE;
-  *CachePtr           = (CHAR8 *) CacheBuffer->Buffer;
+  CacheBuffer->Valid    = TRUE;
+  CacheBuffer->Lru      = ++PrivateData->CacheTick;
+  CacheBuffer->HashNext = PrivateData->CacheHash[Bucket];
+  PrivateData->CacheHash[Bucket] = Victim + 1;
+  *CachePtr             = (CHAR8 *) CacheBuffer->Buffer;
 
   return Status;
 }
@@ -265,25 +342,27 @@ FatReadDisk (
   BlockSize = PrivateData->BlockDevice[BlockDeviceNo].BlockSize;
 
   //
-  // Read underrun
+  // Read underrun. Block aligned reads bypass the cache so that bulk
+  // file data does not evict the cached metadata blocks.
   //
   Lba     = DivU64x32Remainder (StartingAddress, BlockSize, &Offset);
-  Status  = FatGetCacheBlock (PrivateData, BlockDeviceNo, Lba, &CachePtr);
-  if (EFI_ERROR (Status)) {
-    return EFI_DEVICE_ERROR;
-  }
+  if ((Offset != 0) || (Size < BlockSize)) {
+    Status  = FatGetCacheBlock (PrivateData, BlockDeviceNo, Lba, &CachePtr);
+    if (EFI_ERROR (Status)) {
+      return EFI_DEVICE_ERROR;
+    }
 
-  Amount = Size < (BlockSize - Offset) ? Size : (BlockSize - Offset);
-  CopyMem (BufferPtr, CachePtr + Offset, Amount);
+    Amount = Size < (BlockSize - Offset) ? Size : (BlockSize - Offset);
+    CopyMem (BufferPtr, CachePtr + Offset, Amount);
 
-  if (Size == Amount) {
-    return EFI_SUCCESS;
-  }
+    if (Size == Amount) {
+      return EFI_SUCCESS;
+    }
 
-  Size -= Amount;
-  BufferPtr += Amount;
-  StartingAddress += Amount;
-  Lba += 1;
+    Size -= Amount;
+    BufferPtr += Amount;
+    Lba += 1;
+  }
 
   //
   // Read aligned parts
@@ -291,12 +370,14 @@ FatReadDisk (
   OverRunLba = Lba + DivU64x32Remainder (Size, BlockSize, &Offset);
 
   Size -= Offset;
-  Status = FatReadBlock (PrivateData, BlockDeviceNo, Lba, Size, BufferPtr);
-  if (EFI_ERROR (Status)) {
-    return EFI_DEVICE_ERROR;
-  }
+  if (Size != 0) {
+    Status = FatReadBlock (PrivateData, BlockDeviceNo, Lba, Size, BufferPtr);
+    if (EFI_ERROR (Status)) {
+      return EFI_DEVICE_ERROR;
+    }
 
-  BufferPtr += Size;
+    BufferPtr += Size;
+  }
 
   //
   // Read overrun
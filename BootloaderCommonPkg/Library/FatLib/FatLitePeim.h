@@ -1,7 +1,7 @@
 /** @file
   Data structures for FAT recovery PEIM
 
-Copyright (c) 2006 - 2019, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2006 - 2020, Intel Corporation. All rights reserved.<BR>
 
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
@@ -26,7 +26,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 //
 // Definitions
 //
-#define PEI_FAT_CACHE_SIZE                            4
+#define PEI_FAT_CACHE_HASH_SIZE                       64
 #define PEI_FAT_MAX_BLOCK_SIZE                        8192
 #define FAT_MAX_FILE_NAME_LENGTH                      128
 #define PEI_FAT_MAX_BLOCK_DEVICE                      64
@@ -78,6 +78,15 @@ typedef struct {
   UINT32        RootDirCluster;
 } PEI_FAT_VOLUME;
 
+//
+// A run of physically contiguous clusters of a file
+//
+typedef struct {
+  UINT32          FileCluster;      // Cluster index of the run within the file
+  UINT32          Cluster;          // First volume cluster of the run
+  UINT32          Count;            // Number of clusters in the run
+} PEI_FAT_CLUSTER_RUN;
+
 //
 // File instance
 //
@@ -92,6 +101,13 @@ typedef struct {
   UINT32          CurrentCluster;
   UINT8           Attributes;
   UINT32          FileSize;
+  //
+  // Cluster run map built once from the FAT chain when a file is opened.
+  // When present, FatReadFile() locates data through it instead of walking
+  // the FAT chain, and only CurrentPos is maintained.
+  //
+  PEI_FAT_CLUSTER_RUN  *RunMap;
+  UINT32                RunCount;
 } PEI_FAT_FILE;
 
 //
@@ -102,7 +118,8 @@ typedef struct {
   UINTN   BlockDeviceNo;
   UINT64  Lba;
   UINT32  Lru;
-  UINT64  Buffer[PEI_FAT_MAX_BLOCK_SIZE / 8];
+  UINT32  HashNext;       // Index + 1 of the next buffer in the same hash bucket
+  UINT8   *Buffer;
   UINTN   Size;
 } PEI_FAT_CACHE_BUFFER;
 
@@ -176,7 +193,13 @@ typedef struct {
   UINTN                               VolumeCount;
   PEI_FAT_VOLUME                      Volume[PEI_FAT_MAX_VOLUME];
   PEI_FAT_FILE                        File;
-  PEI_FAT_CACHE_BUFFER                CacheBuffer[PEI_FAT_CACHE_SIZE];
+  UINT32                              CacheCount;
+  UINT32                              CacheBlockSize;
+  UINT32                              CacheTick;
+  UINT32                              CacheHits;
+  UINT32                              CacheMisses;
+  UINT32                              CacheHash[PEI_FAT_CACHE_HASH_SIZE];
+  PEI_FAT_CACHE_BUFFER                *CacheBuffer;
 } PEI_FAT_PRIVATE_DATA;
 
 
@@ -261,6 +284,26 @@ FatReadBlock (
   );
 
 
+/**
+  Allocate the metadata block cache.
+
+  The cache holds PcdFatCacheBlockCount blocks and is indexed by a hash of
+  the block device number and Lba, so that the FAT sectors and directory
+  blocks touched repeatedly while walking cluster chains are read only once.
+
+  @param  PrivateData            Global memory map for accessing global variables.
+
+  @retval EFI_SUCCESS            The cache was allocated.
+  @retval EFI_UNSUPPORTED        The block size is not supported.
+  @retval EFI_OUT_OF_RESOURCES   Insufficant memory resource pool.
+
+**/
+EFI_STATUS
+FatInitCache (
+  IN  PEI_FAT_PRIVATE_DATA   *PrivateData
+  );
+
+
 /**
   Check if there is a valid FAT in the corresponding Block device
   of the volume and if yes, fill in the relevant fields for the
@@ -353,6 +396,28 @@ FatSetFilePos (
   );
 
 
+/**
+  Build the cluster run map of a file from its FAT chain.
+
+  Each run describes a group of physically contiguous clusters, so that the
+  file data can be located later without walking the FAT chain again.
+
+  @param  PrivateData            Global memory map for accessing global variables
+  @param  File                   The file.
+
+  @retval EFI_SUCCESS            The run map was built, or is not needed.
+  @retval EFI_VOLUME_CORRUPTED   The cluster chain is shorter than the file.
+  @retval EFI_OUT_OF_RESOURCES   Insufficant memory resource pool.
+  @retval EFI_DEVICE_ERROR       Something error while accessing media.
+
+**/
+EFI_STATUS
+FatBuildClusterRunMap (
+  IN  PEI_FAT_PRIVATE_DATA  *PrivateData,
+  IN  PEI_FAT_FILE          *File
+  );
+
+
 /**
   Reads file data. Updates the file's CurrentPos.
 
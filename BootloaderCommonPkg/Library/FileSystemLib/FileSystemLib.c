@@ -55,6 +55,7 @@ RegisterFileSystems (
       mFileSystemFuncs[FsType].ReadFile         = FatFsReadFile;
       mFileSystemFuncs[FsType].CloseFile        = FatFsCloseFile;
       mFileSystemFuncs[FsType].ListDir          = FatFsListDir;
+      mFileSystemFuncs[FsType].GetCacheStats    = FatFsGetCacheStats;
     }
 
     FsType = EnumFileSystemTypeExt2;
@@ -503,3 +504,42 @@ DEBUG_CODE_END ();
 
   return EFI_UNSUPPORTED;
 }
+
+/**
+  Get the metadata cache statistics of a file system.
+
+  @param[in]     FsHandle         file system handle.
+  @param[out]    CacheStats       Pointer to receive the cache statistics.
+
+  @retval EFI_SUCCESS             The statistics were returned.
+  @retval EFI_INVALID_PARAMETER   Parameter is not valid.
+  @retval EFI_NOT_READY           The file system is not initialized.
+  @retval EFI_UNSUPPORTED         The file system has no metadata cache.
+
+**/
+EFI_STATUS
+EFIAPI
+GetFileSystemCacheStats (
+  IN  EFI_HANDLE                                  FsHandle,
+  OUT FS_CACHE_STATS                             *CacheStats
+  )
+{
+  OS_FILE_SYSTEM_TYPE         FsType;
+  FILE_SYSTEM_CONTROL_BLOCK  *FileSystemControlBlock;
+
+  FileSystemControlBlock = (FILE_SYSTEM_CONTROL_BLOCK *)FsHandle;
+  if (FileSystemControlBlock == NULL || CacheStats == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  FsType = GetFileSystemType (FsHandle);
+  if (FsType >= EnumFileSystemTypeAuto) {
+    return EFI_NOT_READY;
+  }
+
+  if (mFileSystemFuncs[FsType].GetCacheStats == NULL) {
+    return EFI_UNSUPPORTED;
+  }
+
+  return mFileSystemFuncs[FsType].GetCacheStats (FileSystemControlBlock->FsHandle, CacheStats);
+}
@@ -1,7 +1,7 @@
 /** @file
   BMP Image Decoding
 
-  Copyright (c) 2004 - 2014, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2004 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -12,6 +12,71 @@
 #include <Library/BlMemoryAllocationLib.h>
 #include <Guid/GraphicsInfoHob.h>
 
+/**
+  Convert one line of BMP image data into Blt pixels.
+
+  The pixel format is resolved once per line, and 24/32-bit lines are
+  converted with whole 32-bit pixel stores.
+
+  @param[in]  Image         BMP pixel data of the line.
+  @param[in]  BmpColorMap   BMP color map for palette formats.
+  @param[in]  BitPerPixel   BMP bits per pixel, 1, 4, 8, 24 or 32.
+  @param[in]  PixelWidth    Number of pixels in the line.
+  @param[out] BltBuffer     Buffer to receive PixelWidth Blt pixels.
+
+**/
+STATIC
+VOID
+ConvertBmpLine (
+  IN  CONST UINT8                    *Image,
+  IN  CONST BMP_COLOR_MAP            *BmpColorMap,
+  IN  UINT16                          BitPerPixel,
+  IN  UINTN                           PixelWidth,
+  OUT EFI_GRAPHICS_OUTPUT_BLT_PIXEL  *BltBuffer
+  )
+{
+  UINT32                       *Pixel;
+  CONST UINT32                 *ColorMap;
+  UINTN                         Width;
+
+  // BMP_COLOR_MAP and EFI_GRAPHICS_OUTPUT_BLT_PIXEL share the same layout
+  Pixel    = (UINT32 *)BltBuffer;
+  ColorMap = (CONST UINT32 *)BmpColorMap;
+
+  switch (BitPerPixel) {
+  case 1:
+    for (Width = 0; Width < PixelWidth; Width++) {
+      Pixel[Width] = ColorMap[(Image[Width >> 3] >> (7 - (Width & 0x7))) & 0x1];
+    }
+    break;
+
+  case 4:
+    for (Width = 0; Width < PixelWidth; Width++) {
+      Pixel[Width] = ColorMap[(Image[Width >> 1] >> (((Width & 0x1) != 0) ? 0 : 4)) & 0xF];
+    }
+    break;
+
+  case 8:
+    for (Width = 0; Width < PixelWidth; Width++) {
+      Pixel[Width] = ColorMap[Image[Width]];
+    }
+    break;
+
+  case 24:
+    for (Width = 0; Width < PixelWidth; Width++, Image += 3) {
+      Pixel[Width] = Image[0] | ((UINT32)Image[1] << 8) | ((UINT32)Image[2] << 16);
+    }
+    break;
+
+  case 32:
+    CopyMem (Pixel, Image, PixelWidth * sizeof (UINT32));
+    break;
+
+  default:
+    break;
+  }
+}
+
 /**
   Display a *.BMP graphics image to the frame buffer. If a NULL GopBlt buffer
   is passed in a GopBlt buffer will be allocated by this routine. If a GopBlt
@@ -40,12 +105,8 @@ DisplayBmpToFrameBuffer (
   BMP_IMAGE_HEADER              *BmpHeader;
   BMP_COLOR_MAP                 *BmpColorMap;
   EFI_GRAPHICS_OUTPUT_BLT_PIXEL *BltBuffer;
-  EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Blt;
   BOOLEAN                       IsAllocated;
-  UINTN                         Index;
   UINTN                         Height;
-  UINTN                         Width;
-  UINTN                         ImageIndex;
   UINTN                         OffX;
   UINTN                         OffY;
   UINTN                         PixelHeight;
@@ -56,8 +117,6 @@ DisplayBmpToFrameBuffer (
   UINT32                        FrameBufferOffset;
   UINT32                        *FrameBufferPtr;
   UINT8                         *Image;
-  UINT8                         *ImageHeader;
-  EFI_STATUS                    Status;
 
   BmpHeader = (BMP_IMAGE_HEADER *) BmpImage;
 
@@ -72,6 +131,14 @@ DisplayBmpToFrameBuffer (
     return EFI_UNSUPPORTED;
   }
 
+  //
+  // Only support palette, 24-bit and 32-bit formats.
+  //
+  if ((BmpHeader->BitPerPixel != 1) && (BmpHeader->BitPerPixel != 4) && (BmpHeader->BitPerPixel != 8) &&
+      (BmpHeader->BitPerPixel != 24) && (BmpHeader->BitPerPixel != 32)) {
+    return EFI_UNSUPPORTED;
+  }
+
   //
   // Only support BITMAPINFOHEADER format.
   // BITMAPFILEHEADER + BITMAPINFOHEADER = BMP_IMAGE_HEADER
@@ -130,7 +197,6 @@ DisplayBmpToFrameBuffer (
   // Calculate graphics image data address in the image
   //
   Image         = ((UINT8 *) BmpImage) + BmpHeader->ImageOffset;
-  ImageHeader   = Image;
 
   PixelWidth   = BmpHeader->PixelWidth;
   PixelHeight  = BmpHeader->PixelHeight;
@@ -177,92 +243,22 @@ DisplayBmpToFrameBuffer (
   BltBuffer = *GopBlt;
 
   FrameBufferPtr = (UINT32 *) (((UINTN) GfxInfoHob->FrameBufferBase));
-  FrameBufferOffset = (UINT32)((OffY + PixelHeight) * GfxInfoHob->GraphicsMode.HorizontalResolution + OffX);
-
-  Status = EFI_SUCCESS;
-
-  for (Height = 0; Height < BmpHeader->PixelHeight; Height++) {
-    Blt = &BltBuffer[PixelWidth - 1];
-    for (Width = 0; Width < BmpHeader->PixelWidth; Width++, Image++, Blt++) {
-      switch (BmpHeader->BitPerPixel) {
-      case 1:
-        //
-        // Convert 1-bit (2 colors) BMP to 24-bit color
-        //
-        for (Index = 0; Index < 8 && Width < BmpHeader->PixelWidth; Index++) {
-          Blt->Red    = BmpColorMap[ ((*Image) >> (7 - Index)) & 0x1].Red;
-          Blt->Green  = BmpColorMap[ ((*Image) >> (7 - Index)) & 0x1].Green;
-          Blt->Blue   = BmpColorMap[ ((*Image) >> (7 - Index)) & 0x1].Blue;
-          Blt++;
-          Width++;
-        }
-
-        Blt--;
-        Width--;
-        break;
-
-      case 4:
-        //
-        // Convert 4-bit (16 colors) BMP Palette to 24-bit color
-        //
-        Index       = (*Image) >> 4;
-        Blt->Red    = BmpColorMap[Index].Red;
-        Blt->Green  = BmpColorMap[Index].Green;
-        Blt->Blue   = BmpColorMap[Index].Blue;
-        if (Width < (BmpHeader->PixelWidth - 1)) {
-          Blt++;
-          Width++;
-          Index       = (*Image) & 0x0f;
-          Blt->Red    = BmpColorMap[Index].Red;
-          Blt->Green  = BmpColorMap[Index].Green;
-          Blt->Blue   = BmpColorMap[Index].Blue;
-        }
-        break;
-
-      case 8:
-        //
-        // Convert 8-bit (256 colors) BMP Palette to 24-bit color
-        //
-        Blt->Red    = BmpColorMap[*Image].Red;
-        Blt->Green  = BmpColorMap[*Image].Green;
-        Blt->Blue   = BmpColorMap[*Image].Blue;
-        break;
-
-      case 24:
-        //
-        // It is 24-bit BMP.
-        //
-        Blt->Blue   = *Image++;
-        Blt->Green  = *Image++;
-        Blt->Red    = *Image;
-        break;
-
-      default:
-        //
-        // Other bit format BMP is not supported.
-        //
-        Status = EFI_UNSUPPORTED;
-        goto End;
-      }
-    }
+  FrameBufferOffset = (UINT32)((OffY + PixelHeight - 1) * GfxInfoHob->GraphicsMode.HorizontalResolution + OffX);
 
-    ImageIndex = (UINTN) (Image - ImageHeader);
-    if ((ImageIndex % 4) != 0) {
-      //
-      // Bmp Image starts each row on a 32-bit boundary!
-      //
-      Image = Image + (4 - (ImageIndex % 4));
-    }
-
-    CopyMem (&FrameBufferPtr[FrameBufferOffset], &BltBuffer[PixelWidth - 1], Width * 4);
+  //
+  // BMP lines are stored bottom-up, and each line starts on a 32-bit boundary.
+  //
+  for (Height = 0; Height < PixelHeight; Height++) {
+    ConvertBmpLine (Image, BmpColorMap, BmpHeader->BitPerPixel, PixelWidth, BltBuffer);
+    CopyMem (&FrameBufferPtr[FrameBufferOffset], BltBuffer, PixelWidth * 4);
     FrameBufferOffset -= GfxInfoHob->GraphicsMode.HorizontalResolution;
+    Image += DataSizePerLine;
   }
 
-End:
   if (IsAllocated) {
     FreePool (*GopBlt);
     *GopBlt = NULL;
   }
 
-  return Status;
+  return EFI_SUCCESS;
 }
@@ -1,7 +1,7 @@
 /** @file
   Basic graphics rendering support
 
-  Copyright (c) 2017 - 2019, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2017 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -9,6 +9,7 @@
 #include <Library/GraphicsLib.h>
 #include <Library/PrintLib.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
 
 #define  ANSI_ESCAPE_SEQ_CLEAR_SCREEN    (UINT8 *)"\x1b[2J"
 
@@ -87,6 +88,54 @@ BltToFrameBuffer (
   return EFI_SUCCESS;
 }
 
+/**
+  Render a glyph into a pixel buffer (ASCII only).
+
+  @param[in]  Glyph               ASCII character to render
+  @param[in]  ForegroundColor     Foreground color to use
+  @param[in]  BackgroundColor     Background color to use
+  @param[out] Dest                Pixel buffer to receive the glyph
+  @param[in]  Stride              Pixels per line of the destination buffer
+
+**/
+STATIC
+VOID
+RenderGlyph (
+  IN  CHAR8                         Glyph,
+  IN  EFI_GRAPHICS_OUTPUT_BLT_PIXEL ForegroundColor,
+  IN  EFI_GRAPHICS_OUTPUT_BLT_PIXEL BackgroundColor,
+  OUT EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Dest,
+  IN  UINTN                         Stride
+  )
+{
+  UINT8                            *GlyphBitmap;
+  UINTN                            Row;
+  UINTN                            Col;
+  UINTN                            Code;
+  UINTN                            Base;
+
+  // Glyph table maps to ASCII characters, index the table with the character
+  Code = (UINTN)(Glyph & 0xFF);
+  Base = 0xAF;
+  if ((Code >= Base) && (Code <= 0xF2)) {
+    Code = (0x80 - 0x20) + (Code - Base);
+  } else if ((Code >= 0x20) && (Code <= 0x7F)) {
+    Code = Code - 0x20;
+  } else {
+    Code = 0;
+  }
+
+  // Glyph table maps to ASCII characters, index the table with the character
+  GlyphBitmap = gUsStdNarrowGlyphData[Code].GlyphCol1;
+
+  for (Row = 0; Row < GLYPH_HEIGHT; Row++) {
+    for (Col = 0; Col < GLYPH_WIDTH; Col++) {
+      Dest[Col] = ((GlyphBitmap[Row] & (1 << (GLYPH_WIDTH - Col - 1))) != 0) ? ForegroundColor : BackgroundColor;
+    }
+    Dest += Stride;
+  }
+}
+
 /**
   Draw a glyph into the frame buffer (ASCII only).
 
@@ -112,42 +161,121 @@ BltGlyphToFrameBuffer (
   IN UINTN                         OffY
   )
 {
-  UINT8                            *GlyphBitmap;
-  UINTN                            Width, Height;
-  UINTN                            Row;
-  UINTN                            Col;
-  UINTN                            Code;
-  UINTN                            Base;
   EFI_GRAPHICS_OUTPUT_BLT_PIXEL    GopBlt[GLYPH_WIDTH * GLYPH_HEIGHT];
 
   if (GfxInfoHob == NULL) {
     return EFI_INVALID_PARAMETER;
   }
 
-  Width = GLYPH_WIDTH;
-  Height = GLYPH_HEIGHT;
+  RenderGlyph (Glyph, ForegroundColor, BackgroundColor, GopBlt, GLYPH_WIDTH);
 
-  // Glyph table maps to ASCII characters, index the table with the character
-  Code = (UINTN)(Glyph & 0xFF);
-  Base = 0xAF;
-  if ((Code >= Base) && (Code <= 0xF2)) {
-    Code = (0x80 - 0x20) + (Code - Base);
-  } else if ((Code >= 0x20) && (Code <= 0x7F)) {
-    Code = Code - 0x20;
-  } else {
-    Code = 0;
+  return BltToFrameBuffer (GfxInfoHob, GopBlt, GLYPH_WIDTH, GLYPH_HEIGHT, OffX, OffY);
+}
+
+/**
+  Draw a glyph into a console text cell.
+
+  With a shadow frame buffer the glyph is rendered into cached memory and the
+  cell is recorded as dirty until the next FlushFrameBufferConsole(). Without
+  it the glyph is drawn straight into the frame buffer.
+
+  @param[in] Console             Frame buffer console
+  @param[in] Glyph               ASCII character to write
+  @param[in] ForegroundColor     Foreground color to use
+  @param[in] BackgroundColor     Background color to use
+  @param[in] Col                 Text column of the cell
+  @param[in] Row                 Text row of the cell
+
+  @retval EFI_SUCCESS            Success
+  @retval EFI_INVALID_PARAMETER  Could not draw entire glyph in frame buffer
+
+**/
+STATIC
+EFI_STATUS
+ConsoleDrawGlyph (
+  IN FRAME_BUFFER_CONSOLE          *Console,
+  IN CHAR8                         Glyph,
+  IN EFI_GRAPHICS_OUTPUT_BLT_PIXEL ForegroundColor,
+  IN EFI_GRAPHICS_OUTPUT_BLT_PIXEL BackgroundColor,
+  IN UINTN                         Col,
+  IN UINTN                         Row
+  )
+{
+  UINTN                            Stride;
+
+  if (Console->ShadowBuf == NULL) {
+    return BltGlyphToFrameBuffer (Console->GfxInfoHob, Glyph, ForegroundColor, BackgroundColor,
+                                  Console->OffX + Col * GLYPH_WIDTH,
+                                  Console->OffY + Row * GLYPH_HEIGHT);
   }
 
-  // Glyph table maps to ASCII characters, index the table with the character
-  GlyphBitmap = gUsStdNarrowGlyphData[Code].GlyphCol1;
+  if ((Col >= Console->Cols) || (Row >= Console->Rows)) {
+    return EFI_INVALID_PARAMETER;
+  }
 
-  for (Row = 0; Row < Height; Row++) {
-    for (Col = 0; Col < Width; Col++) {
-      GopBlt[Row * Width + Col] = ((GlyphBitmap[Row] & (1 << (Width - Col - 1))) != 0) ? ForegroundColor : BackgroundColor;
-    }
+  Stride = Console->Cols * GLYPH_WIDTH;
+  RenderGlyph (Glyph, ForegroundColor, BackgroundColor,
+               &Console->ShadowBuf[Row * GLYPH_HEIGHT * Stride + Col * GLYPH_WIDTH], Stride);
+
+  if (Console->DirtyStart[Row] > Col) {
+    Console->DirtyStart[Row] = (UINT16)Col;
+  }
+  if (Console->DirtyEnd[Row] < Col + 1) {
+    Console->DirtyEnd[Row] = (UINT16)(Col + 1);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Copy the dirty spans of the shadow frame buffer into the frame buffer.
+
+  Each text row keeps one dirty span, so a flush writes whole pixel lines of
+  that span with a single CopyMem instead of one glyph row at a time.
+
+  @param[in] Console             Frame buffer console
+
+**/
+STATIC
+VOID
+FlushFrameBufferConsole (
+  IN FRAME_BUFFER_CONSOLE          *Console
+  )
+{
+  UINT32                          *FrameBufferPtr;
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL   *ShadowPtr;
+  UINTN                            HorizontalResolution;
+  UINTN                            Stride;
+  UINTN                            Row;
+  UINTN                            Line;
+  UINTN                            Start;
+  UINTN                            Length;
+
+  if (Console->ShadowBuf == NULL) {
+    return;
   }
 
-  return BltToFrameBuffer (GfxInfoHob, GopBlt, Width, Height, OffX, OffY);
+  HorizontalResolution = Console->GfxInfoHob->GraphicsMode.HorizontalResolution;
+  Stride = Console->Cols * GLYPH_WIDTH;
+  for (Row = 0; Row < Console->Rows; Row++) {
+    if (Console->DirtyEnd[Row] <= Console->DirtyStart[Row]) {
+      continue;
+    }
+
+    Start  = Console->DirtyStart[Row] * GLYPH_WIDTH;
+    Length = (Console->DirtyEnd[Row] * GLYPH_WIDTH - Start) * sizeof (UINT32);
+    FrameBufferPtr = (UINT32 *) (UINTN) (Console->GfxInfoHob->FrameBufferBase);
+    FrameBufferPtr += (Console->OffY + Row * GLYPH_HEIGHT) * HorizontalResolution + Console->OffX + Start;
+    ShadowPtr = &Console->ShadowBuf[Row * GLYPH_HEIGHT * Stride + Start];
+    for (Line = 0; Line < GLYPH_HEIGHT; Line++) {
+      CopyMem (FrameBufferPtr, ShadowPtr, Length);
+      FrameBufferPtr += HorizontalResolution;
+      ShadowPtr      += Stride;
+    }
+
+    Console->DirtyStart[Row] = (UINT16)Console->Cols;
+    Console->DirtyEnd[Row]   = 0;
+  }
 }
 
 /**
@@ -176,6 +304,8 @@ InitFrameBufferConsole (
 {
   FRAME_BUFFER_CONSOLE  *Console;
   BOOLEAN                ClearScreen;
+  UINTN                  Row;
+  UINTN                  ShadowSize;
 
   Console = &mFbConsole;
   if (Console->GfxInfoHob != NULL) {
@@ -214,6 +344,27 @@ InitFrameBufferConsole (
   Console->TextDrawBuf = AllocateZeroPool (Console->Rows * Console->Cols * 2);
   ASSERT (Console->TextDrawBuf != NULL);
 
+  //
+  // Render the console into a cached shadow buffer and only copy changed
+  // spans to the frame buffer. Draw straight into the frame buffer if the
+  // shadow would exceed PcdFrameBufferConsoleShadowMaxSize or there is not
+  // enough memory for it.
+  //
+  ShadowSize = Console->Rows * GLYPH_HEIGHT * Console->Cols * GLYPH_WIDTH * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+  if ((ShadowSize > 0) && (ShadowSize <= PcdGet32 (PcdFrameBufferConsoleShadowMaxSize))) {
+    Console->ShadowBuf  = AllocateZeroPool (ShadowSize);
+    Console->DirtyStart = AllocatePool (Console->Rows * sizeof (UINT16));
+    Console->DirtyEnd   = AllocatePool (Console->Rows * sizeof (UINT16));
+  }
+  if ((Console->ShadowBuf == NULL) || (Console->DirtyStart == NULL) || (Console->DirtyEnd == NULL)) {
+    ReleaseFrameBufferConsoleShadow ();
+  } else {
+    for (Row = 0; Row < Console->Rows; Row++) {
+      Console->DirtyStart[Row] = (UINT16)Console->Cols;
+      Console->DirtyEnd[Row]   = 0;
+    }
+  }
+
   if (ClearScreen) {
     // Clear screen using standard ANSI Escape Sequences 'ESC[2J'
     FrameBufferWrite (ANSI_ESCAPE_SEQ_CLEAR_SCREEN, 4);
@@ -222,6 +373,45 @@ InitFrameBufferConsole (
   return EFI_SUCCESS;
 }
 
+/**
+  Release the shadow buffer of the frame buffer console.
+
+  Pending changes are copied to the frame buffer first, and the console draws
+  straight into the frame buffer afterwards. This is used to give the memory
+  back before the OS image is loaded.
+
+  @retval EFI_SUCCESS            The shadow buffer was released or not in use.
+
+**/
+EFI_STATUS
+EFIAPI
+ReleaseFrameBufferConsoleShadow (
+  VOID
+  )
+{
+  FRAME_BUFFER_CONSOLE   *Console;
+
+  Console = &mFbConsole;
+  if ((Console->ShadowBuf != NULL) && (Console->DirtyStart != NULL) && (Console->DirtyEnd != NULL)) {
+    FlushFrameBufferConsole (Console);
+  }
+
+  if (Console->ShadowBuf != NULL) {
+    FreePool (Console->ShadowBuf);
+    Console->ShadowBuf = NULL;
+  }
+  if (Console->DirtyStart != NULL) {
+    FreePool (Console->DirtyStart);
+    Console->DirtyStart = NULL;
+  }
+  if (Console->DirtyEnd != NULL) {
+    FreePool (Console->DirtyEnd);
+    Console->DirtyEnd = NULL;
+  }
+
+  return EFI_SUCCESS;
+}
+
 /**
   Scroll the console area of the screen up.
 
@@ -242,6 +432,8 @@ FrameBufferConsoleScroll (
   UINTN                  BufPos;
   UINTN                  ScreenX;
   UINTN                  ScreenY;
+  UINTN                  RowPixels;
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL_UNION  Blank;
 
   Console = &mFbConsole;
   if (Console->Height == 0) {
@@ -252,6 +444,29 @@ FrameBufferConsoleScroll (
     ScrollAmount = Console->Rows;
   }
 
+  // Pending shadow changes must reach the screen first since the text
+  // buffers below are compared against what is actually displayed.
+  FlushFrameBufferConsole (Console);
+
+  if (Console->ShadowBuf != NULL) {
+    // Move whole text rows of pixels up in the shadow buffer
+    RowPixels = GLYPH_HEIGHT * Console->Cols * GLYPH_WIDTH;
+    if (ScrollAmount < Console->Rows) {
+      CopyMem (&Console->ShadowBuf[0],
+               &Console->ShadowBuf[RowPixels * ScrollAmount],
+               RowPixels * (Console->Rows - ScrollAmount) * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
+    }
+    Blank.Pixel = Console->BackgroundColor;
+    SetMem32 (&Console->ShadowBuf[RowPixels * (Console->Rows - ScrollAmount)],
+              RowPixels * ScrollAmount * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL), Blank.Raw);
+
+    // Every pixel of the console moved, so all rows need to be copied out
+    for (BufY = 0; BufY < Console->Rows; BufY++) {
+      Console->DirtyStart[BufY] = 0;
+      Console->DirtyEnd[BufY]   = (UINT16)Console->Cols;
+    }
+  }
+
   if (ScrollAmount < Console->Rows) {
     // Move all lines in text buffer up
     CopyMem (&Console->TextSwapBuf[0],
@@ -276,9 +491,11 @@ FrameBufferConsoleScroll (
     for (BufX = 0; BufX < Console->Cols; BufX++) {
       if (Console->TextSwapBuf[BufPos] != Console->TextDisplayBuf[BufPos]) {
         Console->TextDisplayBuf[BufPos] = Console->TextSwapBuf[BufPos];
-        BltGlyphToFrameBuffer (Console->GfxInfoHob, Console->TextSwapBuf[BufPos],
-                               Console->ForegroundColor, Console->BackgroundColor,
-                               ScreenX, ScreenY);
+        if (Console->ShadowBuf == NULL) {
+          BltGlyphToFrameBuffer (Console->GfxInfoHob, Console->TextSwapBuf[BufPos],
+                                 Console->ForegroundColor, Console->BackgroundColor,
+                                 ScreenX, ScreenY);
+        }
       }
       BufPos++;
       ScreenX += GLYPH_WIDTH;
@@ -286,6 +503,8 @@ FrameBufferConsoleScroll (
     ScreenY += GLYPH_HEIGHT;
   }
 
+  FlushFrameBufferConsole (Console);
+
   return EFI_SUCCESS;
 }
 
@@ -338,6 +557,14 @@ FrameBufferWrite (
     GfxInfoHob = Console->GfxInfoHob;
     Length = (GfxInfoHob->GraphicsMode.HorizontalResolution * GfxInfoHob->GraphicsMode.PixelsPerScanLine) * 4;
     SetMem64 ((UINT32 *) (UINTN)(GfxInfoHob->FrameBufferBase), Length, 0);
+    if (Console->ShadowBuf != NULL) {
+      ZeroMem (Console->ShadowBuf, Console->Rows * GLYPH_HEIGHT * Console->Cols * GLYPH_WIDTH *
+                                   sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
+      for (Pos = 0; Pos < Console->Rows; Pos++) {
+        Console->DirtyStart[Pos] = (UINT16)Console->Cols;
+        Console->DirtyEnd[Pos]   = 0;
+      }
+    }
     Console->CursorX = 0;
     Console->CursorY = 0;
     return NumberOfBytes;
@@ -379,10 +606,9 @@ FrameBufferWrite (
       Console->CursorX = 0;
     } else {
       Console->TextDisplayBuf[Console->CursorY * Console->Cols + Console->CursorX] = Buffer[Pos];
-      Status = BltGlyphToFrameBuffer (Console->GfxInfoHob, Buffer[Pos],
-                                      Console->ForegroundColor, Console->BackgroundColor,
-                                      Console->OffX + Console->CursorX * GLYPH_WIDTH,
-                                      Console->OffY + Console->CursorY * GLYPH_HEIGHT);
+      Status = ConsoleDrawGlyph (Console, Buffer[Pos],
+                                 Console->ForegroundColor, Console->BackgroundColor,
+                                 Console->CursorX, Console->CursorY);
       if (Status != EFI_SUCCESS) {
         break;
       }
@@ -390,6 +616,8 @@ FrameBufferWrite (
     }
   }
 
+  FlushFrameBufferConsole (Console);
+
   return Pos;
 }
 
@@ -453,17 +681,19 @@ DrawFrameBuffer (
       Ptr   = (UINT16 *)(Console->TextDrawBuf + Pos);
       if (*Ptr != Value) {
         *Ptr = Value;
-        BltGlyphToFrameBuffer (
-          Console->GfxInfoHob, Buffer[Pos],
+        ConsoleDrawGlyph (
+          Console, Buffer[Pos],
           mColors[(Value >>  8) & 0x0F],
           mColors[(Value >> 12) & 0x0F],
-          Console->OffX + (PosX + OffX) * GLYPH_WIDTH,
-          Console->OffY + (PosY + OffY) * GLYPH_HEIGHT);
+          PosX + OffX,
+          PosY + OffY);
       }
       Pos += 2;
     }
   }
 
+  FlushFrameBufferConsole (Console);
+
   return EFI_SUCCESS;
 }
 
@@ -1,7 +1,7 @@
 /** @file
   Provide Hob Library functions for Pei phase.
 
-Copyright (c) 2007 - 2017, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2007 - 2020, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -9,9 +9,199 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <PiPei.h>
 
 #include <Library/HobLib.h>
+#include <Library/ExtraHobLib.h>
 #include <Library/DebugLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/BootloaderCommonLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#define HOB_DIRECTORY_SIGNATURE   SIGNATURE_32 ('H', 'D', 'I', 'R')
+
+typedef struct {
+  EFI_GUID   Name;
+  //
+  // Offset of the first GUID HOB with this name from the start of HOB list.
+  // 0 indicates an empty entry.
+  //
+  UINT32     Offset;
+} HOB_DIRECTORY_ENTRY;
+
+//
+// GUID to HOB directory of the loader HOB list. It is stored as library data
+// so that it is passed to payloads together with the HOB list. Offsets are
+// used so that it does not contain any pointer into the HOB list.
+//
+typedef struct {
+  UINT32               Signature;
+  UINT32               EntryNum;
+  UINT32               UsedNum;
+  UINT32               SavedWalks;
+  UINT64               HobList;
+  UINT64               EndOfHobList;
+  HOB_DIRECTORY_ENTRY  Entry[0];
+} HOB_DIRECTORY;
+
+/**
+  Get the directory slot for a GUID.
+
+  @param[in] Directory  HOB directory.
+  @param[in] Guid       The GUID to look up.
+
+  @retval    Pointer to the slot holding the GUID, or the empty slot
+             where the GUID can be inserted.
+
+**/
+STATIC
+HOB_DIRECTORY_ENTRY *
+GetHobDirectorySlot (
+  IN  HOB_DIRECTORY     *Directory,
+  IN  CONST EFI_GUID    *Guid
+  )
+{
+  CONST UINT32  *Data32;
+  UINT32         Slot;
+  UINT32         Mask;
+
+  Data32 = (CONST UINT32 *)Guid;
+  Mask   = Directory->EntryNum - 1;
+  Slot   = (((Data32[0] ^ Data32[1] ^ Data32[2] ^ Data32[3]) * 0x9E3779B1) >> 16) & Mask;
+  while ((Directory->Entry[Slot].Offset != 0) && !CompareGuid (&Directory->Entry[Slot].Name, Guid)) {
+    Slot = (Slot + 1) & Mask;
+  }
+  return &Directory->Entry[Slot];
+}
+
+/**
+  Add the GUID HOBs in a range of the HOB list into the directory.
+
+  @param[in] Directory  HOB directory.
+  @param[in] HobStart   The first HOB to add.
+  @param[in] HobEnd     The end of HOB list.
+
+  @retval    TRUE       All GUID HOBs were added.
+  @retval    FALSE      The directory is too small and needs to be rebuilt.
+
+**/
+STATIC
+BOOLEAN
+AddHobDirectoryEntries (
+  IN  HOB_DIRECTORY     *Directory,
+  IN  UINT8             *HobStart,
+  IN  UINT8             *HobEnd
+  )
+{
+  EFI_PEI_HOB_POINTERS   Hob;
+  HOB_DIRECTORY_ENTRY   *Entry;
+
+  Hob.Raw = HobStart;
+  while ((Hob.Raw < HobEnd) && !END_OF_HOB_LIST (Hob)) {
+    if (Hob.Header->HobType == EFI_HOB_TYPE_GUID_EXTENSION) {
+      Entry = GetHobDirectorySlot (Directory, &Hob.Guid->Name);
+      if (Entry->Offset == 0) {
+        // Keep the load factor below 1/2
+        if ((Directory->UsedNum + 1) * 2 > Directory->EntryNum) {
+          return FALSE;
+        }
+        CopyGuid (&Entry->Name, &Hob.Guid->Name);
+        Entry->Offset = (UINT32)(Hob.Raw - (UINT8 *)(UINTN)Directory->HobList);
+        Directory->UsedNum++;
+      }
+    }
+    Hob.Raw = GET_NEXT_HOB (Hob);
+  }
+
+  Directory->EndOfHobList = (UINTN)HobEnd;
+  return TRUE;
+}
+
+/**
+  Get the GUID HOB directory of the loader HOB list.
+
+  The directory is built on first use and extended with the HOBs appended
+  to the HOB list afterwards.
+
+  @retval    The HOB directory, or NULL if it is not available.
+
+**/
+STATIC
+HOB_DIRECTORY *
+GetHobDirectory (
+  VOID
+  )
+{
+  EFI_PEI_HOB_POINTERS   Hob;
+  HOB_DIRECTORY         *Directory;
+  HOB_DIRECTORY         *NewDirectory;
+  UINT8                 *HobEnd;
+  UINT32                 GuidNum;
+  UINT32                 EntryNum;
+  UINT32                 DirectorySize;
+  EFI_STATUS             Status;
+
+  if (!FeaturePcdGet (PcdHobDirectoryEnabled)) {
+    return NULL;
+  }
+
+  //
+  // Only the HOB list started with a handoff HOB can be tracked
+  //
+  Hob.Raw = (UINT8 *) GetHobListPtr ();
+  if ((Hob.Raw == NULL) || (Hob.Header->HobType != EFI_HOB_TYPE_HANDOFF)) {
+    return NULL;
+  }
+  HobEnd = (UINT8 *)(UINTN)Hob.HandoffInformationTable->EfiEndOfHobList;
+
+  Status = GetLibraryData (PcdGet8 (PcdHobLibId), (VOID **)&Directory);
+  if (EFI_ERROR (Status) || (Directory->Signature != HOB_DIRECTORY_SIGNATURE)) {
+    Directory = NULL;
+  } else if ((Directory->HobList == (UINTN)Hob.Raw) && (Directory->EndOfHobList <= (UINTN)HobEnd)) {
+    if (Directory->EndOfHobList == (UINTN)HobEnd) {
+      return Directory;
+    }
+    if (AddHobDirectoryEntries (Directory, (UINT8 *)(UINTN)Directory->EndOfHobList, HobEnd)) {
+      return Directory;
+    }
+  }
+
+  //
+  // (Re)build the directory
+  //
+  GuidNum = 0;
+  while (!END_OF_HOB_LIST (Hob)) {
+    if (Hob.Header->HobType == EFI_HOB_TYPE_GUID_EXTENSION) {
+      GuidNum++;
+    }
+    Hob.Raw = GET_NEXT_HOB (Hob);
+  }
+
+  // Leave room for the HOBs appended later
+  EntryNum = 32;
+  while (EntryNum < GuidNum * 4) {
+    EntryNum <<= 1;
+  }
+
+  DirectorySize = sizeof (HOB_DIRECTORY) + EntryNum * sizeof (HOB_DIRECTORY_ENTRY);
+  NewDirectory  = AllocateZeroPool (DirectorySize);
+  if (NewDirectory == NULL) {
+    return NULL;
+  }
+
+  NewDirectory->Signature = HOB_DIRECTORY_SIGNATURE;
+  NewDirectory->EntryNum  = EntryNum;
+  NewDirectory->HobList   = (UINTN) GetHobListPtr ();
+  if (Directory != NULL) {
+    NewDirectory->SavedWalks = Directory->SavedWalks;
+    Directory->Signature     = 0;
+    DEBUG ((DEBUG_VERBOSE, "HOB directory rebuilt, %d HOB list walks saved\n", Directory->SavedWalks));
+  }
+
+  if (!AddHobDirectoryEntries (NewDirectory, (UINT8 *)(UINTN)NewDirectory->HobList, HobEnd)) {
+    return NULL;
+  }
+  SetLibraryData (PcdGet8 (PcdHobLibId), NewDirectory, DirectorySize);
+
+  return NewDirectory;
+}
 
 /**
   Returns the pointer to the HOB list.
@@ -30,6 +220,29 @@ GetHobList (
   return GetHobListPtr();
 }
 
+/**
+  Returns the number of HOB list walks saved by the GUID HOB directory.
+
+  @return The number of GUID HOB searches answered from the directory,
+          or 0 if the directory is not available.
+
+**/
+UINT32
+EFIAPI
+GetHobDirectorySavedWalks (
+  VOID
+  )
+{
+  HOB_DIRECTORY  *Directory;
+
+  Directory = GetHobDirectory ();
+  if (Directory == NULL) {
+    return 0;
+  }
+
+  return Directory->SavedWalks;
+}
+
 /**
   Returns the next instance of a HOB type from the starting HOB.
 
@@ -109,6 +322,9 @@ GetFirstHob (
   unconditionally: it returns HobStart back if HobStart itself meets the requirement;
   caller is required to use GET_NEXT_HOB() if it wishes to skip current HobStart.
 
+  The GUID HOB directory is consulted first when HobStart is within the loader
+  HOB list, and the HOB list is walked only if the directory cannot tell.
+
   If Guid is NULL, then ASSERT().
   If HobStart is NULL, then ASSERT().
 
@@ -126,6 +342,29 @@ GetNextGuidHob (
   )
 {
   EFI_PEI_HOB_POINTERS  GuidHob;
+  HOB_DIRECTORY        *Directory;
+  HOB_DIRECTORY_ENTRY  *Entry;
+  UINT8                *HobList;
+
+  Directory = GetHobDirectory ();
+  if (Directory != NULL) {
+    HobList = (UINT8 *)(UINTN)Directory->HobList;
+    if (((UINT8 *)HobStart >= HobList) && ((UINTN)HobStart < Directory->EndOfHobList)) {
+      //
+      // The directory holds the first instance, so it answers any search
+      // starting at or before that instance.
+      //
+      Entry = GetHobDirectorySlot (Directory, Guid);
+      if (Entry->Offset == 0) {
+        Directory->SavedWalks++;
+        return NULL;
+      }
+      if (HobList + Entry->Offset >= (UINT8 *)HobStart) {
+        Directory->SavedWalks++;
+        return HobList + Entry->Offset;
+      }
+    }
+  }
 
   GuidHob.Raw = (UINT8 *) HobStart;
   while ((GuidHob.Raw = GetNextHob (EFI_HOB_TYPE_GUID_EXTENSION, GuidHob.Raw)) != NULL) {
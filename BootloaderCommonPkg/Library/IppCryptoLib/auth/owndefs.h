@@ -28,6 +28,7 @@
   #include <Library/BaseLib.h>
   #include <Library/BaseMemoryLib.h>
   #include <Library/PcdLib.h>
+  #include <Library/ExtraBaseLib.h>
 #endif
 
 #if defined(__INTEL_COMPILER) || defined(_MSC_VER)
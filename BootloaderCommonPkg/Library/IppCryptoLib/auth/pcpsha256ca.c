@@ -174,16 +174,71 @@ void UpdateSHA256Compact(void* uniHash, const Ipp8u* mblk, int mlen, const void*
 }
 #endif
 
+#if defined(_SLIMBOOT_OPT) && (FixedPcdGet32 (PcdCryptoShaOptMask) & (IPP_CRYPTO_SHA256_NI | IPP_CRYPTO_SHA256_V8))
+/*
+// SHA extensions are reported by CPUID.(EAX=7,ECX=0):EBX[29], V8 needs SSSE3
+// (CPUID.1:ECX[9]). Both use XMM registers, so SSE state (CR4.OSFXSR) must be
+// enabled as well.
+// The result is cached after the first check. When running in place from
+// flash the cache write has no effect and the check is simply repeated.
+*/
+#define SHA256_KERNEL_COMPACT  0
+#define SHA256_KERNEL_V8       1
+#define SHA256_KERNEL_NI       2
+#define SHA256_KERNEL_UNKNOWN  0xFF
+
+static Ipp8u sha256Kernel = SHA256_KERNEL_UNKNOWN;
+
+static int GetSha256Kernel(void)
+{
+   UINT32 maxLeaf;
+   UINT32 regEbx;
+   UINT32 regEcx;
+   Ipp8u  kernel;
+
+   kernel = sha256Kernel;
+   if(kernel != SHA256_KERNEL_UNKNOWN)
+      return kernel;
+
+   kernel = SHA256_KERNEL_COMPACT;
+   if(AsmReadCr4() & BIT9) {
+      AsmCpuid(0, &maxLeaf, NULL, NULL, NULL);
+      AsmCpuid(1, NULL, NULL, &regEcx, NULL);
+      regEbx = 0;
+      if(maxLeaf >= 7)
+         AsmCpuidEx(7, 0, NULL, &regEbx, NULL, NULL);
+
+      if(regEbx & BIT29)
+         kernel = SHA256_KERNEL_NI;
+      else if(regEcx & BIT9)
+         kernel = SHA256_KERNEL_V8;
+   }
+
+   sha256Kernel = kernel;
+   return kernel;
+}
+#endif
+
 void UpdateSHA256(void* pHash, const Ipp8u* pMsg, int msgLen, const void* pParam)
 {
 #if defined(_SLIMBOOT_OPT)
+   #if (FixedPcdGet32 (PcdCryptoShaOptMask) & (IPP_CRYPTO_SHA256_NI | IPP_CRYPTO_SHA256_V8))
+   int kernel = GetSha256Kernel();
+   #endif
+
    #if (FixedPcdGet32 (PcdCryptoShaOptMask) & IPP_CRYPTO_SHA256_NI)
+   if(kernel == SHA256_KERNEL_NI) {
       UpdateSHA256Ni(pHash, pMsg, msgLen, pParam);
-   #elif (FixedPcdGet32 (PcdCryptoShaOptMask) & IPP_CRYPTO_SHA256_V8)
+      return;
+   }
+   #endif
+   #if (FixedPcdGet32 (PcdCryptoShaOptMask) & IPP_CRYPTO_SHA256_V8)
+   if(kernel != SHA256_KERNEL_COMPACT) {
       UpdateSHA256V8(pHash, pMsg, msgLen, pParam);
-   #else
-      UpdateSHA256Compact(pHash, pMsg, msgLen, pParam);
+      return;
+   }
    #endif
+   UpdateSHA256Compact(pHash, pMsg, msgLen, pParam);
 #else
   #if defined(_ALG_SHA256_COMPACT_)
     UpdateSHA256Compact(pHash, pMsg, msgLen, pParam);
@@ -562,16 +562,63 @@ void UpdateSHA512Normal(void* uniHash, const Ipp8u* mblk, int mlen, const void*
 //
 *F*/
 
+#if defined(_SLIMBOOT_OPT) && (FixedPcdGet32 (PcdCryptoShaOptMask) & (IPP_CRYPTO_SHA384_G9 | IPP_CRYPTO_SHA384_W7))
+/*
+// G9 uses AVX for the vectorized message schedule, so AVX must be supported
+// and YMM/XMM state enabled in XCR0. W7 uses SSSE3 and needs CR4.OSFXSR.
+// The result is cached after the first check. When running in place from
+// flash the cache write has no effect and the check is simply repeated.
+*/
+#define SHA512_KERNEL_COMPACT  0
+#define SHA512_KERNEL_W7       1
+#define SHA512_KERNEL_G9       2
+#define SHA512_KERNEL_UNKNOWN  0xFF
+
+static Ipp8u sha512Kernel = SHA512_KERNEL_UNKNOWN;
+
+static int GetSha512Kernel(void)
+{
+   UINT32 regEcx;
+   Ipp8u  kernel;
+
+   kernel = sha512Kernel;
+   if(kernel != SHA512_KERNEL_UNKNOWN)
+      return kernel;
+
+   kernel = SHA512_KERNEL_COMPACT;
+   if(AsmReadCr4() & BIT9) {
+      AsmCpuid(1, NULL, NULL, &regEcx, NULL);
+      if(((regEcx & (BIT28 | BIT27)) == (BIT28 | BIT27)) && ((AsmReadXcr0() & (BIT2 | BIT1)) == (BIT2 | BIT1)))
+         kernel = SHA512_KERNEL_G9;
+      else if(regEcx & BIT9)
+         kernel = SHA512_KERNEL_W7;
+   }
+
+   sha512Kernel = kernel;
+   return kernel;
+}
+#endif
+
 void UpdateSHA512(void* uniHash, const Ipp8u* mblk, int mlen, const void* uniPraram)
 {
 #if defined(_SLIMBOOT_OPT)
+   #if (FixedPcdGet32 (PcdCryptoShaOptMask) & (IPP_CRYPTO_SHA384_G9 | IPP_CRYPTO_SHA384_W7))
+   int kernel = GetSha512Kernel();
+   #endif
+
    #if (FixedPcdGet32 (PcdCryptoShaOptMask) & IPP_CRYPTO_SHA384_G9)
+   if(kernel == SHA512_KERNEL_G9) {
       UpdateSHA512G9 (uniHash, mblk, mlen, uniPraram);
-   #elif (FixedPcdGet32 (PcdCryptoShaOptMask) & IPP_CRYPTO_SHA384_W7)
+      return;
+   }
+   #endif
+   #if (FixedPcdGet32 (PcdCryptoShaOptMask) & IPP_CRYPTO_SHA384_W7)
+   if(kernel != SHA512_KERNEL_COMPACT) {
       UpdateSHA512W7 (uniHash, mblk, mlen, uniPraram);
-   #else
-      UpdateSHA512Compact (uniHash, mblk, mlen, uniPraram);
+      return;
+   }
    #endif
+   UpdateSHA512Compact (uniHash, mblk, mlen, uniPraram);
 #else
 
 #if  defined(_ALG_SHA512_COMPACT_)
@@ -183,13 +183,96 @@ IsBzImage (
 }
 
 /**
-  Load linux kernel image to specified address and setup boot parameters.
+  Get the size of the real-mode setup code in front of the protected-mode kernel.
+
+  @param[in]  Hdr            Setup header of a bzImage.
+
+  @retval     Size of the setup code in bytes.
+**/
+STATIC
+UINT32
+GetBzImageSetupSize (
+  IN  CONST SETUP_HEADER     *Hdr
+  )
+{
+  if (Hdr->SetupSectorss != 0) {
+    return (Hdr->SetupSectorss + 1) * 512;
+  } else {
+    return 5 * 512;
+  }
+}
+
+/**
+  Get the placement requirement of a relocatable linux kernel image.
+
+  A boot loader that knows the placement in advance can load the image so
+  that its protected-mode kernel already sits at an acceptable run address,
+  and LoadBzImageInPlace() can then boot it without relocating it to
+  LINUX_KERNEL_BASE.
+
+  @param[in]  ImageBase      Memory address of a bzImage or its first 4KB.
+  @param[out] KernelOffset   Offset of the protected-mode kernel in the image.
+  @param[out] KernelAlign    Required alignment of the protected-mode kernel.
+  @param[out] KernelSize     Memory needed by the kernel from its run address.
+
+  @retval EFI_INVALID_PARAMETER   Input parameters are not valid.
+  @retval EFI_UNSUPPORTED         Not a bzImage or kernel is not relocatable.
+  @retval EFI_SUCCESS             Placement information is returned.
+**/
+EFI_STATUS
+EFIAPI
+GetBzImagePlacement (
+  IN  CONST VOID             *ImageBase,
+  OUT UINT32                 *KernelOffset,
+  OUT UINT32                 *KernelAlign,
+  OUT UINT32                 *KernelSize
+  )
+{
+  CONST SETUP_HEADER         *Hdr;
+
+  if ((ImageBase == NULL) || (KernelOffset == NULL) || (KernelAlign == NULL) || (KernelSize == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (!IsBzImage (ImageBase)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // InitSize is only reported from boot protocol 2.10. Without it the memory
+  // used by the kernel decompressor beyond the image is unknown.
+  //
+  Hdr = &((CONST BOOT_PARAMS *)ImageBase)->Hdr;
+  if ((Hdr->Version < 0x020A) || (Hdr->RelocatableKernel == 0)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if ((Hdr->KernelAlignment == 0) || ((Hdr->KernelAlignment & (Hdr->KernelAlignment - 1)) != 0)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  *KernelOffset = GetBzImageSetupSize (Hdr);
+  *KernelAlign  = Hdr->KernelAlignment;
+  *KernelSize   = MAX (Hdr->InitSize, Hdr->SysSize * 16);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Load linux kernel image and setup boot parameters, running the kernel in
+  place when the image buffer satisfies its placement requirement.
+
+  The protected-mode kernel is only copied to LINUX_KERNEL_BASE when it is not
+  relocatable, not aligned as required, or KernelBufLen does not cover the
+  memory returned by GetBzImagePlacement().
 
   @param[in]  KernelBase     Memory address of an kernel image.
+  @param[in]  KernelBufLen   Bytes owned by the caller from KernelBase. 0 if unknown.
   @param[in]  InitRdBase     Memory address of an InitRd image.
   @param[in]  InitRdLen      InitRd image size.
   @param[in]  CmdLineBase    Memory address of command line buffer.
   @param[in]  CmdLineLen     Command line buffer size.
+  @param[out] CopiedLen      Bytes of kernel copied, 0 if run in place. Optional.
 
   @retval EFI_INVALID_PARAMETER   Input parameters are not valid.
   @retval EFI_UNSUPPORTED         Unsupported binary type.
@@ -197,20 +280,27 @@ IsBzImage (
 **/
 EFI_STATUS
 EFIAPI
-LoadBzImage (
+LoadBzImageInPlace (
   IN  CONST VOID                  *KernelBase,
+  IN      UINT32                   KernelBufLen,
   IN  CONST VOID                  *InitRdBase,
   IN      UINT32                   InitRdLen,
   IN  CONST VOID                  *CmdLineBase,
-  IN      UINT32                   CmdLineLen
+  IN      UINT32                   CmdLineLen,
+  OUT     UINT32                  *CopiedLen    OPTIONAL
   )
 {
+  EFI_STATUS                  Status;
   BOOT_PARAMS                *Bp;
   BOOT_PARAMS                *BaseBp;
   VOID                       *KernelBuf;
   UINT32                      BootParamSize;
   UINTN                       KernelSize;
   VOID CONST                 *ImageBase;
+  UINT32                      KernelOffset;
+  UINT32                      KernelAlign;
+  UINT32                      KernelMemSize;
+  UINTN                       KernelSrc;
 
   ImageBase = KernelBase;
   if (ImageBase == NULL) {
@@ -226,15 +316,38 @@ LoadBzImage (
   ZeroMem ((VOID *)Bp, sizeof (BOOT_PARAMS));
   CopyMem (&Bp->Hdr, &BaseBp->Hdr, sizeof (SETUP_HEADER));
 
-  if (Bp->Hdr.SetupSectorss != 0) {
-    BootParamSize = (Bp->Hdr.SetupSectorss + 1) * 512;
+  BootParamSize = GetBzImageSetupSize (&Bp->Hdr);
+  KernelSrc     = (UINTN)ImageBase + BootParamSize;
+  KernelSize    = Bp->Hdr.SysSize * 16;
+
+  //
+  // A relocatable kernel runs from wherever it was loaded as long as it is
+  // aligned and the caller owns the memory it decompresses into.
+  //
+  Status = GetBzImagePlacement (ImageBase, &KernelOffset, &KernelAlign, &KernelMemSize);
+  if (!EFI_ERROR (Status)) {
+    if (((KernelSrc & (KernelAlign - 1)) != 0) || (KernelBufLen < KernelOffset) ||
+        ((KernelBufLen - KernelOffset) < KernelMemSize)) {
+      Status = EFI_UNSUPPORTED;
+    }
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Bp->Hdr.Code32Start = (UINT32)KernelSrc;
+    KernelSize = 0;
+    DEBUG ((DEBUG_INFO, "Run kernel in place at 0x%p\n", (VOID *)KernelSrc));
   } else {
-    BootParamSize = 5 * 512;
+    KernelBuf = (VOID *) (UINTN)LINUX_KERNEL_BASE;
+    if ((UINTN)KernelBuf == KernelSrc) {
+      KernelSize = 0;
+    } else {
+      CopyMem (KernelBuf, (VOID *)KernelSrc, KernelSize);
+    }
   }
 
-  KernelBuf  = (VOID *) (UINTN)LINUX_KERNEL_BASE;
-  KernelSize = Bp->Hdr.SysSize * 16;
-  CopyMem (KernelBuf, (UINT8 *)ImageBase + BootParamSize, KernelSize);
+  if (CopiedLen != NULL) {
+    *CopiedLen = (UINT32)KernelSize;
+  }
 
   //
   // Update boot params
@@ -248,6 +361,32 @@ LoadBzImage (
   return EFI_SUCCESS;
 }
 
+/**
+  Load linux kernel image to specified address and setup boot parameters.
+
+  @param[in]  KernelBase     Memory address of an kernel image.
+  @param[in]  InitRdBase     Memory address of an InitRd image.
+  @param[in]  InitRdLen      InitRd image size.
+  @param[in]  CmdLineBase    Memory address of command line buffer.
+  @param[in]  CmdLineLen     Command line buffer size.
+
+  @retval EFI_INVALID_PARAMETER   Input parameters are not valid.
+  @retval EFI_UNSUPPORTED         Unsupported binary type.
+  @retval EFI_SUCCESS             Kernel is loaded successfully.
+**/
+EFI_STATUS
+EFIAPI
+LoadBzImage (
+  IN  CONST VOID                  *KernelBase,
+  IN  CONST VOID                  *InitRdBase,
+  IN      UINT32                   InitRdLen,
+  IN  CONST VOID                  *CmdLineBase,
+  IN      UINT32                   CmdLineLen
+  )
+{
+  return LoadBzImageInPlace (KernelBase, 0, InitRdBase, InitRdLen, CmdLineBase, CmdLineLen, NULL);
+}
+
 /**
   Update linux kernel boot parameters.
 
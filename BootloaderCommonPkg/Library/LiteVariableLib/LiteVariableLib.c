@@ -1,7 +1,7 @@
 /** @file
 Lite variable service library
 
-Copyright (c) 2006 - 2016, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2006 - 2020, Intel Corporation. All rights reserved.<BR>
 Portions copyright (c) 2008 - 2009, Apple Inc. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
@@ -43,11 +43,69 @@ GetVariableInstance (
 
   if (EFI_ERROR (Status)) {
     VarInstance = NULL;
+  } else if (VarInstance->ShadowOwner != (UINT32)(UINTN)VarInstance) {
+    //
+    // The instance was copied into a new stage, the buffers it points to
+    // belong to the previous stage and cannot be used anymore.
+    //
+    if (VarInstance->PendingLen > 0) {
+      DEBUG ((DEBUG_ERROR, "Uncommitted variable updates are dropped!\n"));
+    }
+    VarInstance->ShadowOwner = (UINT32)(UINTN)VarInstance;
+    VarInstance->ShadowStore = 0;
+    VarInstance->ShadowBase  = 0;
+    VarInstance->ShadowSize  = 0;
+    VarInstance->IndexBase   = 0;
+    VarInstance->IndexNum    = 0;
+    VarInstance->IndexCount  = 0;
+    VarInstance->IndexValid  = FALSE;
+    VarInstance->WriteBack   = FALSE;
+    VarInstance->PendingBase = 0;
+    VarInstance->PendingSize = 0;
+    VarInstance->PendingLen  = 0;
   }
 
   return VarInstance;
 }
 
+/**
+  Translate a variable store address to the flash and the RAM shadow address.
+
+  @param[in]  VarInstance     Variable instance.
+  @param[in]  Address         Variable store flash address or RAM shadow address.
+  @param[out] FlashAddress    Pointer to receive the flash address.
+
+  @retval     The RAM shadow address, or NULL if the address is not shadowed.
+
+**/
+STATIC
+UINT8 *
+GetShadowAddress (
+  IN  VARIABLE_INSTANCE  *VarInstance,
+  IN  VOID               *Address,
+  OUT UINT8             **FlashAddress
+  )
+{
+  UINT32      Addr;
+
+  Addr          = (UINT32)(UINTN)Address;
+  *FlashAddress = (UINT8 *)Address;
+  if ((VarInstance == NULL) || (VarInstance->ShadowStore == 0)) {
+    return NULL;
+  }
+
+  if ((Addr >= VarInstance->ShadowBase) && (Addr - VarInstance->ShadowBase < VarInstance->ShadowSize)) {
+    *FlashAddress = (UINT8 *)(UINTN)(VarInstance->ShadowStore + (Addr - VarInstance->ShadowBase));
+    return (UINT8 *)Address;
+  }
+
+  if ((Addr >= VarInstance->ShadowStore) && (Addr - VarInstance->ShadowStore < VarInstance->ShadowSize)) {
+    return (UINT8 *)(UINTN)(VarInstance->ShadowBase + (Addr - VarInstance->ShadowStore));
+  }
+
+  return NULL;
+}
+
 /**
   This function retrieves the variable store region base and size.
 
@@ -97,6 +155,19 @@ EraseVariableStore (
   UINT32              RgnBase;
   UINT32              RgnSize;
 
+  VARIABLE_INSTANCE  *VarInstance;
+
+  //
+  // Drop the RAM shadow if the erased region covers it
+  //
+  VarInstance = GetVariableInstance ();
+  if ((VarInstance != NULL) && (VarInstance->ShadowStore != 0) &&
+      ((UINT32)(UINTN)VariableStore < VarInstance->ShadowStore + VarInstance->ShadowSize) &&
+      ((UINT32)(UINTN)VariableStore + Length > VarInstance->ShadowStore)) {
+    VarInstance->ShadowStore = 0;
+    VarInstance->IndexValid  = FALSE;
+  }
+
   DEBUG ((DEBUG_INFO, "  SPI ERASE: %08X  %08X\n", (UINT32)(UINTN)VariableStore, Length));
   SpiService = (SPI_FLASH_SERVICE *)GetServiceBySignature (SPI_FLASH_SERVICE_SIGNATURE);
   if (SpiService != NULL) {
@@ -116,7 +187,9 @@ EraseVariableStore (
 /**
   This function writs to the specified variable store region with data buffer.
 
-  @param[in]  VariableStore     Writing region base.
+  The RAM shadow of the active variable store is kept in sync with the flash.
+
+  @param[in]  VariableStore     Writing region base, either flash or RAM shadow address.
   @param[in]  Length            Writing region size.
   @param[in]  Buffer            Data buffer to write.
 
@@ -136,20 +209,32 @@ WriteVariableStore (
   UINT32              BiosRgnOffset;
   UINT32              RgnBase;
   UINT32              RgnSize;
+  VARIABLE_INSTANCE  *VarInstance;
+  UINT8              *ShadowPtr;
+  UINT8              *FlashPtr;
+
+  VarInstance = GetVariableInstance ();
+  ShadowPtr   = GetShadowAddress (VarInstance, VariableStore, &FlashPtr);
 
-  DEBUG ((DEBUG_INFO, "  SPI WRITE: %08X  %08X\n", (UINT32)(UINTN)VariableStore, Length));
+  DEBUG ((DEBUG_INFO, "  SPI WRITE: %08X  %08X\n", (UINT32)(UINTN)FlashPtr, Length));
   SpiService = (SPI_FLASH_SERVICE *)GetServiceBySignature (SPI_FLASH_SERVICE_SIGNATURE);
   if (SpiService != NULL) {
     Status = SpiService->SpiGetRegion (FlashRegionBios, &RgnBase, &RgnSize);
     if (!EFI_ERROR (Status)) {
       // BIOS region offset can be calculated by (HostAddress + BiosRgnLimit)
-      BiosRgnOffset = (UINT32)((UINT32)(UINTN)VariableStore + RgnSize);
+      BiosRgnOffset = (UINT32)((UINT32)(UINTN)FlashPtr + RgnSize);
       Status = SpiService->SpiWrite (FlashRegionBios, BiosRgnOffset, Length, Buffer);
-      AsmFlushCacheRange (VariableStore, Length);
+      AsmFlushCacheRange (FlashPtr, Length);
     }
   } else {
     Status = EFI_NOT_AVAILABLE_YET;
   }
+
+  if (ShadowPtr != NULL) {
+    // Flash can only clear bits, so mirror what was really programmed
+    CopyMem (ShadowPtr, FlashPtr, Length);
+  }
+
   return Status;
 }
 
@@ -218,165 +303,58 @@ GetActiveVaraibelStoreBase (
 }
 
 /**
+  Calculate the hash of a variable name.
 
-  This function initilizes the variable store.
-
-  If the variable store needs repair, it will fix previous error if required.
+  @param    VariableName    Variable name.
 
-  @retval   EFI_DEVICE_ERROR    Device write failure.
-  @retval   EFI_SUCCESS         Variable store has been initialized successfully.
+  @retval   The variable name hash.
 
 **/
-EFI_STATUS
-EFIAPI
-InitializeVariableStore (
-  VOID
+STATIC
+UINT32
+GetVariableNameHash (
+  IN CONST CHAR8    *VariableName
   )
 {
-  UINT32                  FullVarStoreLen;
-  UINT32                  VarStoreLen;
-  VARIABLE_STORE_HEADER   VarStoreHdr;
-  VARIABLE_STORE_HEADER  *VarStoreHdrPtr1;
-  VARIABLE_STORE_HEADER  *VarStoreHdrPtr2;
-  VARIABLE_STORE_HEADER  *ActivateVarStoreHdrPtr;
-  VARIABLE_STORE_HEADER  *InactiveVarStoreHdrPtr;
-  UINT8                   State;
-  EFI_STATUS              Status;
-
-  VarStoreHdrPtr1 = (VARIABLE_STORE_HEADER *)GetVaraibelStoreBase (&FullVarStoreLen);
-  if (VarStoreHdrPtr1 == NULL) {
-    return EFI_NOT_READY;
-  }
-
-  VarStoreLen     = FullVarStoreLen >> 1;
-  VarStoreHdrPtr2 = (VARIABLE_STORE_HEADER *) ((UINT8 *)VarStoreHdrPtr1 + VarStoreLen);
-
-  if (((VarStoreHdrPtr1->State & VAR_HEADER_VALID) == 0) && ((VarStoreHdrPtr2->State & VAR_HEADER_VALID) == 0)) {
-    //
-    // Both headers are valid, check delete state
-    //
-    if ((VarStoreHdrPtr1->State & VAR_DELETED) == 0) {
-      ActivateVarStoreHdrPtr = VarStoreHdrPtr2;
-    } else if ((VarStoreHdrPtr2->State & VAR_DELETED) == 0) {
-      ActivateVarStoreHdrPtr = VarStoreHdrPtr1;
-    } else {
-      //
-      // Both headers are active, check migration state
-      //
-      if ((VarStoreHdrPtr1->State & VAR_IN_MIGRATION) == 0) {
-        ActivateVarStoreHdrPtr = VarStoreHdrPtr2;
-        InactiveVarStoreHdrPtr = VarStoreHdrPtr1;
-      } else {
-        ActivateVarStoreHdrPtr = VarStoreHdrPtr1;
-        InactiveVarStoreHdrPtr = VarStoreHdrPtr2;
-      }
-      //
-      // Mark migration copy as deleted
-      //
-      State  = InactiveVarStoreHdrPtr->State & ~VAR_DELETED;
-      Status = WriteVariableStore (&InactiveVarStoreHdrPtr->State, sizeof (InactiveVarStoreHdrPtr->State), &State);
-      if (EFI_ERROR (Status)) {
-        return Status;
-      }
-    }
-  } else if ((VarStoreHdrPtr2->State & VAR_HEADER_VALID) == 0) {
-    ActivateVarStoreHdrPtr = VarStoreHdrPtr2;
-  } else {
-    ActivateVarStoreHdrPtr = VarStoreHdrPtr1;
-  }
+  UINT32    Hash;
 
-  if (!IsVariableStoreValid (ActivateVarStoreHdrPtr)) {
-    //
-    // Erase current partition
-    //
-    Status = EraseVariableStore (VarStoreHdrPtr1, VarStoreLen * 2);
-    if (EFI_ERROR (Status)) {
-      return EFI_DEVICE_ERROR;
-    }
-    ActivateVarStoreHdrPtr = VarStoreHdrPtr1;
-
-    //
-    // Write store header
-    //
-    SetMem (&VarStoreHdr, sizeof (VARIABLE_STORE_HEADER), 0);
-    VarStoreHdr.Signature = VARIABLE_STORE_SIGNATURE;
-    VarStoreHdr.State  = 0xFF;
-    VarStoreHdr.Format = 0xFF;
-    VarStoreHdr.Size   = VarStoreLen;
-    Status = WriteVariableStore (ActivateVarStoreHdrPtr, sizeof (VARIABLE_STORE_HEADER), &VarStoreHdr);
-    if (EFI_ERROR (Status)) {
-      return Status;
-    }
-
-    //
-    // Mark header as valid
-    //
-    State  = ActivateVarStoreHdrPtr->State & ~VAR_HEADER_VALID;
-    Status = WriteVariableStore (&ActivateVarStoreHdrPtr->State, sizeof (ActivateVarStoreHdrPtr->State), &State);
-    if (EFI_ERROR (Status)) {
-      return Status;
-    }
+  // FNV-1a
+  Hash = 0x811C9DC5;
+  while (*VariableName != 0) {
+    Hash = (Hash ^ (UINT8)*VariableName++) * 0x01000193;
   }
-
-  return EFI_SUCCESS;
+  return Hash;
 }
 
 /**
+  Find a variable by walking the variable store.
 
-  This internal function finds variable in storage blocks.
-
-  Caution: This function may receive untrusted input.
-  This function will do basic validation, before parse the data.
+  If there are multiple copies, the one not in migration is returned.
 
-  @param VariableName               Name of Variable to be found.
-  @param Attributes                 Attribute value of the variable found.
-  @param DataSize                   Size of Data found. If size is less than the
-                                    data, this value contains the required size.
-  @param Data                       The buffer to return the contents of the variable. May be NULL
-                                    with a zero DataSize in order to determine the size buffer needed.
-  @param VariableHeader             Variable header pointer if the variable is found.
+  @param    VarStoreHdrPtr    Variable store header pointer.
+  @param    VariableName      Variable name to find.
+  @param    VarEndPtr         End of the region to search.
+  @param    VariableHeader    Pointer to receive the variable header.
 
-  @retval EFI_INVALID_PARAMETER     Invalid parameter.
-  @retval EFI_SUCCESS               Find the specified variable.
-  @retval EFI_NOT_FOUND             Not found.
-  @retval EFI_BUFFER_TOO_SMALL      DataSize is too small for the result.
-  @retval EFI_VOLUME_CORRUPTED      Variable store is corrupted.
+  @retval   EFI_SUCCESS           The variable was found.
+  @retval   EFI_NOT_FOUND         The variable was not found.
+  @retval   EFI_VOLUME_CORRUPTED  Variable store is corrupted.
 
 **/
+STATIC
 EFI_STATUS
-EFIAPI
-InternalGetVariable (
-  IN      CHAR8             *VariableName,
-  OUT     UINT8             *Attributes OPTIONAL,
-  IN OUT  UINTN             *DataSize,
-  OUT     VOID              *Data OPTIONAL,
-  IN OUT  VARIABLE_HEADER  **VariableHeader OPTIONAL
+WalkVariableStore (
+  IN  VARIABLE_STORE_HEADER  *VarStoreHdrPtr,
+  IN  CONST CHAR8            *VariableName,
+  IN  UINT8                  *VarEndPtr,
+  OUT VARIABLE_HEADER       **VariableHeader
   )
 {
-
-  UINT32                  VarStoreLen;
-  VARIABLE_STORE_HEADER  *VarStoreHdrPtr;
   VARIABLE_HEADER        *VarHdrPtr;
   VARIABLE_HEADER        *FindVarHdrPtr;
-  UINT8                  *VarEndPtr;
   UINT8                   State;
-  UINT32                  VariableNameLen;
-  UINT32                  VariableDataLen;
-  UINTN                   DataSizeIn;
-
-  if ((DataSize == NULL) || (VariableName == NULL)) {
-    return EFI_INVALID_PARAMETER;
-  }
-
-  VarStoreHdrPtr = GetActiveVaraibelStoreBase (&VarStoreLen);
-  if (!IsVariableStoreValid (VarStoreHdrPtr)) {
-    return EFI_VOLUME_CORRUPTED;
-  }
-
-  VariableNameLen = (UINT32)AsciiStrLen (VariableName) + 1;
-  VarHdrPtr = (VARIABLE_HEADER *)&VarStoreHdrPtr[1];
-  VarEndPtr = (UINT8 *)VarStoreHdrPtr + VarStoreHdrPtr->Size;
 
+  VarHdrPtr     = (VARIABLE_HEADER *)&VarStoreHdrPtr[1];
   FindVarHdrPtr = NULL;
   while ((UINT8 *)VarHdrPtr < VarEndPtr) {
     State = VarHdrPtr->State;
@@ -385,8 +363,7 @@ InternalGetVariable (
     }
 
     if (VarHdrPtr->StartId != VARIABLE_DATA) {
-      VarHdrPtr = NULL;
-      break;
+      return EFI_VOLUME_CORRUPTED;
     }
 
     if (IS_DATA_VALID (State) && !IS_DELETED (State)) {
@@ -401,51 +378,615 @@ InternalGetVariable (
     VarHdrPtr = (VARIABLE_HEADER *) ((UINT8 *)&VarHdrPtr[1] + VarHdrPtr->DataSize);
   }
 
-  if (VarHdrPtr == NULL) {
-    return EFI_VOLUME_CORRUPTED;
-  }
+  *VariableHeader = FindVarHdrPtr;
+  return (FindVarHdrPtr == NULL) ? EFI_NOT_FOUND : EFI_SUCCESS;
+}
 
-  if (FindVarHdrPtr == NULL) {
-    return EFI_NOT_FOUND;
-  }
+/**
+  Build the variable name index for the RAM shadow.
 
-  DataSizeIn = *DataSize;
-  VariableDataLen = FindVarHdrPtr->DataSize - VariableNameLen;
-  *DataSize = VariableDataLen;
-  if (DataSizeIn <  VariableDataLen) {
-    return EFI_BUFFER_TOO_SMALL;
+  Every slot holds the store offset of the variable header that a walk of the
+  variable store would find for that name. 0 indicates an empty slot.
+
+  @param    VarInstance     Variable instance.
+
+**/
+STATIC
+VOID
+BuildVariableIndex (
+  IN  VARIABLE_INSTANCE  *VarInstance
+  )
+{
+  VARIABLE_STORE_HEADER  *VarStoreHdrPtr;
+  VARIABLE_HEADER        *VarHdrPtr;
+  VARIABLE_HEADER        *SlotHdrPtr;
+  UINT8                  *VarEndPtr;
+  UINT32                 *Index;
+  UINT32                  Count;
+  UINT32                  IndexNum;
+  UINT32                  Slot;
+  UINT8                   State;
+
+  VarStoreHdrPtr = (VARIABLE_STORE_HEADER *)(UINTN)VarInstance->ShadowBase;
+  VarEndPtr      = (UINT8 *)VarStoreHdrPtr + VarInstance->ShadowSize;
+
+  //
+  // Count the variables and validate the chain
+  //
+  Count     = 0;
+  VarHdrPtr = (VARIABLE_HEADER *)&VarStoreHdrPtr[1];
+  while ((UINT8 *)VarHdrPtr < VarEndPtr) {
+    State = VarHdrPtr->State;
+    if (!IS_HEADER_VALID (State)) {
+      break;
+    }
+    if (VarHdrPtr->StartId != VARIABLE_DATA) {
+      // Leave it to the store walk to report the corruption
+      return;
+    }
+    if (IS_DATA_VALID (State) && !IS_DELETED (State)) {
+      Count++;
+    }
+    VarHdrPtr = (VARIABLE_HEADER *) ((UINT8 *)&VarHdrPtr[1] + VarHdrPtr->DataSize);
   }
 
-  if (Data != NULL) {
-    CopyMem (Data, (UINT8 *)&FindVarHdrPtr[1] + VariableNameLen, VariableDataLen);
+  // Keep the load factor below 1/2
+  IndexNum = 16;
+  while (IndexNum < Count * 2) {
+    IndexNum <<= 1;
   }
 
-  if (VariableHeader) {
-    *VariableHeader = FindVarHdrPtr;
+  if (VarInstance->IndexNum < IndexNum) {
+    Index = AllocatePool (IndexNum * sizeof (UINT32));
+    if (Index == NULL) {
+      return;
+    }
+    if (VarInstance->IndexBase != 0) {
+      FreePool ((VOID *)(UINTN)VarInstance->IndexBase);
+    }
+    VarInstance->IndexBase = (UINT32)(UINTN)Index;
+    VarInstance->IndexNum  = IndexNum;
   }
 
-  return EFI_SUCCESS;
+  Index    = (UINT32 *)(UINTN)VarInstance->IndexBase;
+  IndexNum = VarInstance->IndexNum;
+  ZeroMem (Index, IndexNum * sizeof (UINT32));
+  VarInstance->IndexCount = 0;
+
+  VarHdrPtr = (VARIABLE_HEADER *)&VarStoreHdrPtr[1];
+  while ((UINT8 *)VarHdrPtr < VarEndPtr) {
+    State = VarHdrPtr->State;
+    if (!IS_HEADER_VALID (State)) {
+      break;
+    }
+    if (IS_DATA_VALID (State) && !IS_DELETED (State)) {
+      Slot = GetVariableNameHash ((CHAR8 *)&VarHdrPtr[1]) & (IndexNum - 1);
+      while (Index[Slot] != 0) {
+        SlotHdrPtr = (VARIABLE_HEADER *)((UINT8 *)VarStoreHdrPtr + Index[Slot]);
+        if (AsciiStrCmp ((CHAR8 *)&SlotHdrPtr[1], (CHAR8 *)&VarHdrPtr[1]) == 0) {
+          break;
+        }
+        Slot = (Slot + 1) & (IndexNum - 1);
+      }
+      //
+      // Same as the store walk, the first copy not in migration wins
+      //
+      if (Index[Slot] == 0) {
+        Index[Slot] = (UINT32)((UINT8 *)VarHdrPtr - (UINT8 *)VarStoreHdrPtr);
+        VarInstance->IndexCount++;
+      } else {
+        SlotHdrPtr = (VARIABLE_HEADER *)((UINT8 *)VarStoreHdrPtr + Index[Slot]);
+        if (IS_IN_MIGRATION (SlotHdrPtr->State)) {
+          Index[Slot] = (UINT32)((UINT8 *)VarHdrPtr - (UINT8 *)VarStoreHdrPtr);
+        }
+      }
+    }
+    VarHdrPtr = (VARIABLE_HEADER *) ((UINT8 *)&VarHdrPtr[1] + VarHdrPtr->DataSize);
+  }
 
+  VarInstance->IndexValid = TRUE;
 }
 
 /**
+  Update the name index entry of a variable after its state was changed.
 
-  This code finds variable in storage blocks.
+  Only the slot of the variable name is updated. The variable store is walked
+  only if the indexed copy itself was retired, to find the copy taking over.
 
-  This function will just call internal function to find variable.
+  @param    VarInstance     Variable instance.
+  @param    VarHdrPtr       Variable header whose state was changed.
 
-  @param VariableName               Name of Variable to be found.
-  @param Attributes                 Attribute value of the variable found.
-  @param DataSize                   Size of Data found. If size is less than the
-                                    data, this value contains the required size.
-  @param Data                       The buffer to return the contents of the variable. May be NULL
-                                    with a zero DataSize in order to determine the size buffer needed.
+**/
+STATIC
+VOID
+UpdateVariableIndex (
+  IN  VARIABLE_INSTANCE  *VarInstance,
+  IN  VARIABLE_HEADER    *VarHdrPtr
+  )
+{
+  VARIABLE_STORE_HEADER  *VarStoreHdrPtr;
+  VARIABLE_HEADER        *SlotHdrPtr;
+  VARIABLE_HEADER        *NewHdrPtr;
+  CHAR8                  *VariableName;
+  UINT32                 *Index;
+  UINT32                  Mask;
+  UINT32                  Slot;
+  UINT32                  Next;
+  UINT32                  Home;
+  UINT8                   State;
 
-  @retval EFI_INVALID_PARAMETER     Invalid parameter.
-  @retval EFI_SUCCESS               Find the specified variable.
-  @retval EFI_NOT_FOUND             Not found.
-  @retval EFI_BUFFER_TOO_SMALL      DataSize is too small for the result.
-  @retval EFI_VOLUME_CORRUPTED      Variable store is corrupted.
+  if ((VarInstance == NULL) || !VarInstance->IndexValid || (VarInstance->ShadowStore == 0) ||
+      ((UINT32)(UINTN)VarHdrPtr - VarInstance->ShadowBase >= VarInstance->ShadowSize)) {
+    return;
+  }
+
+  //
+  // A copy without valid data is never indexed, and its name may not be written yet
+  //
+  State = VarHdrPtr->State;
+  if (!IS_DATA_VALID (State)) {
+    return;
+  }
+
+  VarStoreHdrPtr = (VARIABLE_STORE_HEADER *)(UINTN)VarInstance->ShadowBase;
+  VariableName   = (CHAR8 *)&VarHdrPtr[1];
+  Index          = (UINT32 *)(UINTN)VarInstance->IndexBase;
+  Mask           = VarInstance->IndexNum - 1;
+  Slot           = GetVariableNameHash (VariableName) & Mask;
+  while (Index[Slot] != 0) {
+    SlotHdrPtr = (VARIABLE_HEADER *)((UINT8 *)VarStoreHdrPtr + Index[Slot]);
+    if (AsciiStrCmp ((CHAR8 *)&SlotHdrPtr[1], VariableName) == 0) {
+      break;
+    }
+    Slot = (Slot + 1) & Mask;
+  }
+
+  NewHdrPtr = NULL;
+  if (Index[Slot] != 0) {
+    NewHdrPtr = (VARIABLE_HEADER *)((UINT8 *)VarStoreHdrPtr + Index[Slot]);
+  }
+
+  if (NewHdrPtr == VarHdrPtr) {
+    if (IS_DELETED (State) || IS_IN_MIGRATION (State)) {
+      if (WalkVariableStore (VarStoreHdrPtr, VariableName, (UINT8 *)VarStoreHdrPtr + VarStoreHdrPtr->Size,
+                             &NewHdrPtr) == EFI_VOLUME_CORRUPTED) {
+        VarInstance->IndexValid = FALSE;
+        return;
+      }
+    }
+  } else if (!IS_DELETED (State)) {
+    //
+    // Same as the store walk, the first copy not in migration wins, otherwise the last copy
+    //
+    if ((NewHdrPtr == NULL) ||
+        (IS_IN_MIGRATION (NewHdrPtr->State) && (!IS_IN_MIGRATION (State) || (VarHdrPtr > NewHdrPtr))) ||
+        (!IS_IN_MIGRATION (NewHdrPtr->State) && !IS_IN_MIGRATION (State) && (VarHdrPtr < NewHdrPtr))) {
+      NewHdrPtr = VarHdrPtr;
+    }
+  }
+
+  if (NewHdrPtr != NULL) {
+    if (Index[Slot] == 0) {
+      if ((VarInstance->IndexCount + 1) * 2 > VarInstance->IndexNum) {
+        // Rebuild a larger index on next lookup
+        VarInstance->IndexValid = FALSE;
+        return;
+      }
+      VarInstance->IndexCount++;
+    }
+    Index[Slot] = (UINT32)((UINT8 *)NewHdrPtr - (UINT8 *)VarStoreHdrPtr);
+  } else if (Index[Slot] != 0) {
+    //
+    // Remove the slot and move up the entries that probed past it
+    //
+    VarInstance->IndexCount--;
+    Next = Slot;
+    while (TRUE) {
+      Next = (Next + 1) & Mask;
+      if (Index[Next] == 0) {
+        break;
+      }
+      SlotHdrPtr = (VARIABLE_HEADER *)((UINT8 *)VarStoreHdrPtr + Index[Next]);
+      Home       = GetVariableNameHash ((CHAR8 *)&SlotHdrPtr[1]) & Mask;
+      if (((Next - Home) & Mask) >= ((Next - Slot) & Mask)) {
+        Index[Slot] = Index[Next];
+        Slot        = Next;
+      }
+    }
+    Index[Slot] = 0;
+  }
+}
+
+/**
+  Write the state of a variable and update its name index entry.
+
+  @param    VarInstance     Variable instance.
+  @param    VarHdrPtr       Variable header, either flash or RAM shadow address.
+  @param    State           New variable state.
+
+  @retval   EFI_SUCCESS     Variable state was written successfully.
+  @retval   Others          Write operation failed.
+
+**/
+STATIC
+EFI_STATUS
+WriteVariableState (
+  IN  VARIABLE_INSTANCE  *VarInstance,
+  IN  VARIABLE_HEADER    *VarHdrPtr,
+  IN  UINT8               State
+  )
+{
+  EFI_STATUS              Status;
+
+  Status = WriteVariableStore (&VarHdrPtr->State, sizeof (VarHdrPtr->State), &State);
+  // The shadow mirrors what was programmed even on failure
+  UpdateVariableIndex (VarInstance, VarHdrPtr);
+  return Status;
+}
+
+/**
+  Get the active variable store for access.
+
+  A RAM shadow of the active variable store is used when it is available,
+  so that lookups don't need to read the flash. The shadow is only created
+  from Stage2 on. Before that the heap may still be in CAR, which is too
+  small for a copy of the whole store, and the library data is migrated
+  anyway so that a shadow would not survive.
+
+  @param    VarInstance     Variable instance.
+  @param    Size            Variable store size.
+
+  @retval   Active variable store header pointer, either RAM shadow or flash.
+
+**/
+STATIC
+VARIABLE_STORE_HEADER *
+GetVariableStore (
+  IN  VARIABLE_INSTANCE  *VarInstance,
+  OUT UINT32             *Size
+  )
+{
+  VARIABLE_STORE_HEADER  *VarStoreHdrPtr;
+  VOID                   *Buffer;
+  UINT32                  VarStoreLen;
+
+  VarStoreLen    = 0;
+  VarStoreHdrPtr = GetActiveVaraibelStoreBase (&VarStoreLen);
+  if ((VarInstance == NULL) || (VarInstance->Signature != VARIABLE_INSTANCE_SIGNATURE) ||
+      !IsVariableStoreValid (VarStoreHdrPtr) || (GetLoaderStage () < LOADER_STAGE_2)) {
+    *Size = VarStoreLen;
+    return VarStoreHdrPtr;
+  }
+
+  if (VarInstance->ShadowStore != (UINT32)(UINTN)VarStoreHdrPtr) {
+    //
+    // First access or the active store was switched by a reclaim
+    //
+    VarInstance->ShadowStore = 0;
+    VarInstance->IndexValid  = FALSE;
+    if (VarInstance->ShadowSize < VarStoreLen) {
+      Buffer = AllocatePool (VarStoreLen);
+      if (Buffer != NULL) {
+        if (VarInstance->ShadowBase != 0) {
+          FreePool ((VOID *)(UINTN)VarInstance->ShadowBase);
+        }
+        VarInstance->ShadowBase = (UINT32)(UINTN)Buffer;
+        VarInstance->ShadowSize = VarStoreLen;
+      }
+    }
+    if (VarInstance->ShadowSize >= VarStoreLen) {
+      CopyMem ((VOID *)(UINTN)VarInstance->ShadowBase, VarStoreHdrPtr, VarStoreLen);
+      VarInstance->ShadowSize  = VarStoreLen;
+      VarInstance->ShadowStore = (UINT32)(UINTN)VarStoreHdrPtr;
+    }
+  }
+
+  *Size = VarStoreLen;
+  if (VarInstance->ShadowStore == 0) {
+    return VarStoreHdrPtr;
+  }
+
+  return (VARIABLE_STORE_HEADER *)(UINTN)VarInstance->ShadowBase;
+}
+
+/**
+  Find a variable in the active variable store.
+
+  The name index is used if the RAM shadow is available.
+
+  @param    VarInstance       Variable instance.
+  @param    VarStoreHdrPtr    Active variable store header returned by GetVariableStore.
+  @param    VariableName      Variable name to find.
+  @param    VariableHeader    Pointer to receive the variable header.
+
+  @retval   EFI_SUCCESS           The variable was found.
+  @retval   EFI_NOT_FOUND         The variable was not found.
+  @retval   EFI_VOLUME_CORRUPTED  Variable store is corrupted.
+
+**/
+STATIC
+EFI_STATUS
+FindVariable (
+  IN  VARIABLE_INSTANCE      *VarInstance,
+  IN  VARIABLE_STORE_HEADER  *VarStoreHdrPtr,
+  IN  CONST CHAR8            *VariableName,
+  OUT VARIABLE_HEADER       **VariableHeader
+  )
+{
+  VARIABLE_HEADER        *VarHdrPtr;
+  UINT32                 *Index;
+  UINT32                  Slot;
+
+  if ((VarInstance != NULL) && (VarInstance->ShadowStore != 0) &&
+      ((UINT32)(UINTN)VarStoreHdrPtr == VarInstance->ShadowBase)) {
+    if (!VarInstance->IndexValid) {
+      BuildVariableIndex (VarInstance);
+    }
+    if (VarInstance->IndexValid) {
+      Index = (UINT32 *)(UINTN)VarInstance->IndexBase;
+      Slot  = GetVariableNameHash (VariableName) & (VarInstance->IndexNum - 1);
+      while (Index[Slot] != 0) {
+        VarHdrPtr = (VARIABLE_HEADER *)((UINT8 *)VarStoreHdrPtr + Index[Slot]);
+        if (AsciiStrCmp ((CHAR8 *)&VarHdrPtr[1], VariableName) == 0) {
+          *VariableHeader = VarHdrPtr;
+          return EFI_SUCCESS;
+        }
+        Slot = (Slot + 1) & (VarInstance->IndexNum - 1);
+      }
+      *VariableHeader = NULL;
+      return EFI_NOT_FOUND;
+    }
+  }
+
+  return WalkVariableStore (VarStoreHdrPtr, VariableName, (UINT8 *)VarStoreHdrPtr + VarStoreHdrPtr->Size,
+                            VariableHeader);
+}
+
+/**
+  Find a variable in the pending updates of current batch.
+
+  @param    VarInstance     Variable instance.
+  @param    VariableName    Variable name to find.
+
+  @retval   The pending variable header, or NULL if it is not found.
+
+**/
+STATIC
+VARIABLE_HEADER *
+FindPendingVariable (
+  IN  VARIABLE_INSTANCE      *VarInstance,
+  IN  CONST CHAR8            *VariableName
+  )
+{
+  VARIABLE_HEADER        *VarHdrPtr;
+  UINT8                  *VarEndPtr;
+
+  if ((VarInstance == NULL) || !VarInstance->WriteBack) {
+    return NULL;
+  }
+
+  VarHdrPtr = (VARIABLE_HEADER *)(UINTN)VarInstance->PendingBase;
+  VarEndPtr = (UINT8 *)VarHdrPtr + VarInstance->PendingLen;
+  while ((UINT8 *)VarHdrPtr < VarEndPtr) {
+    if (AsciiStrCmp ((VOID *)&VarHdrPtr[1], VariableName) == 0) {
+      return VarHdrPtr;
+    }
+    VarHdrPtr = (VARIABLE_HEADER *) ((UINT8 *)&VarHdrPtr[1] + VarHdrPtr->DataSize);
+  }
+
+  return NULL;
+}
+
+/**
+
+  This function initilizes the variable store.
+
+  If the variable store needs repair, it will fix previous error if required.
+
+  @retval   EFI_DEVICE_ERROR    Device write failure.
+  @retval   EFI_SUCCESS         Variable store has been initialized successfully.
+
+**/
+EFI_STATUS
+EFIAPI
+InitializeVariableStore (
+  VOID
+  )
+{
+  UINT32                  FullVarStoreLen;
+  UINT32                  VarStoreLen;
+  VARIABLE_STORE_HEADER   VarStoreHdr;
+  VARIABLE_STORE_HEADER  *VarStoreHdrPtr1;
+  VARIABLE_STORE_HEADER  *VarStoreHdrPtr2;
+  VARIABLE_STORE_HEADER  *ActivateVarStoreHdrPtr;
+  VARIABLE_STORE_HEADER  *InactiveVarStoreHdrPtr;
+  UINT8                   State;
+  EFI_STATUS              Status;
+
+  VarStoreHdrPtr1 = (VARIABLE_STORE_HEADER *)GetVaraibelStoreBase (&FullVarStoreLen);
+  if (VarStoreHdrPtr1 == NULL) {
+    return EFI_NOT_READY;
+  }
+
+  VarStoreLen     = FullVarStoreLen >> 1;
+  VarStoreHdrPtr2 = (VARIABLE_STORE_HEADER *) ((UINT8 *)VarStoreHdrPtr1 + VarStoreLen);
+
+  if (((VarStoreHdrPtr1->State & VAR_HEADER_VALID) == 0) && ((VarStoreHdrPtr2->State & VAR_HEADER_VALID) == 0)) {
+    //
+    // Both headers are valid, check delete state
+    //
+    if ((VarStoreHdrPtr1->State & VAR_DELETED) == 0) {
+      ActivateVarStoreHdrPtr = VarStoreHdrPtr2;
+    } else if ((VarStoreHdrPtr2->State & VAR_DELETED) == 0) {
+      ActivateVarStoreHdrPtr = VarStoreHdrPtr1;
+    } else {
+      //
+      // Both headers are active, check migration state
+      //
+      if ((VarStoreHdrPtr1->State & VAR_IN_MIGRATION) == 0) {
+        ActivateVarStoreHdrPtr = VarStoreHdrPtr2;
+        InactiveVarStoreHdrPtr = VarStoreHdrPtr1;
+      } else {
+        ActivateVarStoreHdrPtr = VarStoreHdrPtr1;
+        InactiveVarStoreHdrPtr = VarStoreHdrPtr2;
+      }
+      //
+      // Mark migration copy as deleted
+      //
+      State  = InactiveVarStoreHdrPtr->State & ~VAR_DELETED;
+      Status = WriteVariableStore (&InactiveVarStoreHdrPtr->State, sizeof (InactiveVarStoreHdrPtr->State), &State);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
+  } else if ((VarStoreHdrPtr2->State & VAR_HEADER_VALID) == 0) {
+    ActivateVarStoreHdrPtr = VarStoreHdrPtr2;
+  } else {
+    ActivateVarStoreHdrPtr = VarStoreHdrPtr1;
+  }
+
+  if (!IsVariableStoreValid (ActivateVarStoreHdrPtr)) {
+    //
+    // Erase current partition
+    //
+    Status = EraseVariableStore (VarStoreHdrPtr1, VarStoreLen * 2);
+    if (EFI_ERROR (Status)) {
+      return EFI_DEVICE_ERROR;
+    }
+    ActivateVarStoreHdrPtr = VarStoreHdrPtr1;
+
+    //
+    // Write store header
+    //
+    SetMem (&VarStoreHdr, sizeof (VARIABLE_STORE_HEADER), 0);
+    VarStoreHdr.Signature = VARIABLE_STORE_SIGNATURE;
+    VarStoreHdr.State  = 0xFF;
+    VarStoreHdr.Format = 0xFF;
+    VarStoreHdr.Size   = VarStoreLen;
+    Status = WriteVariableStore (ActivateVarStoreHdrPtr, sizeof (VARIABLE_STORE_HEADER), &VarStoreHdr);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    //
+    // Mark header as valid
+    //
+    State  = ActivateVarStoreHdrPtr->State & ~VAR_HEADER_VALID;
+    Status = WriteVariableStore (&ActivateVarStoreHdrPtr->State, sizeof (ActivateVarStoreHdrPtr->State), &State);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+
+  This internal function finds variable in storage blocks.
+
+  Caution: This function may receive untrusted input.
+  This function will do basic validation, before parse the data.
+
+  @param VariableName               Name of Variable to be found.
+  @param Attributes                 Attribute value of the variable found.
+  @param DataSize                   Size of Data found. If size is less than the
+                                    data, this value contains the required size.
+  @param Data                       The buffer to return the contents of the variable. May be NULL
+                                    with a zero DataSize in order to determine the size buffer needed.
+  @param VariableHeader             Variable header pointer if the variable is found.
+
+  @retval EFI_INVALID_PARAMETER     Invalid parameter.
+  @retval EFI_SUCCESS               Find the specified variable.
+  @retval EFI_NOT_FOUND             Not found.
+  @retval EFI_BUFFER_TOO_SMALL      DataSize is too small for the result.
+  @retval EFI_VOLUME_CORRUPTED      Variable store is corrupted.
+
+**/
+EFI_STATUS
+EFIAPI
+InternalGetVariable (
+  IN      CHAR8             *VariableName,
+  OUT     UINT8             *Attributes OPTIONAL,
+  IN OUT  UINTN             *DataSize,
+  OUT     VOID              *Data OPTIONAL,
+  IN OUT  VARIABLE_HEADER  **VariableHeader OPTIONAL
+  )
+{
+
+  UINT32                  VarStoreLen;
+  VARIABLE_INSTANCE      *VarInstance;
+  VARIABLE_STORE_HEADER  *VarStoreHdrPtr;
+  VARIABLE_HEADER        *FindVarHdrPtr;
+  UINT32                  VariableNameLen;
+  UINT32                  VariableDataLen;
+  UINTN                   DataSizeIn;
+  EFI_STATUS              Status;
+
+  if ((DataSize == NULL) || (VariableName == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  VarInstance    = GetVariableInstance ();
+  VarStoreHdrPtr = GetVariableStore (VarInstance, &VarStoreLen);
+  if (!IsVariableStoreValid (VarStoreHdrPtr)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  VariableNameLen = (UINT32)AsciiStrLen (VariableName) + 1;
+
+  //
+  // Updates pending in current batch take precedence
+  //
+  FindVarHdrPtr = FindPendingVariable (VarInstance, VariableName);
+  if (FindVarHdrPtr != NULL) {
+    if (FindVarHdrPtr->StartId == VARIABLE_DELETE) {
+      return EFI_NOT_FOUND;
+    }
+  } else {
+    Status = FindVariable (VarInstance, VarStoreHdrPtr, VariableName, &FindVarHdrPtr);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  DataSizeIn = *DataSize;
+  VariableDataLen = FindVarHdrPtr->DataSize - VariableNameLen;
+  *DataSize = VariableDataLen;
+  if (DataSizeIn <  VariableDataLen) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  if (Data != NULL) {
+    CopyMem (Data, (UINT8 *)&FindVarHdrPtr[1] + VariableNameLen, VariableDataLen);
+  }
+
+  if (VariableHeader) {
+    *VariableHeader = FindVarHdrPtr;
+  }
+
+  return EFI_SUCCESS;
+
+}
+
+/**
+
+  This code finds variable in storage blocks.
+
+  This function will just call internal function to find variable.
+
+  @param VariableName               Name of Variable to be found.
+  @param Attributes                 Attribute value of the variable found.
+  @param DataSize                   Size of Data found. If size is less than the
+                                    data, this value contains the required size.
+  @param Data                       The buffer to return the contents of the variable. May be NULL
+                                    with a zero DataSize in order to determine the size buffer needed.
+
+  @retval EFI_INVALID_PARAMETER     Invalid parameter.
+  @retval EFI_SUCCESS               Find the specified variable.
+  @retval EFI_NOT_FOUND             Not found.
+  @retval EFI_BUFFER_TOO_SMALL      DataSize is too small for the result.
+  @retval EFI_VOLUME_CORRUPTED      Variable store is corrupted.
 
 **/
 EFI_STATUS
@@ -464,6 +1005,8 @@ GetVariable (
 
   This code Finds the Next available variable.
 
+  Updates pending in a variable batch are not enumerated until committed.
+
   Caution: This function may receive untrusted input.
   This function may be invoked in SMM mode. This function will do basic validation, before parse the data.
 
@@ -508,176 +1051,654 @@ GetNextVariableName (
     return EFI_INVALID_PARAMETER;
   }
 
-  VarStoreHdrPtr = GetActiveVaraibelStoreBase (&VarStoreLen);
-  if (!IsVariableStoreValid (VarStoreHdrPtr)) {
-    return EFI_VOLUME_CORRUPTED;
-  }
+  VarStoreHdrPtr = GetVariableStore (GetVariableInstance (), &VarStoreLen);
+  if (!IsVariableStoreValid (VarStoreHdrPtr)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  VarHdrPtr = (VARIABLE_HEADER *)&VarStoreHdrPtr[1];
+  VarEndPtr = (UINT8 *)VarStoreHdrPtr + VarStoreHdrPtr->Size;
+
+  Key   = 0;
+  FindVarHdrPtr = NULL;
+  while ((UINT8 *)VarHdrPtr < VarEndPtr) {
+    State = VarHdrPtr->State;
+    if (!IS_HEADER_VALID (State)) {
+      VarHdrPtr = NULL;
+      break;
+    }
+
+    if (IS_DATA_VALID (State) && !IS_DELETED (State)) {
+      if (Key++ == *VariableKey) {
+        FindVarHdrPtr = VarHdrPtr;
+        break;
+      }
+    }
+
+    VarHdrPtr = (VARIABLE_HEADER *) ((UINT8 *)&VarHdrPtr[1] + VarHdrPtr->DataSize);
+  }
+
+  if (VarHdrPtr == NULL) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  if (FindVarHdrPtr == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  VariableNameLen = (UINT32)AsciiStrLen ((CONST CHAR8 *)&FindVarHdrPtr[1]) + 1;
+  if (*VariableNameSize < VariableNameLen) {
+    *VariableNameSize = VariableNameLen;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  CopyMem (VariableName, (UINT8 *)&FindVarHdrPtr[1], VariableNameLen);
+  *VariableKey = Key;
+
+  return EFI_SUCCESS;
+
+}
+
+/**
+
+  This function builds the reclaimed variable store content in memory.
+
+  Only the latest copy of each variable is kept. Variables updated in current
+  batch are replaced with the pending updates if requested.
+
+  @param   VarInstance         Variable instance with a valid RAM shadow.
+  @param   IncludePending      Merge the pending updates of current batch.
+  @param   Buffer              Buffer to receive the variables following the store header.
+  @param   BufferSize          Buffer size.
+  @param   Length              Pointer to receive the used length in the buffer.
+
+  @retval  EFI_OUT_OF_RESOURCES  The variables don't fit into the variable store.
+  @retval  EFI_SUCCESS           The variable store content was built successfully.
+
+**/
+STATIC
+EFI_STATUS
+BuildReclaimImage (
+  IN  VARIABLE_INSTANCE  *VarInstance,
+  IN  BOOLEAN             IncludePending,
+  IN  UINT8              *Buffer,
+  IN  UINT32              BufferSize,
+  OUT UINT32             *Length
+  )
+{
+  VARIABLE_STORE_HEADER  *VarStoreHdrPtr;
+  VARIABLE_HEADER        *VarHdrPtr;
+  VARIABLE_HEADER        *FindVarHdrPtr;
+  VARIABLE_HEADER        *CopyHdrPtr;
+  UINT8                  *VarEndPtr;
+  UINT8                   State;
+  UINT32                  Offset;
+  UINT32                  CopyLen;
+  EFI_STATUS              Status;
+
+  VarStoreHdrPtr = (VARIABLE_STORE_HEADER *)(UINTN)VarInstance->ShadowBase;
+  VarEndPtr      = (UINT8 *)VarStoreHdrPtr + VarInstance->ShadowSize;
+  VarHdrPtr      = (VARIABLE_HEADER *)&VarStoreHdrPtr[1];
+  Offset         = 0;
+
+  //
+  // Copy the latest copy of the variables not updated by current batch
+  //
+  while ((UINT8 *)VarHdrPtr < VarEndPtr) {
+    State = VarHdrPtr->State;
+    if (!IS_HEADER_VALID (State)) {
+      break;
+    }
+
+    if (IS_DATA_VALID (State) && !IS_DELETED (State)) {
+      Status = FindVariable (VarInstance, VarStoreHdrPtr, (CHAR8 *)&VarHdrPtr[1], &FindVarHdrPtr);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+      if ((FindVarHdrPtr == VarHdrPtr) &&
+          (!IncludePending || (FindPendingVariable (VarInstance, (CHAR8 *)&VarHdrPtr[1]) == NULL))) {
+        CopyLen = sizeof (VARIABLE_HEADER) + VarHdrPtr->DataSize;
+        if (Offset + CopyLen > BufferSize) {
+          return EFI_OUT_OF_RESOURCES;
+        }
+        CopyHdrPtr = (VARIABLE_HEADER *)(Buffer + Offset);
+        CopyMem (CopyHdrPtr, VarHdrPtr, CopyLen);
+        CopyHdrPtr->State |= VAR_IN_MIGRATION;
+        Offset += CopyLen;
+      }
+    }
+
+    VarHdrPtr = (VARIABLE_HEADER *) ((UINT8 *)&VarHdrPtr[1] + VarHdrPtr->DataSize);
+  }
+
+  //
+  // Append the pending updates
+  //
+  if (IncludePending) {
+    VarHdrPtr = (VARIABLE_HEADER *)(UINTN)VarInstance->PendingBase;
+    VarEndPtr = (UINT8 *)VarHdrPtr + VarInstance->PendingLen;
+    while ((UINT8 *)VarHdrPtr < VarEndPtr) {
+      CopyLen = sizeof (VARIABLE_HEADER) + VarHdrPtr->DataSize;
+      if (VarHdrPtr->StartId == VARIABLE_DATA) {
+        if (Offset + CopyLen > BufferSize) {
+          return EFI_OUT_OF_RESOURCES;
+        }
+        CopyHdrPtr = (VARIABLE_HEADER *)(Buffer + Offset);
+        CopyMem (CopyHdrPtr, VarHdrPtr, CopyLen);
+        CopyHdrPtr->State = 0xFF & ~(VAR_HEADER_VALID | VAR_DATA_VALID);
+        Offset += CopyLen;
+      }
+      VarHdrPtr = (VARIABLE_HEADER *) ((UINT8 *)VarHdrPtr + CopyLen);
+    }
+  }
+
+  *Length = Offset;
+  return EFI_SUCCESS;
+}
+
+/**
+
+  This function reclaim the variable store from active region to the alternative region.
+
+  When the RAM shadow is available, the reclaimed variable store is built in
+  memory first and programmed with a single flash write.
+
+  @param   ActiveVarStoreHdrPtr       The active variable store header pointer in flash
+  @param   IncludePending             Merge the pending updates of current batch.
+
+  @retval  EFI_DEVICE_ERROR      Failed to erase device
+  @retval  EFI_OUT_OF_RESOURCES  The variables don't fit into the variable store
+  @retval  EFI_NOT_READY         Pending updates can't be merged without the RAM shadow
+  @retval  EFI_SUCCESS           Variable store was reclaimed successfully
+
+**/
+
+EFI_STATUS
+Reclaim (
+  IN VARIABLE_STORE_HEADER  *ActiveVarStoreHdrPtr,
+  IN BOOLEAN                 IncludePending
+  )
+{
+  UINT32                  FullVarStoreLen;
+  UINT32                  VarStoreLen;
+  VARIABLE_STORE_HEADER   VarStoreHdr;
+  VARIABLE_STORE_HEADER  *VarStoreHdrPtr1;
+  VARIABLE_STORE_HEADER  *VarStoreHdrPtr2;
+  VARIABLE_STORE_HEADER  *InactiveVarStoreHdrPtr;
+  CHAR8                   VarName[VARIABLE_NAME_MAX_LEN];
+  EFI_STATUS              Status;
+  VARIABLE_HEADER        *VarHdrPtr;
+  VARIABLE_HEADER         VarHdr;
+  UINT8                  *CurPtr;
+  UINTN                   DataLen;
+  UINTN                   NameSize;
+  UINTN                   Key;
+  UINT8                   ActiveState;
+  UINT8                   InactiveState;
+  VARIABLE_INSTANCE      *VarInstance;
+  UINT8                  *Image;
+  UINT32                  ImageLen;
+  UINT32                  ShadowLen;
+
+  DEBUG ((DEBUG_INFO, "Reclaiming variable storage\n"));
+
+  VarStoreHdrPtr1 = (VARIABLE_STORE_HEADER *)GetVaraibelStoreBase (&FullVarStoreLen);
+  if (VarStoreHdrPtr1 == NULL) {
+    return EFI_NOT_READY;
+  }
+
+  VarStoreLen     = FullVarStoreLen >> 1;
+  VarStoreHdrPtr2 = (VARIABLE_STORE_HEADER *) ((UINT8 *)VarStoreHdrPtr1 + VarStoreLen);
+
+  if (VarStoreHdrPtr1 == ActiveVarStoreHdrPtr) {
+    InactiveVarStoreHdrPtr = VarStoreHdrPtr2;
+  } else {
+    InactiveVarStoreHdrPtr = VarStoreHdrPtr1;
+  }
+  CurPtr = (UINT8 *) (InactiveVarStoreHdrPtr + 1);
+
+  //
+  // Build the reclaimed variables in memory if possible
+  //
+  Image       = NULL;
+  ImageLen    = 0;
+  VarInstance = GetVariableInstance ();
+  GetVariableStore (VarInstance, &ShadowLen);
+  if ((VarInstance != NULL) && (VarInstance->ShadowStore == (UINT32)(UINTN)ActiveVarStoreHdrPtr)) {
+    Image = AllocatePool (VarStoreLen);
+    if (Image != NULL) {
+      Status = BuildReclaimImage (VarInstance, IncludePending, Image,
+                                  VarStoreLen - sizeof (VARIABLE_STORE_HEADER), &ImageLen);
+      if (EFI_ERROR (Status)) {
+        FreePool (Image);
+        return Status;
+      }
+    }
+  }
+
+  if ((Image == NULL) && IncludePending) {
+    return EFI_NOT_READY;
+  }
+
+  //
+  // Erase InactiveVarStoreHdrPtr
+  //
+  Status = EraseVariableStore (InactiveVarStoreHdrPtr, VarStoreLen);
+  if (EFI_ERROR (Status)) {
+    if (Image != NULL) {
+      FreePool (Image);
+    }
+    return EFI_DEVICE_ERROR;
+  }
+
+  if (Image != NULL) {
+    //
+    // Program all variables at once
+    //
+    Status = EFI_SUCCESS;
+    if (ImageLen > 0) {
+      Status = WriteVariableStore (CurPtr, ImageLen, Image);
+    }
+    FreePool (Image);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  } else {
+    //
+    // Copy variable over one by one
+    //
+    Key = 0;
+    while (TRUE) {
+      NameSize = sizeof (VarName);
+      Status   = GetNextVariableName (&NameSize, VarName, &Key);
+      if (!EFI_ERROR (Status)) {
+        DataLen = MAX_UINTN;
+        Status  = InternalGetVariable (VarName, NULL, &DataLen, NULL, &VarHdrPtr);
+        if (!EFI_ERROR (Status)) {
+          CopyMem (&VarHdr, VarHdrPtr, sizeof (VarHdr));
+          VarHdr.State |= VAR_IN_MIGRATION;
+          Status  = WriteVariableStore (CurPtr, sizeof (VarHdr), &VarHdr);
+          CurPtr += sizeof (VarHdr);
+          if (!EFI_ERROR (Status)) {
+            Status  = WriteVariableStore (CurPtr, VarHdrPtr->DataSize, (VOID *)&VarHdrPtr[1]);
+            CurPtr += VarHdrPtr->DataSize;
+          }
+          if (EFI_ERROR (Status)) {
+            return Status;
+          }
+        }
+      } else {
+        break;
+      }
+    }
+  }
+
+  //
+  // Write inactive store header
+  //
+  InactiveState = 0xFF;
+  CopyMem (&VarStoreHdr, ActiveVarStoreHdrPtr, sizeof (VarStoreHdr));
+  VarStoreHdr.State = InactiveState;
+  Status = WriteVariableStore (InactiveVarStoreHdrPtr, sizeof (VarStoreHdr), (VOID *)&VarStoreHdr);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Mark active store in migration
+  //
+  ActiveState = ActiveVarStoreHdrPtr->State & ~VAR_IN_MIGRATION;;
+  Status = WriteVariableStore (&ActiveVarStoreHdrPtr->State, sizeof (ActiveVarStoreHdrPtr->State), &ActiveState);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Mark inactive store as valid
+  //
+  InactiveState = InactiveState & ~VAR_HEADER_VALID;
+  Status = WriteVariableStore (&InactiveVarStoreHdrPtr->State, sizeof (InactiveVarStoreHdrPtr->State), &InactiveState);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Delete active store
+  //
+  ActiveState = ActiveState & ~VAR_DELETED;
+  Status = WriteVariableStore (&ActiveVarStoreHdrPtr->State, sizeof (ActiveVarStoreHdrPtr->State), &ActiveState);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+
+  This function writes the pending updates of current batch into the free space
+  of the active variable store.
+
+  The headers, names and data of all updated variables are programmed with a
+  single flash write, and then the state of each variable is updated following
+  the same sequence as SetVariable so that a power failure can be recovered.
+
+  @param   VarInstance         Variable instance with a valid RAM shadow.
+
+  @retval  EFI_OUT_OF_RESOURCES  There is not enough free space in the active variable store.
+  @retval  EFI_NOT_READY         The active variable store needs to be repaired first.
+  @retval  EFI_SUCCESS           All pending updates were written successfully.
+  @retval  Others                Failed to write the variable store.
+
+**/
+STATIC
+EFI_STATUS
+WritePendingVariables (
+  IN  VARIABLE_INSTANCE  *VarInstance
+  )
+{
+  VARIABLE_STORE_HEADER  *VarStoreHdrPtr;
+  VARIABLE_HEADER        *VarHdrPtr;
+  VARIABLE_HEADER        *NewVarHdrPtr;
+  VARIABLE_HEADER        *FindVarHdrPtr;
+  VARIABLE_HEADER        *CopyHdrPtr;
+  UINT8                  *FreePtr;
+  UINT8                  *VarEndPtr;
+  UINT8                  *PendingEndPtr;
+  UINT8                  *Image;
+  UINT32                  ImageLen;
+  UINT32                  Offset;
+  UINTN                   Idx;
+  UINT8                   State;
+  EFI_STATUS              Status;
+
+  VarStoreHdrPtr = (VARIABLE_STORE_HEADER *)(UINTN)VarInstance->ShadowBase;
+  VarEndPtr      = (UINT8 *)VarStoreHdrPtr + VarStoreHdrPtr->Size;
 
+  //
+  // Locate the free space, leave any repair work to SetVariable
+  //
   VarHdrPtr = (VARIABLE_HEADER *)&VarStoreHdrPtr[1];
-  VarEndPtr = (UINT8 *)VarStoreHdrPtr + VarStoreHdrPtr->Size;
-
-  Key   = 0;
-  FindVarHdrPtr = NULL;
   while ((UINT8 *)VarHdrPtr < VarEndPtr) {
     State = VarHdrPtr->State;
     if (!IS_HEADER_VALID (State)) {
-      VarHdrPtr = NULL;
       break;
     }
+    if ((VarHdrPtr->StartId != VARIABLE_DATA) || !IS_DATA_VALID (State)) {
+      return EFI_NOT_READY;
+    }
+    VarHdrPtr = (VARIABLE_HEADER *) ((UINT8 *)&VarHdrPtr[1] + VarHdrPtr->DataSize);
+  }
 
-    if (IS_DATA_VALID (State) && !IS_DELETED (State)) {
-      if (Key++ == *VariableKey) {
-        FindVarHdrPtr = VarHdrPtr;
-        break;
-      }
+  FreePtr = (UINT8 *)VarHdrPtr;
+  for (Idx = 0; (Idx < sizeof (VARIABLE_HEADER)) && (FreePtr + Idx < VarEndPtr); Idx++) {
+    if (FreePtr[Idx] != 0xFF) {
+      return EFI_NOT_READY;
     }
+  }
 
+  PendingEndPtr = (UINT8 *)(UINTN)VarInstance->PendingBase + VarInstance->PendingLen;
+  ImageLen      = 0;
+  VarHdrPtr     = (VARIABLE_HEADER *)(UINTN)VarInstance->PendingBase;
+  while ((UINT8 *)VarHdrPtr < PendingEndPtr) {
+    if (VarHdrPtr->StartId == VARIABLE_DATA) {
+      ImageLen += sizeof (VARIABLE_HEADER) + VarHdrPtr->DataSize;
+    }
     VarHdrPtr = (VARIABLE_HEADER *) ((UINT8 *)&VarHdrPtr[1] + VarHdrPtr->DataSize);
   }
 
-  if (VarHdrPtr == NULL) {
-    return EFI_VOLUME_CORRUPTED;
+  if (FreePtr + ImageLen > VarEndPtr) {
+    return EFI_OUT_OF_RESOURCES;
   }
 
-  if (FindVarHdrPtr == NULL) {
-    return EFI_NOT_FOUND;
-  }
+  //
+  // Write all new variables with valid headers at once
+  //
+  if (ImageLen > 0) {
+    Image = AllocatePool (ImageLen);
+    if (Image == NULL) {
+      return EFI_NOT_READY;
+    }
 
-  VariableNameLen = (UINT32)AsciiStrLen ((CONST CHAR8 *)&FindVarHdrPtr[1]) + 1;
-  if (*VariableNameSize < VariableNameLen) {
-    *VariableNameSize = VariableNameLen;
-    return EFI_BUFFER_TOO_SMALL;
+    Offset    = 0;
+    VarHdrPtr = (VARIABLE_HEADER *)(UINTN)VarInstance->PendingBase;
+    while ((UINT8 *)VarHdrPtr < PendingEndPtr) {
+      if (VarHdrPtr->StartId == VARIABLE_DATA) {
+        CopyHdrPtr = (VARIABLE_HEADER *)(Image + Offset);
+        CopyMem (CopyHdrPtr, VarHdrPtr, sizeof (VARIABLE_HEADER) + VarHdrPtr->DataSize);
+        CopyHdrPtr->State = 0xFF & ~VAR_HEADER_VALID;
+        Offset += sizeof (VARIABLE_HEADER) + VarHdrPtr->DataSize;
+      }
+      VarHdrPtr = (VARIABLE_HEADER *) ((UINT8 *)&VarHdrPtr[1] + VarHdrPtr->DataSize);
+    }
+
+    Status = WriteVariableStore (FreePtr, ImageLen, Image);
+    FreePool (Image);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
   }
 
-  CopyMem (VariableName, (UINT8 *)&FindVarHdrPtr[1], VariableNameLen);
-  *VariableKey = Key;
+  //
+  // Activate the new variables and retire the old copies
+  //
+  NewVarHdrPtr = (VARIABLE_HEADER *)FreePtr;
+  VarHdrPtr    = (VARIABLE_HEADER *)(UINTN)VarInstance->PendingBase;
+  while ((UINT8 *)VarHdrPtr < PendingEndPtr) {
+    Status = WalkVariableStore (VarStoreHdrPtr, (CHAR8 *)&VarHdrPtr[1], FreePtr, &FindVarHdrPtr);
+    if (Status == EFI_VOLUME_CORRUPTED) {
+      return Status;
+    }
 
-  return EFI_SUCCESS;
+    if (VarHdrPtr->StartId == VARIABLE_DATA) {
+      if (FindVarHdrPtr != NULL) {
+        //
+        // Mark previous variable in migration
+        //
+        State  = FindVarHdrPtr->State & ~VAR_IN_MIGRATION;
+        Status = WriteVariableState (VarInstance, FindVarHdrPtr, State);
+        if (EFI_ERROR (Status)) {
+          return Status;
+        }
+      }
+
+      //
+      // Mark data valid
+      //
+      State  = NewVarHdrPtr->State & ~VAR_DATA_VALID;
+      Status = WriteVariableState (VarInstance, NewVarHdrPtr, State);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+      NewVarHdrPtr = (VARIABLE_HEADER *) ((UINT8 *)&NewVarHdrPtr[1] + NewVarHdrPtr->DataSize);
+    }
+
+    if (FindVarHdrPtr != NULL) {
+      //
+      // Mark previous variable as invalid
+      //
+      State  = FindVarHdrPtr->State & ~VAR_DELETED;
+      Status = WriteVariableState (VarInstance, FindVarHdrPtr, State);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
 
+    VarHdrPtr = (VARIABLE_HEADER *) ((UINT8 *)&VarHdrPtr[1] + VarHdrPtr->DataSize);
+  }
+
+  return EFI_SUCCESS;
 }
 
 /**
 
-  This function reclaim the variable store from active region to the alternative region.
+  This function writes all pending updates of current batch to flash.
 
-  @param   ActiveVarStoreHdrPtr       The active variable store header pointer
+  The pending updates are appended to the active variable store if they fit,
+  otherwise they are merged into a reclaim of the variable store. If neither is
+  possible, the updates are written one by one through SetVariable.
 
-  @retval  EFI_DEVICE_ERROR      Failed to erase device
-    @retval  EFI_SUCCESS           Variable store was reclaimed successfully
+  @param   VarInstance         Variable instance.
 
-**/
+  @retval  EFI_SUCCESS           All pending updates were written successfully.
+  @retval  Others                Failed to write the pending updates.
 
+**/
+STATIC
 EFI_STATUS
-Reclaim (
-  IN VARIABLE_STORE_HEADER  *ActiveVarStoreHdrPtr
+FlushPendingVariables (
+  IN  VARIABLE_INSTANCE  *VarInstance
   )
 {
-  UINT32                  FullVarStoreLen;
+  VARIABLE_STORE_HEADER  *VarStoreHdrPtr;
+  VARIABLE_HEADER        *VarHdrPtr;
+  UINT8                  *PendingEndPtr;
   UINT32                  VarStoreLen;
-  VARIABLE_STORE_HEADER   VarStoreHdr;
-  VARIABLE_STORE_HEADER  *VarStoreHdrPtr1;
-  VARIABLE_STORE_HEADER  *VarStoreHdrPtr2;
-  VARIABLE_STORE_HEADER  *InactiveVarStoreHdrPtr;
-  CHAR8                   VarName[VARIABLE_NAME_MAX_LEN];
+  UINT32                  VariableNameLen;
   EFI_STATUS              Status;
-  VARIABLE_HEADER        *VarHdrPtr;
-  VARIABLE_HEADER         VarHdr;
-  UINT8                  *CurPtr;
-  UINTN                   DataLen;
-  UINTN                   NameSize;
-  UINTN                   Key;
-  UINT8                   ActiveState;
-  UINT8                   InactiveState;
-
-  DEBUG ((DEBUG_INFO, "Reclaiming variable storage\n"));
+  EFI_STATUS              SetStatus;
 
-  VarStoreHdrPtr1 = (VARIABLE_STORE_HEADER *)GetVaraibelStoreBase (&FullVarStoreLen);
-  if (VarStoreHdrPtr1 == NULL) {
-    return EFI_NOT_READY;
+  if (VarInstance->PendingLen == 0) {
+    return EFI_SUCCESS;
   }
 
-  VarStoreLen     = FullVarStoreLen >> 1;
-  VarStoreHdrPtr2 = (VARIABLE_STORE_HEADER *) ((UINT8 *)VarStoreHdrPtr1 + VarStoreLen);
-
-  if (VarStoreHdrPtr1 == ActiveVarStoreHdrPtr) {
-    InactiveVarStoreHdrPtr = VarStoreHdrPtr2;
-  } else {
-    InactiveVarStoreHdrPtr = VarStoreHdrPtr1;
-  }
-  CurPtr = (UINT8 *) (InactiveVarStoreHdrPtr + 1);
+  DEBUG ((DEBUG_INFO, "Writing 0x%X bytes of pending variable updates\n", VarInstance->PendingLen));
 
-  //
-  // Erase InactiveVarStoreHdrPtr
-  //
-  Status = EraseVariableStore (InactiveVarStoreHdrPtr, VarStoreLen);
-  if (EFI_ERROR (Status)) {
-    return EFI_DEVICE_ERROR;
+  Status = EFI_NOT_READY;
+  VarStoreHdrPtr = GetVariableStore (VarInstance, &VarStoreLen);
+  if (IsVariableStoreValid (VarStoreHdrPtr) && (VarInstance->ShadowStore != 0)) {
+    Status = WritePendingVariables (VarInstance);
+    if (Status == EFI_OUT_OF_RESOURCES) {
+      Status = Reclaim ((VARIABLE_STORE_HEADER *)(UINTN)VarInstance->ShadowStore, TRUE);
+    }
   }
 
-  //
-  // Copy variable over one by one
-  //
-  Key = 0;
-  while (TRUE) {
-    NameSize = sizeof (VarName);
-    Status   = GetNextVariableName (&NameSize, VarName, &Key);
-    if (!EFI_ERROR (Status)) {
-      Status = InternalGetVariable (VarName, NULL, &DataLen, NULL, &VarHdrPtr);
-      if (!EFI_ERROR (Status)) {
-        CopyMem (&VarHdr, VarHdrPtr, sizeof (VarHdr));
-        VarHdr.State |= VAR_IN_MIGRATION;
-        Status  = WriteVariableStore (CurPtr, sizeof (VarHdr), &VarHdr);
-        CurPtr += sizeof (VarHdr);
-        if (!EFI_ERROR (Status)) {
-          Status  = WriteVariableStore (CurPtr, VarHdrPtr->DataSize, (VOID *)&VarHdrPtr[1]);
-          CurPtr += VarHdrPtr->DataSize;
-        }
-        if (EFI_ERROR (Status)) {
-          return Status;
+  if ((Status == EFI_NOT_READY) || (Status == EFI_OUT_OF_RESOURCES)) {
+    //
+    // Fall back to write the variables one by one
+    //
+    Status        = EFI_SUCCESS;
+    PendingEndPtr = (UINT8 *)(UINTN)VarInstance->PendingBase + VarInstance->PendingLen;
+    VarHdrPtr     = (VARIABLE_HEADER *)(UINTN)VarInstance->PendingBase;
+    VarInstance->WriteBack = FALSE;
+    while ((UINT8 *)VarHdrPtr < PendingEndPtr) {
+      VariableNameLen = (UINT32)AsciiStrLen ((CHAR8 *)&VarHdrPtr[1]) + 1;
+      if (VarHdrPtr->StartId == VARIABLE_DELETE) {
+        SetStatus = SetVariable ((CHAR8 *)&VarHdrPtr[1], 0, 0, NULL);
+        if (SetStatus == EFI_NOT_FOUND) {
+          SetStatus = EFI_SUCCESS;
         }
+      } else {
+        SetStatus = SetVariable ((CHAR8 *)&VarHdrPtr[1], 0, VarHdrPtr->DataSize - VariableNameLen,
+                                 (UINT8 *)&VarHdrPtr[1] + VariableNameLen);
       }
-    } else {
-      break;
+      if (EFI_ERROR (SetStatus)) {
+        Status = SetStatus;
+      }
+      VarHdrPtr = (VARIABLE_HEADER *) ((UINT8 *)&VarHdrPtr[1] + VarHdrPtr->DataSize);
     }
+    VarInstance->WriteBack = TRUE;
   }
 
-  //
-  // Write inactive store header
-  //
-  InactiveState = 0xFF;
-  CopyMem (&VarStoreHdr, ActiveVarStoreHdrPtr, sizeof (VarStoreHdr));
-  VarStoreHdr.State = InactiveState;
-  Status = WriteVariableStore (InactiveVarStoreHdrPtr, sizeof (VarStoreHdr), (VOID *)&VarStoreHdr);
-  if (EFI_ERROR (Status)) {
-    return Status;
+  VarInstance->PendingLen = 0;
+  return Status;
+}
+
+/**
+
+  This function records a variable update in current batch.
+
+  @param   VarInstance         Variable instance.
+  @param   VariableName        Name of Variable to be set.
+  @param   DataSize            Size of Data. 0 to delete the variable.
+  @param   Data                Data pointer.
+
+  @retval  EFI_INVALID_PARAMETER  Invalid parameter.
+  @retval  EFI_SUCCESS            The update was recorded successfully.
+  @retval  EFI_NOT_FOUND          The variable to delete was not found.
+  @retval  EFI_OUT_OF_RESOURCES   The update doesn't fit into the pending buffer.
+
+**/
+STATIC
+EFI_STATUS
+SetPendingVariable (
+  IN  VARIABLE_INSTANCE  *VarInstance,
+  IN  CHAR8              *VariableName,
+  IN  UINTN               DataSize,
+  IN  VOID               *Data
+  )
+{
+  VARIABLE_STORE_HEADER  *VarStoreHdrPtr;
+  VARIABLE_HEADER        *VarHdrPtr;
+  VARIABLE_HEADER        *FindVarHdrPtr;
+  UINT8                  *PendingEndPtr;
+  UINT8                  *NextPtr;
+  UINTN                   CurDataSize;
+  UINT32                  VarStoreLen;
+  UINT32                  VariableNameLen;
+  UINT32                  TotalLen;
+  EFI_STATUS              Status;
+
+  VariableNameLen = (UINT32)AsciiStrLen (VariableName) + 1;
+  TotalLen        = sizeof (VARIABLE_HEADER) + VariableNameLen + (UINT32)DataSize;
+  if (TotalLen > 0xFFFF) {
+    return EFI_INVALID_PARAMETER;
   }
 
-  //
-  // Mark active store in migration
-  //
-  ActiveState = ActiveVarStoreHdrPtr->State & ~VAR_IN_MIGRATION;;
-  Status = WriteVariableStore (&ActiveVarStoreHdrPtr->State, sizeof (ActiveVarStoreHdrPtr->State), &ActiveState);
-  if (EFI_ERROR (Status)) {
+  CurDataSize = MAX_UINTN;
+  Status = InternalGetVariable (VariableName, NULL, &CurDataSize, NULL, &VarHdrPtr);
+  if (Status == EFI_NOT_FOUND) {
+    if (DataSize == 0) {
+      return EFI_NOT_FOUND;
+    }
+  } else if (EFI_ERROR (Status)) {
     return Status;
+  } else if ((DataSize > 0) && (CurDataSize == DataSize) &&
+             (CompareMem ((UINT8 *)&VarHdrPtr[1] + VariableNameLen, Data, DataSize) == 0)) {
+    return EFI_SUCCESS;
   }
 
   //
-  // Mark inactive store as valid
+  // Drop the previous update of the same variable in current batch
   //
-  InactiveState = InactiveState & ~VAR_HEADER_VALID;
-  Status = WriteVariableStore (&InactiveVarStoreHdrPtr->State, sizeof (InactiveVarStoreHdrPtr->State), &InactiveState);
-  if (EFI_ERROR (Status)) {
-    return Status;
+  VarHdrPtr = FindPendingVariable (VarInstance, VariableName);
+  if (VarHdrPtr != NULL) {
+    PendingEndPtr = (UINT8 *)(UINTN)VarInstance->PendingBase + VarInstance->PendingLen;
+    NextPtr       = (UINT8 *)&VarHdrPtr[1] + VarHdrPtr->DataSize;
+    VarInstance->PendingLen -= (UINT32)(NextPtr - (UINT8 *)VarHdrPtr);
+    CopyMem (VarHdrPtr, NextPtr, PendingEndPtr - NextPtr);
   }
 
-  //
-  // Delete active store
-  //
-  ActiveState = ActiveState & ~VAR_DELETED;
-  Status = WriteVariableStore (&ActiveVarStoreHdrPtr->State, sizeof (ActiveVarStoreHdrPtr->State), &ActiveState);
-  if (EFI_ERROR (Status)) {
-    return Status;
+  if (DataSize == 0) {
+    //
+    // Nothing to delete if the variable only existed in current batch
+    //
+    VarStoreHdrPtr = GetVariableStore (VarInstance, &VarStoreLen);
+    Status = FindVariable (VarInstance, VarStoreHdrPtr, VariableName, &FindVarHdrPtr);
+    if (Status == EFI_NOT_FOUND) {
+      return EFI_SUCCESS;
+    }
+  }
+
+  if (VarInstance->PendingLen + TotalLen > VarInstance->PendingSize) {
+    Status = FlushPendingVariables (VarInstance);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    if (TotalLen > VarInstance->PendingSize) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  VarHdrPtr = (VARIABLE_HEADER *)(UINTN)(VarInstance->PendingBase + VarInstance->PendingLen);
+  VarHdrPtr->StartId  = (DataSize > 0) ? VARIABLE_DATA : VARIABLE_DELETE;
+  VarHdrPtr->State    = 0xFF;
+  VarHdrPtr->DataSize = (UINT16)(TotalLen - sizeof (VARIABLE_HEADER));
+  CopyMem (&VarHdrPtr[1], VariableName, VariableNameLen);
+  if (DataSize > 0) {
+    CopyMem ((UINT8 *)&VarHdrPtr[1] + VariableNameLen, Data, DataSize);
   }
+  VarInstance->PendingLen += TotalLen;
 
   return EFI_SUCCESS;
 }
@@ -718,6 +1739,7 @@ SetVariable (
 {
   VARIABLE_HEADER         VarHdr;
   UINT32                  VarStoreLen;
+  VARIABLE_INSTANCE      *VarInstance;
   VARIABLE_STORE_HEADER  *VarStoreHdrPtr;
   VARIABLE_HEADER        *VarHdrPtr;
   VARIABLE_HEADER        *NextVarHdrPtr;
@@ -744,7 +1766,15 @@ SetVariable (
     return EFI_INVALID_PARAMETER;
   }
 
-  VarStoreHdrPtr = GetActiveVaraibelStoreBase (&VarStoreLen);
+  VarInstance = GetVariableInstance ();
+  if ((VarInstance != NULL) && VarInstance->WriteBack) {
+    return SetPendingVariable (VarInstance, VariableName, DataSize, Data);
+  }
+
+  //
+  // Read through the RAM shadow, writes are translated to flash
+  //
+  VarStoreHdrPtr = GetVariableStore (VarInstance, &VarStoreLen);
   if (!IsVariableStoreValid (VarStoreHdrPtr)) {
     return EFI_VOLUME_CORRUPTED;
   }
@@ -813,7 +1843,7 @@ SetVariable (
         // Mark header valid
         //
         State &= ~VAR_HEADER_VALID;
-        Status = WriteVariableStore (&VarHdrPtr->State, sizeof (VarHdrPtr->State), &State);
+        Status = WriteVariableState (VarInstance, VarHdrPtr, State);
         if (EFI_ERROR (Status)) {
           return Status;
         }
@@ -836,7 +1866,7 @@ SetVariable (
         //
         NeedReclaim = TRUE;
         State &= ~VAR_DELETED;
-        Status = WriteVariableStore (&VarHdrPtr->State, sizeof (VarHdrPtr->State), &State);
+        Status = WriteVariableState (VarInstance, VarHdrPtr, State);
         if (EFI_ERROR (Status)) {
           return Status;
         }
@@ -854,7 +1884,7 @@ SetVariable (
           //
           NeedReclaim   = TRUE;
           FindVarState &= ~VAR_DELETED;
-          Status = WriteVariableStore (&FindVarHdrPtr->State, sizeof (FindVarHdrPtr->State), &FindVarState);
+          Status = WriteVariableState (VarInstance, FindVarHdrPtr, FindVarState);
           if (EFI_ERROR (Status)) {
             return Status;
           }
@@ -889,7 +1919,7 @@ SetVariable (
     // No space left
     //
     if (NeedReclaim) {
-      Status = Reclaim (VarStoreHdrPtr);
+      Status = Reclaim (GetActiveVaraibelStoreBase (NULL), FALSE);
       if (EFI_ERROR (Status)) {
         return EFI_DEVICE_ERROR;
       }
@@ -915,7 +1945,7 @@ SetVariable (
     // Mark header valid
     //
     State  = VarHdr.State & ~VAR_HEADER_VALID;
-    Status = WriteVariableStore (&VarHdrPtr->State, sizeof (VarHdrPtr->State), &State);
+    Status = WriteVariableState (VarInstance, VarHdrPtr, State);
     if (EFI_ERROR (Status)) {
       return Status;
     }
@@ -941,7 +1971,7 @@ SetVariable (
       // Mark previous variable in migration
       //
       FindVarState &= ~VAR_IN_MIGRATION;
-      Status = WriteVariableStore (&FindVarHdrPtr->State, sizeof (FindVarHdrPtr->State), &FindVarState);
+      Status = WriteVariableState (VarInstance, FindVarHdrPtr, FindVarState);
       if (EFI_ERROR (Status)) {
         return Status;
       }
@@ -951,7 +1981,7 @@ SetVariable (
     // Mark data valid
     //
     State  = State & ~VAR_DATA_VALID;
-    Status = WriteVariableStore (&VarHdrPtr->State, sizeof (VarHdrPtr->State), &State);
+    Status = WriteVariableState (VarInstance, VarHdrPtr, State);
     if (EFI_ERROR (Status)) {
       return Status;
     }
@@ -963,7 +1993,7 @@ SetVariable (
     // Mark previous variable as invalid
     //
     FindVarState &= ~VAR_DELETED;
-    Status = WriteVariableStore (&FindVarHdrPtr->State, sizeof (FindVarHdrPtr->State), &FindVarState);
+    Status = WriteVariableState (VarInstance, FindVarHdrPtr, FindVarState);
     if (EFI_ERROR (Status)) {
       return Status;
     }
@@ -976,6 +2006,94 @@ SetVariable (
   return EFI_SUCCESS;
 }
 
+/**
+  Start a batch of variable updates.
+
+  The following SetVariable calls are kept in memory and visible to GetVariable,
+  and they are written to flash together by CommitVariableBatch. The batch needs
+  to be committed before the current stage exits, otherwise the updates are lost.
+
+  @retval EFI_SUCCESS             The batch was started.
+  @retval EFI_NOT_READY           The variable service is not initialized.
+  @retval EFI_ALREADY_STARTED     A batch has been started already.
+  @retval EFI_OUT_OF_RESOURCES    Not enough memory to hold the pending updates.
+
+**/
+EFI_STATUS
+EFIAPI
+StartVariableBatch (
+  VOID
+  )
+{
+  VARIABLE_INSTANCE      *VarInstance;
+  VARIABLE_STORE_HEADER  *VarStoreHdrPtr;
+  VOID                   *Buffer;
+  UINT32                  VarStoreLen;
+
+  VarInstance = GetVariableInstance ();
+  if ((VarInstance == NULL) || (VarInstance->Signature != VARIABLE_INSTANCE_SIGNATURE)) {
+    return EFI_NOT_READY;
+  }
+
+  if (VarInstance->WriteBack) {
+    return EFI_ALREADY_STARTED;
+  }
+
+  VarStoreHdrPtr = GetActiveVaraibelStoreBase (&VarStoreLen);
+  if (!IsVariableStoreValid (VarStoreHdrPtr)) {
+    return EFI_NOT_READY;
+  }
+
+  //
+  // The pending updates can never exceed the variable store size
+  //
+  if (VarInstance->PendingSize < VarStoreLen) {
+    Buffer = AllocatePool (VarStoreLen);
+    if (Buffer == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    if (VarInstance->PendingBase != 0) {
+      FreePool ((VOID *)(UINTN)VarInstance->PendingBase);
+    }
+    VarInstance->PendingBase = (UINT32)(UINTN)Buffer;
+    VarInstance->PendingSize = VarStoreLen;
+  }
+
+  VarInstance->PendingLen = 0;
+  VarInstance->WriteBack  = TRUE;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Write all variable updates of current batch to flash and end the batch.
+
+  @retval EFI_SUCCESS             All pending updates were written.
+  @retval EFI_NOT_STARTED         No batch has been started.
+  @retval Others                  Failed to write the pending updates.
+
+**/
+EFI_STATUS
+EFIAPI
+CommitVariableBatch (
+  VOID
+  )
+{
+  VARIABLE_INSTANCE      *VarInstance;
+  EFI_STATUS              Status;
+
+  VarInstance = GetVariableInstance ();
+  if ((VarInstance == NULL) || !VarInstance->WriteBack) {
+    return EFI_NOT_STARTED;
+  }
+
+  Status = FlushPendingVariables (VarInstance);
+  VarInstance->WriteBack  = FALSE;
+  VarInstance->PendingLen = 0;
+
+  return Status;
+}
+
 /**
   Initialize an varaible instance.
   Base needs to be 4KB aligned and Size needs to be 8KB aligned.
@@ -1,7 +1,7 @@
 /** @file
 Lite variable service library header file
 
-Copyright (c) 2006 - 2016, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2006 - 2020, Intel Corporation. All rights reserved.<BR>
 Portions copyright (c) 2008 - 2009, Apple Inc. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
@@ -30,6 +30,27 @@ typedef struct {
   UINT32                Signature;
   UINT32                StoreSize;
   UINT32                StoreBase;
+  //
+  // RAM shadow of the active variable store and its name index.
+  // The buffers belong to the instance at ShadowOwner address only, since
+  // the instance is copied when the library data is migrated.
+  //
+  UINT32                ShadowOwner;
+  UINT32                ShadowStore;
+  UINT32                ShadowBase;
+  UINT32                ShadowSize;
+  UINT32                IndexBase;
+  UINT32                IndexNum;
+  UINT32                IndexCount;
+  BOOLEAN               IndexValid;
+  //
+  // Variable updates pending for a batched write-back
+  //
+  BOOLEAN               WriteBack;
+  UINT8                 Reserved[2];
+  UINT32                PendingBase;
+  UINT32                PendingSize;
+  UINT32                PendingLen;
 } VARIABLE_INSTANCE;
 
 #endif
@@ -1,7 +1,7 @@
 /** @file
   The variable data structures.
 
-  Copyright (c) 2017, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2017 - 2020, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -20,6 +20,11 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 ///
 #define VARIABLE_DATA                    0xA5
 
+///
+/// Pending variable deletion flag, only used in RAM.
+///
+#define VARIABLE_DELETE                  0x5A
+
 ///
 /// Variable State flags.
 ///
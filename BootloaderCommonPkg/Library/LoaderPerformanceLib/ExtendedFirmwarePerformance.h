@@ -2,7 +2,7 @@
   This file defines edk2 extended firmware performance records.
   These records will be added into ACPI FPDT Firmware Basic Boot Performance Table.
 
-Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2018 - 2020, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -258,6 +258,19 @@ typedef struct {
   EFI_GUID              ModuleGuid;
 } MEASUREMENT_RECORD;
 
+/**
+  Get Measurement form Fpdt records.
+
+  @param[in]   RecordHeader        Pointer to the FPDT record.
+  @param[out]  Measurement         Pointer to the measurement which need to be filled.
+
+**/
+VOID
+GetMeasurementInfo (
+  IN     EFI_ACPI_5_0_FPDT_PERFORMANCE_RECORD_HEADER  *RecordHeader,
+  OUT    MEASUREMENT_RECORD                           *Measurement
+  );
+
 extern EFI_GUID gEdkiiFpdtExtendedFirmwarePerformanceGuid;
 
 #endif
@@ -0,0 +1,243 @@
+/** @file
+  Export the boot measure points as a timeline of nested spans.
+
+  Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiPei.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/HobLib.h>
+#include <Library/BootloaderCommonLib.h>
+#include <Library/LoaderPerformanceLib.h>
+#include <Guid/LoaderFspInfoGuid.h>
+#include "ExtendedFirmwarePerformance.h"
+
+/**
+  Convert a measure point timestamp into nanoseconds.
+
+  @param[in]  Tsc         Timestamp with the measure point Id stripped.
+  @param[in]  FreqKhz     Timestamp frequency in KHz.
+
+  @retval     Time in nanoseconds.
+
+**/
+STATIC
+UINT64
+TscToNs (
+  IN  UINT64    Tsc,
+  IN  UINT32    FreqKhz
+  )
+{
+  UINT64  TimeInMs;
+  UINT32  Remainder;
+
+  TimeInMs = DivU64x32Remainder (Tsc, FreqKhz, &Remainder);
+  return MultU64x32 (TimeInMs, 1000000) + DivU64x32 (MultU64x32 (Remainder, 1000000), FreqKhz);
+}
+
+/**
+  Append a span to the timeline if there is room left.
+
+  @param[in]      Timeline    Timeline to append to, or NULL to only count.
+  @param[in]      MaxCount    Number of spans the timeline can hold.
+  @param[in, out] Count       Number of spans in the timeline.
+  @param[in]      Id          Span Id.
+  @param[in]      Type        Span type.
+  @param[in]      StartNs     Span start time in nanoseconds.
+  @param[in]      EndNs       Span end time in nanoseconds.
+
+**/
+STATIC
+VOID
+AddSpan (
+  IN     PERF_TIMELINE  *Timeline,
+  IN     UINT32          MaxCount,
+  IN OUT UINT32         *Count,
+  IN     UINT16          Id,
+  IN     UINT8           Type,
+  IN     UINT64          StartNs,
+  IN     UINT64          EndNs
+  )
+{
+  PERF_TIMELINE_SPAN   *Span;
+
+  if ((Timeline != NULL) && (*Count < MaxCount)) {
+    Span           = &Timeline->Span[*Count];
+    Span->Id       = Id;
+    Span->Type     = Type;
+    Span->Depth    = Type;
+    Span->Reserved = 0;
+    Span->StartNs  = StartNs;
+    Span->EndNs    = EndNs;
+  }
+  (*Count)++;
+}
+
+/**
+  Add the FSP API spans from the FSP performance HOBs.
+
+  An FSP API is measured by an entry record with Id 0xX000 and an exit
+  record with Id 0xX07F.
+
+  @param[in]      Timeline    Timeline to append to, or NULL to only count.
+  @param[in]      MaxCount    Number of spans the timeline can hold.
+  @param[in, out] Count       Number of spans in the timeline.
+
+**/
+STATIC
+VOID
+AddFspSpans (
+  IN     PERF_TIMELINE  *Timeline,
+  IN     UINT32          MaxCount,
+  IN OUT UINT32         *Count
+  )
+{
+  EFI_HOB_GUID_TYPE                           *GuidHob;
+  LOADER_FSP_INFO                             *FspInfo;
+  FPDT_PEI_EXT_PERF_HEADER                    *LogHeader;
+  EFI_ACPI_5_0_FPDT_PERFORMANCE_RECORD_HEADER *RecordHeader;
+  UINT8                                       *Records;
+  MEASUREMENT_RECORD                           Entry;
+  MEASUREMENT_RECORD                           Exit;
+  UINT32                                       Offset;
+  UINT32                                       ExitOffset;
+
+  GuidHob = GetFirstGuidHob (&gLoaderFspInfoGuid);
+  if (GuidHob == NULL) {
+    return;
+  }
+  FspInfo = GET_GUID_HOB_DATA (GuidHob);
+
+  GuidHob = GetNextGuidHob (&gEdkiiFpdtExtendedFirmwarePerformanceGuid, FspInfo->FspHobList);
+  while (GuidHob != NULL) {
+    LogHeader = (FPDT_PEI_EXT_PERF_HEADER *)GET_GUID_HOB_DATA (GuidHob);
+    Records   = (UINT8 *)(LogHeader + 1);
+
+    for (Offset = 0; Offset < LogHeader->SizeOfAllEntries; Offset += RecordHeader->Length) {
+      RecordHeader = (EFI_ACPI_5_0_FPDT_PERFORMANCE_RECORD_HEADER *)(Records + Offset);
+      if (RecordHeader->Length == 0) {
+        break;
+      }
+      ZeroMem (&Entry, sizeof (Entry));
+      GetMeasurementInfo (RecordHeader, &Entry);
+      if ((Entry.Identifier == 0) || ((Entry.Identifier & 0x0FFF) != 0)) {
+        continue;
+      }
+
+      //
+      // Find the matching exit record
+      //
+      ExitOffset = Offset + RecordHeader->Length;
+      while (ExitOffset < LogHeader->SizeOfAllEntries) {
+        ZeroMem (&Exit, sizeof (Exit));
+        GetMeasurementInfo ((EFI_ACPI_5_0_FPDT_PERFORMANCE_RECORD_HEADER *)(Records + ExitOffset), &Exit);
+        if (Exit.Identifier == (Entry.Identifier | 0x7F)) {
+          AddSpan (Timeline, MaxCount, Count, (UINT16)Entry.Identifier, PERF_SPAN_TYPE_FSP,
+                   Entry.StartTimeStamp, Exit.StartTimeStamp);
+          break;
+        }
+        if (((EFI_ACPI_5_0_FPDT_PERFORMANCE_RECORD_HEADER *)(Records + ExitOffset))->Length == 0) {
+          break;
+        }
+        ExitOffset += ((EFI_ACPI_5_0_FPDT_PERFORMANCE_RECORD_HEADER *)(Records + ExitOffset))->Length;
+      }
+    }
+
+    GuidHob = GetNextGuidHob (&gEdkiiFpdtExtendedFirmwarePerformanceGuid, GET_NEXT_HOB (GuidHob));
+  }
+}
+
+/**
+  Build a boot timeline from the measure points.
+
+  Every measure point closes a step span that starts at the previous measure
+  point. The steps are grouped into stage spans by the upper nibble of their
+  Id, and the FSP API spans are added when the FSP performance HOBs are
+  available.
+
+  @param[in]      PerfData    Measure points to export.
+  @param[out]     Timeline    Buffer to receive the timeline. Optional.
+  @param[in, out] Size        On input, size of the Timeline buffer.
+                              On output, size of the complete timeline.
+
+  @retval EFI_SUCCESS             The timeline was exported.
+  @retval EFI_INVALID_PARAMETER   PerfData or Size is NULL.
+  @retval EFI_BUFFER_TOO_SMALL    The buffer is too small. Size is updated
+                                  with the required size.
+
+**/
+EFI_STATUS
+EFIAPI
+BuildPerfTimeline (
+  IN     BL_PERF_DATA    *PerfData,
+  OUT    PERF_TIMELINE   *Timeline  OPTIONAL,
+  IN OUT UINT32          *Size
+  )
+{
+  UINT32    MaxCount;
+  UINT32    Count;
+  UINT32    Idx;
+  UINT32    Length;
+  UINT64    Tsc;
+  UINT64    PrevNs;
+  UINT64    TimeNs;
+  UINT64    StageStartNs;
+  UINT16    Id;
+  UINT16    Stage;
+
+  if ((PerfData == NULL) || (Size == NULL) || (PerfData->FreqKhz == 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  MaxCount = 0;
+  if ((Timeline != NULL) && (*Size >= sizeof (PERF_TIMELINE))) {
+    MaxCount = (*Size - sizeof (PERF_TIMELINE)) / sizeof (PERF_TIMELINE_SPAN);
+  } else {
+    Timeline = NULL;
+  }
+
+  Count        = 0;
+  PrevNs       = 0;
+  StageStartNs = 0;
+  Stage        = 0;
+  for (Idx = 0; Idx < PerfData->PerfIndex; Idx++) {
+    Tsc    = PerfData->TimeStamp[Idx];
+    Id     = (UINT16)RShiftU64 (Tsc, 48);
+    TimeNs = TscToNs (Tsc & 0x0000FFFFFFFFFFFFULL, PerfData->FreqKhz);
+
+    if ((Id >> 12) != Stage) {
+      if (Stage != 0) {
+        AddSpan (Timeline, MaxCount, &Count, Stage, PERF_SPAN_TYPE_STAGE, StageStartNs, PrevNs);
+      }
+      Stage        = Id >> 12;
+      StageStartNs = PrevNs;
+    }
+
+    AddSpan (Timeline, MaxCount, &Count, Id, PERF_SPAN_TYPE_STEP, PrevNs, TimeNs);
+    PrevNs = TimeNs;
+  }
+  if (Stage != 0) {
+    AddSpan (Timeline, MaxCount, &Count, Stage, PERF_SPAN_TYPE_STAGE, StageStartNs, PrevNs);
+  }
+
+  AddFspSpans (Timeline, MaxCount, &Count);
+
+  Length = sizeof (PERF_TIMELINE) + Count * sizeof (PERF_TIMELINE_SPAN);
+  if ((Timeline == NULL) || (Count > MaxCount)) {
+    *Size = Length;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  Timeline->Signature = PERF_TIMELINE_SIGNATURE;
+  Timeline->Revision  = PERF_TIMELINE_REVISION;
+  Timeline->Count     = (UINT16)Count;
+  Timeline->Length    = Length;
+  Timeline->Reserved  = 0;
+  *Size = Length;
+
+  return EFI_SUCCESS;
+}
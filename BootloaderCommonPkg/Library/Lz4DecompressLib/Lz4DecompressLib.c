@@ -37,6 +37,8 @@
 #include <Library/BaseLib.h>
 #include <Library/DebugLib.h>
 #include <Library/BaseMemoryLib.h>
+#include <Library/ExtraBaseLib.h>
+#include <Library/Lz4DecompressLib.h>
 
 /*========== Version =========== */
 #define LZ4_VERSION_MAJOR     1    /* for breaking interface changes  */
@@ -61,6 +63,105 @@ typedef UINTN*                uptrval;
 #define LZ4_wildCopy(d,s,e)   {UINT64 *d1 = (UINT64 *)(d); UINT64 *s1 = (UINT64 *)(s); do {*d1++=*s1++;} while ((BYTE *)d1<e);}
 #define LZ4_copy8(d,s)        *(UINT64 *)(d) = *(UINT64 *)(s)
 
+/* Minimal copy length to use the wide copy kernel instead of LZ4_wildCopy */
+#define LZ4_WIDE_COPY_MIN     32
+
+/* mLz4WideLen value before the processor has been checked */
+#define LZ4_WIDE_LEN_UNKNOWN  0xFF
+
+/**
+  Copy data in 16 or 32 byte chunks until DestinationEnd is reached.
+  Up to one chunk minus one byte may be written beyond DestinationEnd.
+
+  @param  Destination     Destination buffer.
+  @param  Source          Source buffer.
+  @param  DestinationEnd  End of destination to copy to.
+
+**/
+typedef
+VOID
+(EFIAPI *LZ4_WIDE_COPY) (
+  OUT VOID        *Destination,
+  IN  CONST VOID  *Source,
+  IN  VOID        *DestinationEnd
+  );
+
+VOID
+EFIAPI
+InternalLz4WideCopySse2 (
+  OUT VOID        *Destination,
+  IN  CONST VOID  *Source,
+  IN  VOID        *DestinationEnd
+  );
+
+VOID
+EFIAPI
+InternalLz4WideCopyAvx2 (
+  OUT VOID        *Destination,
+  IN  CONST VOID  *Source,
+  IN  VOID        *DestinationEnd
+  );
+
+/* Chunk size of the selected wide copy kernel, LZ4_WIDE_LEN_UNKNOWN if not checked yet */
+STATIC UINT8  mLz4WideLen = LZ4_WIDE_LEN_UNKNOWN;
+
+/**
+  Select the widest copy kernel usable on the current processor.
+
+  SSE2 requires CR4.OSFXSR, and AVX2 additionally requires the YMM state
+  to be enabled in XCR0. The result is cached after the first check. When
+  running in place from flash the cache write has no effect and the check
+  is simply repeated. APs enable the same SSE/AVX state as the BSP, so the
+  cached result is also valid on APs.
+
+  @param  WideCopy        Pointer to receive the copy kernel, NULL if none.
+
+  @retval                 Chunk size of the selected copy kernel, 0 if none.
+
+**/
+STATIC
+UINTN
+Lz4GetWideCopy (
+  OUT LZ4_WIDE_COPY  *WideCopy
+  )
+{
+  UINT8   WideLen;
+  UINT32  MaxLeaf;
+  UINT32  RegEbx;
+  UINT32  RegEcx;
+  UINT32  RegEdx;
+
+  WideLen = mLz4WideLen;
+  if (WideLen == LZ4_WIDE_LEN_UNKNOWN) {
+    WideLen = 0;
+    if ((AsmReadCr4 () & BIT9) != 0) {
+      AsmCpuid (0, &MaxLeaf, NULL, NULL, NULL);
+      AsmCpuid (1, NULL, NULL, &RegEcx, &RegEdx);
+      if ((MaxLeaf >= 7) && ((RegEcx & BIT27) != 0) &&
+          ((AsmReadXcr0 () & (BIT1 | BIT2)) == (BIT1 | BIT2))) {
+        AsmCpuidEx (7, 0, NULL, &RegEbx, NULL, NULL);
+        if ((RegEbx & BIT5) != 0) {
+          WideLen = 32;
+        }
+      }
+      if ((WideLen == 0) && ((RegEdx & BIT26) != 0)) {
+        WideLen = 16;
+      }
+    }
+    mLz4WideLen = WideLen;
+  }
+
+  if (WideLen == 32) {
+    *WideCopy = InternalLz4WideCopyAvx2;
+  } else if (WideLen == 16) {
+    *WideCopy = InternalLz4WideCopySse2;
+  } else {
+    *WideCopy = NULL;
+  }
+
+  return WideLen;
+}
+
 /*-************************************
 *  Common Constants
 **************************************/
@@ -152,6 +253,9 @@ FORCE_INLINE int LZ4_decompress_generic(
     const int safeDecode = (endOnInput==endOnInputSize);
     const int checkOffset = ((safeDecode) && (dictSize < (int)(64 KB)));
 
+    LZ4_WIDE_COPY wideCopy;
+    const size_t wideLen = Lz4GetWideCopy(&wideCopy);
+
 
     /* Special cases */
     if ((partialDecoding) && (oexit > oend-MFLIMIT)) oexit = oend-MFLIMIT;                        /* targetOutputSize too high => decode everything */
@@ -193,7 +297,12 @@ FORCE_INLINE int LZ4_decompress_generic(
             op += length;
             break;     /* Necessarily EOF, due to parsing restrictions */
         }
-        LZ4_wildCopy(op, ip, cpy);
+        if ((wideLen != 0) && (length >= LZ4_WIDE_COPY_MIN) &&
+            (cpy + wideLen <= oend) && (ip + length + wideLen <= iend)) {
+            wideCopy(op, ip, cpy);
+        } else {
+            LZ4_wildCopy(op, ip, cpy);
+        }
         ip += length; op = cpy;
 
         /* get offset */
@@ -267,7 +376,15 @@ FORCE_INLINE int LZ4_decompress_generic(
             while (op<cpy) *op++ = *match++;
         } else {
             LZ4_copy8(op, match);
-            if (length>16) LZ4_wildCopy(op+8, match+8, cpy);
+            if (length>16) {
+                /* wide chunks must not overlap the bytes they produce */
+                if ((wideLen != 0) && (length >= LZ4_WIDE_COPY_MIN) &&
+                    ((size_t)(op - match) >= wideLen) && (cpy + wideLen <= oend)) {
+                    wideCopy(op+8, match+8, cpy);
+                } else {
+                    LZ4_wildCopy(op+8, match+8, cpy);
+                }
+            }
         }
         op=cpy;   /* correction */
     }
@@ -384,3 +501,193 @@ Lz4Decompress (
     return RETURN_INVALID_PARAMETER;
   }
 }
+
+/**
+  Given a block-split LZ4 source buffer, this function retrieves the size of
+  the uncompressed buffer and the size of the scratch buffer required to
+  decompress it.
+
+  The scratch buffer is used to hold the source offset of every block.
+
+  @param  Source          The source buffer containing the compressed data.
+  @param  SourceSize      The size, in bytes, of the source buffer.
+  @param  DestinationSize A pointer to the size, in bytes, of the uncompressed buffer.
+  @param  ScratchSize     A pointer to the size, in bytes, of the scratch buffer.
+
+  @retval  RETURN_SUCCESS            The sizes were returned successfully.
+  @retval  RETURN_INVALID_PARAMETER  The block index table is not valid.
+
+**/
+RETURN_STATUS
+EFIAPI
+Lz4BlockDecompressGetInfo (
+  IN  CONST VOID  *Source,
+  IN  UINT32       SourceSize,
+  OUT UINT32      *DestinationSize,
+  OUT UINT32      *ScratchSize
+  )
+{
+  CONST LZ4_BLOCK_HEADER  *BlockHdr;
+
+  BlockHdr = (CONST LZ4_BLOCK_HEADER *)Source;
+  if ((SourceSize < sizeof (LZ4_BLOCK_HEADER)) ||
+      (BlockHdr->BlockCount > (SourceSize - sizeof (LZ4_BLOCK_HEADER)) / sizeof (UINT32))) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  if (DestinationSize) {
+    *DestinationSize = BlockHdr->DecompressedSize;
+  }
+
+  if (ScratchSize) {
+    *ScratchSize = BlockHdr->BlockCount * sizeof (UINT32);
+  }
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Validate a block-split LZ4 source buffer and build its block offset table.
+
+  @param  Source          The source buffer containing the compressed data.
+  @param  SourceSize      The size, in bytes, of the source buffer.
+  @param  Scratch         The scratch buffer to receive the block offset table.
+  @param  BlockCount      A pointer to receive the number of blocks.
+
+  @retval  RETURN_SUCCESS            The block offset table was built successfully.
+  @retval  RETURN_INVALID_PARAMETER  The block index table is not valid.
+
+**/
+RETURN_STATUS
+EFIAPI
+Lz4BlockDecompressSetup (
+  IN  CONST VOID  *Source,
+  IN  UINTN        SourceSize,
+  IN OUT VOID     *Scratch,
+  OUT UINT32      *BlockCount
+  )
+{
+  CONST LZ4_BLOCK_HEADER  *BlockHdr;
+  UINT32                  *BlockOffset;
+  UINT32                   Index;
+  UINTN                    Offset;
+
+  BlockHdr = (CONST LZ4_BLOCK_HEADER *)Source;
+  if ((SourceSize < sizeof (LZ4_BLOCK_HEADER)) ||
+      (BlockHdr->BlockCount > (SourceSize - sizeof (LZ4_BLOCK_HEADER)) / sizeof (UINT32))) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  // The block count must match the decompressed size exactly, rounding up without overflow
+  if ((BlockHdr->BlockSize == 0) ||
+      (BlockHdr->BlockCount != BlockHdr->DecompressedSize / BlockHdr->BlockSize +
+                               ((BlockHdr->DecompressedSize % BlockHdr->BlockSize) != 0 ? 1 : 0))) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  if ((BlockHdr->BlockCount > 0) && (Scratch == NULL)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  BlockOffset = (UINT32 *)Scratch;
+  Offset      = sizeof (LZ4_BLOCK_HEADER) + BlockHdr->BlockCount * sizeof (UINT32);
+  for (Index = 0; Index < BlockHdr->BlockCount; Index++) {
+    if (BlockHdr->CompressedSize[Index] > SourceSize - Offset) {
+      return RETURN_INVALID_PARAMETER;
+    }
+    BlockOffset[Index] = (UINT32)Offset;
+    Offset += BlockHdr->CompressedSize[Index];
+  }
+
+  if (BlockCount != NULL) {
+    *BlockCount = BlockHdr->BlockCount;
+  }
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Decompress a single block from a block-split LZ4 source buffer.
+
+  Blocks are independent from each other, so different blocks can be
+  decompressed concurrently on different processors.
+
+  @param  Source          The source buffer containing the compressed data.
+  @param  Destination     The destination buffer of the whole decompressed data.
+  @param  Scratch         The block offset table built by Lz4BlockDecompressSetup.
+  @param  Index           The block index to decompress.
+
+  @retval  RETURN_SUCCESS            The block was decompressed successfully.
+  @retval  RETURN_INVALID_PARAMETER  The block is corrupted.
+
+**/
+RETURN_STATUS
+EFIAPI
+Lz4BlockDecompressOne (
+  IN CONST VOID  *Source,
+  IN OUT VOID    *Destination,
+  IN CONST VOID  *Scratch,
+  IN UINT32       Index
+  )
+{
+  CONST LZ4_BLOCK_HEADER  *BlockHdr;
+  CONST UINT32            *BlockOffset;
+  UINT32                   DstOffset;
+  UINT32                   DstLen;
+  INT32                    Size;
+
+  BlockHdr    = (CONST LZ4_BLOCK_HEADER *)Source;
+  BlockOffset = (CONST UINT32 *)Scratch;
+  if (Index >= BlockHdr->BlockCount) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  DstOffset = Index * BlockHdr->BlockSize;
+  DstLen    = BlockHdr->DecompressedSize - DstOffset;
+  if (DstLen > BlockHdr->BlockSize) {
+    DstLen = BlockHdr->BlockSize;
+  }
+
+  Size = LZ4_decompress_safe ((CONST CHAR8 *)Source + BlockOffset[Index], (CHAR8 *)Destination + DstOffset,
+                              (INT32)BlockHdr->CompressedSize[Index], (INT32)DstLen);
+  if ((UINT32)Size == DstLen) {
+    return RETURN_SUCCESS;
+  } else {
+    return RETURN_INVALID_PARAMETER;
+  }
+}
+
+/**
+  Decompresses a block-split LZ4 source buffer on the current processor.
+
+  @param  Source      The source buffer containing the compressed data.
+  @param  SourceSize  The size of source buffer.
+  @param  Destination The destination buffer to store the decompressed data
+  @param  Scratch     A temporary scratch buffer that is used to perform the decompression.
+
+  @retval  RETURN_SUCCESS Decompression completed successfully, and
+                          the uncompressed buffer is returned in Destination.
+  @retval  RETURN_INVALID_PARAMETER
+                          The source buffer specified by Source is corrupted
+                          (not in a valid compressed format).
+**/
+RETURN_STATUS
+EFIAPI
+Lz4BlockDecompress (
+  IN CONST VOID  *Source,
+  IN UINTN       SourceSize,
+  IN OUT VOID    *Destination,
+  IN OUT VOID    *Scratch
+  )
+{
+  RETURN_STATUS  Status;
+  UINT32         BlockCount;
+  UINT32         Index;
+
+  Status = Lz4BlockDecompressSetup (Source, SourceSize, Scratch, &BlockCount);
+  for (Index = 0; (Index < BlockCount) && !RETURN_ERROR (Status); Index++) {
+    Status = Lz4BlockDecompressOne (Source, Destination, Scratch, Index);
+  }
+
+  return Status;
+}
@@ -1,7 +1,7 @@
 /** @file
   This file provides some helper functions which are specific for EMMC device.
 
-  Copyright (c) 2015 - 2017, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2015 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -391,9 +391,13 @@ SdMmcInitialize (
   DumpCapabilityReg (&Private->Capability);
   DEBUG_CODE_END ();
 
-  if (Private->Capability.Adma2 && Private->Capability.Sdma) {
-    DEBUG ((DEBUG_INFO, "Use SDMA instead of ADMA2\n"));
-    Private->Capability.Adma2 = 0;
+  //
+  // Prefer ADMA2 over SDMA. A single ADMA2 descriptor chain covers the whole
+  // transfer while SDMA stops at every 512KB boundary to be re-armed by the CPU.
+  // SDMA is still used for the buffers ADMA2 can't describe.
+  //
+  if (Private->Capability.Adma2) {
+    DEBUG ((DEBUG_INFO, "Use ADMA2 for data transfer\n"));
   }
 
   /* Only support eMMC and SD for now */
@@ -1006,12 +1006,17 @@ SdMmcHcLedOnOff (
 /**
   Build ADMA descriptor table for transfer.
 
+  The whole data buffer is described by a single descriptor chain so that one
+  multiple block command can transfer it without any CPU intervention.
+
   Refer to SD Host Controller Simplified spec 3.0 Section 1.13 for details.
 
   @param[in] Trb            The pointer to the SD_MMC_HC_TRB instance.
 
-  @retval EFI_SUCCESS       The ADMA descriptor table is created successfully.
-  @retval Others            The ADMA descriptor table isn't created successfully.
+  @retval EFI_SUCCESS             The ADMA descriptor table is created successfully.
+  @retval EFI_INVALID_PARAMETER   The data buffer isn't aligned to 4 bytes boundary.
+  @retval EFI_UNSUPPORTED         The data buffer is above or crosses the 4GB boundary.
+  @retval Others                  The ADMA descriptor table isn't created successfully.
 
 **/
 EFI_STATUS
@@ -1031,19 +1036,21 @@ BuildAdmaDescTable (
   Data    = (EFI_PHYSICAL_ADDRESS) (UINTN)Trb->DataPhy;
   DataLen = Trb->DataLen;
 
-  DEBUG ((DEBUG_INFO, "BuildAdmaDescTable Data=0x%08X DataLen=0x%08X\n", (UINT32) (UINTN)Data, (UINT32)DataLen));
+  DEBUG ((DEBUG_VERBOSE, "BuildAdmaDescTable Data=0x%08X DataLen=0x%08X\n", (UINT32) (UINTN)Data, (UINT32)DataLen));
   //
   // Only support 32bit ADMA Descriptor Table
   //
   if ((Data >= 0x100000000ul) || ((Data + DataLen) > 0x100000000ul)) {
-    return EFI_INVALID_PARAMETER;
+    DEBUG ((DEBUG_ERROR, "The buffer [0x%lx] to construct ADMA desc is above 4GB!\n", Data));
+    return EFI_UNSUPPORTED;
   }
   //
   // Address field shall be set on 32-bit boundary (Lower 2-bit is always set to 0)
   // for 32-bit address descriptor table.
   //
   if ((Data & (BIT0 | BIT1)) != 0) {
-    DEBUG ((DEBUG_INFO, "The buffer [0x%x] to construct ADMA desc is not aligned to 4 bytes boundary!\n", Data));
+    DEBUG ((DEBUG_VERBOSE, "The buffer [0x%x] to construct ADMA desc is not aligned to 4 bytes boundary!\n", Data));
+    return EFI_INVALID_PARAMETER;
   }
 
   Entries   = DivU64x32 ((DataLen + ADMA_MAX_DATA_PER_LINE - 1), ADMA_MAX_DATA_PER_LINE);
@@ -1189,7 +1196,15 @@ SdMmcCreateTrb (
       }
       Status = BuildAdmaDescTable (Trb);
       if (EFI_ERROR (Status)) {
-        goto Error;
+        //
+        // A buffer not aligned to 4 bytes can't be described by ADMA2
+        // descriptors, fall back to SDMA for this transfer if it is supported.
+        // A buffer above 4GB can't be reached by SDMA either, so fail it.
+        //
+        if ((Status != EFI_INVALID_PARAMETER) || (Private->Capability.Sdma == 0)) {
+          goto Error;
+        }
+        Trb->Mode = SdMmcSdmaMode;
       }
     } else if (Private->Capability.Sdma != 0) {
       Trb->Mode = SdMmcSdmaMode;
@@ -1390,6 +1405,15 @@ SdMmcExecTrb (
     if (EFI_ERROR (Status)) {
       return Status;
     }
+  } else if (Trb->Mode == SdMmcSdmaMode) {
+    //
+    // ADMA2 might have been selected by a previous transfer
+    //
+    HostCtrl1 = (UINT8)~ (BIT4 | BIT3);
+    Status = SdMmcHcAndMmio (Address, SD_MMC_HC_HOST_CTRL1, sizeof (HostCtrl1), (VOID *) (UINTN)&HostCtrl1);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
   }
 
   SdMmcHcLedOnOff (Address, TRUE);
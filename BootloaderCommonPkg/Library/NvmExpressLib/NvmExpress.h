@@ -255,6 +255,22 @@ struct _NVME_BLKIO2_SUBTASK {
 #define NVME_BLKIO2_SUBTASK_FROM_EVENT(a) \
   CR(a, NVME_BLKIO2_SUBTASK, Event, NVME_BLKIO2_SUBTASK_SIGNATURE)
 
+//
+// Nvme pipelined read slot, one for each read command in flight.
+//
+typedef struct {
+  NVME_BLKIO2_SUBTASK                      Subtask;
+  EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET CommandPacket;
+  EFI_NVM_EXPRESS_COMMAND                  Command;
+  EFI_NVM_EXPRESS_COMPLETION               Completion;
+  //
+  // Free slot list, overall status and in-flight command count of the read request
+  //
+  LIST_ENTRY                               *FreeSlots;
+  EFI_STATUS                               *Status;
+  UINT32                                   *InFlight;
+} NVME_READ_SLOT;
+
 //
 // Nvme asynchronous passthru request.
 //
@@ -271,7 +287,7 @@ typedef struct {
   VOID                                     *PrpListHost;
   VOID                                     *MapData;
   VOID                                     *MapMeta;
-  ASYNC_IO_CALL_BACK                       CallerEvent;
+  ASYNC_IO_CALL_BACK                       *CallerEvent;
 } NVME_PASS_THRU_ASYNC_REQ;
 
 #define NVME_PASS_THRU_ASYNC_REQ_FROM_THIS(a) \
@@ -372,5 +388,42 @@ NvmeDumpStatus (
   IN NVME_CQ             *Cq
   );
 
+/**
+  Reap the completed commands from the asynchronous I/O completion queue.
+
+  All the completion entries posted so far are processed in one batch and the
+  completion queue head doorbell is rung once for the whole batch.
+
+  @param[in]  Private            The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[out] Completed          The number of completion entries processed. Optional.
+
+  @retval EFI_SUCCESS            The completion queue was processed.
+  @retval Others                 Failed to update the completion queue head doorbell.
+
+**/
+EFI_STATUS
+NvmeProcessAsyncCompletions (
+  IN  NVME_CONTROLLER_PRIVATE_DATA   *Private,
+  OUT UINT32                         *Completed OPTIONAL
+  );
+
+/**
+  Abort all the commands still outstanding on the asynchronous I/O queue.
+
+  The controller is reset so that it stops any DMA for the outstanding
+  commands, and the pending requests are released without signaling the
+  caller events.
+
+  @param[in]  Private            The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+  @retval EFI_SUCCESS            The commands were aborted and the controller is ready again.
+  @retval Others                 Failed to reset the controller.
+
+**/
+EFI_STATUS
+NvmeAbortAsyncPassThru (
+  IN  NVME_CONTROLLER_PRIVATE_DATA   *Private
+  );
+
 
 #endif
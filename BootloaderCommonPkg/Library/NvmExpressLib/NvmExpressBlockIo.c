@@ -105,6 +105,209 @@ ReadSectors (
   return Status;
 }
 
+/**
+  Completion callback of a pipelined read command.
+
+  @param[in]  Subtask            The sub-task embedded in the completed read slot.
+
+**/
+STATIC
+VOID
+EFIAPI
+NvmeReadSlotDone (
+  IN NVME_BLKIO2_SUBTASK         *Subtask
+  )
+{
+  NVME_READ_SLOT                 *Slot;
+  NVME_CQ                        *Cq;
+
+  Slot = BASE_CR (Subtask, NVME_READ_SLOT, Subtask);
+  Cq   = (NVME_CQ *)&Slot->Completion;
+  if ((Cq->Sct != 0) || (Cq->Sc != 0)) {
+    *Slot->Status = EFI_DEVICE_ERROR;
+  }
+
+  (*Slot->InFlight)--;
+  InsertTailList (Slot->FreeSlots, &Subtask->Link);
+}
+
+/**
+  Read blocks from the device keeping several read commands in flight.
+
+  The read commands are submitted on the asynchronous I/O queue until either
+  all the read slots are in use or the submission queue is full, and the
+  completions are then reaped in batches.
+
+  @param  Device                 The pointer to the NVME_DEVICE_PRIVATE_DATA data structure.
+  @param  Buffer                 The buffer used to store the data read from the device.
+  @param  Lba                    The start block number.
+  @param  Blocks                 Total block number to be read.
+  @param  ChunkBlocks            Max block number for a single read command.
+  @param  Depth                  Max number of read commands in flight.
+
+  @retval EFI_SUCCESS            Datum are read from the device.
+  @retval EFI_OUT_OF_RESOURCES   Not enough memory for the read slots.
+  @retval EFI_NO_RESPONSE        Commands timed out and the controller could not be
+                                 reset, so the buffer may still be written by the device.
+  @retval Others                 Fail to read all the datum.
+
+**/
+STATIC
+EFI_STATUS
+NvmeReadPipelined (
+  IN NVME_DEVICE_PRIVATE_DATA           *Device,
+  IN UINT64                             Buffer,
+  IN UINT64                             Lba,
+  IN UINTN                              Blocks,
+  IN UINT32                             ChunkBlocks,
+  IN UINT32                             Depth
+  )
+{
+  NVME_CONTROLLER_PRIVATE_DATA             *Private;
+  NVME_READ_SLOT                           *Slots;
+  NVME_READ_SLOT                           *Slot;
+  EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET *CommandPacket;
+  LIST_ENTRY                               FreeSlots;
+  EFI_STATUS                               Status;
+  EFI_STATUS                               IoStatus;
+  UINT32                                   BlockSize;
+  UINT32                                   Count;
+  UINT32                                   InFlight;
+  UINT32                                   Pending;
+  UINT32                                   Index;
+  UINT64                                   TimeCount;
+
+  Private   = Device->Controller;
+  BlockSize = Device->Media.BlockSize;
+
+  Slots = AllocateZeroPool (Depth * sizeof (NVME_READ_SLOT));
+  if (Slots == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  IoStatus = EFI_SUCCESS;
+  InitializeListHead (&FreeSlots);
+  for (Index = 0; Index < Depth; Index++) {
+    Slot = &Slots[Index];
+    Slot->Subtask.Signature     = NVME_BLKIO2_SUBTASK_SIGNATURE;
+    Slot->Subtask.NamespaceId   = Device->NamespaceId;
+    Slot->Subtask.Event         = NvmeReadSlotDone;
+    Slot->Subtask.CommandPacket = &Slot->CommandPacket;
+    Slot->FreeSlots             = &FreeSlots;
+    Slot->Status                = &IoStatus;
+    Slot->InFlight              = &InFlight;
+    InsertTailList (&FreeSlots, &Slot->Subtask.Link);
+  }
+
+  InFlight  = 0;
+  TimeCount = 0;
+  while (TRUE) {
+    //
+    // Fill the submission queue as long as there are free read slots.
+    //
+    while ((Blocks > 0) && !IsListEmpty (&FreeSlots) && !EFI_ERROR (IoStatus)) {
+      Slot  = BASE_CR (GetFirstNode (&FreeSlots), NVME_READ_SLOT, Subtask.Link);
+      Count = (Blocks > ChunkBlocks) ? ChunkBlocks : (UINT32)Blocks;
+
+      CommandPacket = &Slot->CommandPacket;
+      ZeroMem (CommandPacket, sizeof (EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET));
+      ZeroMem (&Slot->Command, sizeof (EFI_NVM_EXPRESS_COMMAND));
+      ZeroMem (&Slot->Completion, sizeof (EFI_NVM_EXPRESS_COMPLETION));
+
+      CommandPacket->NvmeCmd        = &Slot->Command;
+      CommandPacket->NvmeCompletion = &Slot->Completion;
+
+      CommandPacket->NvmeCmd->Cdw0.Opcode = NVME_IO_READ_OPC;
+      CommandPacket->NvmeCmd->Nsid        = Device->NamespaceId;
+      CommandPacket->TransferBuffer       = (VOID *) (UINTN)Buffer;
+      CommandPacket->TransferLength       = Count * BlockSize;
+      CommandPacket->CommandTimeout       = NVME_GENERIC_TIMEOUT;
+      CommandPacket->QueueType            = NVME_IO_QUEUE;
+
+      CommandPacket->NvmeCmd->Cdw10 = (UINT32)Lba;
+      CommandPacket->NvmeCmd->Cdw11 = (UINT32)RShiftU64 (Lba, 32);
+      CommandPacket->NvmeCmd->Cdw12 = (Count - 1) & 0xFFFF;
+      CommandPacket->NvmeCmd->Flags = CDW10_VALID | CDW11_VALID | CDW12_VALID;
+
+      Status = Private->Passthru.PassThru (
+                 &Private->Passthru,
+                 Device->NamespaceId,
+                 CommandPacket,
+                 &Slot->Subtask.Event
+                 );
+      if ((Status == EFI_NOT_READY) && (InFlight > 0)) {
+        //
+        // Submission queue is full, reap some completions first.
+        //
+        break;
+      }
+      if (EFI_ERROR (Status)) {
+        //
+        // A full submission queue without any command of this request in
+        // flight would never drain.
+        //
+        IoStatus = (Status == EFI_NOT_READY) ? EFI_DEVICE_ERROR : Status;
+        break;
+      }
+
+      RemoveEntryList (&Slot->Subtask.Link);
+      InFlight++;
+      Blocks -= Count;
+      Buffer += Count * BlockSize;
+      Lba    += Count;
+    }
+
+    if (InFlight == 0) {
+      break;
+    }
+
+    //
+    // Reap all the completions posted so far in one batch. Only completions
+    // of the read slots decrease InFlight, other asynchronous commands may
+    // complete in the same batch.
+    //
+    Pending = InFlight;
+    Status  = NvmeProcessAsyncCompletions (Private, NULL);
+    if (EFI_ERROR (Status)) {
+      IoStatus = Status;
+    }
+
+    if (InFlight < Pending) {
+      TimeCount = 0;
+    } else {
+      if (TimeCount++ > RShiftU64 (NVME_GENERIC_TIMEOUT, 7)) {
+        IoStatus = EFI_TIMEOUT;
+        break;
+      }
+      NanoSecondDelay (100);
+    }
+  }
+
+  if (InFlight > 0) {
+    //
+    // Commands are still owned by the controller and may still DMA into the
+    // caller buffer or post completions into the read slots. Reset the
+    // controller to abort them before the read slots are released.
+    //
+    Status = NvmeAbortAsyncPassThru (Private);
+    if (EFI_ERROR (Status)) {
+      //
+      // The controller may still access the read slots, so never free them.
+      //
+      DEBUG ((DEBUG_ERROR, "NVMe controller reset failed (%r)\n", Status));
+      return EFI_NO_RESPONSE;
+    }
+  }
+
+  FreePool (Slots);
+
+  if (!EFI_ERROR (IoStatus) && (Blocks != 0)) {
+    IoStatus = EFI_DEVICE_ERROR;
+  }
+
+  return IoStatus;
+}
+
 /**
   Write some sectors to the device.
 
@@ -198,6 +401,8 @@ NvmeRead (
   UINT32                           BlockSize;
   NVME_CONTROLLER_PRIVATE_DATA     *Private;
   UINT32                           MaxTransferBlocks;
+  UINT32                           ChunkBlocks;
+  UINT32                           Depth;
   UINTN                            OrginalBlocks;
   BOOLEAN                          IsEmpty;
 
@@ -220,6 +425,35 @@ NvmeRead (
   OrginalBlocks = Blocks;
 
   MaxTransferBlocks = GetMaxTransferBlockNumber (Private, BlockSize);
+
+  //
+  // Keep several read commands in flight on the asynchronous I/O queue when
+  // the request needs more than one command.
+  //
+  Depth = MIN (PcdGet32 (PcdNvmeQueueDepth), MIN (NVME_ASYNC_CSQ_SIZE, Private->Cap.Mqes));
+  if ((Depth > 1) && (Blocks > MaxTransferBlocks)) {
+    ChunkBlocks = MaxTransferBlocks;
+    if (FeaturePcdGet (PcdDmaProtectionEnabled)) {
+      //
+      // Every command in flight is bounced through the DMA buffer, so share
+      // the DMA buffer budget of a single command among all of them.
+      //
+      ChunkBlocks = MAX (MaxTransferBlocks / Depth, EFI_PAGE_SIZE / BlockSize);
+      Depth       = MAX (MaxTransferBlocks / ChunkBlocks, 1);
+    }
+    Status = NvmeReadPipelined (Device, (UINT64) (UINTN)Buffer, Lba, Blocks, ChunkBlocks, Depth);
+    if (!EFI_ERROR (Status)) {
+      Blocks = 0;
+    } else if (Status == EFI_NO_RESPONSE) {
+      //
+      // Do not reuse the buffer while the device may still write into it
+      //
+      return EFI_DEVICE_ERROR;
+    } else {
+      DEBUG ((DEBUG_WARN, "NVMe pipelined read failed (%r), retry synchronously\n", Status));
+    }
+  }
+
   while (Blocks > 0) {
     if (Blocks > MaxTransferBlocks) {
       Status = ReadSectors (Device, (UINT64) (UINTN)Buffer, Lba, MaxTransferBlocks);
@@ -2,7 +2,7 @@
   NvmExpressDxe driver is used to manage non-volatile memory subsystem which follows
   NVM Express specification.
 
-  Copyright (c) 2013 - 2016, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2013 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -788,16 +788,17 @@ NvmeCreateIoSubmissionQueue (
 }
 
 /**
-  Initialize the Nvm Express controller.
+  Reset the controller, program the admin queues and enable the controller again.
 
   @param[in] Private                 The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
 
-  @retval EFI_SUCCESS                The NVM Express Controller is initialized successfully.
-  @retval Others                     A device error occurred while initializing the controller.
+  @retval EFI_SUCCESS                The admin queues are ready.
+  @retval Others                     A device error occurred while enabling the controller.
 
 **/
+STATIC
 EFI_STATUS
-NvmeControllerInit (
+NvmeInitAdminQueues (
   IN NVME_CONTROLLER_PRIVATE_DATA    *Private
   )
 {
@@ -805,31 +806,10 @@ NvmeControllerInit (
   NVME_AQA                        Aqa;
   NVME_ASQ                        Asq;
   NVME_ACQ                        Acq;
-  UINT8                           Sn[21];
-  UINT8                           Mn[41];
   UINT32                          NvmeHCBase;
 
-  //NVME PCI base address
   NvmeHCBase = Private->NvmeHCBase;
 
-  //
-  // Read the Controller Capabilities register and verify that the NVM command set is supported
-  //
-  Status = ReadNvmeControllerCapabilities (NvmeHCBase, &Private->Cap);
-  if (EFI_ERROR (Status)) {
-    return Status;
-  }
-
-  if (Private->Cap.Css != 0x01) {
-    DEBUG ((DEBUG_INFO, "NvmeControllerInit: the controller doesn't support NVMe command set\n"));
-    return EFI_UNSUPPORTED;
-  }
-
-  //
-  // Currently the driver only supports 4k page size.
-  //
-  ASSERT ((Private->Cap.Mpsmin + 12) <= EFI_PAGE_SHIFT);
-
   Private->Cid[0] = 0;
   Private->Cid[1] = 0;
   Private->Cid[2] = 0;
@@ -921,6 +901,54 @@ NvmeControllerInit (
     return Status;
   }
 
+  return EFI_SUCCESS;
+}
+
+/**
+  Initialize the Nvm Express controller.
+
+  @param[in] Private                 The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+  @retval EFI_SUCCESS                The NVM Express Controller is initialized successfully.
+  @retval Others                     A device error occurred while initializing the controller.
+
+**/
+EFI_STATUS
+NvmeControllerInit (
+  IN NVME_CONTROLLER_PRIVATE_DATA    *Private
+  )
+{
+  EFI_STATUS                      Status;
+  UINT8                           Sn[21];
+  UINT8                           Mn[41];
+  UINT32                          NvmeHCBase;
+
+  //NVME PCI base address
+  NvmeHCBase = Private->NvmeHCBase;
+
+  //
+  // Read the Controller Capabilities register and verify that the NVM command set is supported
+  //
+  Status = ReadNvmeControllerCapabilities (NvmeHCBase, &Private->Cap);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Private->Cap.Css != 0x01) {
+    DEBUG ((DEBUG_INFO, "NvmeControllerInit: the controller doesn't support NVMe command set\n"));
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Currently the driver only supports 4k page size.
+  //
+  ASSERT ((Private->Cap.Mpsmin + 12) <= EFI_PAGE_SHIFT);
+
+  Status = NvmeInitAdminQueues (Private);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
   //
   // Allocate buffer for Identify Controller data
   //
@@ -981,3 +1009,34 @@ NvmeControllerInit (
   return Status;
 }
 
+/**
+  Reset the Nvm Express controller and re-create its queues.
+
+  The identify controller data read by NvmeControllerInit is kept.
+
+  @param[in] Private                 The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+  @retval EFI_SUCCESS                The NVM Express Controller is ready again.
+  @retval Others                     A device error occurred while resetting the controller.
+
+**/
+EFI_STATUS
+NvmeControllerReset (
+  IN NVME_CONTROLLER_PRIVATE_DATA    *Private
+  )
+{
+  EFI_STATUS                      Status;
+
+  Status = NvmeInitAdminQueues (Private);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = NvmeCreateIoCompletionQueue (Private);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return NvmeCreateIoSubmissionQueue (Private);
+}
+
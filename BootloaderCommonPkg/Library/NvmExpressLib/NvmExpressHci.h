@@ -63,6 +63,22 @@ NvmeControllerInit (
   IN NVME_CONTROLLER_PRIVATE_DATA    *Private
   );
 
+/**
+  Reset the Nvm Express controller and re-create its queues.
+
+  The identify controller data read by NvmeControllerInit is kept.
+
+  @param[in] Private                 The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+  @retval EFI_SUCCESS                The NVM Express Controller is ready again.
+  @retval Others                     A device error occurred while resetting the controller.
+
+**/
+EFI_STATUS
+NvmeControllerReset (
+  IN NVME_CONTROLLER_PRIVATE_DATA    *Private
+  );
+
 /**
   Get identify controller data.
 
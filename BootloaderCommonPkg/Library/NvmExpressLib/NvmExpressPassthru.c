@@ -605,7 +605,7 @@ NvmExpressPassThru (
     AsyncRequest->Signature     = NVME_PASS_THRU_ASYNC_REQ_SIG;
     AsyncRequest->Packet        = Packet;
     AsyncRequest->CommandId     = Sq->Cid;
-    AsyncRequest->CallerEvent   = *Event;
+    AsyncRequest->CallerEvent   = Event;
     AsyncRequest->MapData       = MapData;
     AsyncRequest->MapMeta       = MapMeta;
     AsyncRequest->MapPrpList    = MapPrpList;
@@ -686,6 +686,155 @@ EXIT:
   return Status;
 }
 
+/**
+  Reap the completed commands from the asynchronous I/O completion queue.
+
+  All the completion entries posted so far are processed in one batch and the
+  completion queue head doorbell is rung once for the whole batch.
+
+  @param[in]  Private            The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[out] Completed          The number of completion entries processed. Optional.
+
+  @retval EFI_SUCCESS            The completion queue was processed.
+  @retval Others                 Failed to update the completion queue head doorbell.
+
+**/
+EFI_STATUS
+NvmeProcessAsyncCompletions (
+  IN  NVME_CONTROLLER_PRIVATE_DATA   *Private,
+  OUT UINT32                         *Completed OPTIONAL
+  )
+{
+  EFI_STATUS                     Status;
+  NVME_CQ                        *Cq;
+  LIST_ENTRY                     *Link;
+  NVME_PASS_THRU_ASYNC_REQ       *AsyncRequest;
+  NVME_BLKIO2_SUBTASK            *Subtask;
+  UINT16                         QueueId;
+  UINT16                         QueueSize;
+  UINT32                         Count;
+  UINT32                         Data;
+
+  QueueId   = 2;
+  QueueSize = MIN (NVME_ASYNC_CCQ_SIZE, Private->Cap.Mqes) + 1;
+  Count     = 0;
+  Status    = EFI_SUCCESS;
+
+  Cq = Private->CqBuffer[QueueId] + Private->CqHdbl[QueueId].Cqh;
+  while (Cq->Pt != Private->Pt[QueueId]) {
+    for (Link = GetFirstNode (&Private->AsyncPassThruQueue);
+         !IsNull (&Private->AsyncPassThruQueue, Link);
+         Link = GetNextNode (&Private->AsyncPassThruQueue, Link)) {
+      AsyncRequest = NVME_PASS_THRU_ASYNC_REQ_FROM_THIS (Link);
+      if (AsyncRequest->CommandId != Cq->Cid) {
+        continue;
+      }
+
+      if ((Cq->Sct != 0) || (Cq->Sc != 0)) {
+        DEBUG_CODE_BEGIN();
+        NvmeDumpStatus (Cq);
+        DEBUG_CODE_END();
+      }
+      CopyMem (AsyncRequest->Packet->NvmeCompletion, Cq, sizeof (EFI_NVM_EXPRESS_COMPLETION));
+
+      if (AsyncRequest->MapData != NULL) {
+        IoMmuUnmap (AsyncRequest->MapData);
+      }
+      if (AsyncRequest->MapMeta != NULL) {
+        IoMmuUnmap (AsyncRequest->MapMeta);
+      }
+      if (AsyncRequest->PrpListHost != NULL) {
+        IoMmuFreeBuffer (AsyncRequest->PrpListNo, AsyncRequest->PrpListHost, AsyncRequest->MapPrpList);
+      }
+
+      RemoveEntryList (Link);
+      if (AsyncRequest->CallerEvent != NULL) {
+        Subtask = NVME_BLKIO2_SUBTASK_FROM_EVENT (AsyncRequest->CallerEvent);
+        (*AsyncRequest->CallerEvent) (Subtask);
+      }
+      FreePool (AsyncRequest);
+      break;
+    }
+
+    //
+    // Free the submission queue entries consumed by the controller.
+    //
+    Private->AsyncSqHead = Cq->Sqhd;
+
+    if (++Private->CqHdbl[QueueId].Cqh == QueueSize) {
+      Private->CqHdbl[QueueId].Cqh = 0;
+      Private->Pt[QueueId] ^= 1;
+    }
+    Cq = Private->CqBuffer[QueueId] + Private->CqHdbl[QueueId].Cqh;
+    Count++;
+  }
+
+  if (Count > 0) {
+    Data   = ReadUnaligned32 ((UINT32 *)&Private->CqHdbl[QueueId]);
+    Status = NvmHcRwMmio (Private->NvmeHCBase, NVME_CQHDBL_OFFSET (QueueId, Private->Cap.Dstrd), FALSE, sizeof (Data),
+                          &Data);
+  }
+
+  if (Completed != NULL) {
+    *Completed = Count;
+  }
+
+  return Status;
+}
+
+/**
+  Abort all the commands still outstanding on the asynchronous I/O queue.
+
+  The controller is reset so that it stops any DMA for the outstanding
+  commands, and the pending requests are released without signaling the
+  caller events.
+
+  @param[in]  Private            The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+  @retval EFI_SUCCESS            The commands were aborted and the controller is ready again.
+  @retval Others                 Failed to reset the controller.
+
+**/
+EFI_STATUS
+NvmeAbortAsyncPassThru (
+  IN  NVME_CONTROLLER_PRIVATE_DATA   *Private
+  )
+{
+  EFI_STATUS                     Status;
+  LIST_ENTRY                     *Link;
+  NVME_PASS_THRU_ASYNC_REQ       *AsyncRequest;
+
+  //
+  // Disabling the controller aborts all the outstanding commands, so the
+  // buffers of the pending requests can be released after it.
+  //
+  Status = NvmeDisableController (Private);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  while (!IsListEmpty (&Private->AsyncPassThruQueue)) {
+    Link         = GetFirstNode (&Private->AsyncPassThruQueue);
+    AsyncRequest = NVME_PASS_THRU_ASYNC_REQ_FROM_THIS (Link);
+    if (AsyncRequest->MapData != NULL) {
+      IoMmuUnmap (AsyncRequest->MapData);
+    }
+    if (AsyncRequest->MapMeta != NULL) {
+      IoMmuUnmap (AsyncRequest->MapMeta);
+    }
+    if (AsyncRequest->PrpListHost != NULL) {
+      IoMmuFreeBuffer (AsyncRequest->PrpListNo, AsyncRequest->PrpListHost, AsyncRequest->MapPrpList);
+    }
+    RemoveEntryList (Link);
+    FreePool (AsyncRequest);
+  }
+
+  //
+  // Bring the controller and its I/O queues back up, the identify data is still valid
+  //
+  return NvmeControllerReset (Private);
+}
+
 /**
   Used to retrieve the next namespace ID for this NVM Express controller.
 
@@ -134,27 +134,23 @@ CalculateHash  (
 
 
 /**
-  Verify data block hash with the built-in one.
+  Verify a pre-calculated digest with the built-in one.
 
-  @param[in]  Data           Data buffer pointer.
-  @param[in]  Length         Data buffer size.
+  @param[in]  Digest         Calculated digest of the data.
   @param[in]  Usage          Hash usage.
-  @param[in]  ComponentType  Component type.
-  @param[in,out]  Hash       On input,  expected hash value when ComponentType is not used.
+  @param[in]  HashAlg        Specify hash algorithm.
+  @param[in,out]  HashData   On input,  expected hash value when Usage is not used.
                              On output, calculated hash value when verification succeeds.
 
   @retval RETURN_SUCCESS             Hash verification succeeded.
   @retval RETURN_INVALID_PARAMETER   Hash parameter is not valid.
-  @retval RETURN_NOT_FOUND           Hash data for ComponentType is not found.
-  @retval RETURN_UNSUPPORTED         Hash component type is not supported.
   @retval RETURN_SECURITY_VIOLATION  Hash verification failed.
 
 **/
 RETURN_STATUS
 EFIAPI
-DoHashVerify (
-  IN CONST UINT8           *Data,
-  IN       UINT32           Length,
+DoHashVerifyDigest (
+  IN CONST UINT8           *Digest,
   IN       HASH_COMP_USAGE  Usage,
   IN       UINT8            HashAlg,
   IN OUT   UINT8           *HashData
@@ -162,12 +158,9 @@ DoHashVerify (
 {
   RETURN_STATUS        Status;
   RETURN_STATUS        Status2;
-  UINT8                Digest[HASH_DIGEST_MAX];
   UINT8                DigestSize;
 
-
-  if ((Data == NULL) ||
-      ((HashAlg != HASH_TYPE_SHA256) && (HashAlg != HASH_TYPE_SHA384))) {
+  if (Digest == NULL) {
     return RETURN_INVALID_PARAMETER;
   }
 
@@ -183,11 +176,6 @@ DoHashVerify (
     return RETURN_INVALID_PARAMETER;
   }
 
-  Status = CalculateHash (Data, Length, HashAlg, Digest);
-  if (EFI_ERROR(Status)) {
-    return RETURN_UNSUPPORTED;
-  }
-
   Status = RETURN_SECURITY_VIOLATION;
   if (Usage == 0) {
     // Compare hash with the buffer passed in
@@ -196,7 +184,7 @@ DoHashVerify (
     }
   } else {
     // Compare hash with the the one stored in hash store
-    Status2 = MatchHashInStore (Usage, HashAlg, Digest);
+    Status2 = MatchHashInStore (Usage, HashAlg, (UINT8 *)Digest);
     if (!EFI_ERROR(Status2)) {
       if (HashData != NULL) {
         CopyMem (HashData, Digest, DigestSize);
@@ -209,12 +197,6 @@ DoHashVerify (
   if (EFI_ERROR(Status)) {
     DEBUG_CODE_BEGIN();
 
-    DEBUG ((DEBUG_INFO, "First %d Bytes Input Data\n", DigestSize));
-    DumpHex (2, 0, DigestSize, (VOID *)Data);
-
-    DEBUG ((DEBUG_INFO, "Last %d Bytes Input Data\n", DigestSize));
-    DumpHex (2, 0, DigestSize, (VOID *) (Data + Length - DigestSize));
-
     DEBUG ((DEBUG_INFO, "Image Digest\n"));
     DumpHex (2, 0, DigestSize, (VOID *)Digest);
 
@@ -226,3 +208,71 @@ DoHashVerify (
 
   return Status;
 }
+
+/**
+  Verify data block hash with the built-in one.
+
+  @param[in]  Data           Data buffer pointer.
+  @param[in]  Length         Data buffer size.
+  @param[in]  Usage          Hash usage.
+  @param[in]  ComponentType  Component type.
+  @param[in,out]  Hash       On input,  expected hash value when ComponentType is not used.
+                             On output, calculated hash value when verification succeeds.
+
+  @retval RETURN_SUCCESS             Hash verification succeeded.
+  @retval RETURN_INVALID_PARAMETER   Hash parameter is not valid.
+  @retval RETURN_NOT_FOUND           Hash data for ComponentType is not found.
+  @retval RETURN_UNSUPPORTED         Hash component type is not supported.
+  @retval RETURN_SECURITY_VIOLATION  Hash verification failed.
+
+**/
+RETURN_STATUS
+EFIAPI
+DoHashVerify (
+  IN CONST UINT8           *Data,
+  IN       UINT32           Length,
+  IN       HASH_COMP_USAGE  Usage,
+  IN       UINT8            HashAlg,
+  IN OUT   UINT8           *HashData
+  )
+{
+  RETURN_STATUS        Status;
+  UINT8                Digest[HASH_DIGEST_MAX];
+  UINT8                DigestSize;
+
+
+  if ((Data == NULL) ||
+      ((HashAlg != HASH_TYPE_SHA256) && (HashAlg != HASH_TYPE_SHA384))) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  if ((Usage == 0) && (HashData == NULL)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  if (HashAlg == HASH_TYPE_SHA256) {
+    DigestSize = SHA256_DIGEST_SIZE;
+  } else {
+    DigestSize = SHA384_DIGEST_SIZE;
+  }
+
+  Status = CalculateHash (Data, Length, HashAlg, Digest);
+  if (EFI_ERROR(Status)) {
+    return RETURN_UNSUPPORTED;
+  }
+
+  Status = DoHashVerifyDigest (Digest, Usage, HashAlg, HashData);
+  if (EFI_ERROR(Status)) {
+    DEBUG_CODE_BEGIN();
+
+    DEBUG ((DEBUG_INFO, "First %d Bytes Input Data\n", DigestSize));
+    DumpHex (2, 0, DigestSize, (VOID *)Data);
+
+    DEBUG ((DEBUG_INFO, "Last %d Bytes Input Data\n", DigestSize));
+    DumpHex (2, 0, DigestSize, (VOID *) (Data + Length - DigestSize));
+
+    DEBUG_CODE_END();
+  }
+
+  return Status;
+}
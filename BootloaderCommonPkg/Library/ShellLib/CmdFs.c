@@ -253,6 +253,7 @@ CmdFsInfo (
   UINT32                HwPartNo;
   UINT32                SwPartNo;
   OS_FILE_SYSTEM_TYPE   FsType;
+  FS_CACHE_STATS        CacheStats;
 
   ShellPrint (L"Current DeviceType: %a\n", (mDeviceType != OsBootDeviceMax) ?
     GetBootDeviceNameString (mDeviceType) : "Not Initialized");
@@ -279,6 +280,12 @@ CmdFsInfo (
   ShellPrint (L"Current FileSystem: %a\n", (FsType != EnumFileSystemMax) ?
     GetFsTypeString (FsType) : "Not Detected");
 
+  Status = GetFileSystemCacheStats (mFsHandle, &CacheStats);
+  if (!EFI_ERROR (Status)) {
+    ShellPrint (L"Metadata Cache: %d x %d bytes, %d hits, %d misses\n",
+      CacheStats.CacheBlocks, CacheStats.BlockSize, CacheStats.Hits, CacheStats.Misses);
+  }
+
   return EFI_SUCCESS;
 }
 
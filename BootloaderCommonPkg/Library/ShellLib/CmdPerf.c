@@ -1,7 +1,7 @@
 /** @file
   Shell command `perf` to display system performance data.
 
-  Copyright (c) 2017, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2017 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -10,6 +10,10 @@
 #include <Library/DebugLib.h>
 #include <Guid/PerformanceInfoGuid.h>
 #include <Library/HobLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/BootloaderCommonLib.h>
+#include <Library/LoaderPerformanceLib.h>
 
 /**
   Display performance data.
@@ -67,6 +71,138 @@ PrintPerformanceInfo (
   ShellPrint (L"------+------------+------------\n");
 }
 
+/**
+  Get the throughput in MB/s.
+
+  @param[in]  Size        Data size in bytes.
+  @param[in]  TimeUs      Time in microseconds.
+
+  @retval     The throughput in MB/s, or 0 if the time is too short to tell.
+
+**/
+STATIC
+UINT32
+GetThroughput (
+  IN UINT32   Size,
+  IN UINT32   TimeUs
+  )
+{
+  // One byte per microsecond is one MB/s
+  return (TimeUs == 0) ? 0 : Size / TimeUs;
+}
+
+/**
+  Print the component load profile.
+
+  The time spent in each load phase is in microseconds. The copy and hash
+  throughput is based on the signed component size while the decompression
+  throughput is based on the decompressed size.
+
+  @param[in]  Profile     pointer to component load profile
+
+**/
+STATIC
+VOID
+EFIAPI
+PrintComponentProfile (
+  IN COMPONENT_PROFILE *Profile
+  )
+{
+  COMPONENT_PROFILE_ENTRY  *Entry;
+  UINT32                    Idx;
+  UINT32                   *Time;
+  CHAR8                     Name[10];
+  CHAR8                     Alg[5];
+
+  ShellPrint (L" Component |  Alg | Auth |  Size (KB)  | Locate |   Copy  MB/s |   Hash  MB/s | Verify | Decomp  MB/s\n");
+  ShellPrint (L"-----------+------+------+-------------+--------+--------------+--------------+--------+-------------\n");
+  for (Idx = 0; Idx < Profile->Count; Idx++) {
+    Entry = &Profile->Entry[Idx];
+    Time  = Entry->PhaseTime;
+    if (Entry->ContainerSig == 0) {
+      CopyMem (Name, &Entry->ComponentName, sizeof (UINT32));
+      Name[4] = 0;
+    } else {
+      CopyMem (Name, &Entry->ContainerSig, sizeof (UINT32));
+      Name[4] = '/';
+      CopyMem (&Name[5], &Entry->ComponentName, sizeof (UINT32));
+      Name[9] = 0;
+    }
+    CopyMem (Alg, &Entry->CompressAlg, sizeof (UINT32));
+    Alg[4] = 0;
+
+    ShellPrint (L" %-9a | %4a | %4d | %5d %5d | %6d | %6d %5d | %6d %5d | %6d | %6d %5d %a\n",
+                Name, Alg, Entry->AuthType, Entry->CompressedSize >> 10, Entry->DecompressedSize >> 10,
+                Time[COMPONENT_PHASE_LOCATE],
+                Time[COMPONENT_PHASE_COPY], GetThroughput (Entry->CompressedSize, Time[COMPONENT_PHASE_COPY]),
+                Time[COMPONENT_PHASE_HASH], GetThroughput (Entry->CompressedSize, Time[COMPONENT_PHASE_HASH]),
+                Time[COMPONENT_PHASE_VERIFY],
+                Time[COMPONENT_PHASE_DECOMPRESS], GetThroughput (Entry->DecompressedSize, Time[COMPONENT_PHASE_DECOMPRESS]),
+                ((Entry->Flags & COMPONENT_PROFILE_FLAG_FAILED) != 0) ? "failed" : "");
+  }
+  ShellPrint (L"-----------+------+------+-------------+--------+--------------+--------------+--------+-------------\n");
+  ShellPrint (L"Times are in us. Copy and hash are merged for streamed components.\n");
+}
+
+/**
+  Print the boot timeline in JSON format.
+
+  The output can be captured from the console and compared between boots
+  with the host side timeline tool.
+
+  @retval EFI_SUCCESS            The timeline was printed.
+  @retval EFI_NOT_FOUND          No measure points are available.
+  @retval EFI_OUT_OF_RESOURCES   Not enough memory to build the timeline.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+PrintPerfTimeline (
+  VOID
+  )
+{
+  STATIC CONST CHAR16  *SpanTypeStr[] = { L"stage", L"step", L"fsp" };
+  BL_PERF_DATA         *PerfData;
+  PERF_TIMELINE        *Timeline;
+  PERF_TIMELINE_SPAN   *Span;
+  EFI_STATUS            Status;
+  UINT32                Size;
+  UINT32                Idx;
+
+  PerfData = GetPerfDataPtr ();
+  if ((PerfData == NULL) || (PerfData->PerfIndex == 0)) {
+    return EFI_NOT_FOUND;
+  }
+
+  Size   = 0;
+  Status = BuildPerfTimeline (PerfData, NULL, &Size);
+  if (Status != EFI_BUFFER_TOO_SMALL) {
+    return Status;
+  }
+
+  Timeline = (PERF_TIMELINE *)AllocatePool (Size);
+  if (Timeline == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = BuildPerfTimeline (PerfData, Timeline, &Size);
+  if (!EFI_ERROR (Status)) {
+    ShellPrint (L"{\"timeline\": {\"revision\": %d, \"spans\": [\n", Timeline->Revision);
+    for (Idx = 0; Idx < Timeline->Count; Idx++) {
+      Span = &Timeline->Span[Idx];
+      ShellPrint (L"  {\"id\": %d, \"type\": \"%s\", \"depth\": %d, \"start_ns\": %ld, \"end_ns\": %ld}%s\n",
+                  Span->Id, (Span->Type < ARRAY_SIZE (SpanTypeStr)) ? SpanTypeStr[Span->Type] : L"unknown",
+                  Span->Depth, Span->StartNs, Span->EndNs, (Idx + 1 < Timeline->Count) ? L"," : L"");
+    }
+    ShellPrint (L"]}}\n");
+  }
+
+  FreePool (Timeline);
+
+  return Status;
+}
+
 /**
   Display performance data.
 
@@ -86,8 +222,39 @@ ShellCommandPerfFunc (
   IN CHAR16 *Argv[]
   )
 {
-  VOID             *GuidHob;
-  PERFORMANCE_INFO *PerfData;
+  VOID              *GuidHob;
+  PERFORMANCE_INFO  *PerfData;
+  COMPONENT_PROFILE *Profile;
+  EFI_STATUS         Status;
+  BOOLEAN            ProfileOnly;
+
+  ProfileOnly = FALSE;
+  if (Argc > 1) {
+    if ((Argc == 2) && (StrCmp (Argv[1], L"-j") == 0)) {
+      Status = PrintPerfTimeline ();
+      if (EFI_ERROR (Status)) {
+        ShellPrint (L"Failed to build performance timeline: %r\n", Status);
+      }
+      return Status;
+    } else if ((Argc == 2) && (StrCmp (Argv[1], L"-c") == 0)) {
+      ProfileOnly = TRUE;
+    } else {
+      ShellPrint (L"Usage: %s [-j | -c]\n", Argv[0]);
+      ShellPrint (L"  -j    Print the boot timeline in JSON format\n");
+      ShellPrint (L"  -c    Print the component load profile only\n");
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  Profile = (COMPONENT_PROFILE *)GetComponentProfilePtr ();
+  if (ProfileOnly) {
+    if ((Profile == NULL) || (Profile->Count == 0)) {
+      ShellPrint (L"No component load profile available\n");
+      return EFI_NOT_FOUND;
+    }
+    PrintComponentProfile (Profile);
+    return EFI_SUCCESS;
+  }
 
   GuidHob = GetNextGuidHob (&gLoaderPerformanceInfoGuid, GetHobList());
   if (GuidHob == NULL) {
@@ -101,5 +268,11 @@ ShellCommandPerfFunc (
   ShellPrint (L"=======================\n\n");
   PrintPerformanceInfo (PerfData);
 
+  if ((Profile != NULL) && (Profile->Count > 0)) {
+    ShellPrint (L"\nComponent Load Profile\n");
+    ShellPrint (L"======================\n\n");
+    PrintComponentProfile (Profile);
+  }
+
   return EFI_SUCCESS;
 }
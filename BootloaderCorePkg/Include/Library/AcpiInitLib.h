@@ -90,4 +90,19 @@ UpdateFpdtS3Table (
   IN  UINT32                   AcpiTableBase
   );
 
+/**
+  Append the boot timeline to the ACPI FPDT boot performance record table.
+
+  @param[in] AcpiTableBase     ACPI base address
+
+  @retval EFI_SUCCESS          The timeline was appended successfully.
+  @retval EFI_NOT_FOUND        The FPDT table could not be found.
+  @retval Others               Failed to build the timeline.
+ **/
+EFI_STATUS
+EFIAPI
+UpdateFpdtBootTimeline (
+  IN  UINT32                   AcpiTableBase
+  );
+
 #endif
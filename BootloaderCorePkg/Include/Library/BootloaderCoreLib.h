@@ -210,9 +210,15 @@ typedef struct {
   VOID             *S3DataPtr;
   VOID             *DebugDataPtr;
   VOID             *DmaBufferPtr;
+  VOID             *ComponentProfile;
   UINT8             PlatformName[PLATFORM_NAME_SIZE];
   UINT32            LdrFeatures;
   BL_PERF_DATA      PerfData;
+  UINT32            MemPoolFreeList;
+  UINT32            MemPoolFreeSize;
+  UINT32            MemPoolFreeCount;
+  UINT32            MemPoolMinTop;
+  UINT32            MemPoolPageList;
 } LOADER_GLOBAL_DATA;
 
 /**
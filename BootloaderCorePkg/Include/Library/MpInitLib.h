@@ -37,6 +37,9 @@ typedef struct {
   UINT32           CProcedure;
   UINT32           Argument;
   UINT32           Result;
+  UINT32           TaskCount;
+  UINT32           Reserved;
+  UINT64           BusyTicks;
 } CPU_TASK;
 
 typedef struct {
@@ -118,6 +121,43 @@ MpRunTask (
   );
 
 
+/**
+  Run a task function on the first idle application processor.
+
+  @param[in]  TaskProc    Task function pointer
+  @param[in]  Argument    Argument for the task function
+  @param[out] Index       Pointer to receive the CPU index running the task
+
+  @retval EFI_INVALID_PARAMETER   TaskProc or Index is NULL.
+  @retval EFI_NOT_READY           No application processor is available now.
+  @retval EFI_SUCCESS             An application processor accepted the new task.
+
+**/
+EFI_STATUS
+EFIAPI
+MpRunTaskOnIdleAp (
+  IN  CPU_TASK_PROC  TaskProc,
+  IN  UINT32         Argument,
+  OUT UINT32        *Index
+  );
+
+/**
+  Wait until the task running on a specific processor completes.
+
+  @param[in]  Index       CPU index returned by MpRunTask or MpRunTaskOnIdleAp
+  @param[out] Result      Pointer to receive the task function return value
+
+  @retval EFI_INVALID_PARAMETER   Invalid Index parameter.
+  @retval EFI_SUCCESS             The task has completed.
+
+**/
+EFI_STATUS
+EFIAPI
+MpWaitTask (
+  IN  UINT32         Index,
+  OUT UINT32        *Result  OPTIONAL
+  );
+
 /**
   Dump MP task state
 
@@ -12,6 +12,8 @@
 #include <Library/BootloaderCoreLib.h>
 #include <Library/AcpiInitLib.h>
 #include <Library/TimeStampLib.h>
+#include <Library/LoaderPerformanceLib.h>
+#include <Library/BlMemoryAllocationLib.h>
 
 BOOT_PERFORMANCE_TABLE mBootPerformanceTableTemplate = {
   {
@@ -86,14 +88,15 @@ UpdateFpdtBootTable (
 
 
 /**
-  Get FPDT S3 performance table by searching ACPI table
+  Get FPDT table by searching ACPI table
 
   @param[in]  AcpiTableBase    ACPI table base address
 
-  @retval S3 performance table address     Value 0 means not found.
+  @retval FPDT table address     NULL means not found.
 **/
-UINTN
-GetFpdtS3Table (
+STATIC
+FIRMWARE_PERFORMANCE_TABLE *
+GetFpdtTable (
   IN  UINT32                                   AcpiTableBase
   )
 {
@@ -102,9 +105,11 @@ GetFpdtS3Table (
   EFI_ACPI_COMMON_HEADER                       *Hdr;
   UINT32                                       *RsdtEntry;
   UINT32                                       NumEntries;
-  FIRMWARE_PERFORMANCE_TABLE                   *Fpdt;
   UINT8                                        Index;
-  BOOT_PERFORMANCE_TABLE                       *BootTable;
+
+  if (AcpiTableBase == 0) {
+    return NULL;
+  }
 
   Rsdp = (EFI_ACPI_5_0_ROOT_SYSTEM_DESCRIPTION_POINTER *)(UINTN)AcpiTableBase;
   Rsdt = (EFI_ACPI_DESCRIPTION_HEADER *)(UINTN)Rsdp->RsdtAddress;
@@ -114,19 +119,100 @@ GetFpdtS3Table (
   for (Index = 0; Index < NumEntries; Index++) {
     Hdr = (EFI_ACPI_COMMON_HEADER *) (UINTN) RsdtEntry[Index];
     if (Hdr->Signature == EFI_ACPI_5_0_FIRMWARE_PERFORMANCE_DATA_TABLE_SIGNATURE) {
-      Fpdt = (FIRMWARE_PERFORMANCE_TABLE *) Hdr;
-      BootTable = (BOOT_PERFORMANCE_TABLE *)(UINTN)Fpdt->BootPointerRecord.BootPerformanceTablePointer;
-      DEBUG ((DEBUG_VERBOSE, "FPDT: ResetEnd                = %ld\n", BootTable->BasicBoot.ResetEnd));
-      DEBUG ((DEBUG_VERBOSE, "FPDT: OsLoaderLoadImageStart  = %ld\n", BootTable->BasicBoot.OsLoaderLoadImageStart));
-      DEBUG ((DEBUG_VERBOSE, "FPDT: OsLoaderStartImageStart = %ld\n", BootTable->BasicBoot.OsLoaderStartImageStart));
-      DEBUG ((DEBUG_VERBOSE, "FPDT: ExitBootServicesEntry   = %ld\n", BootTable->BasicBoot.ExitBootServicesEntry));
-      DEBUG ((DEBUG_VERBOSE, "FPDT: ExitBootServicesExit    = %ld\n", BootTable->BasicBoot.ExitBootServicesExit));
-
-      return (UINTN)Fpdt->S3PointerRecord.S3PerformanceTablePointer;
+      return (FIRMWARE_PERFORMANCE_TABLE *) Hdr;
+    }
+  }
+
+  return NULL;
+}
+
+
+/**
+  Get FPDT S3 performance table by searching ACPI table
+
+  @param[in]  AcpiTableBase    ACPI table base address
+
+  @retval S3 performance table address     Value 0 means not found.
+**/
+UINTN
+GetFpdtS3Table (
+  IN  UINT32                                   AcpiTableBase
+  )
+{
+  FIRMWARE_PERFORMANCE_TABLE                   *Fpdt;
+  BOOT_PERFORMANCE_TABLE                       *BootTable;
+
+  Fpdt = GetFpdtTable (AcpiTableBase);
+  if (Fpdt == NULL) {
+    return 0;
+  }
+
+  BootTable = (BOOT_PERFORMANCE_TABLE *)(UINTN)Fpdt->BootPointerRecord.BootPerformanceTablePointer;
+  DEBUG ((DEBUG_VERBOSE, "FPDT: ResetEnd                = %ld\n", BootTable->BasicBoot.ResetEnd));
+  DEBUG ((DEBUG_VERBOSE, "FPDT: OsLoaderLoadImageStart  = %ld\n", BootTable->BasicBoot.OsLoaderLoadImageStart));
+  DEBUG ((DEBUG_VERBOSE, "FPDT: OsLoaderStartImageStart = %ld\n", BootTable->BasicBoot.OsLoaderStartImageStart));
+  DEBUG ((DEBUG_VERBOSE, "FPDT: ExitBootServicesEntry   = %ld\n", BootTable->BasicBoot.ExitBootServicesEntry));
+  DEBUG ((DEBUG_VERBOSE, "FPDT: ExitBootServicesExit    = %ld\n", BootTable->BasicBoot.ExitBootServicesExit));
+
+  return (UINTN)Fpdt->S3PointerRecord.S3PerformanceTablePointer;
+}
+
+
+/**
+  Append the boot timeline to the ACPI FPDT boot performance record table.
+
+  Each timeline span is exported as one vendor specific performance record
+  following the basic boot record, so that the OS can retrieve the bootloader
+  timeline from the FPDT.
+
+  @param[in] AcpiTableBase     ACPI base address
+
+  @retval EFI_SUCCESS          The timeline was appended successfully.
+  @retval EFI_NOT_FOUND        The FPDT table could not be found.
+  @retval Others               Failed to build the timeline.
+ **/
+EFI_STATUS
+EFIAPI
+UpdateFpdtBootTimeline (
+  IN  UINT32                          AcpiTableBase
+  )
+{
+  FIRMWARE_PERFORMANCE_TABLE          *Fpdt;
+  BOOT_PERFORMANCE_TABLE              *BootPerfTable;
+  PERF_TIMELINE_FPDT_RECORD           *Record;
+  PERF_TIMELINE                       *Timeline;
+  EFI_STATUS                          Status;
+  UINT32                              Size;
+  UINT32                              Index;
+
+  Fpdt = GetFpdtTable (AcpiTableBase);
+  if (Fpdt == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  Size     = sizeof (PERF_TIMELINE) + PERF_TIMELINE_MAX_SPANS * sizeof (PERF_TIMELINE_SPAN);
+  Timeline = (PERF_TIMELINE *)AllocateTemporaryMemory (Size);
+  if (Timeline == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = BuildPerfTimeline (GetPerfDataPtr (), Timeline, &Size);
+  if (!EFI_ERROR (Status)) {
+    BootPerfTable = (BOOT_PERFORMANCE_TABLE *)(UINTN)Fpdt->BootPointerRecord.BootPerformanceTablePointer;
+    Record        = (PERF_TIMELINE_FPDT_RECORD *)(BootPerfTable + 1);
+    for (Index = 0; Index < Timeline->Count; Index++) {
+      Record[Index].Type     = PERF_TIMELINE_FPDT_RECORD_TYPE;
+      Record[Index].Length   = sizeof (PERF_TIMELINE_FPDT_RECORD);
+      Record[Index].Revision = PERF_TIMELINE_FPDT_RECORD_REVISION;
+      CopyMem (&Record[Index].Span, &Timeline->Span[Index], sizeof (PERF_TIMELINE_SPAN));
     }
+    BootPerfTable->Header.Length = sizeof (BOOT_PERFORMANCE_TABLE) + Index * sizeof (PERF_TIMELINE_FPDT_RECORD);
+    DEBUG ((DEBUG_VERBOSE, "FPDT: %d timeline records added\n", Index));
   }
 
-  return 0;
+  FreeTemporaryMemory (Timeline);
+
+  return Status;
 }
 
 
@@ -208,7 +294,11 @@ UpdateFpdt (
   if (BootMode != BOOT_ON_S3_RESUME) {
     Fpdt          = (FIRMWARE_PERFORMANCE_TABLE *)Table;
     BootPerfTable = (BOOT_PERFORMANCE_TABLE *) (Fpdt + 1);
-    S3PerfTable   = (S3_PERFORMANCE_TABLE *) (BootPerfTable + 1);
+    //
+    // Reserve room for the boot timeline records after the basic boot record.
+    //
+    S3PerfTable   = (S3_PERFORMANCE_TABLE *) ((UINT8 *) (BootPerfTable + 1) +
+                      PERF_TIMELINE_MAX_SPANS * sizeof (PERF_TIMELINE_FPDT_RECORD));
 
     Fpdt->BootPointerRecord.BootPerformanceTablePointer = (UINT64) (UINTN) BootPerfTable;
     Fpdt->S3PointerRecord.S3PerformanceTablePointer     = (UINT64) (UINTN) S3PerfTable;
@@ -1,6 +1,6 @@
 /** @file
 
-  Copyright (c) 2016 - 2019, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2016 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -235,6 +235,36 @@ GetHashStorePtr (
   return GetLoaderGlobalDataPointer()->HashStorePtr;
 }
 
+/**
+  This function retrieves component load profile pointer.
+
+  @retval    The component load profile pointer.
+
+**/
+VOID *
+EFIAPI
+GetComponentProfilePtr (
+  VOID
+  )
+{
+  return GetLoaderGlobalDataPointer()->ComponentProfile;
+}
+
+/**
+  This function sets component load profile pointer.
+
+  @param ComponentProfile   The pointer to component load profile.
+
+**/
+VOID
+EFIAPI
+SetComponentProfilePtr (
+  IN VOID         *ComponentProfile
+  )
+{
+  GetLoaderGlobalDataPointer()->ComponentProfile = ComponentProfile;
+}
+
 /**
   This function retrieves features configuration.
 
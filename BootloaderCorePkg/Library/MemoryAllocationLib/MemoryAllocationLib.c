@@ -2,7 +2,7 @@
   Support routines for memory allocation routines
   based on PeiService for PEI phase drivers.
 
-  Copyright (c) 2006 - 2015, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2006 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -10,11 +10,70 @@
 
 #include <PiPei.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/BootloaderCoreLib.h>
+#include <Library/LocalApic.h>
 
 #define   POOL_MIN_ALIGNMENT    0x10
+#define   POOL_HEAD_SIGNATURE   SIGNATURE_32 ('P', 'H', 'D', '0')
+#define   FREE_BLOCK_SIGNATURE  SIGNATURE_32 ('F', 'B', 'L', 'K')
+#define   PAGE_RANGE_SIGNATURE  SIGNATURE_32 ('P', 'G', 'R', 'G')
+
+//
+// Header in front of every pool allocation so that FreePool knows its size.
+// Its size keeps the POOL_MIN_ALIGNMENT of the returned buffer.
+//
+typedef struct {
+  UINT32    Signature;
+  UINT32    Size;
+  UINT32    Reserved[2];
+} POOL_HEADER;
+
+//
+// Free block in the permanent memory pool. The free list is kept in address
+// order so that the adjacent free blocks can be coalesced.
+//
+typedef struct {
+  UINT32    Signature;
+  UINT32    Size;
+  UINT32    Next;
+  UINT32    Reserved;
+} FREE_BLOCK;
+
+//
+// Range of pages allocated from the permanent memory pool. Page allocations
+// have no room for a header, so their ranges are tracked in a list of pool
+// allocations to validate FreePages.
+//
+typedef struct {
+  UINT32    Signature;
+  UINT32    Base;
+  UINT32    Size;
+  UINT32    Next;
+} PAGE_RANGE;
+
+/**
+  Check if the current processor is the BSP.
+
+  The free list is not protected by any lock, so the memory pool must only
+  be used on the BSP. Tasks running on APs must not allocate or free memory.
+
+  @retval TRUE    The current processor is the BSP.
+  @retval FALSE   The current processor is an AP.
+ **/
+STATIC
+BOOLEAN
+InternalIsBsp (
+  VOID
+  )
+{
+  MSR_IA32_APIC_BASE  ApicBaseMsr;
+
+  ApicBaseMsr.Uint64 = AsmReadMsr64 (MSR_IA32_APIC_BASE_ADDRESS);
+  return (BOOLEAN)(ApicBaseMsr.Bits.Bsp != 0);
+}
 
 /**
   Update the Memory pool top address.
@@ -31,6 +90,9 @@ InternalUpdateMemPoolTop (
   LdrGlobal = GetLoaderGlobalDataPointer();
   ASSERT (Top >= LdrGlobal->MemPoolCurrBottom);
   LdrGlobal->MemPoolCurrTop = Top;
+  if (Top < LdrGlobal->MemPoolMinTop) {
+    LdrGlobal->MemPoolMinTop = Top;
+  }
 }
 
 /**
@@ -50,13 +112,310 @@ InternalUpdateMemPoolBottom (
   LdrGlobal->MemPoolCurrBottom = Bottom;
 }
 
+/**
+  Return a memory block to the permanent memory pool.
+
+  The block is merged back into the unallocated region if it is right above
+  the pool top, otherwise it is inserted into the free list and coalesced
+  with its neighbours.
+
+  @param [in] Base    Base address of the block.
+  @param [in] Size    Size of the block.
+ **/
+STATIC
+VOID
+InternalFreeBlock (
+  IN UINT32  Base,
+  IN UINT32  Size
+  )
+{
+  LOADER_GLOBAL_DATA  *LdrGlobal;
+  FREE_BLOCK          *Block;
+  FREE_BLOCK          *PrevBlock;
+  UINT32               Prev;
+  UINT32               Next;
+  UINT32               Top;
+
+  ASSERT (InternalIsBsp ());
+
+  if (Size == 0) {
+    return;
+  }
+
+  LdrGlobal = GetLoaderGlobalDataPointer();
+  if (Base == LdrGlobal->MemPoolCurrTop) {
+    Top = Base + Size;
+    while (LdrGlobal->MemPoolFreeList == Top) {
+      Block = (FREE_BLOCK *)(UINTN)Top;
+      LdrGlobal->MemPoolFreeList  = Block->Next;
+      LdrGlobal->MemPoolFreeSize -= Block->Size;
+      LdrGlobal->MemPoolFreeCount--;
+      Top += Block->Size;
+    }
+    LdrGlobal->MemPoolCurrTop = Top;
+    return;
+  }
+
+  if (Size < sizeof (FREE_BLOCK)) {
+    // Too small to be tracked
+    return;
+  }
+
+  Prev = 0;
+  Next = LdrGlobal->MemPoolFreeList;
+  while ((Next != 0) && (Next < Base)) {
+    Prev = Next;
+    Next = ((FREE_BLOCK *)(UINTN)Next)->Next;
+  }
+  PrevBlock = (FREE_BLOCK *)(UINTN)Prev;
+
+  if ((Base < LdrGlobal->MemPoolCurrTop) || (Base + Size > LdrGlobal->MemPoolEnd) ||
+      ((Next != 0) && (Base + Size > Next)) || ((Prev != 0) && (Prev + PrevBlock->Size > Base))) {
+    DEBUG ((DEBUG_ERROR, "Invalid memory free 0x%08X:0x%X\n", Base, Size));
+    ASSERT (FALSE);
+    return;
+  }
+
+  LdrGlobal->MemPoolFreeSize += Size;
+  LdrGlobal->MemPoolFreeCount++;
+
+  if ((Next != 0) && (Base + Size == Next)) {
+    Block = (FREE_BLOCK *)(UINTN)Next;
+    Size += Block->Size;
+    Next  = Block->Next;
+    LdrGlobal->MemPoolFreeCount--;
+  }
+
+  if ((Prev != 0) && (Prev + PrevBlock->Size == Base)) {
+    PrevBlock->Size += Size;
+    PrevBlock->Next  = Next;
+    LdrGlobal->MemPoolFreeCount--;
+    return;
+  }
+
+  Block = (FREE_BLOCK *)(UINTN)Base;
+  Block->Signature = FREE_BLOCK_SIGNATURE;
+  Block->Size      = Size;
+  Block->Next      = Next;
+  if (Prev == 0) {
+    LdrGlobal->MemPoolFreeList = Base;
+  } else {
+    PrevBlock->Next = Base;
+  }
+}
+
+/**
+  Allocate a memory block from the free list of the permanent memory pool.
+
+  The best fitting free block is used, and the allocation is placed at its
+  top end. The remaining parts are returned to the free list.
+
+  @param [in] Size        Size of the block.
+  @param [in] Alignment   Alignment of the block, must be a power of 2.
+
+  @retval     Base address of the allocated block, or 0 if no free block fits.
+ **/
+STATIC
+UINT32
+InternalAllocateFreeBlock (
+  IN UINT32  Size,
+  IN UINT32  Alignment
+  )
+{
+  LOADER_GLOBAL_DATA  *LdrGlobal;
+  FREE_BLOCK          *Block;
+  UINT32               Prev;
+  UINT32               Curr;
+  UINT32               Best;
+  UINT32               BestPrev;
+  UINT32               BestSize;
+  UINT32               Start;
+  UINT32               End;
+
+  ASSERT (InternalIsBsp ());
+
+  LdrGlobal = GetLoaderGlobalDataPointer();
+  Best      = 0;
+  BestPrev  = 0;
+  BestSize  = MAX_UINT32;
+  Prev      = 0;
+  Curr      = LdrGlobal->MemPoolFreeList;
+  while (Curr != 0) {
+    Block = (FREE_BLOCK *)(UINTN)Curr;
+    if ((Block->Size >= Size) && (Block->Size < BestSize)) {
+      Start = ALIGN_DOWN (Curr + Block->Size - Size, Alignment);
+      if (Start >= Curr) {
+        Best     = Curr;
+        BestPrev = Prev;
+        BestSize = Block->Size;
+      }
+    }
+    Prev = Curr;
+    Curr = Block->Next;
+  }
+
+  if (Best == 0) {
+    return 0;
+  }
+
+  Block = (FREE_BLOCK *)(UINTN)Best;
+  if (BestPrev == 0) {
+    LdrGlobal->MemPoolFreeList = Block->Next;
+  } else {
+    ((FREE_BLOCK *)(UINTN)BestPrev)->Next = Block->Next;
+  }
+  LdrGlobal->MemPoolFreeSize -= BestSize;
+  LdrGlobal->MemPoolFreeCount--;
+
+  End   = Best + BestSize;
+  Start = ALIGN_DOWN (End - Size, Alignment);
+  InternalFreeBlock (Best, Start - Best);
+  InternalFreeBlock (Start + Size, End - Start - Size);
+
+  return Start;
+}
+
+/**
+  Record a range of allocated pages.
+
+  @param [in] Prev    The range to insert the new range after, 0 to insert it first.
+  @param [in] Base    Base address of the pages.
+  @param [in] Size    Size of the pages.
+ **/
+STATIC
+VOID
+InternalAddPageRange (
+  IN UINT32  Prev,
+  IN UINT32  Base,
+  IN UINT32  Size
+  )
+{
+  LOADER_GLOBAL_DATA  *LdrGlobal;
+  PAGE_RANGE          *Range;
+
+  Range = AllocatePool (sizeof (PAGE_RANGE));
+  Range->Signature = PAGE_RANGE_SIGNATURE;
+  Range->Base      = Base;
+  Range->Size      = Size;
+
+  LdrGlobal = GetLoaderGlobalDataPointer();
+  if (Prev == 0) {
+    Range->Next = LdrGlobal->MemPoolPageList;
+    LdrGlobal->MemPoolPageList = (UINT32)(UINTN)Range;
+  } else {
+    Range->Next = ((PAGE_RANGE *)(UINTN)Prev)->Next;
+    ((PAGE_RANGE *)(UINTN)Prev)->Next = (UINT32)(UINTN)Range;
+  }
+}
+
+/**
+  Remove pages from the allocated page ranges.
+
+  The pages must be part of a single allocated range. Freeing the head, the
+  tail or the middle of a range is allowed, the rest stays allocated.
+
+  @param [in] Base    Base address of the pages.
+  @param [in] Size    Size of the pages.
+
+  @retval TRUE        The pages were allocated and are removed from the ranges.
+  @retval FALSE       The pages are not part of an allocated range.
+ **/
+STATIC
+BOOLEAN
+InternalRemovePageRange (
+  IN UINT32  Base,
+  IN UINT32  Size
+  )
+{
+  LOADER_GLOBAL_DATA  *LdrGlobal;
+  PAGE_RANGE          *Range;
+  UINT32               Prev;
+  UINT32               Curr;
+  UINT32               End;
+
+  LdrGlobal = GetLoaderGlobalDataPointer();
+  Prev      = 0;
+  Curr      = LdrGlobal->MemPoolPageList;
+  while (Curr != 0) {
+    Range = (PAGE_RANGE *)(UINTN)Curr;
+    ASSERT (Range->Signature == PAGE_RANGE_SIGNATURE);
+    End   = Range->Base + Range->Size;
+    if ((Base >= Range->Base) && (Base < End)) {
+      if (Size > End - Base) {
+        return FALSE;
+      }
+
+      if (Base + Size < End) {
+        // Keep the pages above the freed ones
+        InternalAddPageRange (Curr, Base + Size, End - (Base + Size));
+      }
+
+      if (Base > Range->Base) {
+        // Keep the pages below the freed ones
+        Range->Size = Base - Range->Base;
+      } else {
+        if (Prev == 0) {
+          LdrGlobal->MemPoolPageList = Range->Next;
+        } else {
+          ((PAGE_RANGE *)(UINTN)Prev)->Next = Range->Next;
+        }
+        FreePool (Range);
+      }
+      return TRUE;
+    }
+    Prev = Curr;
+    Curr = Range->Next;
+  }
+
+  return FALSE;
+}
+
+/**
+  Allocate pages from the permanent memory pool.
+
+  @param [in] Pages       The number of 4 KB pages to allocate.
+  @param [in] Alignment   Alignment of the allocation, must be a power of 2 and at least 4 KB.
+
+  @retval     A pointer to the allocated buffer.
+ **/
+STATIC
+VOID *
+InternalAllocatePages (
+  IN UINTN   Pages,
+  IN UINT32  Alignment
+  )
+{
+  LOADER_GLOBAL_DATA  *LdrGlobal;
+  UINT32               Size;
+  UINT32               Top;
+  UINT32               OldTop;
+
+  Size = (UINT32)(Pages * EFI_PAGE_SIZE);
+  Top  = InternalAllocateFreeBlock (Size, Alignment);
+  if (Top == 0) {
+    LdrGlobal = GetLoaderGlobalDataPointer();
+    OldTop = LdrGlobal->MemPoolCurrTop;
+    Top    = ALIGN_DOWN (OldTop, EFI_PAGE_SIZE);
+    Top   -= Size;
+    Top    = ALIGN_DOWN (Top, Alignment);
+    InternalUpdateMemPoolTop (Top);
+
+    // Keep the alignment gap for later allocations
+    InternalFreeBlock (Top + Size, OldTop - (Top + Size));
+  }
+
+  InternalAddPageRange (0, Top, Size);
+
+  return (VOID *)(UINTN)Top;
+}
+
 /**
   Allocates a buffer of type EfiBootServicesData.
 
   Allocates the number bytes specified by AllocationSize of type EfiBootServicesData and returns a
-  pointer to the allocated buffer.  If AllocationSize is 0, LdrGlobal->MemPoolCurrTop is returned.
-  If there is not enough memory remaining to satisfy the request, InternalUpdateMemPoolTop ASSERTS
-  and the function does not return.
+  pointer to the allocated buffer.  A freed block is reused if one fits, otherwise the buffer is
+  carved from LdrGlobal->MemPoolCurrTop. If there is not enough memory remaining to satisfy the
+  request, InternalUpdateMemPoolTop ASSERTS and the function does not return.
 
   @param  AllocationSize        The number of bytes to allocate.
 
@@ -70,14 +429,25 @@ AllocatePool (
   )
 {
   LOADER_GLOBAL_DATA  *LdrGlobal;
+  POOL_HEADER         *Header;
+  UINT32               Size;
   UINT32               Top;
 
-  LdrGlobal = GetLoaderGlobalDataPointer();
-  Top  = LdrGlobal->MemPoolCurrTop;
-  Top -= (UINT32)AllocationSize;
-  Top  = ALIGN_DOWN (Top, POOL_MIN_ALIGNMENT);
-  InternalUpdateMemPoolTop (Top);
-  return (VOID *)(UINTN)Top;
+  Size = ALIGN_UP ((UINT32)AllocationSize + sizeof (POOL_HEADER), POOL_MIN_ALIGNMENT);
+  Top  = InternalAllocateFreeBlock (Size, POOL_MIN_ALIGNMENT);
+  if (Top == 0) {
+    LdrGlobal = GetLoaderGlobalDataPointer();
+    Top  = LdrGlobal->MemPoolCurrTop;
+    Top -= Size;
+    Top  = ALIGN_DOWN (Top, POOL_MIN_ALIGNMENT);
+    Size = LdrGlobal->MemPoolCurrTop - Top;
+    InternalUpdateMemPoolTop (Top);
+  }
+
+  Header = (POOL_HEADER *)(UINTN)Top;
+  Header->Signature = POOL_HEAD_SIGNATURE;
+  Header->Size      = Size;
+  return (VOID *)(Header + 1);
 }
 
 /**
@@ -127,19 +497,11 @@ AllocatePages (
   IN UINTN  Pages
   )
 {
-  LOADER_GLOBAL_DATA  *LdrGlobal;
-  UINT32               Top;
-
   if (Pages == 0) {
     return NULL;
   }
 
-  LdrGlobal = GetLoaderGlobalDataPointer();
-  Top  = LdrGlobal->MemPoolCurrTop;
-  Top  = ALIGN_DOWN (Top, EFI_PAGE_SIZE);
-  Top -= (UINT32)(Pages * EFI_PAGE_SIZE);
-  InternalUpdateMemPoolTop (Top);
-  return (VOID *)(UINTN)Top;
+  return InternalAllocatePages (Pages, EFI_PAGE_SIZE);
 }
 
 /**
@@ -167,23 +529,14 @@ AllocateAlignedPages (
   IN UINTN  Alignment
   )
 {
-  LOADER_GLOBAL_DATA  *LdrGlobal;
-  UINT32               Top;
-
   if (Pages == 0) {
     return NULL;
   }
 
-  LdrGlobal = GetLoaderGlobalDataPointer();
-  Top  = LdrGlobal->MemPoolCurrTop;
-  Top  = ALIGN_DOWN (Top, EFI_PAGE_SIZE);
-  Top -= (UINT32)(Pages * EFI_PAGE_SIZE);
-  if (Alignment > EFI_PAGE_SIZE) {
-    Top  = ALIGN_DOWN (Top, Alignment);
+  if (Alignment < EFI_PAGE_SIZE) {
+    Alignment = EFI_PAGE_SIZE;
   }
-  Top  = ALIGN_DOWN (Top, EFI_PAGE_SIZE);
-  InternalUpdateMemPoolTop (Top);
-  return (VOID *)(UINTN)Top;
+  return InternalAllocatePages (Pages, (UINT32)Alignment);
 }
 
 /**
@@ -246,10 +599,14 @@ FreeTemporaryMemory (
 
   Frees the number of 4KB pages specified by Pages from the buffer specified by Buffer.  Buffer
   must have been allocated on a previous call to the page allocation services of the Memory
-  Allocation Library.  If it is not possible to free allocated pages, then this function will
-  perform no actions.
-
-  If Buffer was not allocated with a page allocation function in the Memory Allocation Library,
+  Allocation Library.  The pages are returned to the permanent memory pool and coalesced with the
+  adjacent free blocks. Pages not allocated from the current pool are ignored. The head, the tail
+  or the middle of an allocation may be freed separately.
+  It must be called on the BSP only. The freed pages are filled with
+  PcdDebugClearMemoryValue if DEBUG_PROPERTY_CLEAR_MEMORY_ENABLED is set so
+  that a use after free is easier to spot.
+
+  If Buffer is in the current pool but the pages are not part of a single page allocation,
   then ASSERT().
   If Pages is zero, then ASSERT().
 
@@ -264,6 +621,27 @@ FreePages (
   IN UINTN  Pages
   )
 {
+  LOADER_GLOBAL_DATA  *LdrGlobal;
+  UINT32               Base;
+  UINT32               Size;
+
+  LdrGlobal = GetLoaderGlobalDataPointer();
+  Base = (UINT32)(UINTN)Buffer;
+  Size = (UINT32)(Pages * EFI_PAGE_SIZE);
+  if ((Base < LdrGlobal->MemPoolStart) || (Base >= LdrGlobal->MemPoolEnd)) {
+    // Not allocated from the current permanent memory pool
+    return;
+  }
+
+  if ((Pages == 0) || ((Base & (EFI_PAGE_SIZE - 1)) != 0) ||
+      !InternalRemovePageRange (Base, Size)) {
+    DEBUG ((DEBUG_ERROR, "Invalid page free 0x%08X:0x%X\n", Base, Size));
+    ASSERT (FALSE);
+    return;
+  }
+
+  DEBUG_CLEAR_MEMORY (Buffer, Size);
+  InternalFreeBlock (Base, Size);
 }
 
 /**
@@ -271,11 +649,15 @@ FreePages (
   Memory Allocation Library.
 
   Frees the buffer specified by Buffer.  Buffer must have been allocated on a previous call to the
-  pool allocation services of the Memory Allocation Library.  If it is not possible to free pool
-  resources, then this function will perform no actions.
+  pool allocation services of the Memory Allocation Library.  The buffer is returned to the
+  permanent memory pool and coalesced with the adjacent free blocks. Buffers not allocated from
+  the current pool are ignored. It must be called on the BSP only. The freed
+  buffer is filled with PcdDebugClearMemoryValue if
+  DEBUG_PROPERTY_CLEAR_MEMORY_ENABLED is set so that a use after free is
+  easier to spot.
 
-  If Buffer was not allocated with a pool allocation function in the Memory Allocation Library,
-  then ASSERT().
+  If Buffer is in the current pool but was not allocated with a pool allocation function in the
+  Memory Allocation Library, or was freed already, then ASSERT().
 
   @param  Buffer                The pointer to the buffer to free.
 
@@ -286,6 +668,35 @@ FreePool (
   IN VOID   *Buffer
   )
 {
+  LOADER_GLOBAL_DATA  *LdrGlobal;
+  POOL_HEADER         *Header;
+  UINT32               Base;
+
+  if (Buffer == NULL) {
+    return;
+  }
+
+  //
+  // Ignore the buffers not allocated from the current permanent memory pool,
+  // e.g. the ones allocated before memory migration.
+  //
+  LdrGlobal = GetLoaderGlobalDataPointer();
+  Header    = (POOL_HEADER *)Buffer - 1;
+  Base      = (UINT32)(UINTN)Header;
+  if ((Base < LdrGlobal->MemPoolStart) || (Base >= LdrGlobal->MemPoolEnd)) {
+    return;
+  }
+
+  if ((Base < LdrGlobal->MemPoolCurrTop) || (Header->Signature != POOL_HEAD_SIGNATURE) ||
+      (Header->Size > LdrGlobal->MemPoolEnd - Base)) {
+    DEBUG ((DEBUG_ERROR, "Invalid pool free 0x%p\n", Buffer));
+    ASSERT (FALSE);
+    return;
+  }
+
+  Header->Signature = 0;
+  DEBUG_CLEAR_MEMORY (Buffer, Header->Size - sizeof (POOL_HEADER));
+  InternalFreeBlock (Base, Header->Size);
 }
 
 /**
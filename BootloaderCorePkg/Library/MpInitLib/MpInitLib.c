@@ -183,6 +183,7 @@ ApFunc (
   BOOLEAN            WaitTask;
   CPU_TASK_PROC      ApRunTask;
   volatile UINT32   *State;
+  UINT64             StartTsc;
 
   // Enable more CPU featurs
   AsmEnableAvx ();
@@ -216,7 +217,10 @@ ApFunc (
       *State = EnumCpuBusy;
       ApRunTask = (CPU_TASK_PROC)(UINTN)mSysCpuTask.CpuTask[Index].CProcedure;
       if (ApRunTask != NULL) {
+        StartTsc = AsmReadTsc ();
         mSysCpuTask.CpuTask[Index].Result = ApRunTask (mSysCpuTask.CpuTask[Index].Argument);
+        mSysCpuTask.CpuTask[Index].BusyTicks += AsmReadTsc () - StartTsc;
+        mSysCpuTask.CpuTask[Index].TaskCount++;
       }
       *State = EnumCpuReady;
       break;
@@ -419,6 +423,7 @@ MpInit (
       }
 
       mSysCpuInfo.CpuCount = CpuCount;
+      mSysCpuTask.CpuCount = CpuCount;
       SortSysCpu (&mSysCpuInfo);
 
       for (Index = 0; Index < CpuCount; Index++) {
@@ -455,6 +460,10 @@ MpInit (
         }
       }
 
+      DEBUG_CODE_BEGIN ();
+      MpDumpTask ();
+      DEBUG_CODE_END ();
+
       //
       // Send an Init IPI to all the APs to put them back in WFS state
       //
@@ -525,7 +534,7 @@ MpRunTask (
     return EFI_INVALID_PARAMETER;
   }
 
-  if (mSysCpuTask.CpuTask[Index].State != EnumCpuReady) {
+  if ((mMpInitPhase != EnumMpInitRun) || (mSysCpuTask.CpuTask[Index].State != EnumCpuReady)) {
     return EFI_NOT_READY;
   }
 
@@ -537,6 +546,76 @@ MpRunTask (
 }
 
 
+/**
+  Run a task function on the first idle application processor.
+
+  @param[in]  TaskProc    Task function pointer
+  @param[in]  Argument    Argument for the task function
+  @param[out] Index       Pointer to receive the CPU index running the task
+
+  @retval EFI_INVALID_PARAMETER   TaskProc or Index is NULL.
+  @retval EFI_NOT_READY           No application processor is available now.
+  @retval EFI_SUCCESS             An application processor accepted the new task.
+
+**/
+EFI_STATUS
+EFIAPI
+MpRunTaskOnIdleAp (
+  IN  CPU_TASK_PROC  TaskProc,
+  IN  UINT32         Argument,
+  OUT UINT32        *Index
+  )
+{
+  UINT32       CpuIdx;
+
+  if ((TaskProc == NULL) || (Index == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  for (CpuIdx = 1; CpuIdx < mSysCpuTask.CpuCount; CpuIdx++) {
+    if (MpRunTask (CpuIdx, TaskProc, Argument) == EFI_SUCCESS) {
+      *Index = CpuIdx;
+      return EFI_SUCCESS;
+    }
+  }
+
+  return EFI_NOT_READY;
+}
+
+
+/**
+  Wait until the task running on a specific processor completes.
+
+  @param[in]  Index       CPU index returned by MpRunTask or MpRunTaskOnIdleAp
+  @param[out] Result      Pointer to receive the task function return value
+
+  @retval EFI_INVALID_PARAMETER   Invalid Index parameter.
+  @retval EFI_SUCCESS             The task has completed.
+
+**/
+EFI_STATUS
+EFIAPI
+MpWaitTask (
+  IN  UINT32         Index,
+  OUT UINT32        *Result  OPTIONAL
+  )
+{
+  if ((Index >= mSysCpuTask.CpuCount) || (Index == 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  while (mSysCpuTask.CpuTask[Index].State != EnumCpuReady) {
+    CpuPause ();
+  }
+
+  if (Result != NULL) {
+    *Result = mSysCpuTask.CpuTask[Index].Result;
+  }
+
+  return EFI_SUCCESS;
+}
+
+
 /**
   Dump MP task running state
 
@@ -552,14 +631,18 @@ MpDumpTask (
   )
 {
   UINT32 Index;
+  UINT32 FreqKhz;
 
+  FreqKhz = GetTimeStampFrequency ();
   for (Index = 0; Index < mSysCpuTask.CpuCount; Index++) {
-    DEBUG ((DEBUG_INFO, "CPU%02X: %08X %08X %08X %08X\n",
+    DEBUG ((DEBUG_INFO, "CPU%02X: %08X %08X %08X %08X  Tasks: %d  Busy: %d us\n",
             Index,
             mSysCpuTask.CpuTask[Index].State,
             mSysCpuTask.CpuTask[Index].CProcedure,
             mSysCpuTask.CpuTask[Index].Argument,
-            mSysCpuTask.CpuTask[Index].Result));
+            mSysCpuTask.CpuTask[Index].Result,
+            mSysCpuTask.CpuTask[Index].TaskCount,
+            (UINT32)DivU64x32 (MultU64x32 (mSysCpuTask.CpuTask[Index].BusyTicks, 1000), FreqKhz)));
   }
   DEBUG ((DEBUG_INFO, "\n"));
 }
@@ -151,6 +151,17 @@ struct _PCI_IO_DEVICE {
 
 };
 
+/**
+  Allocate the memory of specified size from the memory pool.
+
+  @param AllocationSize size to be allocated.
+
+ **/
+VOID *
+PciAllocatePool (
+  IN UINTN            AllocationSize
+  );
+
 /**
   Check whether the bar is existed or not.
 
@@ -0,0 +1,499 @@
+/** @file
+  PCI enumeration cache.
+
+  The result of a full PCI enumeration is saved into a variable. On the next
+  boots the PCI resources are programmed from it directly as long as the
+  enumeration policy is unchanged, every cached device is still present and
+  the set of functions found on the root buses and behind the cached bridges
+  is the same. Any added, removed or replaced device falls back to a full
+  enumeration.
+
+  Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiPei.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/PcdLib.h>
+#include <Library/HobLib.h>
+#include <Library/PciExpressLib.h>
+#include <Library/VariableLib.h>
+#include "InternalPciEnumerationLib.h"
+#include "PciEnumCache.h"
+
+//
+// Enumeration inputs covered by the cache policy fingerprint
+//
+typedef struct {
+  UINT64                    IoBase;
+  UINT64                    Mem32Base;
+  UINT64                    Mem64Base;
+  UINT32                    EnumPolicyCrc;
+} PCI_ENUM_CACHE_POLICY;
+
+//
+// One function found while fingerprinting the bus topology
+//
+typedef struct {
+  UINT32                    Crc;
+  UINT32                    Address;
+  UINT32                    Id;
+} PCI_ENUM_CACHE_TOPOLOGY;
+
+/**
+  Calculate the fingerprint of the enumeration policy and resource bases.
+
+  @param[in]  EnumPolicy          PCI enumeration policy.
+
+  @retval     CRC32 of the enumeration inputs.
+
+**/
+STATIC
+UINT32
+GetPciEnumPolicyCrc (
+  IN CONST PCI_ENUM_POLICY_INFO   *EnumPolicy
+  )
+{
+  PCI_ENUM_CACHE_POLICY   Policy;
+
+  ZeroMem (&Policy, sizeof (Policy));
+  Policy.IoBase    = PcdGet32 (PcdPciResourceIoBase);
+  Policy.Mem32Base = PcdGet32 (PcdPciResourceMem32Base);
+  Policy.Mem64Base = PcdGet64 (PcdPciResourceMem64Base);
+  if (EnumPolicy != NULL) {
+    Policy.EnumPolicyCrc = CalculateCrc32 ((VOID *)EnumPolicy, sizeof (PCI_ENUM_POLICY_INFO) + EnumPolicy->NumOfBus);
+  }
+
+  return CalculateCrc32 (&Policy, sizeof (Policy));
+}
+
+/**
+  Calculate the CRC32 of an enumeration cache with the Crc field cleared.
+
+  @param[in]  CacheHdr            PCI enumeration cache.
+
+  @retval     CRC32 of the cache.
+
+**/
+STATIC
+UINT32
+GetPciEnumCacheCrc (
+  IN PCI_ENUM_CACHE_HDR   *CacheHdr
+  )
+{
+  UINT32    Crc;
+  UINT32    SavedCrc;
+
+  SavedCrc      = CacheHdr->Crc;
+  CacheHdr->Crc = 0;
+  Crc           = CalculateCrc32 (CacheHdr, CacheHdr->Length);
+  CacheHdr->Crc = SavedCrc;
+
+  return Crc;
+}
+
+/**
+  Fingerprint the functions present on a PCI bus.
+
+  @param[in]  Bus                 PCI bus number.
+  @param[in]  Crc                 Fingerprint of the buses scanned so far.
+
+  @retval     Fingerprint including this bus.
+
+**/
+STATIC
+UINT32
+GetPciBusTopologyCrc (
+  IN UINT8    Bus,
+  IN UINT32   Crc
+  )
+{
+  PCI_ENUM_CACHE_TOPOLOGY   Item;
+  UINT32                    Address;
+  UINT32                    Id;
+  UINT8                     Device;
+  UINT8                     Func;
+
+  for (Device = 0; Device <= PCI_MAX_DEVICE; Device++) {
+    for (Func = 0; Func <= PCI_MAX_FUNC; Func++) {
+      Address = PCI_EXPRESS_LIB_ADDRESS (Bus, Device, Func, 0);
+      Id      = PciExpressRead32 (Address + PCI_VENDOR_ID_OFFSET);
+      if ((UINT16)Id == 0xFFFF) {
+        if (Func == 0) {
+          break;
+        }
+        continue;
+      }
+
+      Item.Crc     = Crc;
+      Item.Address = Address;
+      Item.Id      = Id;
+      Crc = CalculateCrc32 (&Item, sizeof (Item));
+
+      if ((Func == 0) && ((PciExpressRead8 (Address + PCI_HEADER_TYPE_OFFSET) & HEADER_TYPE_MULTI_FUNCTION) == 0)) {
+        break;
+      }
+    }
+  }
+
+  return Crc;
+}
+
+/**
+  Fingerprint the PCI topology covered by the enumeration cache.
+
+  The vendor and device IDs of every function on the root bridge buses and on
+  the secondary bus of every cached bridge are included. The bridge bus
+  numbers must have been programmed.
+
+  @param[in]  RootBridgeCount     Number of root bridges.
+  @param[in]  RootBridgeEntry     Root bridge entries.
+  @param[in]  DeviceCount         Number of cached devices.
+  @param[in]  Device              Cached devices.
+
+  @retval     Fingerprint of the PCI topology.
+
+**/
+STATIC
+UINT32
+GetPciTopologyCrc (
+  IN UINT32                   RootBridgeCount,
+  IN PCI_ROOT_BRIDGE_ENTRY   *RootBridgeEntry,
+  IN UINT32                   DeviceCount,
+  IN PCI_ENUM_CACHE_DEVICE   *Device
+  )
+{
+  UINT32    Crc;
+  UINT32    Index;
+  UINT8     Bus;
+
+  Crc = 0;
+  for (Index = 0; Index < RootBridgeCount; Index++) {
+    Crc = GetPciBusTopologyCrc (RootBridgeEntry[Index].BusBase, Crc);
+  }
+
+  for (Index = 0; Index < DeviceCount; Index++) {
+    if ((Device[Index].HeaderType & HEADER_LAYOUT_CODE) == HEADER_TYPE_PCI_TO_PCI_BRIDGE) {
+      Bus = (UINT8)(Device[Index].Reg[2] >> 8);
+      if (Bus != 0) {
+        Crc = GetPciBusTopologyCrc (Bus, Crc);
+      }
+    }
+  }
+
+  return Crc;
+}
+
+/**
+  Add all devices under a parent into the enumeration cache.
+
+  Devices are added in pre-order so that a bridge always comes before the
+  devices behind it. Root bridges are not PCI devices and only their
+  children are added.
+
+  @param[in]      Parent          Parent bridge instance.
+  @param[in]      Device          Device cache array, or NULL to count the devices only.
+  @param[in,out]  Count           Number of devices in the cache.
+
+**/
+STATIC
+VOID
+AddPciEnumCacheDevices (
+  IN     PCI_IO_DEVICE            *Parent,
+  IN     PCI_ENUM_CACHE_DEVICE    *Device,
+  IN OUT UINT32                   *Count
+  )
+{
+  LIST_ENTRY              *CurrentLink;
+  PCI_IO_DEVICE           *PciIoDevice;
+  PCI_ENUM_CACHE_DEVICE   *Entry;
+  UINT32                   Index;
+
+  CurrentLink = Parent->ChildList.ForwardLink;
+  while ((CurrentLink != NULL) && (CurrentLink != &Parent->ChildList)) {
+    PciIoDevice = PCI_IO_DEVICE_FROM_LINK (CurrentLink);
+    if ((PciIoDevice->Address & BIT31) == 0) {
+      if (Device != NULL) {
+        Entry = &Device[*Count];
+        ZeroMem (Entry, sizeof (PCI_ENUM_CACHE_DEVICE));
+        Entry->Address       = PciIoDevice->Address;
+        Entry->Id            = PciExpressRead32 (PciIoDevice->Address + PCI_VENDOR_ID_OFFSET);
+        Entry->ClassRev      = PciExpressRead32 (PciIoDevice->Address + PCI_REVISION_ID_OFFSET);
+        Entry->Command       = PciExpressRead16 (PciIoDevice->Address + PCI_COMMAND_OFFSET);
+        Entry->HeaderType    = PciExpressRead8  (PciIoDevice->Address + PCI_HEADER_TYPE_OFFSET);
+        Entry->InterruptLine = PciExpressRead8  (PciIoDevice->Address + PCI_INT_LINE_OFFSET);
+        if (IS_PCI_BRIDGE (&PciIoDevice->Pci)) {
+          Entry->BridgeControl = PciExpressRead16 (PciIoDevice->Address + PCI_BRIDGE_CONTROL_REGISTER_OFFSET);
+        }
+        for (Index = 0; Index < PCI_ENUM_CACHE_REG_NUM; Index++) {
+          Entry->Reg[Index] = PciExpressRead32 (PciIoDevice->Address + PCI_BASE_ADDRESSREG_OFFSET + Index * sizeof (UINT32));
+        }
+      }
+      (*Count)++;
+    }
+
+    AddPciEnumCacheDevices (PciIoDevice, Device, Count);
+    CurrentLink = CurrentLink->ForwardLink;
+  }
+}
+
+/**
+  Check whether a PCI device still matches its cache entry.
+
+  @param[in]  Entry               Cached device.
+
+  @retval TRUE                    The device matches the cache.
+  @retval FALSE                   The device is missing or has been replaced.
+
+**/
+STATIC
+BOOLEAN
+IsPciEnumCacheDeviceMatch (
+  IN PCI_ENUM_CACHE_DEVICE    *Entry
+  )
+{
+  UINT32    Address;
+
+  Address = Entry->Address;
+  return (BOOLEAN)((PciExpressRead32 (Address + PCI_VENDOR_ID_OFFSET) == Entry->Id) &&
+                   (PciExpressRead32 (Address + PCI_REVISION_ID_OFFSET) == Entry->ClassRev) &&
+                   (PciExpressRead8 (Address + PCI_HEADER_TYPE_OFFSET) == Entry->HeaderType));
+}
+
+/**
+  Program a PCI device from its cache entry.
+
+  The device must have been verified. Decoding is not enabled here.
+
+  @param[in]  Entry               Cached device.
+
+**/
+STATIC
+VOID
+ProgramPciEnumCacheDevice (
+  IN PCI_ENUM_CACHE_DEVICE    *Entry
+  )
+{
+  UINT32    Address;
+  UINT32    Index;
+
+  Address = Entry->Address;
+  PciExpressAnd16 (Address + PCI_COMMAND_OFFSET, (UINT16)~EFI_PCI_COMMAND_BITS_OWNED);
+
+  if ((Entry->HeaderType & HEADER_LAYOUT_CODE) == HEADER_TYPE_PCI_TO_PCI_BRIDGE) {
+    //
+    // Only the IO base and limit are written at 0x1C to keep the
+    // write-1-to-clear secondary status untouched.
+    //
+    PciExpressWrite32 (Address + 0x10, Entry->Reg[0]);
+    PciExpressWrite32 (Address + 0x14, Entry->Reg[1]);
+    PciExpressWrite32 (Address + 0x18, Entry->Reg[2]);
+    PciExpressWrite16 (Address + 0x1C, (UINT16)Entry->Reg[3]);
+    for (Index = 4; Index < PCI_ENUM_CACHE_REG_NUM; Index++) {
+      PciExpressWrite32 (Address + PCI_BASE_ADDRESSREG_OFFSET + Index * sizeof (UINT32), Entry->Reg[Index]);
+    }
+    PciExpressWrite16 (Address + PCI_BRIDGE_CONTROL_REGISTER_OFFSET, Entry->BridgeControl);
+  } else {
+    for (Index = 0; Index < PCI_MAX_BAR; Index++) {
+      PciExpressWrite32 (Address + PCI_BASE_ADDRESSREG_OFFSET + Index * sizeof (UINT32), Entry->Reg[Index]);
+    }
+  }
+  PciExpressWrite8 (Address + PCI_INT_LINE_OFFSET, Entry->InterruptLine);
+}
+
+/**
+  Program PCI resources from the enumeration cache.
+
+  All cached devices and the bus topology are verified against the hardware
+  before any device resource is written, so that a full enumeration can still
+  run on any mismatch.
+
+  @param[in]  EnumPolicy          PCI enumeration policy.
+
+  @retval EFI_SUCCESS             PCI resources were programmed from the cache.
+  @retval EFI_NOT_FOUND           No valid cache is available.
+  @retval EFI_NOT_READY           Cache does not match the current platform.
+  @retval EFI_OUT_OF_RESOURCES    Failed to build the root bridge info HOB.
+
+**/
+EFI_STATUS
+PciEnumerationFromCache (
+  IN CONST PCI_ENUM_POLICY_INFO   *EnumPolicy
+  )
+{
+  EFI_STATUS                 Status;
+  PCI_ENUM_CACHE_HDR        *CacheHdr;
+  PCI_ROOT_BRIDGE_ENTRY     *RootBridgeEntry;
+  PCI_ENUM_CACHE_DEVICE     *Device;
+  PCI_ROOT_BRIDGE_INFO_HOB  *RootBridgeInfoHob;
+  UINT32                    *BusReg;
+  UINTN                      DataSize;
+  UINTN                      Length;
+  UINT32                     Index;
+
+  DataSize = 0;
+  Status   = GetVariable (PCI_ENUM_CACHE_VAR_NAME, NULL, &DataSize, NULL);
+  if ((Status != EFI_BUFFER_TOO_SMALL) || (DataSize < sizeof (PCI_ENUM_CACHE_HDR))) {
+    return EFI_NOT_FOUND;
+  }
+
+  CacheHdr = (PCI_ENUM_CACHE_HDR *)PciAllocatePool (DataSize);
+  Status   = GetVariable (PCI_ENUM_CACHE_VAR_NAME, NULL, &DataSize, CacheHdr);
+  if (EFI_ERROR (Status)) {
+    return EFI_NOT_FOUND;
+  }
+
+  Length = sizeof (PCI_ENUM_CACHE_HDR) + CacheHdr->RootBridgeCount * sizeof (PCI_ROOT_BRIDGE_ENTRY) +
+           CacheHdr->DeviceCount * sizeof (PCI_ENUM_CACHE_DEVICE);
+  if ((CacheHdr->Signature != PCI_ENUM_CACHE_SIGNATURE) || (CacheHdr->Length != DataSize) ||
+      (Length != DataSize) || (CacheHdr->RootBridgeCount == 0) || (GetPciEnumCacheCrc (CacheHdr) != CacheHdr->Crc)) {
+    return EFI_NOT_FOUND;
+  }
+
+  if (CacheHdr->PolicyCrc != GetPciEnumPolicyCrc (EnumPolicy)) {
+    return EFI_NOT_READY;
+  }
+
+  RootBridgeEntry = (PCI_ROOT_BRIDGE_ENTRY *)&CacheHdr[1];
+  Device = (PCI_ENUM_CACHE_DEVICE *)&RootBridgeEntry[CacheHdr->RootBridgeCount];
+
+  //
+  // Verify everything before programming any resource. Only the bridge bus
+  // numbers are set here, in pre-order, so that the devices behind them can
+  // be reached. They are restored if anything does not match.
+  //
+  BusReg = (UINT32 *)PciAllocatePool (CacheHdr->DeviceCount * sizeof (UINT32));
+  for (Index = 0; Index < CacheHdr->DeviceCount; Index++) {
+    if (!IsPciEnumCacheDeviceMatch (&Device[Index])) {
+      DEBUG ((DEBUG_INFO, "PCI enum cache mismatch at 0x%08X\n", Device[Index].Address));
+      Status = EFI_NOT_READY;
+      break;
+    }
+    if ((Device[Index].HeaderType & HEADER_LAYOUT_CODE) == HEADER_TYPE_PCI_TO_PCI_BRIDGE) {
+      BusReg[Index] = PciExpressRead32 (Device[Index].Address + 0x18);
+      PciExpressWrite32 (Device[Index].Address + 0x18, Device[Index].Reg[2]);
+    }
+  }
+
+  if (!EFI_ERROR (Status) &&
+      (GetPciTopologyCrc (CacheHdr->RootBridgeCount, RootBridgeEntry, CacheHdr->DeviceCount, Device) != CacheHdr->TopologyCrc)) {
+    DEBUG ((DEBUG_INFO, "PCI enum cache topology mismatch\n"));
+    Status = EFI_NOT_READY;
+  }
+
+  if (EFI_ERROR (Status)) {
+    while (Index > 0) {
+      Index--;
+      if ((Device[Index].HeaderType & HEADER_LAYOUT_CODE) == HEADER_TYPE_PCI_TO_PCI_BRIDGE) {
+        PciExpressWrite32 (Device[Index].Address + 0x18, BusReg[Index]);
+      }
+    }
+    return Status;
+  }
+
+  for (Index = 0; Index < CacheHdr->DeviceCount; Index++) {
+    ProgramPciEnumCacheDevice (&Device[Index]);
+  }
+
+  Length  = sizeof (PCI_ROOT_BRIDGE_INFO_HOB);
+  Length += sizeof (PCI_ROOT_BRIDGE_ENTRY) * CacheHdr->RootBridgeCount;
+  RootBridgeInfoHob = BuildGuidHob (&gLoaderPciRootBridgeInfoGuid, Length);
+  if (RootBridgeInfoHob == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  ZeroMem (RootBridgeInfoHob, Length);
+  RootBridgeInfoHob->Revision = 1;
+  RootBridgeInfoHob->Count    = (UINT8)CacheHdr->RootBridgeCount;
+  CopyMem (RootBridgeInfoHob->Entry, RootBridgeEntry, sizeof (PCI_ROOT_BRIDGE_ENTRY) * CacheHdr->RootBridgeCount);
+
+  //
+  // Enable decoding after all devices have been verified and programmed
+  //
+  for (Index = 0; Index < CacheHdr->DeviceCount; Index++) {
+    PciExpressWrite16 (Device[Index].Address + PCI_COMMAND_OFFSET, Device[Index].Command);
+  }
+
+  DEBUG ((DEBUG_INFO, "PCI resources programmed from cache for %d devices\n", CacheHdr->DeviceCount));
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Save the result of a full PCI enumeration into the enumeration cache.
+
+  The cache is only written when its content has changed.
+
+  @param[in]  EnumPolicy          PCI enumeration policy.
+  @param[in]  RootBridge          A pointer which has root bridges in ChildList.
+
+  @retval EFI_SUCCESS             The cache is up to date.
+  @retval EFI_NOT_FOUND           No root bridge info HOB was found.
+  @retval Others                  Failed to write the cache.
+
+**/
+EFI_STATUS
+SavePciEnumerationCache (
+  IN CONST PCI_ENUM_POLICY_INFO   *EnumPolicy,
+  IN       PCI_IO_DEVICE          *RootBridge
+  )
+{
+  EFI_STATUS                 Status;
+  PCI_ENUM_CACHE_HDR        *CacheHdr;
+  PCI_ENUM_CACHE_HDR        *OldCacheHdr;
+  PCI_ROOT_BRIDGE_ENTRY     *RootBridgeEntry;
+  PCI_ENUM_CACHE_DEVICE     *Device;
+  PCI_ROOT_BRIDGE_INFO_HOB  *RootBridgeInfoHob;
+  EFI_HOB_GUID_TYPE         *GuidHob;
+  UINT32                     Count;
+  UINTN                      Length;
+  UINTN                      DataSize;
+
+  GuidHob = GetFirstGuidHob (&gLoaderPciRootBridgeInfoGuid);
+  if (GuidHob == NULL) {
+    return EFI_NOT_FOUND;
+  }
+  RootBridgeInfoHob = (PCI_ROOT_BRIDGE_INFO_HOB *)GET_GUID_HOB_DATA (GuidHob);
+  if (RootBridgeInfoHob->Count == 0) {
+    return EFI_NOT_FOUND;
+  }
+
+  Count = 0;
+  AddPciEnumCacheDevices (RootBridge, NULL, &Count);
+  Length = sizeof (PCI_ENUM_CACHE_HDR) + RootBridgeInfoHob->Count * sizeof (PCI_ROOT_BRIDGE_ENTRY) +
+           Count * sizeof (PCI_ENUM_CACHE_DEVICE);
+
+  CacheHdr = (PCI_ENUM_CACHE_HDR *)PciAllocatePool (Length);
+  ZeroMem (CacheHdr, Length);
+  CacheHdr->Signature       = PCI_ENUM_CACHE_SIGNATURE;
+  CacheHdr->Length          = (UINT32)Length;
+  CacheHdr->PolicyCrc       = GetPciEnumPolicyCrc (EnumPolicy);
+  CacheHdr->RootBridgeCount = RootBridgeInfoHob->Count;
+  CacheHdr->DeviceCount     = (UINT16)Count;
+  RootBridgeEntry = (PCI_ROOT_BRIDGE_ENTRY *)&CacheHdr[1];
+  CopyMem (RootBridgeEntry, RootBridgeInfoHob->Entry, sizeof (PCI_ROOT_BRIDGE_ENTRY) * RootBridgeInfoHob->Count);
+  Device = (PCI_ENUM_CACHE_DEVICE *)&RootBridgeEntry[CacheHdr->RootBridgeCount];
+  Count  = 0;
+  AddPciEnumCacheDevices (RootBridge, Device, &Count);
+  CacheHdr->TopologyCrc = GetPciTopologyCrc (CacheHdr->RootBridgeCount, RootBridgeEntry, Count, Device);
+  CacheHdr->Crc         = GetPciEnumCacheCrc (CacheHdr);
+
+  //
+  // Avoid flash writes if nothing has changed
+  //
+  OldCacheHdr = (PCI_ENUM_CACHE_HDR *)PciAllocatePool (Length);
+  DataSize    = Length;
+  Status = GetVariable (PCI_ENUM_CACHE_VAR_NAME, NULL, &DataSize, OldCacheHdr);
+  if (!EFI_ERROR (Status) && (DataSize == Length) && (CompareMem (OldCacheHdr, CacheHdr, Length) == 0)) {
+    return EFI_SUCCESS;
+  }
+
+  Status = SetVariable (PCI_ENUM_CACHE_VAR_NAME, 0, Length, CacheHdr);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "PCI enum cache save error, status = %r\n", Status));
+  }
+
+  return Status;
+}
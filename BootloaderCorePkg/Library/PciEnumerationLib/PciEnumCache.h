@@ -0,0 +1,88 @@
+/** @file
+
+  Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef __PCI_ENUM_CACHE_H__
+#define __PCI_ENUM_CACHE_H__
+
+#define PCI_ENUM_CACHE_VAR_NAME       "PCIENUM"
+#define PCI_ENUM_CACHE_SIGNATURE      SIGNATURE_32 ('P', 'E', 'N', 'C')
+
+//
+// Configuration registers from offset 0x10 to 0x30
+//
+#define PCI_ENUM_CACHE_REG_NUM        9
+
+//
+// Snapshot of a PCI device after enumeration
+//
+typedef struct {
+  UINT32                    Address;
+  UINT32                    Id;
+  UINT32                    ClassRev;
+  UINT16                    Command;
+  UINT16                    BridgeControl;
+  UINT8                     HeaderType;
+  UINT8                     InterruptLine;
+  UINT8                     Reserved[2];
+  UINT32                    Reg[PCI_ENUM_CACHE_REG_NUM];
+} PCI_ENUM_CACHE_DEVICE;
+
+//
+// PCI enumeration cache header.
+// It is followed by PCI_ROOT_BRIDGE_ENTRY[RootBridgeCount] and
+// PCI_ENUM_CACHE_DEVICE[DeviceCount].
+//
+typedef struct {
+  UINT32                    Signature;
+  UINT32                    Length;
+  UINT32                    Crc;
+  UINT32                    PolicyCrc;
+  UINT32                    TopologyCrc;
+  UINT16                    RootBridgeCount;
+  UINT16                    DeviceCount;
+} PCI_ENUM_CACHE_HDR;
+
+/**
+  Program PCI resources from the enumeration cache.
+
+  All cached devices and the bus topology are verified against the hardware
+  before any device resource is written, so that a full enumeration can still
+  run on any mismatch.
+
+  @param[in]  EnumPolicy          PCI enumeration policy.
+
+  @retval EFI_SUCCESS             PCI resources were programmed from the cache.
+  @retval EFI_NOT_FOUND           No valid cache is available.
+  @retval EFI_NOT_READY           Cache does not match the current platform.
+  @retval EFI_OUT_OF_RESOURCES    Failed to build the root bridge info HOB.
+
+**/
+EFI_STATUS
+PciEnumerationFromCache (
+  IN CONST PCI_ENUM_POLICY_INFO   *EnumPolicy
+  );
+
+/**
+  Save the result of a full PCI enumeration into the enumeration cache.
+
+  The cache is only written when its content has changed.
+
+  @param[in]  EnumPolicy          PCI enumeration policy.
+  @param[in]  RootBridge          A pointer which has root bridges in ChildList.
+
+  @retval EFI_SUCCESS             The cache is up to date.
+  @retval EFI_NOT_FOUND           No root bridge info HOB was found.
+  @retval Others                  Failed to write the cache.
+
+**/
+EFI_STATUS
+SavePciEnumerationCache (
+  IN CONST PCI_ENUM_POLICY_INFO   *EnumPolicy,
+  IN       PCI_IO_DEVICE          *RootBridge
+  );
+
+#endif // __PCI_ENUM_CACHE_H__
@@ -10,16 +10,56 @@
 #include <Library/DebugLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/PciExpressLib.h>
+#include <Library/IoLib.h>
 #include <Library/SortLib.h>
 #include <Library/HobLib.h>
+#include <Library/TimeStampLib.h>
 #include <InternalPciEnumerationLib.h>
 #include <Library/BootloaderCommonLib.h>
+#include <Service/MpService.h>
 #include "PciAri.h"
 #include "PciIov.h"
+#include "PciEnumCache.h"
 
 #define  DEBUG_PCI_ENUM    0
 
-UINT8   *mPoolPtr;
+//
+// Presence of the functions found by the root bridge probe.
+// FuncMask has one bit per function for each device on a probed bus.
+//
+typedef struct {
+  UINT8              Probed[PCI_MAX_BUS + 1];
+  UINT8              FuncMask[PCI_MAX_BUS + 1][PCI_MAX_DEVICE + 1];
+} PCI_PROBE_TABLE;
+
+//
+// Position of the probe on one bus level behind a root bridge
+//
+typedef struct {
+  UINT8              Bus;
+  UINT8              Device;
+  UINT8              Func;
+  BOOLEAN            MultiFunc;
+} PCI_PROBE_FRAME;
+
+//
+// Probe context for a root bridge. The probe runs on an AP, so all buffers
+// are allocated by BSP before the task is started.
+//
+typedef struct {
+  UINTN              PciExpressBase;
+  PCI_PROBE_TABLE   *Table;
+  PCI_PROBE_FRAME   *Stack;
+  UINT8              Bus;
+  UINT8              BusLimit;
+  BOOLEAN            OnAp;
+  UINT8              Reserved;
+  UINT32             TaskId;
+  UINT64             Ticks;
+} PCI_ROOT_PROBE_TASK;
+
+UINT8            *mPoolPtr;
+PCI_PROBE_TABLE  *mPciProbeTable;
 
 /**
  Set the memory pool address to the global pointer -file scope.
@@ -88,6 +128,14 @@ PciDevicePresent (
   UINT32      *Src;
   UINT32      *Dst;
 
+  //
+  // Skip the functions that the root bridge probe did not find
+  //
+  if ((mPciProbeTable != NULL) && (mPciProbeTable->Probed[Bus] != 0) &&
+      ((mPciProbeTable->FuncMask[Bus][Device] & (1 << Func)) == 0)) {
+    return EFI_NOT_FOUND;
+  }
+
   //
   // Create PCI address map in terms of Bus, Device and Func
   //
@@ -1407,9 +1455,129 @@ PciProgramResources (
   return Address;
 }
 
+/**
+  Advance a probe position to the next function to probe on its bus.
+
+  @param[in, out] Frame   Probe position on a bus.
+
+**/
+STATIC
+VOID
+PciProbeNextFunc (
+  IN OUT PCI_PROBE_FRAME  *Frame
+  )
+{
+  if (((Frame->Func == 0) && !Frame->MultiFunc) || (Frame->Func == PCI_MAX_FUNC)) {
+    Frame->Device++;
+    Frame->Func = 0;
+  } else {
+    Frame->Func++;
+  }
+}
+
+/**
+  Probe the functions present behind a root bridge.
+
+  It walks the hierarchy in the same order as PciScanBus () and assigns the
+  same bus numbers to the bridges, so that the probe table is valid for the
+  bus numbers PciScanBus () uses later on BSP. It only reads the vendor ID
+  and header type, and it is iterative, so it can run on an AP without
+  printing or allocating memory.
+
+  @param[in] Argument     Pointer to PCI_ROOT_PROBE_TASK.
+
+  @retval                 Always 0.
+**/
+STATIC
+UINT32
+PciProbeRootBridgeTask (
+  IN UINT32   Argument
+  )
+{
+  PCI_ROOT_PROBE_TASK  *Task;
+  PCI_PROBE_FRAME      *Frame;
+  UINTN                 Address;
+  UINTN                 Depth;
+  UINT8                 SubBusNumber;
+  UINT8                 HeaderType;
+  UINT64                Start;
+
+  Task  = (PCI_ROOT_PROBE_TASK *)(UINTN)Argument;
+  Start = AsmReadTsc ();
+
+  Depth = 0;
+  SubBusNumber = Task->Bus;
+  ZeroMem (&Task->Stack[0], sizeof (PCI_PROBE_FRAME));
+  Task->Stack[0].Bus = Task->Bus;
+  Task->Table->Probed[Task->Bus] = 1;
+
+  while (TRUE) {
+    Frame = &Task->Stack[Depth];
+    if (Frame->Device > PCI_MAX_DEVICE) {
+      if (Depth == 0) {
+        break;
+      }
+      //
+      // Set the current maximum bus number under the PPB and continue
+      // with the function after it on the upper bus
+      //
+      Depth--;
+      Frame   = &Task->Stack[Depth];
+      Address = Task->PciExpressBase + PCI_EXPRESS_LIB_ADDRESS (Frame->Bus, Frame->Device, Frame->Func,
+                                                                PCI_BRIDGE_SUBORDINATE_BUS_REGISTER_OFFSET);
+      MmioWrite8 (Address, SubBusNumber);
+      PciProbeNextFunc (Frame);
+      continue;
+    }
+
+    Address = Task->PciExpressBase + PCI_EXPRESS_LIB_ADDRESS (Frame->Bus, Frame->Device, Frame->Func, 0);
+    if (MmioRead16 (Address) == 0xFFFF) {
+      if (Frame->Func == 0) {
+        Frame->Device++;
+      } else {
+        PciProbeNextFunc (Frame);
+      }
+      continue;
+    }
+
+    Task->Table->FuncMask[Frame->Bus][Frame->Device] |= (UINT8)(1 << Frame->Func);
+    HeaderType = MmioRead8 (Address + PCI_HEADER_TYPE_OFFSET);
+    if (Frame->Func == 0) {
+      Frame->MultiFunc = (HeaderType & HEADER_TYPE_MULTI_FUNCTION) != 0;
+    }
+
+    if (((HeaderType & HEADER_LAYOUT_CODE) != HEADER_TYPE_PCI_TO_PCI_BRIDGE) ||
+        (Depth >= PCI_MAX_BUS)) {
+      PciProbeNextFunc (Frame);
+      continue;
+    }
+
+    //
+    // Assign the bus numbers as PciScanBus () does and probe the secondary bus
+    //
+    SubBusNumber += 1;
+    MmioWrite16 (Address + PCI_BRIDGE_PRIMARY_BUS_REGISTER_OFFSET, (UINT16)((SubBusNumber << 8) | Frame->Bus));
+    MmioWrite8 (Address + PCI_BRIDGE_SUBORDINATE_BUS_REGISTER_OFFSET, Task->BusLimit);
+
+    Depth++;
+    ZeroMem (&Task->Stack[Depth], sizeof (PCI_PROBE_FRAME));
+    Task->Stack[Depth].Bus = SubBusNumber;
+    Task->Table->Probed[SubBusNumber] = 1;
+  }
+
+  Task->Ticks = AsmReadTsc () - Start;
+  return 0;
+}
+
 /**
  Scan Root Bridges depending on Pci Enumeration Policy
 
+ Root bridges from a bus list have independent bus number ranges. When the
+ MP service is available, the functions behind each root bridge are first
+ probed on idle APs in parallel. BSP then builds the device tree of each
+ root bridge in the bus list order, and PciDevicePresent () skips the config
+ reads of the functions that the probe did not find.
+
  @param [in]  EnumPolicy        PciEnum Policy with root bridge mask to be scanned
  @param [out] RootBridge        A pointer which has root bridges in ChildList
  @param [out] RootBridgeCount   The number of detected Root Bridges
@@ -1433,6 +1601,12 @@ PciScanRootBridges (
   UINT8                             Count;
   UINT8                             BusLimit;
   UINT32                            RootBridgeDecodes;
+  UINT64                            Ticks;
+  UINT32                            FreqKhz;
+  MP_SERVICE                       *MpService;
+  PCI_ROOT_PROBE_TASK              *Tasks;
+  PCI_ROOT_PROBE_TASK              *Task;
+  EFI_STATUS                        Status;
 
   if ((EnumPolicy == NULL) || (RootBridge == NULL) || (RootBridgeCount == NULL)) {
     return EFI_INVALID_PARAMETER;
@@ -1481,6 +1655,41 @@ PciScanRootBridges (
     RootBridgeDecodes &= (UINT32)~(EFI_BRIDGE_PMEM64_DECODE_SUPPORTED);
   }
 
+  //
+  // A bus range requires the subordinate bus number of the previous root
+  // bridge to locate the next one, so only a bus list can be probed in
+  // parallel. SR-IOV bus reservation needs the full device info, so it is
+  // not done by the probe.
+  //
+  MpService = NULL;
+  Tasks     = NULL;
+  if ((EnumPolicy->BusScanType == BusScanTypeList) && (EndIndex > StartIndex) &&
+      !FeaturePcdGet (PcdSrIovSupport)) {
+    MpService = (MP_SERVICE *) GetServiceBySignature (MP_SERVICE_SIGNATURE);
+  }
+
+  if (MpService != NULL) {
+    mPciProbeTable = (PCI_PROBE_TABLE *)PciAllocatePool (sizeof (PCI_PROBE_TABLE));
+    ZeroMem (mPciProbeTable, sizeof (PCI_PROBE_TABLE));
+    Tasks = (PCI_ROOT_PROBE_TASK *)PciAllocatePool (sizeof (PCI_ROOT_PROBE_TASK) * (EndIndex - StartIndex + 1));
+    ZeroMem (Tasks, sizeof (PCI_ROOT_PROBE_TASK) * (EndIndex - StartIndex + 1));
+    for (Index = StartIndex; Index <= EndIndex; Index++) {
+      Bus = EnumPolicy->BusScanItems[Index];
+      if (PciExpressRead16 (PCI_EXPRESS_LIB_ADDRESS (Bus, 0, 0, 0)) == 0xFFFF) {
+        continue;
+      }
+      Task = &Tasks[Index - StartIndex];
+      Task->PciExpressBase = (UINTN)PcdGet64 (PcdPciExpressBaseAddress);
+      Task->Table    = mPciProbeTable;
+      Task->Stack    = (PCI_PROBE_FRAME *)PciAllocatePool (sizeof (PCI_PROBE_FRAME) * (PCI_MAX_BUS + 1));
+      Task->Bus      = (UINT8)Bus;
+      Task->BusLimit = BusLimit;
+      Status = MpService->RunTask (PciProbeRootBridgeTask, (UINT32)(UINTN)Task, &Task->TaskId);
+      Task->OnAp = !EFI_ERROR (Status);
+    }
+  }
+
+  FreqKhz = GetTimeStampFrequency ();
   for (Index = StartIndex; Index <= EndIndex; Index++) {
     if (EnumPolicy->BusScanType == BusScanTypeList) {
       Bus = EnumPolicy->BusScanItems[Index];
@@ -1488,6 +1697,15 @@ PciScanRootBridges (
       Bus = Index;
     }
 
+    //
+    // Join the probe of this root bridge before building its device tree
+    //
+    Task = NULL;
+    if ((Tasks != NULL) && Tasks[Index - StartIndex].OnAp) {
+      Task = &Tasks[Index - StartIndex];
+      MpService->WaitTask (Task->TaskId, NULL);
+    }
+
     Address = PCI_EXPRESS_LIB_ADDRESS (Bus, 0, 0, 0);
     if (PciExpressRead16 (Address) != 0xFFFF) {
       Root = CreatePciIoDevice (NULL, NULL, (UINT8)Bus, 0, 0);
@@ -1495,8 +1713,10 @@ PciScanRootBridges (
       Root->BusNumberRanges.BusBase  = (UINT8)Bus;
       Root->BusNumberRanges.BusLimit = BusLimit;
 
+      Ticks = AsmReadTsc ();
       SubBusNumber = (UINT8)Bus;
       PciScanBus (Root, (UINT8)Bus, &SubBusNumber, NULL);
+      Ticks = AsmReadTsc () - Ticks;
       if (Bus == PCI_MAX_BUS) {
         SubBusNumber = (UINT8)Bus;
       }
@@ -1506,11 +1726,17 @@ PciScanRootBridges (
       InsertPciDevice (Bridge, Root);
       Count++;
 
+      DEBUG ((DEBUG_INFO, "PCI root bridge bus 0x%02X-0x%02X scanned in %d us, AP probe %d us\n",
+              Bus, SubBusNumber, (UINT32)DivU64x32 (MultU64x32 (Ticks, 1000), FreqKhz),
+              (Task != NULL) ? (UINT32)DivU64x32 (MultU64x32 (Task->Ticks, 1000), FreqKhz) : 0));
+
       if (EnumPolicy->BusScanType != BusScanTypeList) {
         Index = SubBusNumber;
       }
     }
   }
+  mPciProbeTable = NULL;
+
   *RootBridge = Bridge;
   *RootBridgeCount = Count;
 
@@ -1641,12 +1867,28 @@ PciEnumeration (
   UINT64                      BaseAddress;
   UINT8                       RootBridgeCount;
   EFI_STATUS                  Status;
+  BOOLEAN                     UseCache;
 
   SetAllocationPool (MemPool);
 
   EnumPolicy = (PCI_ENUM_POLICY_INFO *)PcdGetPtr (PcdPciEnumPolicyInfo);
   RootBridgeCount = 0;
 
+  //
+  // The cache only covers the standard configuration header, so it cannot
+  // be used with the ARI and SR-IOV extended capability programming.
+  //
+  UseCache = FeaturePcdGet (PcdPciEnumCacheEnabled) &&
+             !FeaturePcdGet (PcdAriSupport) && !FeaturePcdGet (PcdSrIovSupport);
+  if (UseCache) {
+    Status = PciEnumerationFromCache (EnumPolicy);
+    if (!EFI_ERROR (Status)) {
+      SetAllocationPool (MemPool);
+      return EFI_SUCCESS;
+    }
+    SetAllocationPool (MemPool);
+  }
+
   Status = PciScanRootBridges (EnumPolicy, &RootBridge, &RootBridgeCount);
   ASSERT_EFI_ERROR (Status);
   ASSERT (RootBridgeCount > 0);
@@ -1681,6 +1923,10 @@ PciEnumeration (
 
   BuildPciRootBridgeInfoHob (RootBridge, RootBridgeCount);
 
+  if (UseCache) {
+    SavePciEnumerationCache (EnumPolicy, RootBridge);
+  }
+
 #if DEBUG_PCI_ENUM
   DumpPciResources (RootBridge);
   DumpPciRootBridgeInfoHob ();
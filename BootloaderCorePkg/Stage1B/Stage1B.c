@@ -1,6 +1,6 @@
 /** @file
 
-  Copyright (c) 2016 - 2019, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2016 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -353,6 +353,7 @@ SecStartup2 (
   PLT_DEVICE_TABLE         *DeviceTable;
   CONTAINER_LIST           *ContainerList;
   CONTAINER_ENTRY          *ContainerEntry;
+  COMPONENT_PROFILE        *ComponentProfile;
   VOID                    **FieldPtr;
 
   LdrGlobal = (LOADER_GLOBAL_DATA *)GetLoaderGlobalDataPointer ();
@@ -396,6 +397,12 @@ SecStartup2 (
 
   BoardInit (PostConfigInit);
 
+  // Platform ID and CFGDATA are final now, index the tags for quick lookup
+  Status = BuildConfigDataIndex ();
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "Build CFGDATA index ... %r\n", Status));
+  }
+
   //Get Platform ID and Boot Mode
   DEBUG ((DEBUG_INIT, "BOOT: BP%d \nMODE: %d\nBoardID: 0x%02X\n",
           GetCurrentBootPartition (), GetBootMode (), GetPlatformId ()));
@@ -446,6 +453,11 @@ SecStartup2 (
   LdrGlobal->MemPoolStart      = MemPoolStart;
   LdrGlobal->MemPoolCurrTop    = MemPoolCurrTop;
   LdrGlobal->MemPoolCurrBottom = MemPoolStart;
+  LdrGlobal->MemPoolMinTop     = MemPoolCurrTop;
+  LdrGlobal->MemPoolFreeList   = 0;
+  LdrGlobal->MemPoolFreeSize   = 0;
+  LdrGlobal->MemPoolFreeCount  = 0;
+  LdrGlobal->MemPoolPageList   = 0;
   LdrGlobal->MemUsableTop      = (UINT32)(FspReservedMemBase + FspReservedMemSize);
 
   if (FeaturePcdGet (PcdDmaProtectionEnabled)) {
@@ -553,6 +565,16 @@ SecStartup2 (
     CopyMem (LdrGlobal->DeviceTable, DeviceTable, AllocateLen);
   }
 
+  // Copy component load profile to memory
+  ComponentProfile = (COMPONENT_PROFILE *) LdrGlobal->ComponentProfile;
+  if (ComponentProfile != NULL) {
+    AllocateLen = sizeof (COMPONENT_PROFILE) + sizeof (COMPONENT_PROFILE_ENTRY) * ComponentProfile->MaxCount;
+    LdrGlobal->ComponentProfile = AllocatePool (AllocateLen);
+    if (LdrGlobal->ComponentProfile != NULL) {
+      CopyMem (LdrGlobal->ComponentProfile, ComponentProfile, AllocateLen);
+    }
+  }
+
   // Migrate container header cache into memory
   ContainerList = (CONTAINER_LIST *) LdrGlobal->ContainerList;
   if (ContainerList != NULL) {
@@ -1,12 +1,42 @@
 /** @file
 
-  Copyright (c) 2016 - 2019, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2016 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
 
 #include "Stage2.h"
 
+// Create a MP service to dispatch tasks onto idle APs
+CONST MP_SERVICE   mMpService = {
+  .Header.Signature = MP_SERVICE_SIGNATURE,
+  .Header.Version   = MP_SERVICE_VERSION,
+  .RunTask          = MpRunTaskOnIdleAp,
+  .WaitTask         = MpWaitTask
+};
+
+// Components loaded in the background by the payload preload task
+#define  PRELOAD_PAYLOAD    0
+#define  PRELOAD_CMDLINE    1
+#define  PRELOAD_INITRD     2
+#define  PRELOAD_MAX        3
+
+typedef struct {
+  UINT32                   PayloadId;
+  UINT32                   TaskId;
+  UINT32                   Valid;
+  BOOLEAN                  Joined;
+  UINT64                   Ticks;
+  COMPONENT_LOAD_CONTEXT   Load[PRELOAD_MAX];
+} PAYLOAD_PRELOAD;
+
+CONST UINT32     mPreloadName[PRELOAD_MAX] = {
+  0,
+  SIGNATURE_32 ('C', 'M', 'D', 'L'),
+  SIGNATURE_32 ('I', 'N', 'R', 'D')
+};
+
+PAYLOAD_PRELOAD  mPayloadPreload;
 
 /**
   Callback function to add performance measure point during component loading.
@@ -51,27 +81,25 @@ LoadComponentCallback (
 }
 
 /**
-  Prepare and load payload into proper location for execution.
+  Get the container and component to load the payload from.
 
-  @param[in]  Stage2Param    Param pointer for Stage2
+  @param[out] ContainerSig    Pointer to receive the container signature or component type.
+  @param[out] ComponentName   Pointer to receive the component name.
+  @param[out] Dst             Pointer to receive the payload load base, 0 if it
+                              should be allocated.
 
-  @retval     The base address of the payload.
-              0 if loading fails.
+  @retval     The payload ID.
 
 **/
 UINT32
-PreparePayload (
-  IN STAGE2_PARAM   *Stage2Param
+GetPayloadComponent (
+  OUT UINT32   *ContainerSig,
+  OUT UINT32   *ComponentName,
+  OUT UINT32   *Dst
   )
 {
-  EFI_STATUS                     Status;
-  UINT32                         Dst;
-  UINT32                         DstLen;
-  VOID                          *DstAdr;
   BOOLEAN                        IsNormalPld;
   UINT32                         PayloadId;
-  UINT32                         ContainerSig;
-  UINT32                         ComponentName;
   UINT8                          BootMode;
 
   BootMode = GetBootMode();
@@ -86,31 +114,260 @@ PreparePayload (
   DEBUG ((DEBUG_INFO, "Loading Payload ID 0x%08X\n", PayloadId));
   IsNormalPld = (PayloadId == 0) ? TRUE : FALSE;
   if (BootMode == BOOT_ON_FLASH_UPDATE) {
-    ContainerSig  = COMP_TYPE_PAYLOAD_FWU;
-    ComponentName = FLASH_MAP_SIG_FWUPDATE;
+    *ContainerSig  = COMP_TYPE_PAYLOAD_FWU;
+    *ComponentName = FLASH_MAP_SIG_FWUPDATE;
   } else {
     if (IsNormalPld) {
-      ContainerSig  = COMP_TYPE_PAYLOAD;
-      ComponentName = FLASH_MAP_SIG_PAYLOAD;
+      *ContainerSig  = COMP_TYPE_PAYLOAD;
+      *ComponentName = FLASH_MAP_SIG_PAYLOAD;
     } else {
-      ContainerSig  = FLASH_MAP_SIG_EPAYLOAD;
-      ComponentName = PayloadId;
+      *ContainerSig  = FLASH_MAP_SIG_EPAYLOAD;
+      *ComponentName = PayloadId;
     }
   }
 
-  Dst = PcdGet32 (PcdPayloadExeBase);
+  *Dst = PcdGet32 (PcdPayloadExeBase);
   if (FixedPcdGetBool (PcdPayloadLoadHigh)) {
-    PayloadId = GetPayloadId();
     if ((PayloadId != LINX_PAYLOAD_ID_SIGNATURE) && (PayloadId != UEFI_PAYLOAD_ID_SIGNATURE)) {
-      Dst = 0;
+      *Dst = 0;
+    }
+  }
+
+  return PayloadId;
+}
+
+/**
+  Load the preloaded components on an AP.
+
+  It only copies, authenticates and decompresses the components prepared by
+  StartPayloadLoad (), so it is safe to run on an AP.
+
+  @param[in] Argument     Pointer to PAYLOAD_PRELOAD.
+
+  @retval                 Always 0.
+**/
+UINT32
+PayloadLoadTask (
+  IN UINT32   Argument
+  )
+{
+  PAYLOAD_PRELOAD   *Preload;
+  UINT64             Start;
+  UINT32             Index;
+
+  Preload = (PAYLOAD_PRELOAD *)(UINTN)Argument;
+  Start   = AsmReadTsc ();
+  for (Index = 0; Index < PRELOAD_MAX; Index++) {
+    if ((Preload->Valid & (1 << Index)) != 0) {
+      ExecuteComponentLoad (&Preload->Load[Index], NULL);
+    }
+  }
+  Preload->Ticks = AsmReadTsc () - Start;
+
+  return 0;
+}
+
+/**
+  Start loading the payload on an idle AP.
+
+  The payload, and the kernel command line and InitRd for a Linux payload,
+  are located and their buffers are allocated on BSP. Their copy,
+  authentication and decompression then run on an AP in parallel with the
+  rest of Stage2. PreparePayload () joins the task afterwards, and the
+  payload is loaded on BSP as usual if the preload cannot be started.
+
+**/
+VOID
+StartPayloadLoad (
+  VOID
+  )
+{
+  MP_SERVICE                    *MpService;
+  EFI_STATUS                     Status;
+  UINT32                         ContainerSig;
+  UINT32                         ComponentName;
+  UINT32                         Dst;
+  UINT32                         Index;
+
+  MpService = (MP_SERVICE *) GetServiceBySignature (MP_SERVICE_SIGNATURE);
+  if (MpService == NULL) {
+    return;
+  }
+
+  ZeroMem (&mPayloadPreload, sizeof (mPayloadPreload));
+  mPayloadPreload.PayloadId = GetPayloadComponent (&ContainerSig, &ComponentName, &Dst);
+  Status = PrepareComponentLoad (ContainerSig, ComponentName, (VOID *)(UINTN)Dst, 0, TRUE,
+                                 &mPayloadPreload.Load[PRELOAD_PAYLOAD]);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "Payload preload skipped - %r\n", Status));
+    return;
+  }
+  mPayloadPreload.Valid = 1 << PRELOAD_PAYLOAD;
+
+  if (FeaturePcdGet (PcdLinuxPayloadEnabled) && (mPayloadPreload.PayloadId == LINX_PAYLOAD_ID_SIGNATURE)) {
+    for (Index = PRELOAD_CMDLINE; Index < PRELOAD_MAX; Index++) {
+      Status = PrepareComponentLoad (FLASH_MAP_SIG_EPAYLOAD, mPreloadName[Index], NULL, 0, TRUE,
+                                     &mPayloadPreload.Load[Index]);
+      if (!EFI_ERROR (Status)) {
+        mPayloadPreload.Valid |= 1 << Index;
+      }
+    }
+  }
+
+  Status = MpService->RunTask (PayloadLoadTask, (UINT32)(UINTN)&mPayloadPreload, &mPayloadPreload.TaskId);
+  if (EFI_ERROR (Status)) {
+    // Release the buffers and load the payload on BSP later
+    for (Index = 0; Index < PRELOAD_MAX; Index++) {
+      if ((mPayloadPreload.Valid & (1 << Index)) != 0) {
+        FinishComponentLoad (&mPayloadPreload.Load[Index], NULL, NULL, NULL);
+      }
+    }
+    mPayloadPreload.Valid = 0;
+    DEBUG ((DEBUG_INFO, "Payload preload skipped - %r\n", Status));
+    return;
+  }
+
+  DEBUG ((DEBUG_INFO, "Payload preload started on AP\n"));
+}
+
+/**
+  Get a component loaded by the payload preload task.
+
+  It waits for the preload task to complete on the first call.
+
+  @param[in]  Index       Preload index, PRELOAD_PAYLOAD, PRELOAD_CMDLINE or PRELOAD_INITRD.
+  @param[in]  PayloadId   Current payload ID.
+  @param[out] Buffer      Pointer to receive component base.
+  @param[out] Length      Pointer to receive component size.
+
+  @retval EFI_NOT_STARTED   The component was not preloaded.
+  @retval Others            The component load status.
+
+**/
+EFI_STATUS
+GetPreloadedComponent (
+  IN  UINT32     Index,
+  IN  UINT32     PayloadId,
+  OUT VOID     **Buffer,
+  OUT UINT32    *Length
+  )
+{
+  MP_SERVICE                    *MpService;
+  UINT32                         Count;
+
+  if ((mPayloadPreload.Valid & (1 << Index)) == 0) {
+    return EFI_NOT_STARTED;
+  }
+
+  if (!mPayloadPreload.Joined) {
+    mPayloadPreload.Joined = TRUE;
+    MpService = (MP_SERVICE *) GetServiceBySignature (MP_SERVICE_SIGNATURE);
+    MpService->WaitTask (mPayloadPreload.TaskId, NULL);
+    DEBUG ((DEBUG_INFO, "Payload preload completed on AP in %d us\n",
+            (UINT32)DivU64x32 (MultU64x32 (mPayloadPreload.Ticks, 1000), GetTimeStampFrequency ())));
+
+    // Board code might have selected another payload after the preload started
+    if (mPayloadPreload.PayloadId != PayloadId) {
+      DEBUG ((DEBUG_INFO, "Payload ID changed, drop the preloaded payload\n"));
+      for (Count = 0; Count < PRELOAD_MAX; Count++) {
+        if ((mPayloadPreload.Valid & (1 << Count)) != 0) {
+          mPayloadPreload.Load[Count].Status = EFI_ABORTED;
+          FinishComponentLoad (&mPayloadPreload.Load[Count], NULL, NULL, NULL);
+        }
+      }
+      mPayloadPreload.Valid = 0;
+      return EFI_NOT_STARTED;
     }
   }
 
+  mPayloadPreload.Valid &= ~(1 << Index);
+  return FinishComponentLoad (&mPayloadPreload.Load[Index],
+                              (Index == PRELOAD_PAYLOAD) ? LoadComponentCallback : NULL, Buffer, Length);
+}
+
+/**
+  Load a component from the extra payload container.
+
+  The component loaded by the payload preload task is used if available.
+
+  @param[in]  Index       Preload index, PRELOAD_CMDLINE or PRELOAD_INITRD.
+  @param[out] Buffer      Pointer to receive component base.
+  @param[out] Length      Pointer to receive component size.
+
+  @retval     The component load status.
+
+**/
+EFI_STATUS
+LoadExtraPayloadComponent (
+  IN  UINT32     Index,
+  OUT VOID     **Buffer,
+  OUT UINT32    *Length
+  )
+{
+  EFI_STATUS                     Status;
+
+  Status = GetPreloadedComponent (Index, GetPayloadId (), Buffer, Length);
+  if (Status == EFI_NOT_STARTED) {
+    Status = LoadComponent (FLASH_MAP_SIG_EPAYLOAD, mPreloadName[Index], Buffer, Length);
+  }
+
+  return Status;
+}
+
+/**
+  Free the preloaded components that are not used by the payload.
+
+**/
+VOID
+ReleasePreloadedComponents (
+  VOID
+  )
+{
+  EFI_STATUS                     Status;
+  VOID                          *Buffer;
+  UINT32                         Length;
+  UINT32                         Index;
+
+  for (Index = 0; Index < PRELOAD_MAX; Index++) {
+    Status = GetPreloadedComponent (Index, GetPayloadId (), &Buffer, &Length);
+    if (!EFI_ERROR (Status)) {
+      FreePages (Buffer, EFI_SIZE_TO_PAGES (Length));
+    }
+  }
+}
+
+/**
+  Prepare and load payload into proper location for execution.
+
+  @param[in]  Stage2Param    Param pointer for Stage2
+
+  @retval     The base address of the payload.
+              0 if loading fails.
+
+**/
+UINT32
+PreparePayload (
+  IN STAGE2_PARAM   *Stage2Param
+  )
+{
+  EFI_STATUS                     Status;
+  UINT32                         Dst;
+  UINT32                         DstLen;
+  VOID                          *DstAdr;
+  UINT32                         PayloadId;
+  UINT32                         ContainerSig;
+  UINT32                         ComponentName;
+
+  PayloadId = GetPayloadComponent (&ContainerSig, &ComponentName, &Dst);
+
   AddMeasurePoint (0x3100);
   DstLen = 0;
   DstAdr = (VOID *)(UINTN)Dst;
-  Status = LoadComponentWithCallback (ContainerSig, ComponentName,
-                                      &DstAdr, &DstLen, LoadComponentCallback);
+  Status = GetPreloadedComponent (PRELOAD_PAYLOAD, PayloadId, &DstAdr, &DstLen);
+  if (Status == EFI_NOT_STARTED) {
+    Status = LoadComponentWithCallback (ContainerSig, ComponentName,
+                                        &DstAdr, &DstLen, LoadComponentCallback);
+  }
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "Loading payload error - %r !", Status));
     return 0;
@@ -194,8 +451,7 @@ NormalBootPath (
         InitRdLen  = 0;
         CmdLine    = NULL;
         CmdLineLen = 0;
-        Status = LoadComponent (FLASH_MAP_SIG_EPAYLOAD, SIGNATURE_32 ('C', 'M', 'D', 'L'),
-                                (VOID **)&CmdLine, &CmdLineLen);
+        Status = LoadExtraPayloadComponent (PRELOAD_CMDLINE, (VOID **)&CmdLine, &CmdLineLen);
         if (!EFI_ERROR (Status)) {
           // Limit max command line length
           if (CmdLineLen > CMDLINE_LENGTH_MAX - 1) {
@@ -206,8 +462,7 @@ NormalBootPath (
         }
 
         // Try to load InitRd if it exists. If loading fails, continue booting
-        Status = LoadComponent (FLASH_MAP_SIG_EPAYLOAD, SIGNATURE_32 ('I', 'N', 'R', 'D'),
-                                (VOID **)&InitRd, &InitRdLen);
+        Status = LoadExtraPayloadComponent (PRELOAD_INITRD, (VOID **)&InitRd, &InitRdLen);
         if (!EFI_ERROR (Status)) {
           DEBUG ((DEBUG_INFO, "InitRD is loaded at 0x%x:0x%x\n", InitRd, InitRdLen));
         }
@@ -227,6 +482,9 @@ NormalBootPath (
   AddMeasurePoint (0x31B0);
   ASSERT_EFI_ERROR (Status);
 
+  ReleasePreloadedComponents ();
+  WaitSplashDisplay ();
+
   if (FixedPcdGetBool (PcdSmpEnabled)) {
     DEBUG ((DEBUG_INIT, "MP Init%a\n", DebugCodeEnabled() ? " (Done)" : ""));
     Status = MpInit (EnumMpInitDone);
@@ -260,8 +518,17 @@ NormalBootPath (
 
   AddMeasurePoint (0x31F0);
 
+  if (ACPI_ENABLED ()) {
+    // Export the boot timeline through the ACPI FPDT
+    Status = UpdateFpdtBootTimeline (((S3_DATA *)LdrGlobal->S3DataPtr)->AcpiBase);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_INFO, "FPDT boot timeline not updated: %r\n", Status));
+    }
+  }
+
   DEBUG ((DEBUG_INFO, "HOB @ 0x%08X\n", LdrGlobal->LdrHobList));
   PldHobList = BuildExtraInfoHob (Stage2Param);
+  DEBUG ((DEBUG_INFO, "HOB directory saved %d HOB list walks\n", GetHobDirectorySavedWalks ()));
 
   DEBUG_CODE_BEGIN ();
   PrintStackHeapInfo ();
@@ -309,6 +576,8 @@ S3ResumePath (
   LdrGlobal = (LOADER_GLOBAL_DATA *)GetLoaderGlobalDataPointer();
   S3Data    = (S3_DATA *)LdrGlobal->S3DataPtr;
 
+  WaitSplashDisplay ();
+
   if (FixedPcdGetBool (PcdSmpEnabled)) {
     DEBUG ((DEBUG_INFO, "MP Init (Done)\n"));
     MpInit (EnumMpInitDone);
@@ -355,6 +624,7 @@ SecStartup (
 {
   EFI_STATUS                      Status;
   EFI_STATUS                      SubStatus;
+  EFI_STATUS                      VarBatchStatus;
   STAGE2_PARAM                   *Stage2Param;
   VOID                           *NvsData;
   UINT32                          MrcDataLen;
@@ -434,8 +704,8 @@ SecStartup (
   // Create base HOB
   BuildBaseInfoHob (Stage2Param);
 
-  // Display splash
-  if (FixedPcdGetBool (PcdSplashEnabled)) {
+  // Display splash, unless it is drawn on an AP after MP init
+  if (FixedPcdGetBool (PcdSplashEnabled) && !FeaturePcdGet (PcdAsyncSplashEnabled)) {
     DisplaySplash ();
     AddMeasurePoint (0x3050);
   }
@@ -454,10 +724,22 @@ SecStartup (
   if (FixedPcdGetBool (PcdSmpEnabled) && !EFI_ERROR (Status)) {
     DEBUG ((DEBUG_INFO, "MP Init (Run)\n"));
     Status = MpInit (EnumMpInitRun);
+    if (!EFI_ERROR (Status)) {
+      RegisterService ((VOID *)&mMpService);
+    }
     AddMeasurePoint (0x3080);
   }
   ASSERT_EFI_ERROR (Status);
 
+  // Load payload on an AP in parallel with the rest of Stage2
+  if (FeaturePcdGet (PcdAsyncPayloadLoadEnabled) &&
+      (BootMode != BOOT_ON_S3_RESUME) && (BootMode != BOOT_ON_FLASH_UPDATE)) {
+    StartPayloadLoad ();
+  }
+
+  // Collect the variable updates around PCI enumeration into a single flash write-back
+  VarBatchStatus = StartVariableBatch ();
+
   // PCI Enumeration
   BoardInit (PrePciEnumeration);
   AddMeasurePoint (0x3090);
@@ -481,6 +763,18 @@ SecStartup (
     ASSERT_EFI_ERROR (Status);
   }
 
+  if (!EFI_ERROR (VarBatchStatus)) {
+    VarBatchStatus = CommitVariableBatch ();
+    if (EFI_ERROR (VarBatchStatus)) {
+      DEBUG ((DEBUG_WARN, "Variable batch commit error, status = %r\n", VarBatchStatus));
+    }
+  }
+
+  // Draw splash on an AP once PCI resources are assigned, or on BSP if no AP can take it
+  if (FixedPcdGetBool (PcdSplashEnabled) && FeaturePcdGet (PcdAsyncSplashEnabled)) {
+    StartSplashDisplay ();
+  }
+
   // ACPI Initialization
   if (ACPI_ENABLED ()) {
     AcpiGnvs = 0;
@@ -12,6 +12,7 @@
 #include <Library/DebugLib.h>
 #include <Library/PcdLib.h>
 #include <Library/HobLib.h>
+#include <Library/ExtraHobLib.h>
 #include <Library/BootloaderCoreLib.h>
 #include <Library/BootloaderCommonLib.h>
 #include <Library/DecompressLib.h>
@@ -49,6 +50,7 @@
 #include <Guid/GraphicsInfoHob.h>
 #include <Guid/SmmInformationGuid.h>
 #include <Service/PlatformService.h>
+#include <Service/MpService.h>
 #include <Pi/PiBootMode.h>
 #include <FspEas.h>
 #include <Service/PlatformService.h>
@@ -57,6 +59,8 @@
 #include <Library/DebugAgentLib.h>
 #include <Library/ElfLib.h>
 #include <Library/SmbiosInitLib.h>
+#include <Library/TimeStampLib.h>
+#include <Library/VariableLib.h>
 #include <VerInfo.h>
 
 #define UIMAGE_FIT_MAGIC               (0x56190527)
@@ -108,6 +112,30 @@ DisplaySplash (
   VOID
   );
 
+/**
+  Draw the graphical splash screen, on an idle AP if possible.
+
+  It must be called after PCI enumeration.
+
+  @retval EFI_SUCCESS     Splash screen task was started or drawn on BSP
+  @retval EFI_UNSUPPORTED Frame buffer access not supported
+  @retval Others          Splash screen cannot be drawn
+
+**/
+EFI_STATUS
+StartSplashDisplay (
+  VOID
+  );
+
+/**
+  Wait for the splash screen task started by StartSplashDisplay () to complete.
+
+**/
+VOID
+WaitSplashDisplay (
+  VOID
+  );
+
 /**
   Load payload from boot media to its execution address.
 
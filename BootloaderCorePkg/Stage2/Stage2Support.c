@@ -1,6 +1,6 @@
 /** @file
 
-  Copyright (c) 2016 - 2019, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2016 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -9,6 +9,17 @@
 
 UINT8   mFspPhaseMask;
 
+typedef struct {
+  VOID                       *SplashLogoBmp;
+  VOID                       *GopBlt;
+  UINTN                       GopBltSize;
+  EFI_PEI_GRAPHICS_INFO_HOB   GfxInfo;
+  UINT32                      TaskId;
+  BOOLEAN                     Started;
+} SPLASH_TASK;
+
+SPLASH_TASK  mSplashTask;
+
 // Create a platform service
 const PLATFORM_SERVICE   mPlatformService = {
   .Header.Signature = PLATFORM_SERVICE_SIGNATURE,
@@ -106,6 +117,130 @@ DisplaySplash (
   return Status;
 }
 
+/**
+  Draw the splash screen on an AP.
+
+  The line buffer is allocated by StartSplashDisplay () so that the BMP
+  conversion does not allocate memory or print on the AP.
+
+  @param[in] Argument     Pointer to SPLASH_TASK.
+
+  @retval                 Status of DisplayBmpToFrameBuffer ().
+**/
+UINT32
+SplashTask (
+  IN UINT32   Argument
+  )
+{
+  SPLASH_TASK   *Splash;
+
+  Splash = (SPLASH_TASK *)(UINTN)Argument;
+  return (UINT32)DisplayBmpToFrameBuffer (Splash->SplashLogoBmp, &Splash->GopBlt,
+                                          &Splash->GopBltSize, &Splash->GfxInfo);
+}
+
+/**
+  Draw the graphical splash screen, on an idle AP if possible.
+
+  It must be called after PCI enumeration since the frame buffer BAR may be
+  reassigned by the enumeration. The frame buffer address is re-read through
+  the board HOB update hook into a private copy of the graphics info.
+
+  The BMP image is validated and the line buffer is allocated on BSP, and the
+  pixel conversion and frame buffer writes then run on an AP in parallel with
+  the rest of Stage2. If no AP can take the task, the splash screen is drawn
+  on BSP.
+
+  @retval EFI_SUCCESS     Splash screen task was started or drawn on BSP
+  @retval EFI_UNSUPPORTED Frame buffer access not supported
+  @retval Others          Splash screen cannot be drawn
+
+**/
+EFI_STATUS
+StartSplashDisplay (
+  VOID
+  )
+{
+  EFI_STATUS                          Status;
+  MP_SERVICE                         *MpService;
+  VOID                               *Probe;
+
+  EFI_PEI_GRAPHICS_INFO_HOB          *GfxInfoHob;
+
+  ZeroMem (&mSplashTask, sizeof (mSplashTask));
+  GfxInfoHob = (EFI_PEI_GRAPHICS_INFO_HOB *)GetGuidHobData (NULL, NULL, &gEfiGraphicsInfoHobGuid);
+  if (GfxInfoHob == NULL) {
+    return EFI_UNSUPPORTED;
+  }
+  CopyMem (&mSplashTask.GfxInfo, GfxInfoHob, sizeof (EFI_PEI_GRAPHICS_INFO_HOB));
+  PlatformUpdateHobInfo (&gEfiGraphicsInfoHobGuid, &mSplashTask.GfxInfo);
+
+  mSplashTask.SplashLogoBmp = (VOID *)(UINTN)PCD_GET32_WITH_ADJUST (PcdSplashLogoAddress);
+  ASSERT (mSplashTask.SplashLogoBmp != NULL);
+
+  // Validate the image and get the line buffer size it needs
+  Probe  = &mSplashTask;
+  Status = DisplayBmpToFrameBuffer (mSplashTask.SplashLogoBmp, &Probe, &mSplashTask.GopBltSize,
+                                    &mSplashTask.GfxInfo);
+  if (Status != EFI_BUFFER_TOO_SMALL) {
+    return EFI_ERROR (Status) ? Status : EFI_UNSUPPORTED;
+  }
+
+  mSplashTask.GopBlt = AllocatePool (mSplashTask.GopBltSize);
+  if (mSplashTask.GopBlt == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status    = EFI_UNSUPPORTED;
+  MpService = (MP_SERVICE *) GetServiceBySignature (MP_SERVICE_SIGNATURE);
+  if (MpService != NULL) {
+    Status = MpService->RunTask (SplashTask, (UINT32)(UINTN)&mSplashTask, &mSplashTask.TaskId);
+  }
+  if (EFI_ERROR (Status)) {
+    // No AP can take it, draw on BSP
+    Status = DisplayBmpToFrameBuffer (mSplashTask.SplashLogoBmp, &mSplashTask.GopBlt,
+                                      &mSplashTask.GopBltSize, &mSplashTask.GfxInfo);
+    FreePool (mSplashTask.GopBlt);
+    mSplashTask.GopBlt = NULL;
+    return Status;
+  }
+
+  mSplashTask.Started = TRUE;
+  DEBUG ((DEBUG_INFO, "Splash screen started on AP\n"));
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Wait for the splash screen task started by StartSplashDisplay () to complete.
+
+**/
+VOID
+WaitSplashDisplay (
+  VOID
+  )
+{
+  MP_SERVICE                         *MpService;
+  UINT32                              Result;
+
+  if (!mSplashTask.Started) {
+    return;
+  }
+
+  mSplashTask.Started = FALSE;
+  MpService = (MP_SERVICE *) GetServiceBySignature (MP_SERVICE_SIGNATURE);
+  if (MpService != NULL) {
+    Result = (UINT32)EFI_SUCCESS;
+    MpService->WaitTask (mSplashTask.TaskId, &Result);
+    if (Result != (UINT32)EFI_SUCCESS) {
+      DEBUG ((DEBUG_INFO, "Splash screen on AP failed - 0x%x\n", Result));
+    }
+  }
+
+  FreePool (mSplashTask.GopBlt);
+  mSplashTask.GopBlt = NULL;
+}
+
 /**
   Print out the current memory map information
 
@@ -435,6 +570,8 @@ BuildExtraInfoHob (
   SYSTEM_TABLE_INFO                *SystemTableInfo;
   SYS_CPU_INFO                     *SysCpuInfo;
   PERFORMANCE_INFO                 *PerformanceInfo;
+  COMPONENT_PROFILE                *ComponentProfile;
+  COMPONENT_PROFILE                *ComponentProfileHob;
   OS_BOOT_OPTION_LIST              *OsBootOptionInfo;
   EFI_PEI_GRAPHICS_INFO_HOB        *GfxInfoHob;
   EFI_PEI_GRAPHICS_DEVICE_INFO_HOB *GfxDeviceInfoHob;
@@ -571,6 +708,21 @@ BuildExtraInfoHob (
     CopyMem (PerformanceInfo->TimeStamp, LdrGlobal->PerfData.TimeStamp, sizeof (UINT64) * Count);
   }
 
+  // Build component load profile Hob with room for the payload to append
+  Length = sizeof (COMPONENT_PROFILE) + sizeof (COMPONENT_PROFILE_ENTRY) * COMPONENT_PROFILE_MAX_ENTRIES;
+  ComponentProfileHob = BuildGuidHob (&gLoaderComponentProfileGuid, Length);
+  if (ComponentProfileHob != NULL) {
+    ZeroMem (ComponentProfileHob, Length);
+    ComponentProfileHob->Revision = COMPONENT_PROFILE_REVISION;
+    ComponentProfileHob->MaxCount = COMPONENT_PROFILE_MAX_ENTRIES;
+    ComponentProfile = (COMPONENT_PROFILE *)LdrGlobal->ComponentProfile;
+    if (ComponentProfile != NULL) {
+      Count = MIN (ComponentProfile->Count, COMPONENT_PROFILE_MAX_ENTRIES);
+      ComponentProfileHob->Count = (UINT16)Count;
+      CopyMem (ComponentProfileHob->Entry, ComponentProfile->Entry, sizeof (COMPONENT_PROFILE_ENTRY) * Count);
+    }
+  }
+
   // Build Loader Platform info Hob
   Length       = sizeof (LOADER_PLATFORM_INFO);
   LoaderPlatformInfo = BuildGuidHob (&gLoaderPlatformInfoGuid, Length);
@@ -619,11 +771,21 @@ PrintStackHeapInfo (
 
   DEBUG ((
            DEBUG_INFO,
-           "Stage2 heap: 0x%X (0x%X used, 0x%X free)\n",
+           "Stage2 heap: 0x%X (0x%X used, 0x%X free, 0x%X peak)\n",
            LdrGlobal->MemPoolEnd - LdrGlobal->MemPoolStart,
-           LdrGlobal->MemPoolEnd - LdrGlobal->MemPoolCurrTop,
-           LdrGlobal->MemPoolCurrTop - LdrGlobal->MemPoolStart
+           LdrGlobal->MemPoolEnd - LdrGlobal->MemPoolCurrTop - LdrGlobal->MemPoolFreeSize,
+           LdrGlobal->MemPoolCurrTop - LdrGlobal->MemPoolStart + LdrGlobal->MemPoolFreeSize,
+           LdrGlobal->MemPoolEnd - LdrGlobal->MemPoolMinTop
            ));
+
+  if (LdrGlobal->MemPoolFreeCount > 0) {
+    DEBUG ((
+             DEBUG_INFO,
+             "Stage2 heap: 0x%X free in %d fragments\n",
+             LdrGlobal->MemPoolFreeSize,
+             LdrGlobal->MemPoolFreeCount
+             ));
+  }
 }
 
 
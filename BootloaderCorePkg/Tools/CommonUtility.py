@@ -62,6 +62,9 @@ AUTH_TYPE_HASH_VALUE = {
             "RSA3072SHA384"  : 2,
     }
 
+# Uncompressed block size for block-split LZ4 (LZ4B) compression
+LZ4_BLOCK_SIZE = 0x40000
+
 HASH_DIGEST_SIZE = {
             # Hash_string : Hash_Size
             "SHA2_256"    : 32,
@@ -109,6 +112,7 @@ class LZ_HEADER(Structure):
     _compress_alg = {
         b'LZDM' : 'Dummy',
         b'LZ4 ' : 'Lz4',
+        b'LZ4B' : 'Lz4b',
         b'LZMA' : 'Lzma',
     }
 
@@ -328,7 +332,7 @@ def decompress (in_file, out_file, tool_dir = ''):
     temp   = os.path.splitext(out_file)[0] + '.tmp'
     if lz_hdr.signature == b"LZMA":
         alg = "Lzma"
-    elif lz_hdr.signature == b"LZ4 ":
+    elif lz_hdr.signature in [b"LZ4 ", b"LZ4B"]:
         alg = "Lz4"
     else:
         raise Exception ("Unsupported compression '%s' !" % lz_hdr.signature)
@@ -342,6 +346,8 @@ def decompress (in_file, out_file, tool_dir = ''):
         "-d",
         "-o", out_file,
         temp]
+    if lz_hdr.signature == b"LZ4B":
+        cmdline[2:2] = ["-b", "%d" % LZ4_BLOCK_SIZE]
     run_process (cmdline, False, True)
     os.remove(temp)
 
@@ -364,6 +370,9 @@ def compress (in_file, alg, svn=0, out_path = '', tool_dir = ''):
         sig = "LZUF"
     elif alg == "Lz4":
         sig = "LZ4 "
+    elif alg == "Lz4b":
+        # Block-split LZ4, blocks can be decompressed in parallel
+        sig = "LZ4B"
     elif alg == "Dummy":
         sig = "LZDM"
     else:
@@ -374,12 +383,17 @@ def compress (in_file, alg, svn=0, out_path = '', tool_dir = ''):
         if sig == "LZDM":
             shutil.copy(in_file, out_file)
         else:
-            compress_tool = "%sCompress" % alg
+            if sig == "LZ4B":
+                compress_tool = "Lz4Compress"
+            else:
+                compress_tool = "%sCompress" % alg
             cmdline = [
                 os.path.join (tool_dir, compress_tool),
                 "-e",
                 "-o", out_file,
                 in_file]
+            if sig == "LZ4B":
+                cmdline[2:2] = ["-b", "%d" % LZ4_BLOCK_SIZE]
             run_process (cmdline, False, True)
         compress_data = get_file_data(out_file)
     else:
@@ -639,7 +639,7 @@ class CONTAINER ():
                     offset = sizeof(lz_header)
                     data = component.data[offset : offset + lz_header.compressed_len]
                     gen_file_from_object (bin_file, data)
-                elif signature in [b'LZMA', b'LZ4 ']:
+                elif signature in [b'LZMA', b'LZ4 ', b'LZ4B']:
                     decompress (sig_file, bin_file, self.tool_dir)
                 else:
                     raise Exception ("Unknown LZ format!")
@@ -835,7 +835,7 @@ def main():
     cmd_display.add_argument('-o',  dest='out_image',  type=str, default='', help='Container new output image path')
     cmd_display.add_argument('-n',  dest='comp_name',  type=str, required=True, help='Component name to replace')
     cmd_display.add_argument('-f',  dest='comp_file',  type=str, required=True, help='Component input file path')
-    cmd_display.add_argument('-c',  dest='compress', choices=['lz4', 'lzma', 'dummy'], default='dummy', help='compression algorithm')
+    cmd_display.add_argument('-c',  dest='compress', choices=['lz4', 'lz4b', 'lzma', 'dummy'], default='dummy', help='compression algorithm')
     cmd_display.add_argument('-k',  dest='key_file',  type=str, default='', help='Key Id or Private key file path to sign component')
     cmd_display.add_argument('-td', dest='tool_dir', type=str, default='', help='Compression tool directory')
     cmd_display.add_argument('-s', dest='svn', type=int,  default=0, help='Security version number for Component')
@@ -845,7 +845,7 @@ def main():
     cmd_display = sub_parser.add_parser('sign', help='compress and sign a component image')
     cmd_display.add_argument('-f',  dest='comp_file',  type=str, required=True, help='Component input file path')
     cmd_display.add_argument('-o',  dest='out_file',  type=str, default='', help='Signed output image path')
-    cmd_display.add_argument('-c',  dest='compress', choices=['lz4', 'lzma', 'dummy'],  default='dummy', help='compression algorithm')
+    cmd_display.add_argument('-c',  dest='compress', choices=['lz4', 'lz4b', 'lzma', 'dummy'],  default='dummy', help='compression algorithm')
     cmd_display.add_argument('-a',  dest='auth', choices=['SHA2_256', 'SHA2_384', 'RSA2048_PKCS1_SHA2_256',
                 'RSA3072_PKCS1_SHA2_384', 'RSA2048_PSS_SHA2_256', 'RSA3072_PSS_SHA2_384', 'NONE'], default='NONE',  help='authentication algorithm')
     cmd_display.add_argument('-k',  dest='key_file',  type=str, default='', help='Key Id or Private key file path to sign component')
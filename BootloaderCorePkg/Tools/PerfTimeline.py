@@ -0,0 +1,170 @@
+#!/usr/bin/env python
+## @ PerfTimeline.py
+# Tools to view and compare boot performance timelines
+#
+# Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+# SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+import sys
+import json
+import struct
+import argparse
+
+sys.dont_write_bytecode = True
+
+SPAN_TYPE_NAME   = ['stage', 'step', 'fsp']
+STAGE_NAME       = {1 : 'Stage1A', 2 : 'Stage1B', 3 : 'Stage2', 4 : 'Payload'}
+
+TIMELINE_SIGNATURE  = b'PTLN'
+FBPT_SIGNATURE      = b'FBPT'
+FPDT_TIMELINE_TYPE  = 0x1000
+
+# PERF_TIMELINE header and PERF_TIMELINE_SPAN layouts
+TIMELINE_HDR_FMT    = '<4sHHII'
+TIMELINE_SPAN_FMT   = '<HBBIQQ'
+FPDT_RECORD_HDR_FMT = '<HBB'
+
+
+def span_dict (id, type, depth, start, end):
+    if type < len(SPAN_TYPE_NAME):
+        type = SPAN_TYPE_NAME[type]
+    else:
+        type = 'unknown'
+    return {'id' : id, 'type' : type, 'depth' : depth, 'start_ns' : start, 'end_ns' : end}
+
+
+def parse_timeline_bin (data):
+    sig, rev, count, length, rsvd = struct.unpack_from (TIMELINE_HDR_FMT, data)
+    offset = struct.calcsize (TIMELINE_HDR_FMT)
+    spans  = []
+    for idx in range(count):
+        id, type, depth, rsvd, start, end = struct.unpack_from (TIMELINE_SPAN_FMT, data, offset)
+        spans.append (span_dict (id, type, depth, start, end))
+        offset += struct.calcsize (TIMELINE_SPAN_FMT)
+    return spans
+
+
+def parse_fbpt_bin (data):
+    sig, length = struct.unpack_from ('<4sI', data)
+    offset = 8
+    spans  = []
+    while offset + struct.calcsize (FPDT_RECORD_HDR_FMT) <= min(length, len(data)):
+        type, rec_len, rev = struct.unpack_from (FPDT_RECORD_HDR_FMT, data, offset)
+        if rec_len == 0:
+            break
+        if type == FPDT_TIMELINE_TYPE:
+            id, type, depth, rsvd, start, end = struct.unpack_from (TIMELINE_SPAN_FMT, data,
+                                                  offset + struct.calcsize (FPDT_RECORD_HDR_FMT))
+            spans.append (span_dict (id, type, depth, start, end))
+        offset += rec_len
+    return spans
+
+
+def parse_timeline_log (text):
+    # Use the last timeline printed by the 'perf -j' shell command
+    decoder = json.JSONDecoder()
+    spans   = None
+    pos     = text.find ('{"timeline"')
+    while pos >= 0:
+        try:
+            obj, end = decoder.raw_decode (text, pos)
+            spans = obj['timeline']['spans']
+        except ValueError:
+            end = pos + 1
+        pos = text.find ('{"timeline"', end)
+    if spans is None:
+        raise Exception ("No timeline found in the log !")
+    return spans
+
+
+def load_timeline (path):
+    data = open (path, 'rb').read()
+    if data[:4] == TIMELINE_SIGNATURE:
+        return parse_timeline_bin (data)
+    if data[:4] == FBPT_SIGNATURE:
+        return parse_fbpt_bin (data)
+    return parse_timeline_log (data.decode ('utf-8', 'ignore'))
+
+
+def span_name (span):
+    if span['type'] == 'stage':
+        return STAGE_NAME.get (span['id'], 'Stage%d' % span['id'])
+    return '%s 0x%04X' % (span['type'], span['id'])
+
+
+def span_key (span):
+    return (span['type'], span['id'])
+
+
+def span_time (span):
+    return span['end_ns'] - span['start_ns']
+
+
+def view_timeline (args):
+    spans = load_timeline (args.timeline)
+    print ('%-20s %12s %12s %12s' % ('Span', 'Start (us)', 'End (us)', 'Time (us)'))
+    print ('-' * 59)
+    for span in sorted (spans, key = lambda x: (x['start_ns'], x['depth'])):
+        name = '  ' * span['depth'] + span_name (span)
+        print ('%-20s %12d %12d %12d' % (name, span['start_ns'] // 1000,
+                                         span['end_ns'] // 1000, span_time (span) // 1000))
+
+
+def diff_timeline (args):
+    base  = load_timeline (args.base)
+    new   = load_timeline (args.new)
+    times = {}
+    for span in base:
+        times[span_key (span)] = [span_name (span), span_time (span), None]
+    for span in new:
+        key = span_key (span)
+        if key not in times:
+            times[key] = [span_name (span), None, None]
+        times[key][2] = span_time (span)
+
+    rows = []
+    for name, old, cur in times.values():
+        delta = (cur or 0) - (old or 0)
+        if abs(delta) // 1000 >= args.threshold:
+            rows.append ((name, old, cur, delta))
+    rows.sort (key = lambda x: abs(x[3]), reverse = True)
+
+    def to_us (val):
+        return '-' if val is None else '%d' % (val // 1000)
+
+    print ('%-16s %12s %12s %12s' % ('Span', 'Base (us)', 'New (us)', 'Delta (us)'))
+    print ('-' * 55)
+    for name, old, cur, delta in rows:
+        print ('%-16s %12s %12s %+12d' % (name, to_us (old), to_us (cur), delta // 1000))
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    sub_parser = parser.add_subparsers(help='command')
+
+    # Command for view
+    cmd_display = sub_parser.add_parser('view', help='display a boot timeline')
+    cmd_display.add_argument('-i', dest='timeline', type=str, required=True,
+                             help='Timeline input: console log with "perf -j" output, timeline binary or FBPT binary')
+    cmd_display.set_defaults(func=view_timeline)
+
+    # Command for diff
+    cmd_display = sub_parser.add_parser('diff', help='compare two boot timelines')
+    cmd_display.add_argument('-b', dest='base', type=str, required=True, help='Baseline timeline input')
+    cmd_display.add_argument('-n', dest='new',  type=str, required=True, help='New timeline input')
+    cmd_display.add_argument('-t', dest='threshold', type=int, default=0, help='Only show deltas of at least this many us')
+    cmd_display.set_defaults(func=diff_timeline)
+
+    # Parse arguments and run sub-command
+    args = parser.parse_args()
+    try:
+        func = args.func
+    except AttributeError:
+        parser.error("too few arguments")
+
+    func(args)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
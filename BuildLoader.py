@@ -196,12 +196,18 @@ class BaseBoard(object):
         self.FIT_ENTRY_MAX_NUM     = 10
 
         self.ENABLE_PCI_ENUM       = 1
+        self.ENABLE_PCI_ENUM_CACHE = 0
         self.ENABLE_SMP_INIT       = 1
+        self.ENABLE_ASYNC_PAYLOAD_LOAD = 0
+        self.ENABLE_ASYNC_SPLASH   = 0
         self.ENABLE_FSP_LOAD_IMAGE = 0
         self.ENABLE_SPLASH         = 0
         self.ENABLE_FRAMEBUFFER_INIT = 0
         self.ENABLE_PRE_OS_CHECKER = 0
-        self.ENABLE_CRYPTO_SHA_OPT  = IPP_CRYPTO_OPTIMIZATION_MASK['SHA256_V8']
+        # Optimized hash kernels are selected at runtime by CPU capability:
+        # SHA256_NI falls back to SHA256_V8, and SHA384_G9 (AVX) falls back to SHA384_W7
+        self.ENABLE_CRYPTO_SHA_OPT  = IPP_CRYPTO_OPTIMIZATION_MASK['SHA256_NI'] | IPP_CRYPTO_OPTIMIZATION_MASK['SHA256_V8'] | \
+                                      IPP_CRYPTO_OPTIMIZATION_MASK['SHA384_G9'] | IPP_CRYPTO_OPTIMIZATION_MASK['SHA384_W7']
         self.ENABLE_FWU            = 0
         self.ENABLE_SOURCE_DEBUG   = 0
         self.ENABLE_SMM_REBASE     = 0
@@ -27,6 +27,7 @@
 #include <Guid/BootLoaderVersionGuid.h>
 #include <Guid/LoaderPlatformInfoGuid.h>
 #include <Guid/PciRootBridgeInfoGuid.h>
+#include <Guid/PerformanceInfoGuid.h>
 
 /**
   Initialize critical payload global data.
@@ -279,6 +280,9 @@ SecStartup (
     GlobalDataPtr->HashStorePtr = GET_GUID_HOB_DATA (GuidHob);
   }
 
+  // Keep appending component load profile to the HOB
+  GlobalDataPtr->ComponentProfile = GetGuidHobData (NULL, NULL, &gLoaderComponentProfileGuid);
+
   // Init features
   LoaderPlatformInfo = (LOADER_PLATFORM_INFO  *) GetGuidHobData (NULL, NULL, &gLoaderPlatformInfoGuid);
   if (LoaderPlatformInfo != NULL) {
@@ -1,7 +1,7 @@
 /** @file
   This file provides payload common library interfaces.
 
-  Copyright (c) 2017 - 2018, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2017 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -331,3 +331,41 @@ GetHashStorePtr (
 
   return PayloadGlobalDataPtr->HashStorePtr;
 }
+
+/**
+  This function retrieves component load profile pointer.
+
+  @retval    The component load profile pointer.
+
+**/
+VOID *
+EFIAPI
+GetComponentProfilePtr (
+  VOID
+  )
+{
+  PAYLOAD_GLOBAL_DATA     *PayloadGlobalDataPtr;
+
+  PayloadGlobalDataPtr = (PAYLOAD_GLOBAL_DATA *)(UINTN)PcdGet32 (PcdGlobalDataAddress);
+
+  return PayloadGlobalDataPtr->ComponentProfile;
+}
+
+/**
+  This function sets component load profile pointer.
+
+  @param ComponentProfile   The pointer to component load profile.
+
+**/
+VOID
+EFIAPI
+SetComponentProfilePtr (
+  IN VOID                 *ComponentProfile
+  )
+{
+  PAYLOAD_GLOBAL_DATA     *PayloadGlobalDataPtr;
+
+  PayloadGlobalDataPtr = (PAYLOAD_GLOBAL_DATA *)(UINTN)PcdGet32 (PcdGlobalDataAddress);
+
+  PayloadGlobalDataPtr->ComponentProfile = ComponentProfile;
+}
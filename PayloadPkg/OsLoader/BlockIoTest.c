@@ -1,13 +1,91 @@
 /** @file
 
-  Copyright (c) 2017 - 2018, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2017 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
 
 #include "BlockIoTest.h"
 
-#if  TEST_DEVICE_WRITE
+#if  TEST_DEVICE_WRITE || TEST_DEVICE_READ_THROUGHPUT
+
+#if  TEST_DEVICE_READ_THROUGHPUT
+
+/**
+  Measure the read throughput of a block device partition.
+
+  The same region is read once with a single request covering the whole buffer
+  and once split into small requests, so that the per-request overhead of the
+  transfer engine can be compared.
+
+  @param  DevBlockFunc  pointer to the device block functions.
+  @param  Index         partition index of the device.
+  @param  BlockInfo     pointer to the partition block info.
+
+  @retval EFI_SUCCESS   the throughput test was done successfully.
+  @retval Others        the throughput test failed.
+
+ **/
+EFI_STATUS
+TestDevReadThroughput (
+  IN  DEVICE_BLOCK_FUNC        *DevBlockFunc,
+  IN  UINTN                     Index,
+  IN  DEVICE_BLOCK_INFO        *BlockInfo
+  )
+{
+  EFI_STATUS                   Status;
+  UINT8                        *Buffer;
+  UINTN                        ReadSize;
+  UINTN                        ChunkSize;
+  UINTN                        Offset;
+  UINT32                       Pass;
+  UINT64                       Start;
+  UINT64                       Ticks;
+  UINT32                       FreqKhz;
+
+  ReadSize = TEST_READ_SIZE;
+  if (MultU64x32 (BlockInfo->BlockNum, BlockInfo->BlockSize) < ReadSize) {
+    ReadSize = (UINTN)MultU64x32 (BlockInfo->BlockNum, BlockInfo->BlockSize);
+  }
+  ReadSize = ReadSize - (ReadSize % TEST_READ_CHUNK_SIZE);
+  if ((ReadSize == 0) || ((TEST_READ_CHUNK_SIZE % BlockInfo->BlockSize) != 0)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Buffer = (UINT8 *)AllocatePages (EFI_SIZE_TO_PAGES (ReadSize));
+  if (Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status  = EFI_SUCCESS;
+  FreqKhz = GetTimeStampFrequency ();
+  for (Pass = 0; Pass < 2; Pass++) {
+    ChunkSize = (Pass == 0) ? ReadSize : TEST_READ_CHUNK_SIZE;
+    Start     = ReadTimeStamp ();
+    for (Offset = 0; Offset < ReadSize; Offset += ChunkSize) {
+      Status = DevBlockFunc->ReadBlocks (Index, Offset / BlockInfo->BlockSize, ChunkSize, Buffer + Offset);
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+    }
+    Ticks = ReadTimeStamp () - Start;
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_INFO, "    P[%d]: Read throughput test Status = %r\n", Index, Status));
+      break;
+    }
+    if (Ticks == 0) {
+      Ticks = 1;
+    }
+    DEBUG ((DEBUG_INFO, "    P[%d]: Read 0x%x bytes in 0x%x byte requests: %d us, %d KB/s\n", Index,
+            ReadSize, ChunkSize, (UINT32)DivU64x32 (MultU64x32 (Ticks, 1000), FreqKhz),
+            (UINT32)DivU64x64Remainder (MultU64x32 (ReadSize, FreqKhz), Ticks, NULL)));
+  }
+
+  FreePages (Buffer, EFI_SIZE_TO_PAGES (ReadSize));
+  return Status;
+}
+
+#endif
 
 /**
   Perform the BlockIO test for the given device type.
@@ -108,8 +186,14 @@ TestDevBlocks (
         continue;
       }
       DEBUG ((DEBUG_INFO, "    P[%d]: Dump Read Data\n", Index));
-      DumpBuffer (Buffer, 0x200);
+      DumpHex (2, 0, 0x200, Buffer);
 
+#if  TEST_DEVICE_READ_THROUGHPUT
+      // test read throughput
+      TestDevReadThroughput (&DevBlockFunc, Index, &BlockInfo);
+#endif
+
+#if  TEST_DEVICE_WRITE
       // test write
       DEBUG ((DEBUG_INFO, "    P[%d]: try to write block 0x%lx with BlockSize=0x%x\n", Index, TestLba, BlockInfo.BlockSize));
       if (* (UINT32 *)Buffer == * (UINT32 *)TestData1) {
@@ -131,7 +215,8 @@ TestDevBlocks (
         continue;
       }
       DEBUG ((DEBUG_INFO, "         P[%d]: Dump Read Data after written.\n", Index));
-      DumpBuffer (Buffer, 0x200);
+      DumpHex (2, 0, 0x200, Buffer);
+#endif
     }
   }
   return EFI_SUCCESS;
@@ -1,6 +1,6 @@
 /** @file
 
-  Copyright (c) 2017, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2017 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -12,14 +12,28 @@
 #include <Library/DebugLib.h>
 #include <Library/PayloadLib.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/TimeStampLib.h>
 
 #include <Library/MmcAccessLib.h>
 #include <Library/SpiBlockIoLib.h>
 #include <Library/UfsBlockIoLib.h>
 #include <Library/UsbBlockIoLib.h>
+#include <Library/PciNvmCtrlLib.h>
+#include <Library/BootloaderCommonLib.h>
 #include <Guid/OsBootOptionGuid.h>
 
-#define TEST_DEVICE_WRITE     0
+//
+// TestDevBlocks writes to the last block of every partition if TEST_DEVICE_WRITE
+// is set, and measures the read throughput if TEST_DEVICE_READ_THROUGHPUT is set.
+//
+#define TEST_DEVICE_WRITE            0
+#define TEST_DEVICE_READ_THROUGHPUT  0
+
+//
+// Size of the read throughput test and the chunk size used for comparison
+//
+#define TEST_READ_SIZE        SIZE_8MB
+#define TEST_READ_CHUNK_SIZE  SIZE_64KB
 
 /**
   Perform the BlockIO test for the given device type.
@@ -659,6 +659,7 @@ UnloadLoadedImage (
   if (LoadedImage->Flags & LOADED_IMAGE_LINUX) {
     LinuxImage = &LoadedImage->Image.Linux;
     FreeImageData (&LinuxImage->InitrdFile);
+    FreeImageData (&LinuxImage->KernelBuf);
 
     Count = ARRAY_SIZE (LinuxImage->ExtraBlob);
     for (Index = 0; Index < Count; Index++) {
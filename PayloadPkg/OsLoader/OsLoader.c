@@ -11,6 +11,8 @@
 UINT8    mCurrentBoot;
 VOID    *mEntryStack;
 
+STATIC IMAGE_PLACEMENT_STATS  mPlacementStats;
+
 /**
   Callback function to add performance measure point during component loading.
 
@@ -34,6 +36,109 @@ LoadComponentCallback (
   }
 }
 
+/**
+  Load a relocatable bzImage component directly to its kernel run address.
+
+  The buffer is laid out so that the protected-mode kernel lands on an address
+  aligned as the kernel requires, with room to decompress itself in place, so
+  that LoadBzImageInPlace() does not have to relocate it. Only uncompressed
+  components can be inspected before they are loaded.
+
+  The kernel would run from payload heap memory, which is reported to the OS
+  as reserved in crash mode, so the placement is skipped in that case.
+
+  @param[in]  ContainerSig    Container signature.
+  @param[in]  ComponentName   Component name.
+  @param[out] File            Image data of the loaded bzImage.
+  @param[out] KernelBuf       Page allocation holding the loaded bzImage.
+
+  @retval  EFI_SUCCESS        The bzImage was loaded to its run address.
+  @retval  Others             The component cannot be placed.
+**/
+STATIC
+EFI_STATUS
+LoadBzImageComponent (
+  IN  UINT32                  ContainerSig,
+  IN  UINT32                  ComponentName,
+  OUT IMAGE_DATA             *File,
+  OUT IMAGE_DATA             *KernelBuf
+  )
+{
+  EFI_STATUS                  Status;
+  LOADER_COMPRESSED_HEADER   *LzHdr;
+  UINT32                      KernelOffset;
+  UINT32                      KernelAlign;
+  UINT32                      KernelSize;
+  UINTN                       HeadSize;
+  UINTN                       Pages;
+  UINTN                       FreeHead;
+  UINT8                      *Buffer;
+  VOID                       *ImageBase;
+  UINT32                      Length;
+  OS_CONFIG_DATA_HOB         *OsConfigData;
+
+  OsConfigData = (OS_CONFIG_DATA_HOB *) GetGuidHobData (NULL, NULL, &gOsConfigDataGuid);
+  if ((OsConfigData != NULL) && (OsConfigData->EnableCrashMode != 0)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Status = LocateComponent (ContainerSig, ComponentName, (VOID **)&LzHdr, NULL);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if ((LzHdr->Signature != LZDM_SIGNATURE) || (LzHdr->Size < EFI_PAGE_SIZE)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Status = GetBzImagePlacement (LzHdr + 1, &KernelOffset, &KernelAlign, &KernelSize);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if ((KernelAlign < EFI_PAGE_SIZE) || (LzHdr->Size <= KernelOffset)) {
+    return EFI_UNSUPPORTED;
+  }
+  KernelSize = MAX (KernelSize, LzHdr->Size - KernelOffset);
+
+  //
+  // Allocate one extra alignment unit in front of the kernel for the setup
+  // code, then give back the pages the setup code does not use.
+  //
+  HeadSize = ALIGN_VALUE (KernelOffset, KernelAlign);
+  Pages    = EFI_SIZE_TO_PAGES (HeadSize) + EFI_SIZE_TO_PAGES (KernelSize);
+  Buffer   = AllocateAlignedPages (Pages, KernelAlign);
+  if (Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  FreeHead = EFI_SIZE_TO_PAGES (HeadSize) - EFI_SIZE_TO_PAGES (KernelOffset);
+  if (FreeHead > 0) {
+    FreePages (Buffer, FreeHead);
+    Buffer += EFI_PAGES_TO_SIZE (FreeHead);
+    Pages  -= FreeHead;
+  }
+
+  ImageBase = Buffer + EFI_PAGES_TO_SIZE (EFI_SIZE_TO_PAGES (KernelOffset)) - KernelOffset;
+  Length    = KernelOffset + KernelSize;
+  Status = LoadComponent (ContainerSig, ComponentName, &ImageBase, &Length);
+  if (EFI_ERROR (Status)) {
+    FreePages (Buffer, Pages);
+    return Status;
+  }
+
+  KernelBuf->Addr      = Buffer;
+  KernelBuf->Size      = (UINT32)EFI_PAGES_TO_SIZE (Pages);
+  KernelBuf->AllocType = ImageAllocateTypePage;
+
+  File->Addr      = ImageBase;
+  File->Size      = Length;
+  File->AllocType = ImageAllocateTypePointer;
+
+  DEBUG ((DEBUG_INFO, "Placed bzImage at 0x%p for in-place kernel boot\n", ImageBase));
+  return EFI_SUCCESS;
+}
+
 /**
   Update fields of LoadedImage
 
@@ -113,6 +218,9 @@ UpdateLoadedImage (
         CopyMem (LinuxImage->InitrdFile.Addr, File[2].Addr, File[2].Size);
         LinuxImage->InitrdFile.AllocType = ImageAllocateTypePage;
         FreeImageData (&File[2]);
+        mPlacementStats.CopiedBytes  += LinuxImage->InitrdFile.Size;
+      } else {
+        mPlacementStats.InPlaceBytes += LinuxImage->InitrdFile.Size;
       }
     }
 
@@ -192,6 +300,7 @@ ParseContainerImage (
   UINT64                      ComponentName;
   LOADER_COMPRESSED_HEADER   *LzHdr;
   IMAGE_DATA                  File[MAX_IAS_SUB_IMAGE];
+  IMAGE_DATA                  KernelBuf;
   UINT8                       Index;
 
   ContainerHdr = (CONTAINER_HDR  *)LoadedImage->ImageData.Addr;
@@ -206,6 +315,7 @@ ParseContainerImage (
   }
 
   ZeroMem (File, sizeof (File));
+  ZeroMem (&KernelBuf, sizeof (KernelBuf));
 
   DEBUG ((DEBUG_INFO, "CONTAINER size = 0x%x, image type = 0x%x, # of components = %d\n", LoadedImage->ImageData.Size, ContainerHdr->ImageType, ContainerHdr->Count));
 
@@ -235,11 +345,21 @@ ParseContainerImage (
       File[Index].AllocType = ImageAllocateTypePointer;
     } else {
       //
-      // Use Load to decompress to a new aligned page
+      // Load a classic bzImage straight to its kernel run address if possible
       //
-      Status = LoadComponent (ContainerHdr->Signature, (UINT32) ComponentName, (VOID **)&File[Index].Addr, &File[Index].Size);
-      if (!EFI_ERROR (Status)) {
-        File[Index].AllocType = ImageAllocateTypePage;
+      Status = EFI_UNSUPPORTED;
+      if (((ContainerHdr->ImageType & 0xF) == IAS_TYPE_CLASSIC) && (Index == 1)) {
+        Status = LoadBzImageComponent (ContainerHdr->Signature, (UINT32) ComponentName,
+                                       &File[Index], &KernelBuf);
+      }
+      if (EFI_ERROR (Status)) {
+        //
+        // Use Load to decompress to a new aligned page
+        //
+        Status = LoadComponent (ContainerHdr->Signature, (UINT32) ComponentName, (VOID **)&File[Index].Addr, &File[Index].Size);
+        if (!EFI_ERROR (Status)) {
+          File[Index].AllocType = ImageAllocateTypePage;
+        }
       }
     }
 
@@ -252,6 +372,16 @@ ParseContainerImage (
   // Mask upper nibble in ImageType so that UpdateLoadedImage() supports both IAS and CONTAINER Image types
   Status = UpdateLoadedImage (Index, File, LoadedImage, ContainerHdr->ImageType & 0xF);
 
+  //
+  // Hand the in-place kernel buffer over to the Linux image, or free it if
+  // the image was not set up as a Linux image
+  //
+  if (!EFI_ERROR (Status) && ((LoadedImage->Flags & LOADED_IMAGE_LINUX) != 0)) {
+    CopyMem (&LoadedImage->Image.Linux.KernelBuf, &KernelBuf, sizeof (IMAGE_DATA));
+  } else {
+    FreeImageData (&KernelBuf);
+  }
+
   if (EFI_ERROR (Status)) {
     UnloadLoadedImage (LoadedImage);
   }
@@ -378,6 +508,8 @@ SetupBootImage (
   LINUX_IMAGE               *LinuxImage;
   UINT32                     Size;
   UINT16                     Machine;
+  UINT32                     KernelBufLen;
+  UINT32                     Index;
 
   //
   // Allocate a cmd line buffer and init it with config file or default value
@@ -421,6 +553,16 @@ SetupBootImage (
   } else if (IsMultiboot (BootFile->Addr)) {
     DEBUG ((DEBUG_INFO, "Boot image is Multiboot format...\n"));
     Status = SetupMultibootImage (MultiBoot);
+    if (!EFI_ERROR (Status)) {
+      for (Index = 0; Index < MultiBoot->MbModuleNumber; Index++) {
+        Size = MultiBoot->MbModuleData[Index].ImgFile.Size;
+        if (MultiBoot->MbModule[Index].Start == (UINT32)(UINTN)MultiBoot->MbModuleData[Index].ImgFile.Addr) {
+          mPlacementStats.InPlaceBytes += Size;
+        } else {
+          mPlacementStats.CopiedBytes  += Size;
+        }
+      }
+    }
   } else if ((LoadedImage->Flags & LOADED_IMAGE_PE32) != 0) {
     DEBUG ((DEBUG_INFO, "Boot image is PE32 format\n"));
     Status = PeCoffRelocateImage ((UINT32)(UINTN)BootFile->Addr);
@@ -441,14 +583,26 @@ SetupBootImage (
   } else {
     DEBUG ((DEBUG_INFO, "Assume BzImage...\n"));
     LinuxImage = &LoadedImage->Image.Linux;
-    Status = LoadBzImage (LinuxImage->BootFile.Addr,
-                          LinuxImage->InitrdFile.Addr, LinuxImage->InitrdFile.Size,
-                          LinuxImage->CmdFile.Addr,    LinuxImage->CmdFile.Size);
+    KernelBufLen = 0;
+    if (LinuxImage->KernelBuf.Addr != NULL) {
+      KernelBufLen = (UINT32)((UINT8 *)LinuxImage->KernelBuf.Addr + LinuxImage->KernelBuf.Size - (UINT8 *)LinuxImage->BootFile.Addr);
+    }
+    Status = LoadBzImageInPlace (LinuxImage->BootFile.Addr, KernelBufLen,
+                                 LinuxImage->InitrdFile.Addr, LinuxImage->InitrdFile.Size,
+                                 LinuxImage->CmdFile.Addr,    LinuxImage->CmdFile.Size, &Size);
     if (!EFI_ERROR (Status)) {
       LoadedImage->Flags  = (LoadedImage->Flags  & ~LOADED_IMAGE_MULTIBOOT) | LOADED_IMAGE_LINUX;
+      if (Size == 0) {
+        mPlacementStats.InPlaceBytes += LinuxImage->BootFile.Size;
+      } else {
+        mPlacementStats.CopiedBytes  += Size;
+      }
     }
   }
 
+  DEBUG ((DEBUG_INFO, "Image placement: 0x%x bytes copied, 0x%x bytes in place\n",
+          mPlacementStats.CopiedBytes, mPlacementStats.InPlaceBytes));
+
   return Status;
 }
 
@@ -894,6 +1048,11 @@ ParseBootImages (
   EFI_STATUS           Status;
   UINT8                Type;
 
+  //
+  // Placement statistics are reported per boot image load
+  //
+  ZeroMem (&mPlacementStats, sizeof (mPlacementStats));
+
   Status = EFI_SUCCESS;
   for (Type = 0; Type < LoadImageTypeMax; Type++) {
     if (Type == LoadImageTypeMisc) {
@@ -1049,6 +1208,10 @@ BootOsImage (
     goto Exit;
   }
 
+#if TEST_DEVICE_WRITE || TEST_DEVICE_READ_THROUGHPUT
+  TestDevBlocks (OsBootOption);
+#endif
+
   //
   // Find Boot Partition
   //
@@ -1067,6 +1230,11 @@ BootOsImage (
     goto Exit;
   }
 
+  //
+  // Give the console shadow memory back before the OS image needs the heap
+  //
+  ReleaseFrameBufferConsoleShadow ();
+
   //
   // Load Boot Image
   //
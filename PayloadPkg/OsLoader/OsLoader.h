@@ -117,8 +117,14 @@ typedef struct {
   UINT16                  Reserved;
   UINT16                  ExtraBlobNumber;
   IMAGE_DATA              ExtraBlob[MAX_EXTRA_FILE_NUMBER];
+  IMAGE_DATA              KernelBuf;    // Owns BootFile when it is placed for in-place boot
 } LINUX_IMAGE;
 
+typedef struct {
+  UINT32                  CopiedBytes;
+  UINT32                  InPlaceBytes;
+} IMAGE_PLACEMENT_STATS;
+
 typedef struct {
   IMAGE_DATA              BootFile;
   IMAGE_DATA              CmdFile;
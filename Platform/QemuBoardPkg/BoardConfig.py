@@ -59,7 +59,6 @@ class Board(BaseBoard):
         self.ENABLE_FWU               = 1
         self.ENABLE_GRUB_CONFIG       = 1
         self.ENABLE_LINUX_PAYLOAD     = 1
-        self.ENABLE_CRYPTO_SHA_OPT    = 0
 
         self.ENABLE_SMBIOS            = 1
         self.ENABLE_SBL_SETUP         = 0
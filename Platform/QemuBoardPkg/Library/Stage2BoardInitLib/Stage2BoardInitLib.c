@@ -1,6 +1,6 @@
 /** @file
 
-  Copyright (c) 2017 - 2019, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2017 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -34,6 +34,7 @@
 #include <PlatformBase.h>
 #include <ConfigDataDefs.h>
 #include "GpioTbl.h"
+#include "Stage2BoardTest.h"
 
 #define GRAPHICS_DATA_SIG    SIGNATURE_32 ('Q', 'G', 'F', 'X')
 
@@ -212,6 +213,22 @@ BoardInit (
     if (!FeaturePcdGet (PcdStage1BXip)) {
       Status = TestVariableService ();
       ASSERT_EFI_ERROR (Status);
+#if TEST_VARIABLE_WORKLOAD
+      Status = ReplayVariableWorkload ();
+      ASSERT_EFI_ERROR (Status);
+#endif
+#if TEST_CRYPTO_KAT
+      Status = RunCryptoKnownAnswerTest ();
+      ASSERT_EFI_ERROR (Status);
+#endif
+#if TEST_LZ4_WIDE_COPY
+      Status = RunLz4WideCopyTest ();
+      ASSERT_EFI_ERROR (Status);
+#endif
+#if TEST_MEMORY_POOL
+      Status = RunMemoryPoolTest ();
+      ASSERT_EFI_ERROR (Status);
+#endif
     }
     // Get TSEG info from FSP HOB
     // It will be consumed in MpInit if SMM rebase is enabled
@@ -0,0 +1,745 @@
+/** @file
+
+  Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "Stage2BoardTest.h"
+
+#if  TEST_VARIABLE_WORKLOAD
+
+/**
+  Replay a typical variable workload on the first boot.
+
+  Every iteration updates the variables of one boot in a batch. A counter
+  changes every time, tuning data is rewritten with the same content and a
+  larger cache blob changes every 4 iterations, so that the variable store
+  needs a reclaim now and then. The variables are deleted in a last batch.
+
+  The flash erase and program operations between the start and end messages
+  are counted by the variable_workload.py QEMU test.
+
+  @retval   EFI_SUCCESS    Workload completed successfully or was replayed before.
+            Others         Workload failed.
+
+**/
+EFI_STATUS
+ReplayVariableWorkload (
+  VOID
+  )
+{
+  UINT8       Blob[256];
+  UINT8       Tuning[32];
+  UINT32      Count;
+  UINT32      Index;
+  UINTN       DataSize;
+  EFI_STATUS  Status;
+  EFI_STATUS  BatchStatus;
+
+  DataSize = sizeof(Count);
+  Status   = GetVariable ("VARWKLD", NULL, &DataSize, &Count);
+  if (!EFI_ERROR(Status)) {
+    return EFI_SUCCESS;
+  }
+
+  DEBUG ((DEBUG_INFO, "Variable workload start\n"));
+
+  SetMem (Tuning, sizeof(Tuning), 0x5A);
+  Status = EFI_SUCCESS;
+  for (Index = 0; (Index < 64) && !EFI_ERROR(Status); Index++) {
+    Status = StartVariableBatch ();
+    if (EFI_ERROR(Status)) {
+      break;
+    }
+
+    Count  = Index;
+    Status = SetVariable ("WKLDCNT", 0, sizeof(Count), &Count);
+
+    if (!EFI_ERROR(Status)) {
+      // Only the first write changes the content
+      Status = SetVariable ("WKLDDLL", 0, sizeof(Tuning), Tuning);
+    }
+
+    if (!EFI_ERROR(Status) && ((Index & 3) == 0)) {
+      SetMem (Blob, sizeof(Blob), (UINT8)Index);
+      Status = SetVariable ("WKLDBLOB", 0, sizeof(Blob), Blob);
+    }
+
+    BatchStatus = CommitVariableBatch ();
+    if (!EFI_ERROR(Status)) {
+      Status = BatchStatus;
+    }
+  }
+
+  if (!EFI_ERROR(Status)) {
+    DataSize = sizeof(Count);
+    Status   = GetVariable ("WKLDCNT", NULL, &DataSize, &Count);
+    if (!EFI_ERROR(Status) && (Count != Index - 1)) {
+      Status = EFI_ABORTED;
+    }
+  }
+
+  BatchStatus = StartVariableBatch ();
+  SetVariable ("WKLDCNT",  0, 0, NULL);
+  SetVariable ("WKLDDLL",  0, 0, NULL);
+  SetVariable ("WKLDBLOB", 0, 0, NULL);
+  if (!EFI_ERROR(BatchStatus)) {
+    BatchStatus = CommitVariableBatch ();
+  }
+  if (!EFI_ERROR(Status)) {
+    Status = BatchStatus;
+  }
+
+  DEBUG ((DEBUG_INFO, "Variable workload end: %d iterations - %r\n", Index, Status));
+
+  if (!EFI_ERROR(Status)) {
+    Count  = 1;
+    Status = SetVariable ("VARWKLD", 0, sizeof(Count), &Count);
+  }
+
+  return Status;
+}
+
+#endif
+
+#if  TEST_CRYPTO_KAT
+
+#define KAT_A10    "aaaaaaaaaa"
+#define KAT_A100   KAT_A10 KAT_A10 KAT_A10 KAT_A10 KAT_A10 KAT_A10 KAT_A10 KAT_A10 KAT_A10 KAT_A10
+
+typedef struct {
+  CONST CHAR8  *Message;
+  UINT32        Repeat;
+  UINT8         Sha256[SHA256_DIGEST_SIZE];
+  UINT8         Sha384[SHA384_DIGEST_SIZE];
+} HASH_TEST_VECTOR;
+
+//
+// FIPS 180-2 example messages. The message is hashed Repeat times in a row.
+//
+STATIC CONST HASH_TEST_VECTOR  mHashTestVector[] = {
+  {
+    "", 1,
+    {
+      0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14, 0x9a, 0xfb, 0xf4, 0xc8,
+      0x99, 0x6f, 0xb9, 0x24, 0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c,
+      0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55,
+    },
+    {
+      0x38, 0xb0, 0x60, 0xa7, 0x51, 0xac, 0x96, 0x38, 0x4c, 0xd9, 0x32, 0x7e,
+      0xb1, 0xb1, 0xe3, 0x6a, 0x21, 0xfd, 0xb7, 0x11, 0x14, 0xbe, 0x07, 0x43,
+      0x4c, 0x0c, 0xc7, 0xbf, 0x63, 0xf6, 0xe1, 0xda, 0x27, 0x4e, 0xde, 0xbf,
+      0xe7, 0x6f, 0x65, 0xfb, 0xd5, 0x1a, 0xd2, 0xf1, 0x48, 0x98, 0xb9, 0x5b,
+    }
+  },
+  {
+    "abc", 1,
+    {
+      0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde,
+      0x5d, 0xae, 0x22, 0x23, 0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+      0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad,
+    },
+    {
+      0xcb, 0x00, 0x75, 0x3f, 0x45, 0xa3, 0x5e, 0x8b, 0xb5, 0xa0, 0x3d, 0x69,
+      0x9a, 0xc6, 0x50, 0x07, 0x27, 0x2c, 0x32, 0xab, 0x0e, 0xde, 0xd1, 0x63,
+      0x1a, 0x8b, 0x60, 0x5a, 0x43, 0xff, 0x5b, 0xed, 0x80, 0x86, 0x07, 0x2b,
+      0xa1, 0xe7, 0xcc, 0x23, 0x58, 0xba, 0xec, 0xa1, 0x34, 0xc8, 0x25, 0xa7,
+    }
+  },
+  {
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+    {
+      0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8, 0xe5, 0xc0, 0x26, 0x93,
+      0x0c, 0x3e, 0x60, 0x39, 0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+      0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1,
+    },
+    {
+      0x33, 0x91, 0xfd, 0xdd, 0xfc, 0x8d, 0xc7, 0x39, 0x37, 0x07, 0xa6, 0x5b,
+      0x1b, 0x47, 0x09, 0x39, 0x7c, 0xf8, 0xb1, 0xd1, 0x62, 0xaf, 0x05, 0xab,
+      0xfe, 0x8f, 0x45, 0x0d, 0xe5, 0xf3, 0x6b, 0xc6, 0xb0, 0x45, 0x5a, 0x85,
+      0x20, 0xbc, 0x4e, 0x6f, 0x5f, 0xe9, 0x5b, 0x1f, 0xe3, 0xc8, 0x45, 0x2b,
+    }
+  },
+  {
+    "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmno"
+    "ijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 1,
+    {
+      0xcf, 0x5b, 0x16, 0xa7, 0x78, 0xaf, 0x83, 0x80, 0x03, 0x6c, 0xe5, 0x9e,
+      0x7b, 0x04, 0x92, 0x37, 0x0b, 0x24, 0x9b, 0x11, 0xe8, 0xf0, 0x7a, 0x51,
+      0xaf, 0xac, 0x45, 0x03, 0x7a, 0xfe, 0xe9, 0xd1,
+    },
+    {
+      0x09, 0x33, 0x0c, 0x33, 0xf7, 0x11, 0x47, 0xe8, 0x3d, 0x19, 0x2f, 0xc7,
+      0x82, 0xcd, 0x1b, 0x47, 0x53, 0x11, 0x1b, 0x17, 0x3b, 0x3b, 0x05, 0xd2,
+      0x2f, 0xa0, 0x80, 0x86, 0xe3, 0xb0, 0xf7, 0x12, 0xfc, 0xc7, 0xc7, 0x1a,
+      0x55, 0x7e, 0x2d, 0xb9, 0x66, 0xc3, 0xe9, 0xfa, 0x91, 0x74, 0x60, 0x39,
+    }
+  },
+  {
+    // One million 'a'
+    KAT_A100, 10000,
+    {
+      0xcd, 0xc7, 0x6e, 0x5c, 0x99, 0x14, 0xfb, 0x92, 0x81, 0xa1, 0xc7, 0xe2,
+      0x84, 0xd7, 0x3e, 0x67, 0xf1, 0x80, 0x9a, 0x48, 0xa4, 0x97, 0x20, 0x0e,
+      0x04, 0x6d, 0x39, 0xcc, 0xc7, 0x11, 0x2c, 0xd0,
+    },
+    {
+      0x9d, 0x0e, 0x18, 0x09, 0x71, 0x64, 0x74, 0xcb, 0x08, 0x6e, 0x83, 0x4e,
+      0x31, 0x0a, 0x4a, 0x1c, 0xed, 0x14, 0x9e, 0x9c, 0x00, 0xf2, 0x48, 0x52,
+      0x79, 0x72, 0xce, 0xc5, 0x70, 0x4c, 0x2a, 0x5b, 0x07, 0xb8, 0xb3, 0xdc,
+      0x38, 0xec, 0xc4, 0xeb, 0xae, 0x97, 0xdd, 0xd8, 0x7f, 0x3d, 0x89, 0x85,
+    }
+  },
+};
+
+//
+// Reflected CRC32 polynomials and the CRC of "123456789" returned by CalculateCrc32WithType
+//
+#define KAT_CRC32_POLY          0xEDB88320
+#define KAT_CRC32C_POLY         0x82F63B78
+#define KAT_CRC32_CHECK         0xCBF43926
+#define KAT_CRC32C_CHECK        0x1CF96D7C
+
+/**
+  Bitwise CRC32 used as reference for the library implementation.
+
+  @param  Crc         The CRC value to update.
+  @param  Data        The buffer containing the data to be processed.
+  @param  DataSize    The size of data to be processed.
+  @param  Poly        The reflected CRC polynomial.
+
+  @return             The updated CRC value.
+
+**/
+STATIC
+UINT32
+Crc32Bitwise (
+  IN  UINT32        Crc,
+  IN  CONST UINT8  *Data,
+  IN  UINTN         DataSize,
+  IN  UINT32        Poly
+  )
+{
+  UINT32  Bit;
+
+  while (DataSize-- > 0) {
+    Crc ^= *Data++;
+    for (Bit = 0; Bit < 8; Bit++) {
+      Crc = (Crc >> 1) ^ (((Crc & 1) != 0) ? Poly : 0);
+    }
+  }
+
+  return Crc;
+}
+
+/**
+  Compare CalculateCrc32WithType with the bitwise reference.
+
+  All lengths up to 64 bytes are checked at every alignment within 8 bytes,
+  so that the unaligned head, the 8 byte body and the tail are all covered.
+
+  @param  Type        The CRC type to check.
+  @param  Poly        The reflected CRC polynomial of the type.
+
+  @retval             The number of mismatches.
+
+**/
+STATIC
+UINT32
+Crc32Sweep (
+  IN  CRC32_TYPE    Type,
+  IN  UINT32        Poly
+  )
+{
+  UINT8   Buffer[72];
+  UINT32  Index;
+  UINT32  Offset;
+  UINT32  Length;
+  UINT32  Crc;
+  UINT32  Expected;
+  UINT32  Failures;
+
+  for (Index = 0; Index < sizeof (Buffer); Index++) {
+    Buffer[Index] = (UINT8)(Index * 167 + 13);
+  }
+
+  Failures = 0;
+  for (Offset = 0; Offset < 8; Offset++) {
+    for (Length = 1; Length <= 64; Length++) {
+      Expected = Crc32Bitwise (0xFFFFFFFF, Buffer + Offset, Length, Poly);
+      if (Type != Crc32TypeCastagnoli) {
+        Expected ^= 0xFFFFFFFF;
+      }
+      CalculateCrc32WithType (Buffer + Offset, Length, Type, &Crc);
+      if (Crc != Expected) {
+        Failures++;
+      }
+    }
+  }
+
+  return Failures;
+}
+
+/**
+  Check the hash and CRC kernels selected at runtime against known answers.
+
+  The hash libraries pick SHA-NI, AVX or SSSE3 kernels and CRC32C uses the
+  SSE4.2 CRC32 instruction depending on the processor. They fall back to the
+  compact C code or the slice-by-8 tables otherwise. The crypto_kat.py QEMU
+  test runs this on CPU models with and without these extensions, so that the
+  accelerated and the scalar paths are both checked against the same vectors.
+  The CRC results are also compared with a bitwise implementation.
+
+  @retval   EFI_SUCCESS    All known answers matched.
+            EFI_ABORTED    At least one known answer did not match.
+
+**/
+EFI_STATUS
+RunCryptoKnownAnswerTest (
+  VOID
+  )
+{
+  HASH_CTX     HashCtx;
+  UINT8        Digest[SHA384_DIGEST_SIZE];
+  UINT32       MaxLeaf;
+  UINT32       RegEbx;
+  UINT32       RegEcx;
+  UINT32       Index;
+  UINT32       Repeat;
+  UINT32       Length;
+  UINT32       Checks;
+  UINT32       Failures;
+  UINT32       Crc;
+  EFI_STATUS   Status;
+
+  AsmCpuid (0, &MaxLeaf, NULL, NULL, NULL);
+  AsmCpuid (1, NULL, NULL, &RegEcx, NULL);
+  RegEbx = 0;
+  if (MaxLeaf >= 7) {
+    AsmCpuidEx (7, 0, NULL, &RegEbx, NULL, NULL);
+  }
+  DEBUG ((DEBUG_INFO, "Crypto KAT start: CPUID.1:ECX %08X CPUID.7:EBX %08X\n", RegEcx, RegEbx));
+
+  Checks   = 0;
+  Failures = 0;
+  for (Index = 0; Index < ARRAY_SIZE (mHashTestVector); Index++) {
+    Length = (UINT32)AsciiStrLen (mHashTestVector[Index].Message);
+
+    Sha256Init (&HashCtx, sizeof (HashCtx));
+    for (Repeat = 0; Repeat < mHashTestVector[Index].Repeat; Repeat++) {
+      Sha256Update (&HashCtx, (CONST UINT8 *)mHashTestVector[Index].Message, Length);
+    }
+    Sha256Final (&HashCtx, Digest);
+    Checks++;
+    if (CompareMem (Digest, mHashTestVector[Index].Sha256, SHA256_DIGEST_SIZE) != 0) {
+      DEBUG ((DEBUG_ERROR, "Crypto KAT SHA256 vector %d mismatch\n", Index));
+      Failures++;
+    }
+
+    Sha384Init (&HashCtx, sizeof (HashCtx));
+    for (Repeat = 0; Repeat < mHashTestVector[Index].Repeat; Repeat++) {
+      Sha384Update (&HashCtx, (CONST UINT8 *)mHashTestVector[Index].Message, Length);
+    }
+    Sha384Final (&HashCtx, Digest);
+    Checks++;
+    if (CompareMem (Digest, mHashTestVector[Index].Sha384, SHA384_DIGEST_SIZE) != 0) {
+      DEBUG ((DEBUG_ERROR, "Crypto KAT SHA384 vector %d mismatch\n", Index));
+      Failures++;
+    }
+  }
+
+  CalculateCrc32WithType ((UINT8 *)"123456789", 9, Crc32TypeDefault, &Crc);
+  Checks++;
+  if (Crc != KAT_CRC32_CHECK) {
+    DEBUG ((DEBUG_ERROR, "Crypto KAT CRC32 check value mismatch\n"));
+    Failures++;
+  }
+
+  CalculateCrc32WithType ((UINT8 *)"123456789", 9, Crc32TypeCastagnoli, &Crc);
+  Checks++;
+  if (Crc != KAT_CRC32C_CHECK) {
+    DEBUG ((DEBUG_ERROR, "Crypto KAT CRC32C check value mismatch\n"));
+    Failures++;
+  }
+
+  Checks++;
+  if (Crc32Sweep (Crc32TypeDefault, KAT_CRC32_POLY) != 0) {
+    DEBUG ((DEBUG_ERROR, "Crypto KAT CRC32 reference mismatch\n"));
+    Failures++;
+  }
+
+  Checks++;
+  if (Crc32Sweep (Crc32TypeCastagnoli, KAT_CRC32C_POLY) != 0) {
+    DEBUG ((DEBUG_ERROR, "Crypto KAT CRC32C reference mismatch\n"));
+    Failures++;
+  }
+
+  Status = (Failures == 0) ? EFI_SUCCESS : EFI_ABORTED;
+  DEBUG ((DEBUG_INFO, "Crypto KAT end: %d checks - %r\n", Checks, Status));
+
+  return Status;
+}
+
+#endif
+
+#if  TEST_LZ4_WIDE_COPY
+
+#define LZ4_TEST_MAX_SIZE       1536
+#define LZ4_TEST_GUARD_SIZE     64
+#define LZ4_TEST_SHIFT_COUNT    32
+
+typedef struct {
+  UINT16  Literals;
+  UINT16  Offset;
+  UINT16  Match;
+} LZ4_TEST_SEQUENCE;
+
+//
+// Sequences hitting the wide copy decisions of the decoder. The last one only
+// has literals, as required at the end of a LZ4 block.
+//
+STATIC CONST LZ4_TEST_SEQUENCE  mLz4TestSequence[] = {
+  { 200,  64, 150 },    // Long literals, long match far enough for any chunk size
+  {  40,   3, 100 },    // Overlapping match, must not use the wide kernels
+  {  33,  20,  60 },    // Match distance between the SSE2 and AVX2 chunk sizes
+  {  15,  32,  32 },    // Lengths and distance at the wide copy threshold
+  {  31,  16,  31 },    // Just below the threshold
+  { 300, 300, 300 },    // Match adjacent to its source
+  {  64,   0,   0 },    // Last literals
+};
+
+/**
+  Append a LZ4 length extension.
+
+  @param  Buffer      The buffer to append to.
+  @param  Length      The length beyond the 4 bit token field.
+
+  @retval             The end of the appended bytes.
+
+**/
+STATIC
+UINT8 *
+Lz4TestPutLength (
+  IN  UINT8   *Buffer,
+  IN  UINT32   Length
+  )
+{
+  while (Length >= 255) {
+    *Buffer++ = 255;
+    Length   -= 255;
+  }
+  *Buffer++ = (UINT8)Length;
+  return Buffer;
+}
+
+/**
+  Build the LZ4 test stream and its expected output.
+
+  The expected output is produced byte by byte, which is also the only valid
+  way to resolve overlapping matches.
+
+  @param  Stream      The buffer to receive the stream with its size header.
+  @param  StreamSize  The size of the stream with its size header.
+  @param  Expected    The buffer to receive the expected output.
+
+  @retval             The size of the expected output.
+
+**/
+STATIC
+UINT32
+Lz4TestBuildStream (
+  OUT UINT8   *Stream,
+  OUT UINT32  *StreamSize,
+  OUT UINT8   *Expected
+  )
+{
+  CONST LZ4_TEST_SEQUENCE  *Seq;
+  UINT8                    *Ptr;
+  UINT32                    Index;
+  UINT32                    Count;
+  UINT32                    Size;
+  UINT32                    Seed;
+
+  Ptr  = Stream + sizeof (UINT32);
+  Size = 0;
+  Seed = 0x13579BDF;
+  for (Index = 0; Index < ARRAY_SIZE (mLz4TestSequence); Index++) {
+    Seq    = &mLz4TestSequence[Index];
+    *Ptr++ = (UINT8)((MIN (Seq->Literals, 15) << 4) | ((Seq->Match == 0) ? 0 : MIN (Seq->Match - 4, 15)));
+    if (Seq->Literals >= 15) {
+      Ptr = Lz4TestPutLength (Ptr, Seq->Literals - 15);
+    }
+
+    for (Count = 0; Count < Seq->Literals; Count++) {
+      Seed             = Seed * 1103515245 + 12345;
+      *Ptr++           = (UINT8)(Seed >> 16);
+      Expected[Size++] = Ptr[-1];
+    }
+
+    if (Seq->Match == 0) {
+      break;
+    }
+
+    *Ptr++ = (UINT8)Seq->Offset;
+    *Ptr++ = (UINT8)(Seq->Offset >> 8);
+    if (Seq->Match - 4 >= 15) {
+      Ptr = Lz4TestPutLength (Ptr, Seq->Match - 4 - 15);
+    }
+
+    for (Count = 0; Count < Seq->Match; Count++) {
+      Expected[Size] = Expected[Size - Seq->Offset];
+      Size++;
+    }
+  }
+
+  *(UINT32 *)Stream = Size;
+  *StreamSize       = (UINT32)(Ptr - Stream);
+  return Size;
+}
+
+/**
+  Check the LZ4 wide copy kernels against a byte by byte decode.
+
+  The decoder picks the AVX2 or SSE2 wide copy kernel depending on the
+  processor. The lz4_wide_copy.py QEMU test runs this on CPU models with and
+  without AVX2. The stream is decoded at different source and destination
+  alignments, and the bytes following the output must not be touched.
+
+  @retval   EFI_SUCCESS    All decodes matched the reference.
+            EFI_ABORTED    At least one decode did not match.
+
+**/
+EFI_STATUS
+RunLz4WideCopyTest (
+  VOID
+  )
+{
+  UINT8          Stream[LZ4_TEST_MAX_SIZE];
+  UINT8          Source[LZ4_TEST_MAX_SIZE + LZ4_TEST_SHIFT_COUNT];
+  UINT8          Expected[LZ4_TEST_MAX_SIZE];
+  UINT8          Output[LZ4_TEST_MAX_SIZE + LZ4_TEST_SHIFT_COUNT + LZ4_TEST_GUARD_SIZE];
+  UINT8         *Src;
+  UINT8         *Dst;
+  UINT32         StreamSize;
+  UINT32         Size;
+  UINT32         Shift;
+  UINT32         Index;
+  UINT32         Decodes;
+  UINT32         Failures;
+  UINT32         MaxLeaf;
+  UINT32         RegEbx;
+  RETURN_STATUS  DecodeStatus;
+  EFI_STATUS     Status;
+
+  AsmCpuid (0, &MaxLeaf, NULL, NULL, NULL);
+  RegEbx = 0;
+  if (MaxLeaf >= 7) {
+    AsmCpuidEx (7, 0, NULL, &RegEbx, NULL, NULL);
+  }
+  DEBUG ((DEBUG_INFO, "LZ4 wide copy test start: CPUID.7:EBX %08X\n", RegEbx));
+
+  Size     = Lz4TestBuildStream (Stream, &StreamSize, Expected);
+  Decodes  = 0;
+  Failures = 0;
+  for (Shift = 0; Shift < LZ4_TEST_SHIFT_COUNT; Shift++) {
+    Src = Source + ((Shift * 7) % LZ4_TEST_SHIFT_COUNT);
+    Dst = Output + Shift;
+    CopyMem (Src, Stream, StreamSize);
+    SetMem (Output, sizeof (Output), 0xA5);
+
+    DecodeStatus = Lz4Decompress (Src, StreamSize, Dst, NULL);
+    Decodes++;
+    if (RETURN_ERROR (DecodeStatus) || (CompareMem (Dst, Expected, Size) != 0)) {
+      DEBUG ((DEBUG_ERROR, "LZ4 wide copy test decode mismatch at shift %d\n", Shift));
+      Failures++;
+      continue;
+    }
+
+    for (Index = Shift + Size; Index < sizeof (Output); Index++) {
+      if (Output[Index] != 0xA5) {
+        DEBUG ((DEBUG_ERROR, "LZ4 wide copy test output overrun at shift %d\n", Shift));
+        Failures++;
+        break;
+      }
+    }
+  }
+
+  Status = (Failures == 0) ? EFI_SUCCESS : EFI_ABORTED;
+  DEBUG ((DEBUG_INFO, "LZ4 wide copy test end: %d decodes - %r\n", Decodes, Status));
+
+  return Status;
+}
+
+#endif
+
+#if  TEST_MEMORY_POOL
+
+#define POOL_TEST_BUFFERS       8
+
+typedef struct {
+  UINT32  Used;
+  UINT32  FreeCount;
+} POOL_TEST_STATE;
+
+/**
+  Get the used memory and the number of free blocks of the memory pool.
+
+  @param  State       Pointer to receive the pool state.
+
+**/
+STATIC
+VOID
+PoolTestGetState (
+  OUT POOL_TEST_STATE  *State
+  )
+{
+  LOADER_GLOBAL_DATA  *LdrGlobal;
+
+  LdrGlobal = GetLoaderGlobalDataPointer ();
+  State->Used      = LdrGlobal->MemPoolEnd - LdrGlobal->MemPoolCurrTop - LdrGlobal->MemPoolFreeSize;
+  State->FreeCount = LdrGlobal->MemPoolFreeCount;
+}
+
+/**
+  Check that the memory pool returned to a previous state.
+
+  All memory allocated since then must be free again, and the freed blocks
+  must have been coalesced with their neighbours or merged into the pool top.
+
+  @param  Step        Step name to report.
+  @param  Initial     The previous pool state.
+
+  @retval             1 if the pool state differs, 0 otherwise.
+
+**/
+STATIC
+UINT32
+PoolTestCheckState (
+  IN  CONST CHAR8            *Step,
+  IN  CONST POOL_TEST_STATE  *Initial
+  )
+{
+  POOL_TEST_STATE  Current;
+
+  PoolTestGetState (&Current);
+  if ((Current.Used != Initial->Used) || (Current.FreeCount != Initial->FreeCount)) {
+    DEBUG ((DEBUG_ERROR, "Memory pool test %a: used 0x%X/0x%X, free blocks %d/%d\n", Step,
+            Current.Used, Initial->Used, Current.FreeCount, Initial->FreeCount));
+    return 1;
+  }
+
+  return 0;
+}
+
+/**
+  Replay allocations and frees on the loader memory pool.
+
+  Pool buffers of different sizes are freed out of order so that they have
+  to be coalesced in the free list, then pages are allocated with different
+  alignments and freed partially. After every step the used memory and the
+  number of free blocks must be back to their initial values. Live buffers
+  are checked for corruption while their neighbours are freed, and a freed
+  pool buffer must be reused by the next allocation of the same size.
+
+  @retval   EFI_SUCCESS    The pool returned to its initial state after every step.
+            EFI_ABORTED    At least one step failed.
+
+**/
+EFI_STATUS
+RunMemoryPoolTest (
+  VOID
+  )
+{
+  STATIC CONST UINT32  PoolSize[POOL_TEST_BUFFERS] = { 16, 4000, 100, 32, 2048, 1, 700, 5000 };
+  POOL_TEST_STATE      Initial;
+  UINT8               *Buffer[POOL_TEST_BUFFERS];
+  UINT8               *Pages[3];
+  UINT8               *Reused;
+  UINT32               Index;
+  UINT32               Offset;
+  UINT32               Checks;
+  UINT32               Failures;
+  EFI_STATUS           Status;
+
+  PoolTestGetState (&Initial);
+  DEBUG ((DEBUG_INFO, "Memory pool test start: used 0x%X, free blocks %d\n", Initial.Used, Initial.FreeCount));
+
+  Checks   = 0;
+  Failures = 0;
+
+  //
+  // Pool buffers freed out of order, the live ones must stay intact
+  //
+  for (Index = 0; Index < POOL_TEST_BUFFERS; Index++) {
+    Buffer[Index] = AllocatePool (PoolSize[Index]);
+    SetMem (Buffer[Index], PoolSize[Index], (UINT8)(0x40 + Index));
+  }
+  for (Index = 1; Index < POOL_TEST_BUFFERS; Index += 2) {
+    FreePool (Buffer[Index]);
+  }
+  Checks++;
+  for (Index = 0; Index < POOL_TEST_BUFFERS; Index += 2) {
+    for (Offset = 0; Offset < PoolSize[Index]; Offset++) {
+      if (Buffer[Index][Offset] != (UINT8)(0x40 + Index)) {
+        break;
+      }
+    }
+    if (Offset < PoolSize[Index]) {
+      DEBUG ((DEBUG_ERROR, "Memory pool test: buffer %d corrupted\n", Index));
+      Failures++;
+      break;
+    }
+  }
+  for (Index = 0; Index < POOL_TEST_BUFFERS; Index += 2) {
+    FreePool (Buffer[Index]);
+  }
+  Checks++;
+  Failures += PoolTestCheckState ("pool", &Initial);
+
+  //
+  // A freed buffer is reused by the next allocation of the same size
+  //
+  Buffer[0] = AllocatePool (PoolSize[1]);
+  FreePool (Buffer[0]);
+  Reused = AllocatePool (PoolSize[1]);
+  FreePool (Reused);
+  Checks++;
+  if (Reused != Buffer[0]) {
+    DEBUG ((DEBUG_ERROR, "Memory pool test: freed buffer 0x%p not reused\n", Buffer[0]));
+    Failures++;
+  }
+  Checks++;
+  Failures += PoolTestCheckState ("reuse", &Initial);
+
+  //
+  // Pages with different alignments freed out of order
+  //
+  Pages[0] = AllocatePages (3);
+  Pages[1] = AllocateAlignedPages (2, SIZE_64KB);
+  Pages[2] = AllocatePages (1);
+  FreePages (Pages[1], 2);
+  FreePages (Pages[0], 3);
+  FreePages (Pages[2], 1);
+  Checks++;
+  Failures += PoolTestCheckState ("pages", &Initial);
+
+  //
+  // An allocation freed in pieces: head, tail, then the middle pages
+  //
+  Pages[0] = AllocatePages (8);
+  FreePages (Pages[0], 2);
+  FreePages (Pages[0] + EFI_PAGES_TO_SIZE (6), 2);
+  FreePages (Pages[0] + EFI_PAGES_TO_SIZE (3), 1);
+  FreePages (Pages[0] + EFI_PAGES_TO_SIZE (2), 1);
+  FreePages (Pages[0] + EFI_PAGES_TO_SIZE (4), 2);
+  Checks++;
+  Failures += PoolTestCheckState ("partial pages", &Initial);
+
+  Status = (Failures == 0) ? EFI_SUCCESS : EFI_ABORTED;
+  DEBUG ((DEBUG_INFO, "Memory pool test end: %d checks - %r\n", Checks, Status));
+
+  return Status;
+}
+
+#endif
@@ -0,0 +1,95 @@
+/** @file
+
+  Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef __STAGE2_BOARD_TEST_H__
+#define __STAGE2_BOARD_TEST_H__
+
+#include <PiPei.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/VariableLib.h>
+#include <Library/CryptoLib.h>
+#include <Library/Crc32Lib.h>
+#include <Library/Lz4DecompressLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/BootloaderCoreLib.h>
+
+//
+// Stage2 runs the variable workload replay on the first boot if TEST_VARIABLE_WORKLOAD
+// is set. The flash operations it causes are checked by the variable_workload.py QEMU test.
+//
+#define TEST_VARIABLE_WORKLOAD  0
+
+//
+// Stage2 checks the hash and CRC kernels selected at runtime against known answers if
+// TEST_CRYPTO_KAT is set. The crypto_kat.py QEMU test boots the image on a CPU
+// model with and without the instruction set extensions they use.
+//
+#define TEST_CRYPTO_KAT         0
+
+//
+// Stage2 decodes a LZ4 stream built for the wide copy kernels if TEST_LZ4_WIDE_COPY
+// is set. The lz4_wide_copy.py QEMU test runs it with the AVX2 and the SSE2 kernel.
+//
+#define TEST_LZ4_WIDE_COPY      0
+
+//
+// Stage2 replays allocations and frees on the loader memory pool if TEST_MEMORY_POOL
+// is set. The memory_pool.py QEMU test checks that all freed memory is coalesced.
+//
+#define TEST_MEMORY_POOL        0
+
+/**
+  Replay a typical variable workload on the first boot.
+
+  @retval   EFI_SUCCESS    Workload completed successfully or was replayed before.
+            Others         Workload failed.
+
+**/
+EFI_STATUS
+ReplayVariableWorkload (
+  VOID
+  );
+
+/**
+  Check the hash and CRC kernels selected at runtime against known answers.
+
+  @retval   EFI_SUCCESS    All known answers matched.
+            EFI_ABORTED    At least one known answer did not match.
+
+**/
+EFI_STATUS
+RunCryptoKnownAnswerTest (
+  VOID
+  );
+
+/**
+  Check the LZ4 wide copy kernels against a byte by byte decode.
+
+  @retval   EFI_SUCCESS    All decodes matched the reference.
+            EFI_ABORTED    At least one decode did not match.
+
+**/
+EFI_STATUS
+RunLz4WideCopyTest (
+  VOID
+  );
+
+/**
+  Replay allocations and frees on the loader memory pool.
+
+  @retval   EFI_SUCCESS    The pool returned to its initial state after every step.
+            EFI_ABORTED    At least one step failed.
+
+**/
+EFI_STATUS
+RunMemoryPoolTest (
+  VOID
+  );
+
+#endif
@@ -0,0 +1,128 @@
+#!/usr/bin/env python
+## @ crypto_kat.py
+#
+# Check the runtime-selected hash and CRC kernels against known answers on QEMU
+#
+# The QEMU image needs to be built with TEST_CRYPTO_KAT set in
+# Platform/QemuBoardPkg/Library/Stage2BoardInitLib/Stage2BoardTest.h.
+# The image is booted once on a CPU model with the instruction set
+# extensions used by the accelerated kernels and once without them,
+# so that both the accelerated and the scalar paths are checked.
+#
+# Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+# SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+import os
+import re
+import sys
+from   test_base import *
+
+# Known answer checks done by RunCryptoKnownAnswerTest
+KAT_CHECKS = 14
+
+# Extensions used by the accelerated kernels: name, QEMU CPU flag, CPUID register and bit
+FEATURES   = [
+               ('SHA-NI', 'sha-ni', 'EBX', 29),
+               ('SSSE3',  'ssse3',  'ECX',  9),
+               ('AVX',    'avx',    'ECX', 28),
+               ('SSE4.2', 'sse4.2', 'ECX', 20),
+             ]
+
+def get_check_lines ():
+    lines = [
+              "===== Intel Slim Bootloader STAGE2 ======",
+              "Crypto KAT start",
+              "Crypto KAT end",
+              "Jump to payload",
+            ]
+    return lines
+
+def get_cpu_models ():
+    scalar = 'max' + ''.join(',-%s' % flag for name, flag, reg, bit in FEATURES)
+    return [('accelerated', 'max'), ('scalar', scalar)]
+
+def parse_result (output):
+    cpuid  = None
+    result = None
+    for line in output:
+        match = re.search(r'Crypto KAT start: CPUID\.1:ECX ([0-9A-Fa-f]+) CPUID\.7:EBX ([0-9A-Fa-f]+)', line)
+        if match:
+            cpuid = {'ECX' : int(match.group(1), 16), 'EBX' : int(match.group(2), 16)}
+            continue
+        match = re.search(r'Crypto KAT end: (\d+) checks - (\w+)', line)
+        if match:
+            result = (int(match.group(1)), match.group(2))
+    if cpuid is None or result is None:
+        return None
+    return cpuid, result[0], result[1]
+
+def usage():
+    print("usage:\n  python %s bios_image temp_dir\n" % sys.argv[0])
+    print("  bios_image  :  QEMU Slim Bootloader firmware image built with TEST_CRYPTO_KAT.")
+    print("  temp_dir    :  Directory to be used as the QEMU boot disk.")
+    print("")
+
+
+def main():
+    if sys.version_info.major < 3:
+        print ("This script needs Python3 !")
+        return -1
+
+    if len(sys.argv) != 3:
+        usage()
+        return -2
+
+    bios_img = sys.argv[1]
+    tmp_dir  = sys.argv[2]
+
+    print("Crypto known answer test for Slim BootLoader")
+
+    create_dirs ([tmp_dir])
+
+    ret = 0
+    for mode, cpu in get_cpu_models ():
+        # run QEMU boot with timeout
+        output = []
+        lines = run_qemu(bios_img, tmp_dir, timeout = 8, cpu = cpu)
+        output.extend(lines)
+
+        # the test is only built in with TEST_CRYPTO_KAT
+        if not any('Crypto KAT start' in line for line in output):
+            ret = check_result (output, [get_check_lines()[0], get_check_lines()[-1]])
+            print ('\nCrypto known answer test %s !\n' % ('SKIPPED' if ret == 0 else 'FAILED'))
+            return ret
+
+        # check test result
+        ret = check_result (output, get_check_lines())
+        if ret != 0:
+            break
+
+        result = parse_result (output)
+        if result is None:
+            print ("Failed parsing the crypto known answer test output !")
+            ret = -1
+            break
+
+        cpuid, checks, status = result
+        present = [name for name, flag, reg, bit in FEATURES if cpuid[reg] & (1 << bit)]
+        print ("Crypto KAT on %s CPU '%s': %d checks, extensions: %s" % (mode, cpu, checks, ', '.join(present) if present else 'none'))
+        if mode == 'scalar' and present:
+            print ("Failed to disable %s on the scalar CPU model !" % ', '.join(present))
+            ret = -1
+        elif status != 'Success':
+            print ("Crypto known answer test failed with %s !" % status)
+            ret = -1
+        elif checks != KAT_CHECKS:
+            print ("Expected %d checks !" % KAT_CHECKS)
+            ret = -1
+        if ret != 0:
+            break
+
+    print ('\nCrypto known answer test %s !\n' % ('PASSED' if ret == 0 else 'FAILED'))
+
+    return ret
+
+if __name__ == '__main__':
+    sys.exit(main())
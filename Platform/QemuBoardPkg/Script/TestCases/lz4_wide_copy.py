@@ -0,0 +1,123 @@
+#!/usr/bin/env python
+## @ lz4_wide_copy.py
+#
+# Check the LZ4 wide copy kernels against a byte by byte decode on QEMU
+#
+# The QEMU image needs to be built with TEST_LZ4_WIDE_COPY set in
+# Platform/QemuBoardPkg/Library/Stage2BoardInitLib/Stage2BoardTest.h.
+# The image is booted once on a CPU model with AVX2 and once without it,
+# so that both the AVX2 and the SSE2 kernel decode the test stream.
+#
+# Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+# SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+import os
+import re
+import sys
+from   test_base import *
+
+# Decodes done by RunLz4WideCopyTest, one per source/destination alignment
+LZ4_DECODES = 32
+
+# CPUID.(EAX=7,ECX=0):EBX bit reporting AVX2
+AVX2_BIT    = 5
+
+def get_check_lines ():
+    lines = [
+              "===== Intel Slim Bootloader STAGE2 ======",
+              "LZ4 wide copy test start",
+              "LZ4 wide copy test end",
+              "Jump to payload",
+            ]
+    return lines
+
+def get_cpu_models ():
+    return [('AVX2', 'max'), ('SSE2', 'max,-avx2')]
+
+def parse_result (output):
+    cpuid  = None
+    result = None
+    for line in output:
+        match = re.search(r'LZ4 wide copy test start: CPUID\.7:EBX ([0-9A-Fa-f]+)', line)
+        if match:
+            cpuid = int(match.group(1), 16)
+            continue
+        match = re.search(r'LZ4 wide copy test end: (\d+) decodes - (\w+)', line)
+        if match:
+            result = (int(match.group(1)), match.group(2))
+    if cpuid is None or result is None:
+        return None
+    return cpuid, result[0], result[1]
+
+def usage():
+    print("usage:\n  python %s bios_image temp_dir\n" % sys.argv[0])
+    print("  bios_image  :  QEMU Slim Bootloader firmware image built with TEST_LZ4_WIDE_COPY.")
+    print("  temp_dir    :  Directory to be used as the QEMU boot disk.")
+    print("")
+
+
+def main():
+    if sys.version_info.major < 3:
+        print ("This script needs Python3 !")
+        return -1
+
+    if len(sys.argv) != 3:
+        usage()
+        return -2
+
+    bios_img = sys.argv[1]
+    tmp_dir  = sys.argv[2]
+
+    print("LZ4 wide copy test for Slim BootLoader")
+
+    create_dirs ([tmp_dir])
+
+    ret = 0
+    for kernel, cpu in get_cpu_models ():
+        # run QEMU boot with timeout
+        output = []
+        lines = run_qemu(bios_img, tmp_dir, timeout = 8, cpu = cpu)
+        output.extend(lines)
+
+        # the test is only built in with TEST_LZ4_WIDE_COPY
+        if not any('LZ4 wide copy test start' in line for line in output):
+            ret = check_result (output, [get_check_lines()[0], get_check_lines()[-1]])
+            print ('\nLZ4 wide copy test %s !\n' % ('SKIPPED' if ret == 0 else 'FAILED'))
+            return ret
+
+        # check test result
+        ret = check_result (output, get_check_lines())
+        if ret != 0:
+            break
+
+        result = parse_result (output)
+        if result is None:
+            print ("Failed parsing the LZ4 wide copy test output !")
+            ret = -1
+            break
+
+        cpuid, decodes, status = result
+        avx2 = (cpuid & (1 << AVX2_BIT)) != 0
+        print ("LZ4 wide copy test on CPU '%s': %d decodes, AVX2 %s" % (cpu, decodes, 'present' if avx2 else 'absent'))
+        if kernel == 'SSE2' and avx2:
+            print ("Failed to disable AVX2 on the SSE2 CPU model !")
+            ret = -1
+        elif kernel == 'AVX2' and not avx2:
+            print ("QEMU does not provide AVX2, only the SSE2 kernel is checked")
+        if ret == 0 and status != 'Success':
+            print ("LZ4 wide copy test failed with %s !" % status)
+            ret = -1
+        elif ret == 0 and decodes != LZ4_DECODES:
+            print ("Expected %d decodes !" % LZ4_DECODES)
+            ret = -1
+        if ret != 0:
+            break
+
+    print ('\nLZ4 wide copy test %s !\n' % ('PASSED' if ret == 0 else 'FAILED'))
+
+    return ret
+
+if __name__ == '__main__':
+    sys.exit(main())
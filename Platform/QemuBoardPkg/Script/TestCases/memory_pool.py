@@ -0,0 +1,94 @@
+#!/usr/bin/env python
+## @ memory_pool.py
+#
+# Replay allocations and frees on the loader memory pool on QEMU
+#
+# The QEMU image needs to be built with TEST_MEMORY_POOL set in
+# Platform/QemuBoardPkg/Library/Stage2BoardInitLib/Stage2BoardTest.h.
+#
+# Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+# SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+import os
+import re
+import sys
+from   test_base import *
+
+# Checks done by RunMemoryPoolTest
+POOL_CHECKS = 6
+
+def get_check_lines ():
+    lines = [
+              "===== Intel Slim Bootloader STAGE2 ======",
+              "Memory pool test start",
+              "Memory pool test end",
+              "Jump to payload",
+            ]
+    return lines
+
+def parse_result (output):
+    for line in output:
+        match = re.search(r'Memory pool test end: (\d+) checks - (\w+)', line)
+        if match:
+            return int(match.group(1)), match.group(2)
+    return None
+
+def usage():
+    print("usage:\n  python %s bios_image temp_dir\n" % sys.argv[0])
+    print("  bios_image  :  QEMU Slim Bootloader firmware image built with TEST_MEMORY_POOL.")
+    print("  temp_dir    :  Directory to be used as the QEMU boot disk.")
+    print("")
+
+
+def main():
+    if sys.version_info.major < 3:
+        print ("This script needs Python3 !")
+        return -1
+
+    if len(sys.argv) != 3:
+        usage()
+        return -2
+
+    bios_img = sys.argv[1]
+    tmp_dir  = sys.argv[2]
+
+    print("Memory pool test for Slim BootLoader")
+
+    create_dirs ([tmp_dir])
+
+    # run QEMU boot with timeout
+    output = []
+    lines = run_qemu(bios_img, tmp_dir, timeout = 8)
+    output.extend(lines)
+
+    # the test is only built in with TEST_MEMORY_POOL
+    if not any('Memory pool test start' in line for line in output):
+        ret = check_result (output, [get_check_lines()[0], get_check_lines()[-1]])
+        print ('\nMemory pool test %s !\n' % ('SKIPPED' if ret == 0 else 'FAILED'))
+        return ret
+
+    # check test result
+    ret = check_result (output, get_check_lines())
+    if ret == 0:
+        result = parse_result (output)
+        if result is None:
+            print ("Failed parsing the memory pool test output !")
+            ret = -1
+        else:
+            checks, status = result
+            print ("Memory pool test: %d checks" % checks)
+            if status != 'Success':
+                print ("Memory pool test failed with %s !" % status)
+                ret = -1
+            elif checks != POOL_CHECKS:
+                print ("Expected %d checks !" % POOL_CHECKS)
+                ret = -1
+
+    print ('\nMemory pool test %s !\n' % ('PASSED' if ret == 0 else 'FAILED'))
+
+    return ret
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,164 @@
+#!/usr/bin/env python
+## @ variable_workload.py
+#
+# Replay a variable workload on QEMU and count the flash erase/program cycles
+#
+# The QEMU image needs to be built with TEST_VARIABLE_WORKLOAD set in
+# Platform/QemuBoardPkg/Library/Stage2BoardInitLib/Stage2BoardTest.h.
+#
+# Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+# SPDX-License-Identifier: BSD-2-Clause-Patent
+#
+##
+
+import os
+import re
+import sys
+from   test_base import *
+
+# Active half of the 8KB QEMU variable region
+STORE_SIZE      = 0x1000
+STORE_HDR_SIZE  = 16
+VAR_HDR_SIZE    = 4
+# Flash writes of a reclaim: variable image, store header and 3 store state updates
+RECLAIM_WRITES  = 5
+# Workload iterations, see ReplayVariableWorkload
+ITERATIONS      = 64
+# Variables left by the Stage1B and Stage2 variable tests before the replay
+BASE_VARIABLES  = {'VARTST0' : 4}
+BASE_COPIES     = 2
+
+def get_check_lines ():
+    lines = [
+              "===== Intel Slim Bootloader STAGE2 ======",
+              "Variable workload start",
+              "Variable workload end",
+              "Jump to payload",
+            ]
+    return lines
+
+def get_var_size (name, size):
+    return VAR_HDR_SIZE + len(name) + 1 + size
+
+def get_expected_cycles ():
+    # Variable updates of each batch, None to delete
+    batches = []
+    for idx in range(ITERATIONS):
+        updates = [('WKLDCNT', 4)]
+        if idx == 0:
+            # Later writes of the tuning data don't change the content
+            updates.append (('WKLDDLL', 32))
+        if idx % 4 == 0:
+            updates.append (('WKLDBLOB', 256))
+        batches.append (updates)
+    batches.append ([('WKLDCNT', None), ('WKLDDLL', None), ('WKLDBLOB', None)])
+
+    live  = dict((name, get_var_size (name, size)) for name, size in BASE_VARIABLES.items())
+    used  = STORE_HDR_SIZE + BASE_COPIES * sum(live.values())
+    erase = 0
+    write = 0
+    for updates in batches:
+        image   = sum(get_var_size (name, size) for name, size in updates if size is not None)
+        reclaim = used + image > STORE_SIZE
+        if not reclaim:
+            # All new copies at once, then per variable mark the old copy in
+            # migration, mark the new copy data valid and delete the old copy
+            write += 1 if image > 0 else 0
+            for name, size in updates:
+                if size is not None:
+                    write += 1
+                if name in live:
+                    write += 2 if size is not None else 1
+            used += image
+        else:
+            # The batch is merged into a reclaim
+            erase += 1
+            write += RECLAIM_WRITES
+        for name, size in updates:
+            if size is None:
+                live.pop (name, None)
+            else:
+                live[name] = get_var_size (name, size)
+        if reclaim:
+            used = STORE_HDR_SIZE + sum(live.values())
+    return erase, write
+
+def count_cycles (output):
+    start = None
+    for index, line in enumerate(output):
+        if 'Variable workload start' in line:
+            start = index
+        elif 'Variable workload end' in line and start is not None:
+            match = re.search(r'(\d+) iterations - (\w+)', line)
+            if not match:
+                return None
+            erase = sum('SPI ERASE:' in each for each in output[start:index])
+            write = sum('SPI WRITE:' in each for each in output[start:index])
+            return int(match.group(1)), match.group(2), erase, write
+    return None
+
+def usage():
+    print("usage:\n  python %s bios_image temp_dir\n" % sys.argv[0])
+    print("  bios_image  :  QEMU Slim Bootloader firmware image built with TEST_VARIABLE_WORKLOAD.")
+    print("                 The variable store in this image must not have replayed the workload yet.")
+    print("  temp_dir    :  Directory to be used as the QEMU boot disk.")
+    print("")
+
+
+def main():
+    if sys.version_info.major < 3:
+        print ("This script needs Python3 !")
+        return -1
+
+    if len(sys.argv) != 3:
+        usage()
+        return -2
+
+    bios_img = sys.argv[1]
+    tmp_dir  = sys.argv[2]
+
+    print("Variable workload test for Slim BootLoader")
+
+    create_dirs ([tmp_dir])
+
+    # run QEMU boot with timeout
+    output = []
+    lines = run_qemu(bios_img, tmp_dir, timeout = 8)
+    output.extend(lines)
+
+    # the replay is only built in with TEST_VARIABLE_WORKLOAD
+    if not any('Variable workload start' in line for line in output):
+        ret = check_result (output, [get_check_lines()[0], get_check_lines()[-1]])
+        print ('\nVariable workload test %s !\n' % ('SKIPPED' if ret == 0 else 'FAILED'))
+        return ret
+
+    # check test result
+    ret = check_result (output, get_check_lines())
+    if ret == 0:
+        result = count_cycles (output)
+        if result is None:
+            print ("Failed parsing the variable workload output !")
+            ret = -1
+        else:
+            iterations, status, erase, write = result
+            exp_erase, exp_write = get_expected_cycles ()
+            print ("Variable workload: %d iterations, %d flash erases, %d flash writes" % (iterations, erase, write))
+            if status != 'Success':
+                print ("Variable workload failed with %s !" % status)
+                ret = -1
+            elif iterations != ITERATIONS:
+                print ("Expected %d iterations !" % ITERATIONS)
+                ret = -1
+            elif erase != exp_erase:
+                print ("Expected %d flash erases !" % exp_erase)
+                ret = -1
+            elif write != exp_write:
+                print ("Expected %d flash writes !" % exp_write)
+                ret = -1
+
+    print ('\nVariable workload test %s !\n' % ('PASSED' if ret == 0 else 'FAILED'))
+
+    return ret
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -29,7 +29,11 @@ def main():
     # run test cases
     test_cases = [
       ('firmware_update.py',  [tst_img, fwu_dir]),
-      ('linux_boot.py'     ,  [tst_img, img_dir])
+      ('linux_boot.py'     ,  [tst_img, img_dir]),
+      ('variable_workload.py', [tst_img, tmp_dir]),
+      ('crypto_kat.py',        [tst_img, tmp_dir]),
+      ('lz4_wide_copy.py',     [tst_img, tmp_dir]),
+      ('memory_pool.py',       [tst_img, tmp_dir])
     ]
 
     for test_file, test_args in test_cases:
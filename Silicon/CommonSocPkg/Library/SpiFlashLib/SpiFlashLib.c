@@ -1,7 +1,7 @@
 /** @file
   SC SPI Common Driver implements the SPI Host Controller Compatibility Interface.
 
-  Copyright (c) 2017-2019, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2017-2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -32,6 +32,11 @@
 #define WAIT_TIME   6000000     ///< Wait Time = 6 seconds = 6000000 microseconds
 #define WAIT_PERIOD 10          ///< Wait Period = 10 microseconds
 
+//
+// The top of BIOS region is decoded right below 4GB, up to 16MB
+//
+#define BIOS_MMIO_WINDOW_SIZE   SIZE_16MB
+
 //
 // Flash cycle Type
 //
@@ -68,6 +73,7 @@ typedef struct {
   UINT32                StrapBaseAddress;
   UINT8                 NumberOfComponents;
   UINT32                Component1StartAddr;
+  UINT32                BiosRegionSize;
 } SPI_INSTANCE;
 
 const SPI_FLASH_SERVICE   mSpiFlashService = {
@@ -249,6 +255,14 @@ SpiConstructor (
   ///
   SpiInstance->StrapBaseAddress &= B_SPI_FDBAR_FPSBA;
 
+  ///
+  /// Get BIOS region size for the memory mapped reads
+  ///
+  Status = SpiGetRegionAddress (FlashRegionBios, NULL, &SpiInstance->BiosRegionSize);
+  if (EFI_ERROR (Status)) {
+    SpiInstance->BiosRegionSize = 0;
+  }
+
   ///
   /// Update Signature at the end of Constructor
   ///
@@ -260,9 +274,85 @@ SpiConstructor (
 }
 
 
+/**
+  Invalidate the cached copy of BIOS region data in the memory mapped window.
+
+  The memory mapped window is cacheable, while writes and erases go through
+  hardware sequencing cycles. The modified range has to be flushed from the
+  CPU cache so that later reads through the window return the new data.
+
+  @param[in] FlashRegionType      The Flash Region type of the modified range.
+  @param[in] Address              The Flash Linear Address of the modified range.
+  @param[in] ByteCount            Number of bytes modified.
+
+**/
+STATIC
+VOID
+InvalidateBiosWindow (
+  IN     FLASH_REGION_TYPE  FlashRegionType,
+  IN     UINT32             Address,
+  IN     UINT32             ByteCount
+  )
+{
+  SPI_INSTANCE      *SpiInstance;
+  UINT32            RgnSize;
+  UINT32            Skip;
+  UINT32            Ebx;
+  UINT32            LineSize;
+  UINT64            Line;
+  UINT64            End;
+
+  if (FlashRegionType != FlashRegionBios) {
+    return;
+  }
+
+  SpiInstance = GetSpiInstance();
+  if (SpiInstance == NULL) {
+    return;
+  }
+
+  ///
+  /// Clip the range to the part of the BIOS region in the window
+  ///
+  RgnSize = SpiInstance->BiosRegionSize;
+  if (Address >= RgnSize) {
+    return;
+  }
+  ByteCount = MIN (ByteCount, RgnSize - Address);
+  if (RgnSize - Address > BIOS_MMIO_WINDOW_SIZE) {
+    Skip = RgnSize - Address - BIOS_MMIO_WINDOW_SIZE;
+    if (ByteCount <= Skip) {
+      return;
+    }
+    Address   += Skip;
+    ByteCount -= Skip;
+  }
+
+  ///
+  /// CPUID.01H:EBX[15:8] is the CLFLUSH line size in 8 byte units
+  ///
+  AsmCpuid (1, NULL, &Ebx, NULL, NULL);
+  LineSize = ((Ebx >> 8) & 0xFF) * 8;
+  if (LineSize == 0) {
+    LineSize = 64;
+  }
+
+  ///
+  /// BIOS region ends at 4GB, so the host address is (Address - RgnSize)
+  ///
+  Line = (UINT32)(Address - RgnSize) & ~(LineSize - 1);
+  End  = (UINT64)(UINT32)(Address - RgnSize) + ByteCount;
+  for (; Line < End; Line += LineSize) {
+    AsmFlushCacheLine ((VOID *)(UINTN)Line);
+  }
+}
+
 /**
   Read data from the flash part.
 
+  BIOS region data within the memory mapped window below 4GB is copied directly
+  from the window. Other data is read through hardware sequencing cycles.
+
   @param[in] FlashRegionType      The Flash Region type for flash cycle which is listed in the Descriptor.
   @param[in] Address              The Flash Linear Address must fall within a region for which BIOS has access permissions.
   @param[in] ByteCount            Number of bytes in the data portion of the SPI cycle.
@@ -283,6 +373,23 @@ SpiFlashRead (
   )
 {
   EFI_STATUS        Status;
+  SPI_INSTANCE      *SpiInstance;
+  UINT32            RgnSize;
+
+  if (FlashRegionType == FlashRegionBios) {
+    SpiInstance = GetSpiInstance();
+    if ((SpiInstance != NULL) && ((SpiInstance->RegionPermission & B_SPI_FRAP_BRRA_BIOS) != 0)) {
+      RgnSize = SpiInstance->BiosRegionSize;
+      if ((Address < RgnSize) && (ByteCount <= RgnSize - Address) &&
+          (RgnSize - Address <= BIOS_MMIO_WINDOW_SIZE)) {
+        ///
+        /// BIOS region ends at 4GB, so the host address is (Address - RgnSize)
+        ///
+        CopyMem (Buffer, (VOID *)(UINTN)(UINT32)(Address - RgnSize), ByteCount);
+        return EFI_SUCCESS;
+      }
+    }
+  }
 
   ///
   /// Sends the command to the SPI interface to execute.
@@ -330,6 +437,12 @@ SpiFlashWrite (
              ByteCount,
              Buffer
              );
+
+  ///
+  /// Drop stale data from the memory mapped window even if the write failed
+  /// half way through.
+  ///
+  InvalidateBiosWindow (FlashRegionType, Address, ByteCount);
   return Status;
 }
 
@@ -364,6 +477,12 @@ SpiFlashErase (
              ByteCount,
              NULL
              );
+
+  ///
+  /// Drop stale data from the memory mapped window even if the erase failed
+  /// half way through.
+  ///
+  InvalidateBiosWindow (FlashRegionType, Address, ByteCount);
   return Status;
 }
 
@@ -615,6 +734,7 @@ SendSpiCmd (
   UINT16          PermissionBit;
   UINT32          SpiDataCount;
   UINT32          FlashCycle;
+  UINT32          Boundary;
   UINT8           BiosCtlSave;
   SPI_INSTANCE    *SpiInstance;
 
@@ -778,14 +898,18 @@ SendSpiCmd (
     SpiDataCount = ByteCount;
     if ((FlashCycleType == FlashCycleRead) || (FlashCycleType == FlashCycleWrite)) {
       ///
-      /// Trim at 256 byte boundary per operation,
+      /// Trim at 4KB boundary for read and 256 byte boundary for write per operation,
       /// - SC SPI controller requires trimming at 4KB boundary
       /// - Some SPI chips require trimming at 256 byte boundary for write operation
-      /// - Trimming has limited performance impact as we can read / write at most 64 byte
-      ///   per operation
+      /// - Reads keep the maximal 64 byte burst until the next 4KB boundary
       ///
-      if (HardwareSpiAddr + ByteCount > ((HardwareSpiAddr + BIT8) &~(BIT8 - 1))) {
-        SpiDataCount = (((UINT32) (HardwareSpiAddr) + BIT8) &~(BIT8 - 1)) - (UINT32) (HardwareSpiAddr);
+      if (FlashCycleType == FlashCycleRead) {
+        Boundary = SIZE_4KB;
+      } else {
+        Boundary = BIT8;
+      }
+      if (HardwareSpiAddr + ByteCount > ((HardwareSpiAddr + Boundary) &~(Boundary - 1))) {
+        SpiDataCount = (((UINT32) (HardwareSpiAddr) + Boundary) &~(Boundary - 1)) - (UINT32) (HardwareSpiAddr);
       }
       ///
       /// Calculate the number of bytes to shift in/out during the SPI data cycle.